@@ -0,0 +1,133 @@
+/* *********************************************************************
+
+        Copyright (c) 2010 - 2015 Codeux Software, LLC
+     Please see ACKNOWLEDGEMENT for additional information.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+
+ * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+ * Neither the name of "Codeux Software, LLC", nor the names of its 
+   contributors may be used to endorse or promote products derived 
+   from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ SUCH DAMAGE.
+
+ *********************************************************************** */
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+@class OTRKitBenchmarkReport, OTRKitSimulation;
+
+/**
+ *  Runs suites of measurements against two OTRKit instances, "alice"
+ *  and "bob", that are wired back to back. See OTRKitBenchmarkPeer
+ *
+ *  Suites:
+ *  - ake: time for a new pair of peers to become encrypted
+ *  - throughput: messages per second that are encoded, decoded, and
+ *    sent from one peer to the other, for each message size
+ *  - fragmentation: the same as throughput for each maximum protocol size
+ *  - smp: time for a peer to verify the other using SMP
+ *  - fingerprints: time to load, look up, and write fingerprint stores
+ *    for each number of fingerprints
+ *  - classify: messages per second classified by -typeOfMessage:, and
+ *    by the baseline of a queue hop, a UTF-8 copy and libotr
+ *  - network: conversations established and used over a simulated
+ *    network with latency, loss, duplication, and reordering that is
+ *    driven by a virtual clock. See OTRKitSimulation
+ *  - replay: throughput and latency of a trace recorded by
+ *    OTRKitTrafficRecorder. See OTRKitTrafficReplay
+ *
+ *  The private keys of alice and bob are generated once and copied to
+ *  each new pair. Key generation is not part of any other measurement.
+ */
+@interface OTRKitBenchmark : NSObject
+/**
+ *  @param workingDirectory	Where the data paths of the peers are created.
+ *							It is created if it does not exist.
+ */
+- (instancetype)initWithWorkingDirectory:(NSString *)workingDirectory report:(OTRKitBenchmarkReport *)report;
+
+@property (readonly, copy) NSString *workingDirectory;
+@property (readonly) OTRKitBenchmarkReport *report;
+
++ (NSArray<NSString *> *)suiteNames;
+
+/**
+ *  Number of times measurements made of samples are repeated (ake, smp).
+ *  Default value for property is 10.
+ */
+@property (assign) NSUInteger iterations;
+
+/**
+ *  Number of messages sent for each throughput measurement.
+ *  Default value for property is 1000.
+ */
+@property (assign) NSUInteger messageCount;
+
+/**
+ *  Default value for property is 16, 256, 1024, 4096, and 16384.
+ */
+@property (copy) NSArray<NSNumber *> *messageSizes;
+
+/**
+ *  Maximum protocol sizes of the fragmentation suite. Zero disables
+ *  fragmentation. Default value for property is 0, 400 (prpl-irc),
+ *  and 1409 (prpl-msn).
+ */
+@property (copy) NSArray<NSNumber *> *maximumProtocolSizes;
+
+/**
+ *  Default value for property is 1000, 10000, and 100000.
+ */
+@property (copy) NSArray<NSNumber *> *fingerprintCounts;
+
+/**
+ *  Configuration of the network suite. Its timeout is set to the
+ *  timeout of the benchmark when the suite is run.
+ */
+@property (readonly) OTRKitSimulation *simulation;
+
+/**
+ *  Trace replayed by the replay suite, which is skipped when it is nil.
+ *  Default value for property is nil.
+ */
+@property (copy, nullable) NSString *tracePath;
+
+/**
+ *  Whether the replay suite sends messages at the time they were recorded
+ *  rather than as fast as possible. Default value for property is NO.
+ */
+@property (assign) BOOL replaysAtRecordedPace;
+
+/**
+ *  How long to wait for anything before a measurement is abandoned.
+ *  Default value for property is 120 seconds.
+ */
+@property (assign) NSTimeInterval timeout;
+
+/**
+ *  @return NO if the suite is unknown or any measurement failed
+ */
+- (BOOL)runSuite:(NSString *)suite;
+@end
+
+NS_ASSUME_NONNULL_END
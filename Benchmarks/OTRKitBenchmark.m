@@ -0,0 +1,845 @@
+/* *********************************************************************
+
+        Copyright (c) 2010 - 2015 Codeux Software, LLC
+     Please see ACKNOWLEDGEMENT for additional information.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+
+ * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+ * Neither the name of "Codeux Software, LLC", nor the names of its 
+   contributors may be used to endorse or promote products derived 
+   from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ SUCH DAMAGE.
+
+ *********************************************************************** */
+
+#import "OTRKitBenchmark.h"
+#import "OTRKitBenchmarkPeer.h"
+#import "OTRKitBenchmarkReport.h"
+#import "OTRKitSimulation.h"
+#import "OTRKitTrafficReplay.h"
+
+#import "libotr/proto.h"
+
+static NSString * const OTRKitBenchmarkProtocol = @"prpl-benchmark";
+
+static NSString * const OTRKitBenchmarkSMPSecret = @"benchmark";
+
+static NSString *OTRKitBenchmarkMessageOfSize(NSUInteger size)
+{
+	static const char alphabet[] = "abcdefghijklmnopqrstuvwxyz0123456789 ";
+
+	NSMutableData *messageData = [NSMutableData dataWithLength:size];
+
+	char *messageBytes = [messageData mutableBytes];
+
+	for (NSUInteger i = 0; i < size; i++) {
+		messageBytes[i] = alphabet[(i % (sizeof(alphabet) - 1))];
+	}
+
+	return [[NSString alloc] initWithData:messageData encoding:NSUTF8StringEncoding];
+}
+
+@interface OTRKitBenchmark ()
+@property (readwrite, copy) NSString *workingDirectory;
+@property (readwrite, strong) OTRKitBenchmarkReport *report;
+@property (readwrite, strong) OTRKitSimulation *simulation;
+@property (nonatomic, copy) NSDictionary<NSString *, NSString *> *privateKeyPaths;
+@end
+
+@implementation OTRKitBenchmark
+
+- (instancetype)initWithWorkingDirectory:(NSString *)workingDirectory report:(OTRKitBenchmarkReport *)report
+{
+	AssertParamaterLength(workingDirectory)
+	AssertParamaterNil(report)
+
+	if ((self = [super init])) {
+		self.workingDirectory = workingDirectory;
+
+		self.report = report;
+
+		self.iterations = 10;
+
+		self.messageCount = 1000;
+
+		self.messageSizes = @[@(16), @(256), @(1024), @(4096), @(16384)];
+
+		self.maximumProtocolSizes = @[@(0), @(400), @(1409)];
+
+		self.fingerprintCounts = @[@(1000), @(10000), @(100000)];
+
+		self.simulation = [[OTRKitSimulation alloc] initWithWorkingDirectory:workingDirectory];
+
+		self.timeout = 120;
+
+		return self;
+	}
+
+	return nil;
+}
+
++ (NSArray<NSString *> *)suiteNames
+{
+	return @[@"ake", @"throughput", @"fragmentation", @"smp", @"fingerprints", @"classify", @"network", @"replay"];
+}
+
+- (BOOL)runSuite:(NSString *)suite
+{
+	AssertParamaterLength(suite)
+
+	OTRKitBenchmarkLog(@"Running suite '%@'", suite);
+
+	if ([suite isEqualToString:@"ake"]) {
+		return [self _runAKESuite];
+	} else if ([suite isEqualToString:@"throughput"]) {
+		return [self _runThroughputSuite];
+	} else if ([suite isEqualToString:@"fragmentation"]) {
+		return [self _runFragmentationSuite];
+	} else if ([suite isEqualToString:@"smp"]) {
+		return [self _runSMPSuite];
+	} else if ([suite isEqualToString:@"fingerprints"]) {
+		return [self _runFingerprintsSuite];
+	} else if ([suite isEqualToString:@"classify"]) {
+		return [self _runClassifySuite];
+	} else if ([suite isEqualToString:@"network"]) {
+		return [self _runNetworkSuite];
+	} else if ([suite isEqualToString:@"replay"]) {
+		return [self _runReplaySuite];
+	}
+
+	OTRKitBenchmarkLog(@"Unknown suite '%@'", suite);
+
+	return NO;
+}
+
+#pragma mark -
+#pragma mark Peers
+
+- (NSString *)_createDirectoryNamed:(NSString *)name
+{
+	NSString *path = [self.workingDirectory stringByAppendingPathComponent:name];
+
+	NSError *createError = nil;
+
+	if ([[NSFileManager defaultManager] createDirectoryAtPath:path withIntermediateDirectories:YES attributes:nil error:&createError] == NO) {
+		LogToConsole(@"Failed to create directory '%@': %@", path, [createError localizedDescription])
+
+		return nil;
+	}
+
+	return path;
+}
+
+- (BOOL)_preparePrivateKeys
+{
+	if (self.privateKeyPaths) {
+		return YES;
+	}
+
+	NSMutableDictionary *privateKeyPaths = [NSMutableDictionary dictionary];
+
+	NSMutableArray *samples = [NSMutableArray array];
+
+	for (NSString *name in @[@"alice", @"bob"]) {
+		NSString *dataPath = [self _createDirectoryNamed:[@"keys" stringByAppendingPathComponent:name]];
+
+		if (dataPath == nil) {
+			return NO;
+		}
+
+		OTRKitBenchmarkPeer *peer = [[OTRKitBenchmarkPeer alloc] initWithName:name protocol:OTRKitBenchmarkProtocol dataPath:dataPath];
+
+		CFAbsoluteTime generateStart = CFAbsoluteTimeGetCurrent();
+
+		if ([peer generatePrivateKeyWithTimeout:self.timeout] == NO) {
+			[self.report addFailureForSuite:@"setup" name:@"key_generation" reason:@"The private key could not be generated"];
+
+			return NO;
+		}
+
+		[samples addObject:@(CFAbsoluteTimeGetCurrent() - generateStart)];
+
+		privateKeyPaths[name] = [[peer otrKit] privateKeyPath];
+	}
+
+	[self.report addResultForSuite:@"setup" name:@"key_generation" samples:samples unit:@"seconds" parameters:nil];
+
+	self.privateKeyPaths = privateKeyPaths;
+
+	return YES;
+}
+
+- (NSArray<OTRKitBenchmarkPeer *> *)_newPairNamed:(NSString *)pairName
+{
+	if ([self _preparePrivateKeys] == NO) {
+		return nil;
+	}
+
+	NSMutableArray *peers = [NSMutableArray arrayWithCapacity:2];
+
+	for (NSString *name in @[@"alice", @"bob"]) {
+		NSString *dataPath = [self _createDirectoryNamed:[pairName stringByAppendingPathComponent:name]];
+
+		if (dataPath == nil) {
+			return nil;
+		}
+
+		NSString *privateKeyPath = self.privateKeyPaths[name];
+
+		NSString *privateKeyCopyPath = [dataPath stringByAppendingPathComponent:[privateKeyPath lastPathComponent]];
+
+		NSError *copyError = nil;
+
+		if ([[NSFileManager defaultManager] copyItemAtPath:privateKeyPath toPath:privateKeyCopyPath error:&copyError] == NO) {
+			LogToConsole(@"Failed to copy private key of '%@': %@", name, [copyError localizedDescription])
+
+			return nil;
+		}
+
+		OTRKitBenchmarkPeer *peer = [[OTRKitBenchmarkPeer alloc] initWithName:name protocol:OTRKitBenchmarkProtocol dataPath:dataPath];
+
+		[peers addObject:peer];
+	}
+
+	OTRKitBenchmarkPeer *alice = peers[0];
+	OTRKitBenchmarkPeer *bob = peers[1];
+
+	alice.remotePeer = bob;
+	bob.remotePeer = alice;
+
+	/* The files are loaded on the internal queue. A synchronous
+	 operation waits for them so that loading is never measured. */
+	for (OTRKitBenchmarkPeer *peer in peers) {
+		(void)[[peer otrKit] messageStateForUsername:[[peer remotePeer] accountName]
+										 accountName:[peer accountName]
+											protocol:[peer protocol]];
+	}
+
+	return peers;
+}
+
+- (BOOL)_waitForPeer:(OTRKitBenchmarkPeer *)peer toReachMessageState:(OTRKitMessageState)messageState
+{
+	return [peer waitUntil:^BOOL(OTRKitBenchmarkPeer *waitingPeer) {
+		return ([waitingPeer messageState] == messageState);
+	} timeout:self.timeout];
+}
+
+- (BOOL)_establishEncryptionBetweenPeers:(NSArray<OTRKitBenchmarkPeer *> *)peers
+{
+	OTRKitBenchmarkPeer *alice = peers[0];
+	OTRKitBenchmarkPeer *bob = peers[1];
+
+	[alice initiateEncryption];
+
+	return ([self _waitForPeer:alice toReachMessageState:OTRKitMessageStateEncrypted] &&
+			[self _waitForPeer:bob toReachMessageState:OTRKitMessageStateEncrypted]);
+}
+
+- (NSArray<OTRKitBenchmarkPeer *> *)_newEncryptedPairNamed:(NSString *)pairName forSuite:(NSString *)suite
+{
+	NSArray *peers = [self _newPairNamed:pairName];
+
+	if (peers == nil) {
+		[self.report addFailureForSuite:suite name:@"setup" reason:@"The peers could not be created"];
+
+		return nil;
+	}
+
+	if ([self _establishEncryptionBetweenPeers:peers] == NO) {
+		[self.report addFailureForSuite:suite name:@"setup" reason:@"The peers did not become encrypted in time"];
+
+		return nil;
+	}
+
+	return peers;
+}
+
+#pragma mark -
+#pragma mark Messages
+
+- (BOOL)_waitForPeer:(OTRKitBenchmarkPeer *)peer toDecodeMessageCount:(NSUInteger)decodedMessageCount
+{
+	return [peer waitUntil:^BOOL(OTRKitBenchmarkPeer *waitingPeer) {
+		return ([waitingPeer decodedMessageCount] >= decodedMessageCount);
+	} timeout:self.timeout];
+}
+
+/* Returns the time for the receiver to decode every message, or a negative value on timeout */
+- (NSTimeInterval)_timeToSendMessage:(NSString *)message count:(NSUInteger)count fromPeer:(OTRKitBenchmarkPeer *)sender
+{
+	OTRKitBenchmarkPeer *receiver = [sender remotePeer];
+
+	NSUInteger expectedCount = ([receiver decodedMessageCount] + count);
+
+	CFAbsoluteTime sendStart = CFAbsoluteTimeGetCurrent();
+
+	for (NSUInteger i = 0; i < count; i++) {
+		[sender encodeMessage:message];
+	}
+
+	if ([self _waitForPeer:receiver toDecodeMessageCount:expectedCount] == NO) {
+		return (-1);
+	}
+
+	return (CFAbsoluteTimeGetCurrent() - sendStart);
+}
+
+/* Returns the time for the sender to encode every message, or a negative
+ value on timeout. The messages to send are captured instead of sent. */
+- (NSTimeInterval)_timeToEncodeMessage:(NSString *)message count:(NSUInteger)count byPeer:(OTRKitBenchmarkPeer *)sender capturedMessages:(NSArray<NSString *> **)capturedMessages
+{
+	NSUInteger expectedCount = ([sender encodedMessageCount] + count);
+
+	sender.capturesInjectedMessages = YES;
+
+	CFAbsoluteTime encodeStart = CFAbsoluteTimeGetCurrent();
+
+	for (NSUInteger i = 0; i < count; i++) {
+		[sender encodeMessage:message];
+	}
+
+	BOOL encoded = [sender waitUntil:^BOOL(OTRKitBenchmarkPeer *waitingPeer) {
+		return ([waitingPeer encodedMessageCount] >= expectedCount);
+	} timeout:self.timeout];
+
+	CFAbsoluteTime encodeEnd = CFAbsoluteTimeGetCurrent();
+
+	sender.capturesInjectedMessages = NO;
+
+	*capturedMessages = [sender takeCapturedMessages];
+
+	if (encoded == NO) {
+		return (-1);
+	}
+
+	return (encodeEnd - encodeStart);
+}
+
+- (NSTimeInterval)_timeToDecodeMessages:(NSArray<NSString *> *)messages count:(NSUInteger)count byPeer:(OTRKitBenchmarkPeer *)receiver
+{
+	NSUInteger expectedCount = ([receiver decodedMessageCount] + count);
+
+	CFAbsoluteTime decodeStart = CFAbsoluteTimeGetCurrent();
+
+	for (NSString *message in messages) {
+		[receiver decodeMessage:message];
+	}
+
+	if ([self _waitForPeer:receiver toDecodeMessageCount:expectedCount] == NO) {
+		return (-1);
+	}
+
+	return (CFAbsoluteTimeGetCurrent() - decodeStart);
+}
+
+#pragma mark -
+#pragma mark Suites
+
+- (BOOL)_runAKESuite
+{
+	NSMutableArray *samples = [NSMutableArray arrayWithCapacity:self.iterations];
+
+	NSMutableArray *messageCounts = [NSMutableArray arrayWithCapacity:self.iterations];
+
+	for (NSUInteger i = 0; i < self.iterations; i++) {
+		@autoreleasepool {
+			NSArray *peers = [self _newPairNamed:[NSString stringWithFormat:@"ake-%lu", (unsigned long)i]];
+
+			if (peers == nil) {
+				[self.report addFailureForSuite:@"ake" name:@"completion_time" reason:@"The peers could not be created"];
+
+				return NO;
+			}
+
+			CFAbsoluteTime exchangeStart = CFAbsoluteTimeGetCurrent();
+
+			if ([self _establishEncryptionBetweenPeers:peers] == NO) {
+				[self.report addFailureForSuite:@"ake" name:@"completion_time" reason:@"The peers did not become encrypted in time"];
+
+				return NO;
+			}
+
+			[samples addObject:@(CFAbsoluteTimeGetCurrent() - exchangeStart)];
+
+			[messageCounts addObject:@([peers[0] injectedMessageCount] + [peers[1] injectedMessageCount])];
+		}
+	}
+
+	[self.report addResultForSuite:@"ake" name:@"completion_time" samples:samples unit:@"seconds" parameters:nil];
+
+	[self.report addResultForSuite:@"ake" name:@"messages_exchanged" samples:messageCounts unit:@"messages" parameters:nil];
+
+	return YES;
+}
+
+- (BOOL)_runThroughputSuite
+{
+	NSArray *peers = [self _newEncryptedPairNamed:@"throughput" forSuite:@"throughput"];
+
+	if (peers == nil) {
+		return NO;
+	}
+
+	OTRKitBenchmarkPeer *alice = peers[0];
+	OTRKitBenchmarkPeer *bob = peers[1];
+
+	NSUInteger messageCount = self.messageCount;
+
+	for (NSNumber *messageSize in self.messageSizes) {
+		@autoreleasepool {
+			NSString *message = OTRKitBenchmarkMessageOfSize([messageSize unsignedIntegerValue]);
+
+			NSDictionary *parameters = @{@"message_size" : messageSize, @"message_count" : @(messageCount)};
+
+			/* Both sides of the loopback */
+			NSTimeInterval sendDuration = [self _timeToSendMessage:message count:messageCount fromPeer:alice];
+
+			if (sendDuration < 0) {
+				[self.report addFailureForSuite:@"throughput" name:@"end_to_end" reason:@"The messages were not received in time"];
+
+				return NO;
+			}
+
+			[self.report addResultForSuite:@"throughput" name:@"end_to_end" value:(messageCount / sendDuration) unit:@"messages_per_second" parameters:parameters];
+
+			/* Each side on its own. The encoded messages are
+			 captured so that they can be decoded in isolation. */
+			NSArray *capturedMessages = nil;
+
+			NSTimeInterval encodeDuration = [self _timeToEncodeMessage:message count:messageCount byPeer:alice capturedMessages:&capturedMessages];
+
+			if (encodeDuration < 0) {
+				[self.report addFailureForSuite:@"throughput" name:@"encode" reason:@"The messages were not encoded in time"];
+
+				return NO;
+			}
+
+			[self.report addResultForSuite:@"throughput" name:@"encode" value:(messageCount / encodeDuration) unit:@"messages_per_second" parameters:parameters];
+
+			NSTimeInterval decodeDuration = [self _timeToDecodeMessages:capturedMessages count:messageCount byPeer:bob];
+
+			if (decodeDuration < 0) {
+				[self.report addFailureForSuite:@"throughput" name:@"decode" reason:@"The messages were not decoded in time"];
+
+				return NO;
+			}
+
+			[self.report addResultForSuite:@"throughput" name:@"decode" value:(messageCount / decodeDuration) unit:@"messages_per_second" parameters:parameters];
+		}
+	}
+
+	return YES;
+}
+
+- (BOOL)_runFragmentationSuite
+{
+	NSArray *peers = [self _newEncryptedPairNamed:@"fragmentation" forSuite:@"fragmentation"];
+
+	if (peers == nil) {
+		return NO;
+	}
+
+	OTRKitBenchmarkPeer *alice = peers[0];
+
+	NSUInteger messageCount = self.messageCount;
+
+	BOOL succeeded = YES;
+
+	for (NSNumber *maximumProtocolSize in self.maximumProtocolSizes) {
+		[[alice otrKit] setMaximumProtocolSize:[maximumProtocolSize intValue] forProtocol:[alice protocol]];
+
+		for (NSNumber *messageSize in self.messageSizes) {
+			@autoreleasepool {
+				NSString *message = OTRKitBenchmarkMessageOfSize([messageSize unsignedIntegerValue]);
+
+				NSDictionary *parameters = @{@"message_size" : messageSize, @"message_count" : @(messageCount), @"maximum_protocol_size" : maximumProtocolSize};
+
+				NSUInteger injectedMessageCount = [alice injectedMessageCount];
+
+				NSTimeInterval sendDuration = [self _timeToSendMessage:message count:messageCount fromPeer:alice];
+
+				if (sendDuration < 0) {
+					[self.report addFailureForSuite:@"fragmentation" name:@"end_to_end" reason:@"The messages were not received in time"];
+
+					succeeded = NO;
+
+					break;
+				}
+
+				double fragmentsPerMessage = ((double)([alice injectedMessageCount] - injectedMessageCount) / messageCount);
+
+				[self.report addResultForSuite:@"fragmentation" name:@"end_to_end" value:(messageCount / sendDuration) unit:@"messages_per_second" parameters:parameters];
+
+				[self.report addResultForSuite:@"fragmentation" name:@"fragments_per_message" value:fragmentsPerMessage unit:@"fragments" parameters:parameters];
+			}
+		}
+
+		if (succeeded == NO) {
+			break;
+		}
+	}
+
+	[[alice otrKit] setMaximumProtocolSize:0 forProtocol:[alice protocol]];
+
+	return succeeded;
+}
+
+- (BOOL)_runSMPSuite
+{
+	NSArray *peers = [self _newEncryptedPairNamed:@"smp" forSuite:@"smp"];
+
+	if (peers == nil) {
+		return NO;
+	}
+
+	OTRKitBenchmarkPeer *alice = peers[0];
+	OTRKitBenchmarkPeer *bob = peers[1];
+
+	bob.smpSecret = OTRKitBenchmarkSMPSecret;
+
+	NSMutableArray *samples = [NSMutableArray arrayWithCapacity:self.iterations];
+
+	for (NSUInteger i = 0; i < self.iterations; i++) {
+		NSUInteger aliceSuccessCount = ([alice smpSuccessCount] + 1);
+		NSUInteger bobSuccessCount = ([bob smpSuccessCount] + 1);
+
+		NSUInteger aliceFailureCount = [alice smpFailureCount];
+
+		CFAbsoluteTime smpStart = CFAbsoluteTimeGetCurrent();
+
+		[alice initiateSMPWithSecret:OTRKitBenchmarkSMPSecret];
+
+		/* alice learns the result last, after the fourth SMP message */
+		BOOL finished = [alice waitUntil:^BOOL(OTRKitBenchmarkPeer *waitingPeer) {
+			return ([waitingPeer smpSuccessCount] >= aliceSuccessCount ||
+					[waitingPeer smpFailureCount] > aliceFailureCount);
+		} timeout:self.timeout];
+
+		CFAbsoluteTime smpEnd = CFAbsoluteTimeGetCurrent();
+
+		if (finished == NO || [alice smpSuccessCount] < aliceSuccessCount) {
+			[self.report addFailureForSuite:@"smp" name:@"round_trip_time" reason:@"SMP did not succeed in time"];
+
+			return NO;
+		}
+
+		BOOL bobFinished = [bob waitUntil:^BOOL(OTRKitBenchmarkPeer *waitingPeer) {
+			return ([waitingPeer smpSuccessCount] >= bobSuccessCount);
+		} timeout:self.timeout];
+
+		if (bobFinished == NO) {
+			[self.report addFailureForSuite:@"smp" name:@"round_trip_time" reason:@"SMP did not succeed for the responder"];
+
+			return NO;
+		}
+
+		[samples addObject:@(smpEnd - smpStart)];
+	}
+
+	[self.report addResultForSuite:@"smp" name:@"round_trip_time" samples:samples unit:@"seconds" parameters:nil];
+
+	return YES;
+}
+
+#pragma mark -
+#pragma mark Fingerprints
+
+- (OTRKit *)_newOTRKitWithDataPath:(NSString *)dataPath
+{
+	OTRKit *otrKit = [OTRKit new];
+
+	otrKit.delegateQueue = dispatch_queue_create("OTRKitBenchmark.fingerprints", DISPATCH_QUEUE_SERIAL);
+
+	[otrKit setupWithDataPath:dataPath];
+
+	[otrKit waitUntilLoaded];
+
+	return otrKit;
+}
+
+- (NSString *)_usernameOfFingerprintAtIndex:(NSUInteger)index
+{
+	return [NSString stringWithFormat:@"user%lu@benchmark", (unsigned long)index];
+}
+
+- (BOOL)_writeFingerprintsFileAtPath:(NSString *)path count:(NSUInteger)count
+{
+	NSMutableData *fileData = [NSMutableData dataWithCapacity:(count * 100)];
+
+	uint32_t state = 2166136261u;
+
+	for (NSUInteger i = 0; i < count; i++) {
+		char line[256];
+
+		uint32_t fingerprint[5];
+
+		for (NSUInteger j = 0; j < 5; j++) {
+			state = ((state * 1664525u) + 1013904223u);
+
+			fingerprint[j] = state;
+		}
+
+		/* Every tenth fingerprint is verified */
+		int lineLength =
+		snprintf(line, sizeof(line), "user%lu@benchmark\talice@benchmark\t%s\t%08x%08x%08x%08x%08x%s\n",
+				 (unsigned long)i,
+				 [OTRKitBenchmarkProtocol UTF8String],
+				 fingerprint[0], fingerprint[1], fingerprint[2], fingerprint[3], fingerprint[4],
+				 (((i % 10) == 0) ? "\tverified" : ""));
+
+		[fileData appendBytes:line length:lineLength];
+	}
+
+	return [fileData writeToFile:path atomically:YES];
+}
+
+- (NSTimeInterval)_timeToLookUpContextsOfOTRKit:(OTRKit *)otrKit count:(NSUInteger)count
+{
+	CFAbsoluteTime lookupStart = CFAbsoluteTimeGetCurrent();
+
+	for (NSUInteger i = 0; i < count; i++) {
+		@autoreleasepool {
+			(void)[otrKit messageStateForUsername:[self _usernameOfFingerprintAtIndex:i]
+									  accountName:@"alice@benchmark"
+										 protocol:OTRKitBenchmarkProtocol];
+		}
+	}
+
+	return (CFAbsoluteTimeGetCurrent() - lookupStart);
+}
+
+- (BOOL)_runFingerprintsSuite
+{
+	NSString *probePath = [self _createDirectoryNamed:@"fingerprints-probe"];
+
+	if (probePath == nil) {
+		return NO;
+	}
+
+	NSString *fingerprintsFileName = [[[self _newOTRKitWithDataPath:probePath] fingerprintsPath] lastPathComponent];
+
+	for (NSNumber *fingerprintCount in self.fingerprintCounts) {
+		@autoreleasepool {
+			NSUInteger count = [fingerprintCount unsignedIntegerValue];
+
+			NSDictionary *parameters = @{@"fingerprint_count" : fingerprintCount};
+
+			NSString *dataPath = [self _createDirectoryNamed:[NSString stringWithFormat:@"fingerprints-%lu", (unsigned long)count]];
+
+			if (dataPath == nil ||
+				[self _writeFingerprintsFileAtPath:[dataPath stringByAppendingPathComponent:fingerprintsFileName] count:count] == NO)
+			{
+				[self.report addFailureForSuite:@"fingerprints" name:@"setup" reason:@"The fingerprints file could not be written"];
+
+				return NO;
+			}
+
+			/* The first load parses the file and saves a snapshot of it */
+			CFAbsoluteTime loadStart = CFAbsoluteTimeGetCurrent();
+
+			OTRKit *otrKit = [self _newOTRKitWithDataPath:dataPath];
+
+			NSTimeInterval loadDuration = (CFAbsoluteTimeGetCurrent() - loadStart);
+
+			OTRKitLoadStatistics *loadStatistics = [otrKit loadStatistics];
+
+			[self.report addResultForSuite:@"fingerprints" name:@"load_file" value:loadDuration unit:@"seconds" parameters:parameters];
+
+			[self.report addResultForSuite:@"fingerprints" name:@"parse_file" value:[loadStatistics fingerprintsReadDuration] unit:@"seconds" parameters:parameters];
+
+			[self.report addResultForSuite:@"fingerprints" name:@"create_snapshot" value:[loadStatistics snapshotCreateDuration] unit:@"seconds" parameters:parameters];
+
+			otrKit = nil;
+
+			/* Later loads read the snapshot */
+			loadStart = CFAbsoluteTimeGetCurrent();
+
+			otrKit = [self _newOTRKitWithDataPath:dataPath];
+
+			loadDuration = (CFAbsoluteTimeGetCurrent() - loadStart);
+
+			loadStatistics = [otrKit loadStatistics];
+
+			if ([loadStatistics snapshotLoadCount] > 0) {
+				[self.report addResultForSuite:@"fingerprints" name:@"load_snapshot" value:loadDuration unit:@"seconds" parameters:parameters];
+			}
+
+			/* Each lookup finds the context that the fingerprint was loaded into.
+			 The first pass finds each context for the first time. The second
+			 pass finds them again once they are known to OTRKit. */
+			NSTimeInterval lookupDuration = [self _timeToLookUpContextsOfOTRKit:otrKit count:count];
+
+			[self.report addResultForSuite:@"fingerprints" name:@"context_lookup_cold" value:(count / lookupDuration) unit:@"lookups_per_second" parameters:parameters];
+
+			lookupDuration = [self _timeToLookUpContextsOfOTRKit:otrKit count:count];
+
+			[self.report addResultForSuite:@"fingerprints" name:@"context_lookup_warm" value:(count / lookupDuration) unit:@"lookups_per_second" parameters:parameters];
+
+			CFAbsoluteTime enumerateStart = CFAbsoluteTimeGetCurrent();
+
+			NSArray *fingerprints = [otrKit requestAllFingerprints];
+
+			[self.report addResultForSuite:@"fingerprints" name:@"enumerate" value:(CFAbsoluteTimeGetCurrent() - enumerateStart) unit:@"seconds" parameters:parameters];
+
+			if ([fingerprints count] != count || count == 0) {
+				[self.report addFailureForSuite:@"fingerprints" name:@"enumerate" reason:[NSString stringWithFormat:@"Expected %lu fingerprints, found %lu", (unsigned long)count, (unsigned long)[fingerprints count]]];
+
+				return NO;
+			}
+
+			/* A change to one fingerprint writes the store */
+			CFAbsoluteTime writeStart = CFAbsoluteTimeGetCurrent();
+
+			OTRKitConcreteObject *changedFingerprint = [fingerprints firstObject];
+
+			[otrKit setFingerprintVerificationForConcreteObject:changedFingerprint verified:([changedFingerprint fingerprintIsTrusted] == NO)];
+
+			[otrKit flushFingerprints];
+
+			NSTimeInterval writeDuration = (CFAbsoluteTimeGetCurrent() - writeStart);
+
+			OTRKitWriteStatistics *writeStatistics = [otrKit fingerprintsWriteStatistics];
+
+			[self.report addResultForSuite:@"fingerprints" name:@"write" value:writeDuration unit:@"seconds" parameters:parameters];
+
+			[self.report addResultForSuite:@"fingerprints" name:@"bytes_written" value:([writeStatistics bytesWritten] + [writeStatistics journalBytesWritten]) unit:@"bytes" parameters:parameters];
+		}
+	}
+
+	return YES;
+}
+
+#pragma mark -
+#pragma mark Classification
+
+- (BOOL)_runClassifySuite
+{
+	NSString *longPlaintext = OTRKitBenchmarkMessageOfSize(4096);
+
+	NSDictionary *samples = @{
+		@"plaintext" : @"Hello, how are you?",
+		@"plaintext_4096" : longPlaintext,
+		@"plaintext_4096_questions" : [longPlaintext stringByReplacingOccurrencesOfString:@" " withString:@"?"],
+		@"tagged_plaintext" : @"Hello \t  \t\t\t\t \t \t \t    \t\t  \t\t",
+		@"query" : @"?OTRv3?",
+		@"data" : [NSString stringWithFormat:@"?OTR:AAMD%@.", [@"" stringByPaddingToLength:1024 withString:@"QUJD" startingAtIndex:0]]
+	};
+
+	OTRKit *otrKit = [OTRKit new];
+
+	/* The baseline is how messages were classified before OTRKit had a
+	 classifier of its own: a hop onto a serial queue, a UTF-8 copy of
+	 the message, and otrl_proto_message_type() */
+	dispatch_queue_t baselineQueue = dispatch_queue_create("OTRKitBenchmark.classify", DISPATCH_QUEUE_SERIAL);
+
+	NSUInteger classifyCount = (self.messageCount * 100);
+
+	for (NSString *sampleName in [[samples allKeys] sortedArrayUsingSelector:@selector(compare:)]) {
+		NSString *sample = samples[sampleName];
+
+		NSDictionary *parameters = @{@"message_size" : @([sample length])};
+
+		/* The first classification may convert the string to UTF-8 */
+		(void)[otrKit typeOfMessage:sample];
+
+		CFAbsoluteTime classifyStart = CFAbsoluteTimeGetCurrent();
+
+		for (NSUInteger i = 0; i < classifyCount; i++) {
+			(void)[otrKit typeOfMessage:sample];
+		}
+
+		NSTimeInterval classifyDuration = (CFAbsoluteTimeGetCurrent() - classifyStart);
+
+		[self.report addResultForSuite:@"classify"
+								  name:sampleName
+								 value:(classifyCount / classifyDuration)
+								  unit:@"messages_per_second"
+							parameters:parameters];
+
+		/* The same samples through the baseline */
+		CFAbsoluteTime baselineStart = CFAbsoluteTimeGetCurrent();
+
+		for (NSUInteger i = 0; i < classifyCount; i++) {
+			@autoreleasepool {
+				dispatch_sync(baselineQueue, ^{
+					(void)otrl_proto_message_type([sample UTF8String]);
+				});
+			}
+		}
+
+		NSTimeInterval baselineDuration = (CFAbsoluteTimeGetCurrent() - baselineStart);
+
+		[self.report addResultForSuite:@"classify"
+								  name:[sampleName stringByAppendingString:@"_baseline"]
+								 value:(classifyCount / baselineDuration)
+								  unit:@"messages_per_second"
+							parameters:parameters];
+	}
+
+	return YES;
+}
+
+#pragma mark -
+#pragma mark Network
+
+- (BOOL)_runNetworkSuite
+{
+	self.simulation.timeout = self.timeout;
+
+	return [self.simulation runWithReport:self.report suite:@"network"];
+}
+
+#pragma mark -
+#pragma mark Replay
+
+- (BOOL)_runReplaySuite
+{
+	NSString *tracePath = self.tracePath;
+
+	if (tracePath == nil) {
+		OTRKitBenchmarkLog(@"Skipping suite 'replay' because no trace was given");
+
+		return YES;
+	}
+
+	NSError *readError = nil;
+
+	OTRKitTrafficTrace *trace = [[OTRKitTrafficTrace alloc] initWithPath:tracePath error:&readError];
+
+	if (trace == nil) {
+		[self.report addFailureForSuite:@"replay"
+								   name:@"setup"
+								 reason:[NSString stringWithFormat:@"The trace could not be read: %@", [readError localizedDescription]]];
+
+		return NO;
+	}
+
+	OTRKitTrafficReplay *replay = [[OTRKitTrafficReplay alloc] initWithTrace:trace workingDirectory:self.workingDirectory];
+
+	replay.replaysAtRecordedPace = self.replaysAtRecordedPace;
+
+	replay.timeout = self.timeout;
+
+	return [replay runWithReport:self.report suite:@"replay"];
+}
+
+@end
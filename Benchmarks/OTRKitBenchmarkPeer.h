@@ -0,0 +1,103 @@
+/* *********************************************************************
+
+        Copyright (c) 2010 - 2015 Codeux Software, LLC
+     Please see ACKNOWLEDGEMENT for additional information.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+
+ * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+ * Neither the name of "Codeux Software, LLC", nor the names of its 
+   contributors may be used to endorse or promote products derived 
+   from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ SUCH DAMAGE.
+
+ *********************************************************************** */
+
+#import <EncryptionKit/EncryptionKit.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ *  One side of a benchmark: an isolated OTRKit with a delegate of its own.
+ *
+ *  Messages the OTRKit injects are decoded by the remote peer, which makes
+ *  two peers a complete loopback without a network. The delegate queue is
+ *  a private serial queue so that the benchmark may block the main thread
+ *  while it waits for either peer.
+ */
+@interface OTRKitBenchmarkPeer : NSObject <OTRKitDelegate>
+/**
+ *  The data path must be empty, or contain nothing but a private key
+ *  for the account of the peer which saves having to generate one.
+ */
+- (instancetype)initWithName:(NSString *)name protocol:(NSString *)protocol dataPath:(NSString *)dataPath;
+
+@property (readonly) OTRKit *otrKit;
+
+@property (readonly, copy) NSString *name;
+@property (readonly, copy) NSString *accountName;
+@property (readonly, copy) NSString *protocol;
+
+@property (nonatomic, weak, nullable) OTRKitBenchmarkPeer *remotePeer;
+
+/**
+ *  When set, messages injected by the OTRKit are kept instead of being
+ *  decoded by the remote peer. See -takeCapturedMessages
+ */
+@property (assign) BOOL capturesInjectedMessages;
+
+- (NSArray<NSString *> *)takeCapturedMessages;
+
+/**
+ *  The secret given in reply to a request to verify using SMP
+ */
+@property (copy, nullable) NSString *smpSecret;
+
+/* The values below are updated on the delegate queue */
+@property (readonly) OTRKitMessageState messageState;
+
+@property (readonly) NSUInteger encodedMessageCount;
+@property (readonly) NSUInteger decodedMessageCount;
+
+@property (readonly) NSUInteger injectedMessageCount;
+@property (readonly) unsigned long long injectedByteCount;
+
+@property (readonly) NSUInteger smpSuccessCount;
+@property (readonly) NSUInteger smpFailureCount;
+
+/**
+ *  Blocks until the condition is true, which is checked each time
+ *  one of the values above changes.
+ *
+ *  @return NO if the timeout expired first
+ */
+- (BOOL)waitUntil:(BOOL (^)(OTRKitBenchmarkPeer *peer))condition timeout:(NSTimeInterval)timeout;
+
+- (BOOL)generatePrivateKeyWithTimeout:(NSTimeInterval)timeout;
+
+- (void)encodeMessage:(NSString *)message;
+- (void)decodeMessage:(NSString *)message;
+
+- (void)initiateEncryption;
+
+- (void)initiateSMPWithSecret:(NSString *)secret;
+@end
+
+NS_ASSUME_NONNULL_END
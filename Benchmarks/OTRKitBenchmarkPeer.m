@@ -0,0 +1,411 @@
+/* *********************************************************************
+
+        Copyright (c) 2010 - 2015 Codeux Software, LLC
+     Please see ACKNOWLEDGEMENT for additional information.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+
+ * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+ * Neither the name of "Codeux Software, LLC", nor the names of its 
+   contributors may be used to endorse or promote products derived 
+   from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ SUCH DAMAGE.
+
+ *********************************************************************** */
+
+#import "OTRKitBenchmarkPeer.h"
+
+@interface OTRKitBenchmarkPeer ()
+@property (readwrite, strong) OTRKit *otrKit;
+@property (readwrite, copy) NSString *name;
+@property (readwrite, copy) NSString *accountName;
+@property (readwrite, copy) NSString *protocol;
+@property (readwrite, assign) OTRKitMessageState messageState;
+@property (readwrite, assign) NSUInteger encodedMessageCount;
+@property (readwrite, assign) NSUInteger decodedMessageCount;
+@property (readwrite, assign) NSUInteger injectedMessageCount;
+@property (readwrite, assign) unsigned long long injectedByteCount;
+@property (readwrite, assign) NSUInteger smpSuccessCount;
+@property (readwrite, assign) NSUInteger smpFailureCount;
+@property (nonatomic, strong) NSMutableArray<NSString *> *capturedMessages;
+@property (nonatomic, strong) NSCondition *stateCondition;
+@end
+
+@implementation OTRKitBenchmarkPeer
+
+- (instancetype)initWithName:(NSString *)name protocol:(NSString *)protocol dataPath:(NSString *)dataPath
+{
+	AssertParamaterLength(name)
+	AssertParamaterLength(protocol)
+	AssertParamaterLength(dataPath)
+
+	if ((self = [super init])) {
+		self.name = name;
+
+		self.accountName = [name stringByAppendingString:@"@benchmark"];
+
+		self.protocol = protocol;
+
+		self.capturedMessages = [NSMutableArray array];
+
+		self.stateCondition = [NSCondition new];
+
+		NSString *queueName = [NSString stringWithFormat:@"OTRKitBenchmarkPeer.%@", name];
+
+		self.otrKit = [OTRKit new];
+
+		self.otrKit.delegate = self;
+
+		self.otrKit.delegateQueue = dispatch_queue_create([queueName UTF8String], DISPATCH_QUEUE_SERIAL);
+
+		[self.otrKit setupWithDataPath:dataPath];
+
+		return self;
+	}
+
+	return nil;
+}
+
+#pragma mark -
+#pragma mark Actions
+
+- (void)encodeMessage:(NSString *)message
+{
+	[self.otrKit encodeMessage:message
+						  tlvs:@[]
+					  username:[self.remotePeer accountName]
+				   accountName:self.accountName
+					  protocol:self.protocol
+						   tag:nil];
+}
+
+- (void)decodeMessage:(NSString *)message
+{
+	[self.otrKit decodeMessage:message
+					  username:[self.remotePeer accountName]
+				   accountName:self.accountName
+					  protocol:self.protocol
+						   tag:nil];
+}
+
+- (void)initiateEncryption
+{
+	[self.otrKit initiateEncryptionWithUsername:[self.remotePeer accountName]
+									accountName:self.accountName
+									   protocol:self.protocol];
+}
+
+- (void)initiateSMPWithSecret:(NSString *)secret
+{
+	[self.otrKit initiateSMPForUsername:[self.remotePeer accountName]
+							accountName:self.accountName
+							   protocol:self.protocol
+								 secret:secret];
+}
+
+- (BOOL)generatePrivateKeyWithTimeout:(NSTimeInterval)timeout
+{
+	OTRKitAccount *account = [[OTRKitAccount alloc] initWithAccountName:self.accountName protocol:self.protocol];
+
+	dispatch_semaphore_t generateSemaphore = dispatch_semaphore_create(0);
+
+	__block NSError *generateError = nil;
+
+	[self.otrKit pregenerateKeysForAccounts:@[account] completion:^(NSError *error) {
+		generateError = error;
+
+		dispatch_semaphore_signal(generateSemaphore);
+	}];
+
+	dispatch_time_t waitTime = dispatch_time(DISPATCH_TIME_NOW, (int64_t)(timeout * NSEC_PER_SEC));
+
+	if (dispatch_semaphore_wait(generateSemaphore, waitTime) != 0) {
+		return NO;
+	}
+
+	if (generateError) {
+		LogToConsole(@"Failed to generate private key for '%@': %@", self.accountName, [generateError localizedDescription])
+
+		return NO;
+	}
+
+	return YES;
+}
+
+- (NSArray<NSString *> *)takeCapturedMessages
+{
+	NSArray *capturedMessages = nil;
+
+	@synchronized(self.capturedMessages) {
+		capturedMessages = [self.capturedMessages copy];
+
+		[self.capturedMessages removeAllObjects];
+	}
+
+	return capturedMessages;
+}
+
+#pragma mark -
+#pragma mark State
+
+- (void)_changeState:(dispatch_block_t)changeBlock
+{
+	[self.stateCondition lock];
+
+	changeBlock();
+
+	[self.stateCondition broadcast];
+
+	[self.stateCondition unlock];
+}
+
+- (BOOL)waitUntil:(BOOL (^)(OTRKitBenchmarkPeer *peer))condition timeout:(NSTimeInterval)timeout
+{
+	AssertParamaterNil(condition)
+
+	NSDate *limitDate = [NSDate dateWithTimeIntervalSinceNow:timeout];
+
+	[self.stateCondition lock];
+
+	BOOL conditionMet = condition(self);
+
+	while (conditionMet == NO) {
+		BOOL signaled = [self.stateCondition waitUntilDate:limitDate];
+
+		conditionMet = condition(self);
+
+		if (signaled == NO) {
+			break;
+		}
+	}
+
+	[self.stateCondition unlock];
+
+	return conditionMet;
+}
+
+#pragma mark -
+#pragma mark Delegate
+
+- (void) otrKit:(OTRKit *)otrKit
+  injectMessage:(NSString *)message
+	   username:(NSString *)username
+	accountName:(NSString *)accountName
+	   protocol:(NSString *)protocol
+			tag:(id)tag
+{
+	[self _changeState:^{
+		self.injectedMessageCount += 1;
+
+		self.injectedByteCount += [message lengthOfBytesUsingEncoding:NSUTF8StringEncoding];
+	}];
+
+	if (self.capturesInjectedMessages) {
+		@synchronized(self.capturedMessages) {
+			[self.capturedMessages addObject:message];
+		}
+
+		return;
+	}
+
+	[self.remotePeer decodeMessage:message];
+}
+
+- (void) otrKit:(OTRKit *)otrKit
+ injectMessages:(NSArray<NSString *> *)messages
+  fragmentCount:(NSUInteger)fragmentCount
+	  byteCount:(NSUInteger)byteCount
+	   username:(NSString *)username
+	accountName:(NSString *)accountName
+	   protocol:(NSString *)protocol
+			tag:(id)tag
+{
+	[self _changeState:^{
+		self.injectedMessageCount += fragmentCount;
+
+		self.injectedByteCount += byteCount;
+	}];
+
+	if (self.capturesInjectedMessages) {
+		@synchronized(self.capturedMessages) {
+			[self.capturedMessages addObjectsFromArray:messages];
+		}
+
+		return;
+	}
+
+	for (NSString *message in messages) {
+		[self.remotePeer decodeMessage:message];
+	}
+}
+
+- (void) otrKit:(OTRKit *)otrKit
+ encodedMessage:(NSString *)encodedMessage
+   wasEncrypted:(BOOL)wasEncrypted
+	   username:(NSString *)username
+	accountName:(NSString *)accountName
+	   protocol:(NSString *)protocol
+			tag:(id)tag
+		  error:(NSError *)error
+{
+	if (error) {
+		LogToConsole(@"Failed to encode message for '%@': %@", self.accountName, [error localizedDescription])
+	}
+
+	[self _changeState:^{
+		self.encodedMessageCount += 1;
+	}];
+}
+
+- (void) otrKit:(OTRKit *)otrKit
+ decodedMessage:(NSString *)decodedMessage
+   wasEncrypted:(BOOL)wasEncrypted
+		   tlvs:(NSArray<OTRTLV *> *)tlvs
+	   username:(NSString *)username
+	accountName:(NSString *)accountName
+	   protocol:(NSString *)protocol
+			tag:(id)tag
+{
+	/* Messages that only carry TLVs (e.g. SMP) are not counted */
+	if (decodedMessage == nil) {
+		return;
+	}
+
+	[self _changeState:^{
+		self.decodedMessageCount += 1;
+	}];
+}
+
+- (void)    otrKit:(OTRKit *)otrKit
+updateMessageState:(OTRKitMessageState)messageState
+		  username:(NSString *)username
+	   accountName:(NSString *)accountName
+		  protocol:(NSString *)protocol
+{
+	[self _changeState:^{
+		self.messageState = messageState;
+	}];
+}
+
+- (BOOL)       otrKit:(OTRKit *)otrKit
+   isUsernameLoggedIn:(NSString *)username
+		  accountName:(NSString *)accountName
+			 protocol:(NSString *)protocol
+{
+	return YES;
+}
+
+- (void)                           otrKit:(OTRKit *)otrKit
+  showFingerprintConfirmationForTheirHash:(NSString *)theirHash
+								  ourHash:(NSString *)ourHash
+								 username:(NSString *)username
+							  accountName:(NSString *)accountName
+								 protocol:(NSString *)protocol
+{
+
+}
+
+- (void)							  otrKit:(OTRKit *)otrKit
+fingerprintIsVerifiedStateChangedForUsername:(NSString *)username
+								 accountName:(NSString *)accountName
+									protocol:(NSString *)protocol
+									verified:(BOOL)verified
+{
+
+}
+
+- (void) otrKit:(OTRKit *)otrKit
+ handleSMPEvent:(OTRKitSMPEvent)event
+	   progress:(double)progress
+	   question:(NSString *)question
+	   username:(NSString *)username
+	accountName:(NSString *)accountName
+	   protocol:(NSString *)protocol
+{
+	switch (event)
+	{
+		case OTRKitSMPEventAskForSecret:
+		case OTRKitSMPEventAskForAnswer:
+		{
+			NSString *smpSecret = self.smpSecret;
+
+			if (smpSecret == nil) {
+				[otrKit abortSMPForUsername:username accountName:accountName protocol:protocol];
+
+				break;
+			}
+
+			[otrKit respondToSMPForUsername:username
+								accountName:accountName
+								   protocol:protocol
+									 secret:smpSecret];
+
+			break;
+		}
+		case OTRKitSMPEventSuccess:
+		{
+			[self _changeState:^{
+				self.smpSuccessCount += 1;
+			}];
+
+			break;
+		}
+		case OTRKitSMPEventCheated:
+		case OTRKitSMPEventFailure:
+		case OTRKitSMPEventAbort:
+		case OTRKitSMPEventError:
+		{
+			[self _changeState:^{
+				self.smpFailureCount += 1;
+			}];
+
+			break;
+		}
+		default:
+		{
+			break;
+		}
+	}
+}
+
+- (void)    otrKit:(OTRKit *)otrKit
+handleMessageEvent:(OTRKitMessageEvent)event
+		   message:(NSString *)message
+		  username:(NSString *)username
+	   accountName:(NSString *)accountName
+		  protocol:(NSString *)protocol
+			   tag:(id)tag
+			 error:(NSError *)error
+{
+
+}
+
+- (void)        otrKit:(OTRKit *)otrKit
+  receivedSymmetricKey:(NSData *)symmetricKey
+				forUse:(NSUInteger)use
+			   useData:(NSData *)useData
+			  username:(NSString *)username
+		   accountName:(NSString *)accountName
+			  protocol:(NSString *)protocol
+{
+
+}
+
+@end
@@ -0,0 +1,90 @@
+/* *********************************************************************
+
+        Copyright (c) 2010 - 2015 Codeux Software, LLC
+     Please see ACKNOWLEDGEMENT for additional information.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+
+ * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+ * Neither the name of "Codeux Software, LLC", nor the names of its 
+   contributors may be used to endorse or promote products derived 
+   from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ SUCH DAMAGE.
+
+ *********************************************************************** */
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ *  Collects the results of a benchmark run and writes them as JSON so that
+ *  runs made with different releases can be compared by a script.
+ *
+ *  Each result names its suite, what was measured, the unit, and the
+ *  parameters it was measured with. Results made of several samples carry
+ *  their median as value, along with the minimum, maximum, mean, and
+ *  95th percentile.
+ */
+@interface OTRKitBenchmarkReport : NSObject
+/**
+ *  Values that describe the whole run, such as the library versions
+ */
+@property (readonly, copy) NSDictionary<NSString *, id> *configuration;
+
+- (void)setConfigurationValue:(id)value forKey:(NSString *)key;
+
+- (void)addResultForSuite:(NSString *)suite
+					 name:(NSString *)name
+					value:(double)value
+					 unit:(NSString *)unit
+			   parameters:(nullable NSDictionary<NSString *, id> *)parameters;
+
+- (void)addResultForSuite:(NSString *)suite
+					 name:(NSString *)name
+				  samples:(NSArray<NSNumber *> *)samples
+					 unit:(NSString *)unit
+			   parameters:(nullable NSDictionary<NSString *, id> *)parameters;
+
+/**
+ *  Records that a measurement could not be made. A run that has any
+ *  failures is reported as failed.
+ */
+- (void)addFailureForSuite:(NSString *)suite
+					  name:(NSString *)name
+					reason:(NSString *)reason;
+
+@property (readonly) BOOL hasFailures;
+
+- (NSData *)JSONRepresentation;
+
+/**
+ *  @param path Where to write the report, or nil for standard output
+ */
+- (BOOL)writeToPath:(nullable NSString *)path error:(NSError **)error;
+@end
+
+/**
+ *  Prints a line of progress to standard error which keeps it
+ *  apart from a report that is written to standard output.
+ */
+extern void OTRKitBenchmarkLog(NSString *format, ...) NS_FORMAT_FUNCTION(1,2);
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,262 @@
+/* *********************************************************************
+
+        Copyright (c) 2010 - 2015 Codeux Software, LLC
+     Please see ACKNOWLEDGEMENT for additional information.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+
+ * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+ * Neither the name of "Codeux Software, LLC", nor the names of its 
+   contributors may be used to endorse or promote products derived 
+   from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ SUCH DAMAGE.
+
+ *********************************************************************** */
+
+#import "OTRKitBenchmarkReport.h"
+
+@interface OTRKitBenchmarkReport ()
+@property (nonatomic, strong) NSMutableDictionary<NSString *, id> *mutableConfiguration;
+@property (nonatomic, strong) NSMutableArray<NSDictionary *> *results;
+@property (nonatomic, strong) NSMutableArray<NSDictionary *> *failures;
+@property (nonatomic, copy) NSDate *startDate;
+@end
+
+@implementation OTRKitBenchmarkReport
+
+- (instancetype)init
+{
+	if ((self = [super init])) {
+		self.mutableConfiguration = [NSMutableDictionary dictionary];
+
+		self.results = [NSMutableArray array];
+
+		self.failures = [NSMutableArray array];
+
+		self.startDate = [NSDate date];
+
+		return self;
+	}
+
+	return nil;
+}
+
+- (NSDictionary<NSString *, id> *)configuration
+{
+	@synchronized(self) {
+		return [self.mutableConfiguration copy];
+	}
+}
+
+- (void)setConfigurationValue:(id)value forKey:(NSString *)key
+{
+	AssertParamaterNil(value)
+	AssertParamaterLength(key)
+
+	@synchronized(self) {
+		self.mutableConfiguration[key] = value;
+	}
+}
+
+#pragma mark -
+#pragma mark Results
+
+- (void)_addResult:(NSDictionary *)result
+{
+	@synchronized(self) {
+		[self.results addObject:result];
+	}
+}
+
+- (void)addResultForSuite:(NSString *)suite
+					 name:(NSString *)name
+					value:(double)value
+					 unit:(NSString *)unit
+			   parameters:(NSDictionary<NSString *, id> *)parameters
+{
+	AssertParamaterLength(suite)
+	AssertParamaterLength(name)
+	AssertParamaterLength(unit)
+
+	OTRKitBenchmarkLog(@"%@ %@ %@: %f %@", suite, name, [self _descriptionOfParameters:parameters], value, unit);
+
+	[self _addResult:@{
+		@"suite" : suite,
+		@"name" : name,
+		@"value" : @(value),
+		@"unit" : unit,
+		@"parameters" : ((parameters) ?: @{})
+	}];
+}
+
+- (void)addResultForSuite:(NSString *)suite
+					 name:(NSString *)name
+				  samples:(NSArray<NSNumber *> *)samples
+					 unit:(NSString *)unit
+			   parameters:(NSDictionary<NSString *, id> *)parameters
+{
+	AssertParamaterLength(suite)
+	AssertParamaterLength(name)
+	AssertParamaterCount(samples)
+	AssertParamaterLength(unit)
+
+	NSArray *sortedSamples = [samples sortedArrayUsingSelector:@selector(compare:)];
+
+	NSUInteger sampleCount = [sortedSamples count];
+
+	double sampleTotal = 0;
+
+	for (NSNumber *sample in sortedSamples) {
+		sampleTotal += [sample doubleValue];
+	}
+
+	double median = [sortedSamples[(sampleCount / 2)] doubleValue];
+
+	if ((sampleCount % 2) == 0) {
+		median = (([sortedSamples[(sampleCount / 2) - 1] doubleValue] + median) / 2.0);
+	}
+
+	NSUInteger percentileIndex = (NSUInteger)ceil(sampleCount * 0.95);
+
+	if (percentileIndex > 0) {
+		percentileIndex -= 1;
+	}
+
+	OTRKitBenchmarkLog(@"%@ %@ %@: %f %@ (median of %lu)", suite, name, [self _descriptionOfParameters:parameters], median, unit, (unsigned long)sampleCount);
+
+	[self _addResult:@{
+		@"suite" : suite,
+		@"name" : name,
+		@"value" : @(median),
+		@"unit" : unit,
+		@"parameters" : ((parameters) ?: @{}),
+		@"samples" : @{
+			@"count" : @(sampleCount),
+			@"minimum" : [sortedSamples firstObject],
+			@"maximum" : [sortedSamples lastObject],
+			@"mean" : @(sampleTotal / sampleCount),
+			@"median" : @(median),
+			@"p95" : sortedSamples[percentileIndex]
+		}
+	}];
+}
+
+- (void)addFailureForSuite:(NSString *)suite
+					  name:(NSString *)name
+					reason:(NSString *)reason
+{
+	AssertParamaterLength(suite)
+	AssertParamaterLength(name)
+	AssertParamaterLength(reason)
+
+	OTRKitBenchmarkLog(@"%@ %@ failed: %@", suite, name, reason);
+
+	@synchronized(self) {
+		[self.failures addObject:@{
+			@"suite" : suite,
+			@"name" : name,
+			@"reason" : reason
+		}];
+	}
+}
+
+- (BOOL)hasFailures
+{
+	@synchronized(self) {
+		return ([self.failures count] > 0);
+	}
+}
+
+- (NSString *)_descriptionOfParameters:(NSDictionary *)parameters
+{
+	if ([parameters count] == 0) {
+		return @"";
+	}
+
+	NSMutableArray *descriptions = [NSMutableArray arrayWithCapacity:[parameters count]];
+
+	for (NSString *key in [[parameters allKeys] sortedArrayUsingSelector:@selector(compare:)]) {
+		[descriptions addObject:[NSString stringWithFormat:@"%@=%@", key, parameters[key]]];
+	}
+
+	return [NSString stringWithFormat:@"[%@]", [descriptions componentsJoinedByString:@" "]];
+}
+
+#pragma mark -
+#pragma mark Output
+
+- (NSData *)JSONRepresentation
+{
+	NSDateFormatter *dateFormatter = [NSDateFormatter new];
+
+	dateFormatter.locale = [NSLocale localeWithLocaleIdentifier:@"en_US_POSIX"];
+
+	dateFormatter.dateFormat = @"yyyy-MM-dd'T'HH:mm:ssZZZZZ";
+
+	NSDictionary *report = nil;
+
+	@synchronized(self) {
+		report = @{
+			@"format" : @(1),
+			@"date" : [dateFormatter stringFromDate:self.startDate],
+			@"duration" : @(-[self.startDate timeIntervalSinceNow]),
+			@"configuration" : [self.mutableConfiguration copy],
+			@"results" : [self.results copy],
+			@"failures" : [self.failures copy],
+			@"passed" : @([self.failures count] == 0)
+		};
+	}
+
+	return [NSJSONSerialization dataWithJSONObject:report options:NSJSONWritingPrettyPrinted error:NULL];
+}
+
+- (BOOL)writeToPath:(NSString *)path error:(NSError **)error
+{
+	NSData *reportData = [self JSONRepresentation];
+
+	if (path == nil) {
+		NSFileHandle *standardOutput = [NSFileHandle fileHandleWithStandardOutput];
+
+		[standardOutput writeData:reportData];
+
+		[standardOutput writeData:[@"\n" dataUsingEncoding:NSUTF8StringEncoding]];
+
+		return YES;
+	}
+
+	return [reportData writeToFile:path options:NSDataWritingAtomic error:error];
+}
+
+@end
+
+#pragma mark -
+
+void OTRKitBenchmarkLog(NSString *format, ...)
+{
+	va_list arguments;
+
+	va_start(arguments, format);
+
+	NSString *line = [[NSString alloc] initWithFormat:format arguments:arguments];
+
+	va_end(arguments);
+
+	fprintf(stderr, "%s\n", [line UTF8String]);
+}
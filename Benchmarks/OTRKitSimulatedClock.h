@@ -0,0 +1,76 @@
+/* *********************************************************************
+
+        Copyright (c) 2010 - 2015 Codeux Software, LLC
+     Please see ACKNOWLEDGEMENT for additional information.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+
+ * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+ * Neither the name of "Codeux Software, LLC", nor the names of its 
+   contributors may be used to endorse or promote products derived 
+   from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ SUCH DAMAGE.
+
+ *********************************************************************** */
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ *  A virtual clock for simulations. Time does not pass on its own: it jumps
+ *  to the time of the next scheduled event when that event is run. Events
+ *  scheduled for the same time run in the order they were scheduled in,
+ *  which makes a simulation repeatable.
+ *
+ *  The clock is not thread safe. It is meant to be used from the thread
+ *  that runs the simulation.
+ */
+@interface OTRKitSimulatedClock : NSObject
+/**
+ *  Seconds since the simulation started
+ */
+@property (readonly) NSTimeInterval now;
+
+/**
+ *  The time of the earliest event, or INFINITY when none is scheduled
+ */
+@property (readonly) NSTimeInterval nextEventTime;
+
+@property (readonly) NSUInteger scheduledEventCount;
+@property (readonly) NSUInteger processedEventCount;
+
+/**
+ *  @param time Times in the past are treated as now
+ */
+- (void)scheduleBlock:(dispatch_block_t)block atTime:(NSTimeInterval)time;
+- (void)scheduleBlock:(dispatch_block_t)block afterDelay:(NSTimeInterval)delay;
+
+/**
+ *  Advances the clock to the time of the earliest event and runs every
+ *  event scheduled for that time, including those scheduled by the events
+ *  themselves for the same time.
+ *
+ *  @return NO if no event was scheduled
+ */
+- (BOOL)runEventsAtNextTime;
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,198 @@
+/* *********************************************************************
+
+        Copyright (c) 2010 - 2015 Codeux Software, LLC
+     Please see ACKNOWLEDGEMENT for additional information.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+
+ * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+ * Neither the name of "Codeux Software, LLC", nor the names of its 
+   contributors may be used to endorse or promote products derived 
+   from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ SUCH DAMAGE.
+
+ *********************************************************************** */
+
+#import "OTRKitSimulatedClock.h"
+
+@interface OTRKitSimulatedEvent : NSObject
+@property (nonatomic, assign) NSTimeInterval time;
+@property (nonatomic, assign) uint64_t sequence;
+@property (nonatomic, copy) dispatch_block_t block;
+@end
+
+@implementation OTRKitSimulatedEvent
+@end
+
+@interface OTRKitSimulatedClock ()
+@property (readwrite, assign) NSTimeInterval now;
+@property (readwrite, assign) NSUInteger processedEventCount;
+@property (nonatomic, strong) NSMutableArray<OTRKitSimulatedEvent *> *eventHeap;
+@property (nonatomic, assign) uint64_t nextSequence;
+@end
+
+@implementation OTRKitSimulatedClock
+
+- (instancetype)init
+{
+	if ((self = [super init])) {
+		self.eventHeap = [NSMutableArray array];
+
+		return self;
+	}
+
+	return nil;
+}
+
+- (NSTimeInterval)nextEventTime
+{
+	OTRKitSimulatedEvent *event = [self.eventHeap firstObject];
+
+	if (event == nil) {
+		return INFINITY;
+	}
+
+	return event.time;
+}
+
+- (NSUInteger)scheduledEventCount
+{
+	return [self.eventHeap count];
+}
+
+- (void)scheduleBlock:(dispatch_block_t)block afterDelay:(NSTimeInterval)delay
+{
+	[self scheduleBlock:block atTime:(self.now + delay)];
+}
+
+- (void)scheduleBlock:(dispatch_block_t)block atTime:(NSTimeInterval)time
+{
+	AssertParamaterNil(block)
+
+	OTRKitSimulatedEvent *event = [OTRKitSimulatedEvent new];
+
+	event.time = MAX(time, self.now);
+
+	event.sequence = self.nextSequence;
+
+	event.block = block;
+
+	self.nextSequence += 1;
+
+	[self _pushEvent:event];
+}
+
+- (BOOL)runEventsAtNextTime
+{
+	OTRKitSimulatedEvent *event = [self.eventHeap firstObject];
+
+	if (event == nil) {
+		return NO;
+	}
+
+	NSTimeInterval time = event.time;
+
+	self.now = time;
+
+	while ((event = [self.eventHeap firstObject]) && event.time <= time) {
+		[self _popEvent];
+
+		event.block();
+
+		self.processedEventCount += 1;
+	}
+
+	return YES;
+}
+
+#pragma mark -
+#pragma mark Heap
+
+/* Events are kept in a binary min-heap ordered by time, then by
+ the order they were scheduled in, which keeps them first in, first out. */
+NS_INLINE BOOL OTRKitSimulatedEventPrecedes(OTRKitSimulatedEvent *event, OTRKitSimulatedEvent *otherEvent)
+{
+	if (event.time != otherEvent.time) {
+		return (event.time < otherEvent.time);
+	}
+
+	return (event.sequence < otherEvent.sequence);
+}
+
+- (void)_pushEvent:(OTRKitSimulatedEvent *)event
+{
+	NSMutableArray *heap = self.eventHeap;
+
+	[heap addObject:event];
+
+	NSUInteger index = ([heap count] - 1);
+
+	while (index > 0) {
+		NSUInteger parentIndex = ((index - 1) / 2);
+
+		if (OTRKitSimulatedEventPrecedes(heap[index], heap[parentIndex]) == NO) {
+			break;
+		}
+
+		[heap exchangeObjectAtIndex:index withObjectAtIndex:parentIndex];
+
+		index = parentIndex;
+	}
+}
+
+- (void)_popEvent
+{
+	NSMutableArray *heap = self.eventHeap;
+
+	NSUInteger count = [heap count];
+
+	[heap exchangeObjectAtIndex:0 withObjectAtIndex:(count - 1)];
+
+	[heap removeLastObject];
+
+	count -= 1;
+
+	NSUInteger index = 0;
+
+	while (YES) {
+		NSUInteger leftIndex = ((index * 2) + 1);
+		NSUInteger rightIndex = (leftIndex + 1);
+
+		NSUInteger smallestIndex = index;
+
+		if (leftIndex < count && OTRKitSimulatedEventPrecedes(heap[leftIndex], heap[smallestIndex])) {
+			smallestIndex = leftIndex;
+		}
+
+		if (rightIndex < count && OTRKitSimulatedEventPrecedes(heap[rightIndex], heap[smallestIndex])) {
+			smallestIndex = rightIndex;
+		}
+
+		if (smallestIndex == index) {
+			break;
+		}
+
+		[heap exchangeObjectAtIndex:index withObjectAtIndex:smallestIndex];
+
+		index = smallestIndex;
+	}
+}
+
+@end
@@ -0,0 +1,180 @@
+/* *********************************************************************
+
+        Copyright (c) 2010 - 2015 Codeux Software, LLC
+     Please see ACKNOWLEDGEMENT for additional information.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+
+ * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+ * Neither the name of "Codeux Software, LLC", nor the names of its 
+   contributors may be used to endorse or promote products derived 
+   from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ SUCH DAMAGE.
+
+ *********************************************************************** */
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+@class OTRKitSimulatedNetwork;
+
+typedef NS_ENUM(NSUInteger, OTRKitLatencyDistributionType) {
+	OTRKitLatencyDistributionTypeConstant,
+	OTRKitLatencyDistributionTypeUniform,
+	OTRKitLatencyDistributionTypeNormal,
+	OTRKitLatencyDistributionTypeExponential,
+	OTRKitLatencyDistributionTypePareto
+};
+
+/**
+ *  The time in seconds a message takes to cross the network
+ */
+@interface OTRKitLatencyDistribution : NSObject
++ (instancetype)constantLatency:(NSTimeInterval)latency;
+
++ (instancetype)uniformLatencyBetween:(NSTimeInterval)minimum and:(NSTimeInterval)maximum;
+
+/**
+ *  Samples below zero are treated as zero
+ */
++ (instancetype)normalLatencyWithMean:(NSTimeInterval)mean deviation:(NSTimeInterval)deviation;
+
++ (instancetype)exponentialLatencyWithMean:(NSTimeInterval)mean;
+
+/**
+ *  A heavy tail of slow messages. No sample is below the minimum.
+ *  A smaller shape makes the tail heavier.
+ */
++ (instancetype)paretoLatencyWithMinimum:(NSTimeInterval)minimum shape:(double)shape;
+
+/**
+ *  Parses the form used by -specification, which is the name of the
+ *  distribution followed by its parameters, separated by colons:
+ *  "constant:0.05", "uniform:0.02:0.2", "normal:0.1:0.03",
+ *  "exponential:0.1", and "pareto:0.05:1.5"
+ *
+ *  @return nil if the specification is not valid
+ */
++ (nullable instancetype)latencyWithSpecification:(NSString *)specification;
+
+@property (readonly) OTRKitLatencyDistributionType type;
+
+@property (readonly) double firstParameter;
+@property (readonly) double secondParameter;
+
+@property (readonly, copy) NSString *specification;
+
+- (NSTimeInterval)sampleFromNetwork:(OTRKitSimulatedNetwork *)network;
+@end
+
+/**
+ *  A simulated chat transport. Decides when, and how many times, each message
+ *  sent on it is delivered. It does not deliver messages itself. That is done
+ *  by the simulation, on a virtual clock, which makes the network usable with
+ *  any number of peers.
+ *
+ *  Messages sent on the same link (from one peer to another in one conversation)
+ *  are delivered in the order they were sent, as by a chat server, unless they
+ *  are picked to be reordered. Every decision is made with a pseudorandom
+ *  generator that is seeded when the network is created so a simulation with
+ *  the same seed makes the same decisions.
+ *
+ *  The network is not thread safe.
+ */
+@interface OTRKitSimulatedNetwork : NSObject
+- (instancetype)initWithSeed:(uint64_t)seed;
+
+@property (readonly) uint64_t seed;
+
+/**
+ *  Default value for property is normal latency with mean of 0.1 seconds
+ *  and deviation of 0.03 seconds.
+ */
+@property (strong) OTRKitLatencyDistribution *latency;
+
+/**
+ *  Probability between 0 and 1 that a message is dropped.
+ *  Default value for property is 0.
+ */
+@property (assign) double lossRate;
+
+/**
+ *  Probability between 0 and 1 that a message is delivered twice.
+ *  Default value for property is 0.
+ */
+@property (assign) double duplicationRate;
+
+/**
+ *  Probability between 0 and 1 that a message is held back by up to
+ *  -reorderingDelay seconds, which lets messages sent after it overtake it.
+ *  Default value for property is 0.
+ */
+@property (assign) double reorderingRate;
+
+/**
+ *  Default value for property is 1 second.
+ */
+@property (assign) NSTimeInterval reorderingDelay;
+
+/**
+ *  The largest message in bytes that the protocol carries. Larger messages
+ *  are dropped. Zero means there is no limit. By default, the limits are
+ *  those OTRKit fragments messages for (e.g. 400 for prpl-irc).
+ */
+- (void)setMaximumMessageSize:(NSUInteger)maximumMessageSize forProtocol:(NSString *)protocol;
+- (NSUInteger)maximumMessageSizeForProtocol:(NSString *)protocol;
+
+/**
+ *  Decides the fate of a message that is sent now.
+ *
+ *  @param message	The message
+ *  @param link		Identifies the sender, receiver, and conversation
+ *  @param protocol	The protocol of the exchange
+ *  @param now		The time of the virtual clock
+ *
+ *  @return The times at which the message is delivered, which is empty
+ *			if it is dropped and has two times if it is duplicated
+ */
+- (NSArray<NSNumber *> *)deliveryTimesForMessage:(NSString *)message
+										  onLink:(NSString *)link
+										protocol:(NSString *)protocol
+											 now:(NSTimeInterval)now;
+
+/**
+ *  A pseudorandom number that is at least 0 and less than 1
+ */
+- (double)nextRandom;
+
+@property (readonly) NSUInteger sentMessageCount;
+@property (readonly) NSUInteger deliveredMessageCount;
+@property (readonly) NSUInteger lostMessageCount;
+@property (readonly) NSUInteger duplicatedMessageCount;
+@property (readonly) NSUInteger reorderedMessageCount;
+@property (readonly) NSUInteger oversizedMessageCount;
+@property (readonly) unsigned long long sentByteCount;
+
+/**
+ *  The configuration of the network, to describe the results made with it
+ */
+- (NSDictionary<NSString *, id> *)parametersForProtocol:(NSString *)protocol;
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,366 @@
+/* *********************************************************************
+
+        Copyright (c) 2010 - 2015 Codeux Software, LLC
+     Please see ACKNOWLEDGEMENT for additional information.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+
+ * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+ * Neither the name of "Codeux Software, LLC", nor the names of its 
+   contributors may be used to endorse or promote products derived 
+   from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ SUCH DAMAGE.
+
+ *********************************************************************** */
+
+#import "OTRKitSimulatedNetwork.h"
+
+@interface OTRKitLatencyDistribution ()
+@property (readwrite, assign) OTRKitLatencyDistributionType type;
+@property (readwrite, assign) double firstParameter;
+@property (readwrite, assign) double secondParameter;
+@end
+
+@implementation OTRKitLatencyDistribution
+
++ (instancetype)_latencyOfType:(OTRKitLatencyDistributionType)type firstParameter:(double)firstParameter secondParameter:(double)secondParameter
+{
+	OTRKitLatencyDistribution *latency = [self new];
+
+	latency.type = type;
+
+	latency.firstParameter = firstParameter;
+	latency.secondParameter = secondParameter;
+
+	return latency;
+}
+
++ (instancetype)constantLatency:(NSTimeInterval)latency
+{
+	NSParameterAssert(latency >= 0);
+
+	return [self _latencyOfType:OTRKitLatencyDistributionTypeConstant firstParameter:latency secondParameter:0];
+}
+
++ (instancetype)uniformLatencyBetween:(NSTimeInterval)minimum and:(NSTimeInterval)maximum
+{
+	NSParameterAssert(minimum >= 0 && maximum >= minimum);
+
+	return [self _latencyOfType:OTRKitLatencyDistributionTypeUniform firstParameter:minimum secondParameter:maximum];
+}
+
++ (instancetype)normalLatencyWithMean:(NSTimeInterval)mean deviation:(NSTimeInterval)deviation
+{
+	NSParameterAssert(mean >= 0 && deviation >= 0);
+
+	return [self _latencyOfType:OTRKitLatencyDistributionTypeNormal firstParameter:mean secondParameter:deviation];
+}
+
++ (instancetype)exponentialLatencyWithMean:(NSTimeInterval)mean
+{
+	NSParameterAssert(mean >= 0);
+
+	return [self _latencyOfType:OTRKitLatencyDistributionTypeExponential firstParameter:mean secondParameter:0];
+}
+
++ (instancetype)paretoLatencyWithMinimum:(NSTimeInterval)minimum shape:(double)shape
+{
+	NSParameterAssert(minimum >= 0 && shape > 0);
+
+	return [self _latencyOfType:OTRKitLatencyDistributionTypePareto firstParameter:minimum secondParameter:shape];
+}
+
++ (instancetype)latencyWithSpecification:(NSString *)specification
+{
+	AssertParamaterNil(specification)
+
+	NSArray *components = [specification componentsSeparatedByString:@":"];
+
+	NSString *name = [components firstObject];
+
+	NSMutableArray *parameters = [NSMutableArray arrayWithCapacity:2];
+
+	for (NSUInteger i = 1; i < [components count]; i++) {
+		NSScanner *scanner = [NSScanner scannerWithString:components[i]];
+
+		double parameter = 0;
+
+		if ([scanner scanDouble:&parameter] == NO || [scanner isAtEnd] == NO || parameter < 0) {
+			return nil;
+		}
+
+		[parameters addObject:@(parameter)];
+	}
+
+	if ([name isEqualToString:@"constant"] && [parameters count] == 1) {
+		return [self constantLatency:[parameters[0] doubleValue]];
+	} else if ([name isEqualToString:@"uniform"] && [parameters count] == 2) {
+		if ([parameters[1] doubleValue] < [parameters[0] doubleValue]) {
+			return nil;
+		}
+
+		return [self uniformLatencyBetween:[parameters[0] doubleValue] and:[parameters[1] doubleValue]];
+	} else if ([name isEqualToString:@"normal"] && [parameters count] == 2) {
+		return [self normalLatencyWithMean:[parameters[0] doubleValue] deviation:[parameters[1] doubleValue]];
+	} else if ([name isEqualToString:@"exponential"] && [parameters count] == 1) {
+		return [self exponentialLatencyWithMean:[parameters[0] doubleValue]];
+	} else if ([name isEqualToString:@"pareto"] && [parameters count] == 2) {
+		if ([parameters[1] doubleValue] <= 0) {
+			return nil;
+		}
+
+		return [self paretoLatencyWithMinimum:[parameters[0] doubleValue] shape:[parameters[1] doubleValue]];
+	}
+
+	return nil;
+}
+
+- (NSString *)specification
+{
+	switch (self.type)
+	{
+		case OTRKitLatencyDistributionTypeConstant:
+		{
+			return [NSString stringWithFormat:@"constant:%g", self.firstParameter];
+		}
+		case OTRKitLatencyDistributionTypeUniform:
+		{
+			return [NSString stringWithFormat:@"uniform:%g:%g", self.firstParameter, self.secondParameter];
+		}
+		case OTRKitLatencyDistributionTypeNormal:
+		{
+			return [NSString stringWithFormat:@"normal:%g:%g", self.firstParameter, self.secondParameter];
+		}
+		case OTRKitLatencyDistributionTypeExponential:
+		{
+			return [NSString stringWithFormat:@"exponential:%g", self.firstParameter];
+		}
+		case OTRKitLatencyDistributionTypePareto:
+		{
+			return [NSString stringWithFormat:@"pareto:%g:%g", self.firstParameter, self.secondParameter];
+		}
+	}
+
+	return nil;
+}
+
+- (NSTimeInterval)sampleFromNetwork:(OTRKitSimulatedNetwork *)network
+{
+	AssertParamaterNil(network)
+
+	switch (self.type)
+	{
+		case OTRKitLatencyDistributionTypeConstant:
+		{
+			return self.firstParameter;
+		}
+		case OTRKitLatencyDistributionTypeUniform:
+		{
+			return (self.firstParameter + ((self.secondParameter - self.firstParameter) * [network nextRandom]));
+		}
+		case OTRKitLatencyDistributionTypeNormal:
+		{
+			/* Box-Muller transform. 1 - u keeps the logarithm away from zero. */
+			double u1 = (1.0 - [network nextRandom]);
+			double u2 = [network nextRandom];
+
+			double sample = (self.firstParameter + (self.secondParameter * sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2)));
+
+			return MAX(sample, 0);
+		}
+		case OTRKitLatencyDistributionTypeExponential:
+		{
+			return (-self.firstParameter * log(1.0 - [network nextRandom]));
+		}
+		case OTRKitLatencyDistributionTypePareto:
+		{
+			return (self.firstParameter / pow((1.0 - [network nextRandom]), (1.0 / self.secondParameter)));
+		}
+	}
+
+	return 0;
+}
+
+- (NSString *)description
+{
+	return [NSString stringWithFormat:@"<%@: %@>", [self class], [self specification]];
+}
+
+@end
+
+#pragma mark -
+
+@interface OTRKitSimulatedNetwork ()
+@property (readwrite, assign) uint64_t seed;
+@property (nonatomic, assign) uint64_t randomState;
+@property (nonatomic, strong) NSMutableDictionary<NSString *, NSNumber *> *maximumMessageSizes;
+@property (nonatomic, strong) NSMutableDictionary<NSString *, NSNumber *> *linkDeliveryTimes;
+@property (readwrite, assign) NSUInteger sentMessageCount;
+@property (readwrite, assign) NSUInteger deliveredMessageCount;
+@property (readwrite, assign) NSUInteger lostMessageCount;
+@property (readwrite, assign) NSUInteger duplicatedMessageCount;
+@property (readwrite, assign) NSUInteger reorderedMessageCount;
+@property (readwrite, assign) NSUInteger oversizedMessageCount;
+@property (readwrite, assign) unsigned long long sentByteCount;
+@end
+
+@implementation OTRKitSimulatedNetwork
+
+- (instancetype)init
+{
+	return [self initWithSeed:1];
+}
+
+- (instancetype)initWithSeed:(uint64_t)seed
+{
+	if ((self = [super init])) {
+		self.seed = seed;
+
+		self.randomState = seed;
+
+		self.latency = [OTRKitLatencyDistribution normalLatencyWithMean:0.1 deviation:0.03];
+
+		self.reorderingDelay = 1.0;
+
+		/* The same limits OTRKit fragments messages for by default */
+		self.maximumMessageSizes = [@{@"prpl-msn":   @(1409),
+									  @"prpl-icq":   @(2346),
+									  @"prpl-aim":   @(2343),
+									  @"prpl-yahoo": @(832),
+									  @"prpl-gg":    @(1999),
+									  @"prpl-irc":   @(400),
+									  @"prpl-oscar": @(2343)} mutableCopy];
+
+		self.linkDeliveryTimes = [NSMutableDictionary dictionary];
+
+		return self;
+	}
+
+	return nil;
+}
+
+- (double)nextRandom
+{
+	/* splitmix64 */
+	self.randomState += 0x9E3779B97F4A7C15ULL;
+
+	uint64_t z = self.randomState;
+
+	z = ((z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL);
+	z = ((z ^ (z >> 27)) * 0x94D049BB133111EBULL);
+	z = (z ^ (z >> 31));
+
+	return ((z >> 11) * (1.0 / 9007199254740992.0));
+}
+
+- (void)setMaximumMessageSize:(NSUInteger)maximumMessageSize forProtocol:(NSString *)protocol
+{
+	AssertParamaterLength(protocol)
+
+	self.maximumMessageSizes[protocol] = @(maximumMessageSize);
+}
+
+- (NSUInteger)maximumMessageSizeForProtocol:(NSString *)protocol
+{
+	AssertParamaterLength(protocol)
+
+	return [self.maximumMessageSizes[protocol] unsignedIntegerValue];
+}
+
+- (NSArray<NSNumber *> *)deliveryTimesForMessage:(NSString *)message
+										  onLink:(NSString *)link
+										protocol:(NSString *)protocol
+											 now:(NSTimeInterval)now
+{
+	AssertParamaterNil(message)
+	AssertParamaterLength(link)
+	AssertParamaterLength(protocol)
+
+	NSUInteger messageSize = [message lengthOfBytesUsingEncoding:NSUTF8StringEncoding];
+
+	self.sentMessageCount += 1;
+
+	self.sentByteCount += messageSize;
+
+	NSUInteger maximumMessageSize = [self maximumMessageSizeForProtocol:protocol];
+
+	if (maximumMessageSize > 0 && messageSize > maximumMessageSize) {
+		self.oversizedMessageCount += 1;
+
+		return @[];
+	}
+
+	if ([self nextRandom] < self.lossRate) {
+		self.lostMessageCount += 1;
+
+		return @[];
+	}
+
+	NSUInteger copyCount = 1;
+
+	if ([self nextRandom] < self.duplicationRate) {
+		self.duplicatedMessageCount += 1;
+
+		copyCount = 2;
+	}
+
+	NSMutableArray *deliveryTimes = [NSMutableArray arrayWithCapacity:copyCount];
+
+	for (NSUInteger i = 0; i < copyCount; i++) {
+		NSTimeInterval deliveryTime = (now + [self.latency sampleFromNetwork:self]);
+
+		if ([self nextRandom] < self.reorderingRate) {
+			/* A reordered message is held back on its own, outside the order of the link */
+			self.reorderedMessageCount += 1;
+
+			deliveryTime += ([self nextRandom] * self.reorderingDelay);
+		} else {
+			NSTimeInterval lastDeliveryTime = [self.linkDeliveryTimes[link] doubleValue];
+
+			deliveryTime = MAX(deliveryTime, lastDeliveryTime);
+
+			self.linkDeliveryTimes[link] = @(deliveryTime);
+		}
+
+		[deliveryTimes addObject:@(deliveryTime)];
+	}
+
+	self.deliveredMessageCount += copyCount;
+
+	return deliveryTimes;
+}
+
+- (NSDictionary<NSString *, id> *)parametersForProtocol:(NSString *)protocol
+{
+	AssertParamaterLength(protocol)
+
+	return @{
+		@"protocol" : protocol,
+		@"maximum_message_size" : @([self maximumMessageSizeForProtocol:protocol]),
+		@"latency" : [self.latency specification],
+		@"loss_rate" : @(self.lossRate),
+		@"duplication_rate" : @(self.duplicationRate),
+		@"reordering_rate" : @(self.reorderingRate),
+		@"reordering_delay" : @(self.reorderingDelay),
+		@"seed" : @(self.seed)
+	};
+}
+
+@end
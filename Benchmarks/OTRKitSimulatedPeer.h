@@ -0,0 +1,100 @@
+/* *********************************************************************
+
+        Copyright (c) 2010 - 2015 Codeux Software, LLC
+     Please see ACKNOWLEDGEMENT for additional information.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+
+ * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+ * Neither the name of "Codeux Software, LLC", nor the names of its 
+   contributors may be used to endorse or promote products derived 
+   from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ SUCH DAMAGE.
+
+ *********************************************************************** */
+
+#import <EncryptionKit/EncryptionKit.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ *  A message sent or received in a simulated conversation. Each conversation
+ *  is identified by the same username on both peers.
+ */
+@interface OTRKitSimulatedMessage : NSObject
+@property (readonly, copy) NSString *username;
+@property (readonly, copy) NSString *protocol;
+@property (readonly, copy) NSString *message;
+
+/**
+ *  When the OTRKit gave the message to the delegate
+ */
+@property (readonly) CFAbsoluteTime time;
+@end
+
+@interface OTRKitSimulatedStateChange : NSObject
+@property (readonly, copy) NSString *username;
+@property (readonly, copy) NSString *protocol;
+@property (readonly) OTRKitMessageState messageState;
+@end
+
+/**
+ *  One end of many simulated conversations: an OTRKit with a single account
+ *  for each protocol. Unlike OTRKitBenchmarkPeer, nothing is delivered to
+ *  the other end as it happens. The messages the OTRKit injects, the messages
+ *  it decodes, and the changes to message state are kept, in order, until
+ *  the simulation takes them, which it does once the peer is idle. This keeps
+ *  the simulation independent of how threads are scheduled.
+ *
+ *  Polling is manual so that the simulation can poll on its virtual clock.
+ */
+@interface OTRKitSimulatedPeer : NSObject <OTRKitDelegate>
+/**
+ *  The data path must be empty, or contain nothing but the private keys
+ *  of the peer which saves having to generate them.
+ */
+- (instancetype)initWithName:(NSString *)name dataPath:(NSString *)dataPath;
+
+@property (readonly) OTRKit *otrKit;
+
+@property (readonly, copy) NSString *name;
+@property (readonly, copy) NSString *accountName;
+
+- (BOOL)generatePrivateKeysForProtocols:(NSArray<NSString *> *)protocols timeout:(NSTimeInterval)timeout;
+
+- (void)initiateEncryptionWithUsername:(NSString *)username protocol:(NSString *)protocol;
+
+- (void)encodeMessage:(NSString *)message username:(NSString *)username protocol:(NSString *)protocol;
+- (void)decodeMessage:(NSString *)message username:(NSString *)username protocol:(NSString *)protocol;
+
+/**
+ *  Blocks until the OTRKit has processed every message given to it
+ *  and has made the delegate calls that resulted from them.
+ *
+ *  @return The interval at which libotr asked to be polled
+ */
+- (NSTimeInterval)waitUntilIdle;
+
+- (NSArray<OTRKitSimulatedMessage *> *)takeInjectedMessages;
+- (NSArray<OTRKitSimulatedMessage *> *)takeDecodedMessages;
+- (NSArray<OTRKitSimulatedStateChange *> *)takeStateChanges;
+@end
+
+NS_ASSUME_NONNULL_END
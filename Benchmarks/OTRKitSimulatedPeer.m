@@ -0,0 +1,357 @@
+/* *********************************************************************
+
+        Copyright (c) 2010 - 2015 Codeux Software, LLC
+     Please see ACKNOWLEDGEMENT for additional information.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+
+ * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+ * Neither the name of "Codeux Software, LLC", nor the names of its 
+   contributors may be used to endorse or promote products derived 
+   from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ SUCH DAMAGE.
+
+ *********************************************************************** */
+
+#import "OTRKitSimulatedPeer.h"
+
+@interface OTRKitSimulatedMessage ()
+@property (readwrite, copy) NSString *username;
+@property (readwrite, copy) NSString *protocol;
+@property (readwrite, copy) NSString *message;
+@property (readwrite, assign) CFAbsoluteTime time;
+@end
+
+@implementation OTRKitSimulatedMessage
+@end
+
+@interface OTRKitSimulatedStateChange ()
+@property (readwrite, copy) NSString *username;
+@property (readwrite, copy) NSString *protocol;
+@property (readwrite, assign) OTRKitMessageState messageState;
+@end
+
+@implementation OTRKitSimulatedStateChange
+@end
+
+#pragma mark -
+
+@interface OTRKitSimulatedPeer ()
+@property (readwrite, strong) OTRKit *otrKit;
+@property (readwrite, copy) NSString *name;
+@property (readwrite, copy) NSString *accountName;
+@property (nonatomic, strong) NSMutableArray<OTRKitSimulatedMessage *> *injectedMessages;
+@property (nonatomic, strong) NSMutableArray<OTRKitSimulatedMessage *> *decodedMessages;
+@property (nonatomic, strong) NSMutableArray<OTRKitSimulatedStateChange *> *stateChanges;
+@end
+
+@implementation OTRKitSimulatedPeer
+
+- (instancetype)initWithName:(NSString *)name dataPath:(NSString *)dataPath
+{
+	AssertParamaterLength(name)
+	AssertParamaterLength(dataPath)
+
+	if ((self = [super init])) {
+		self.name = name;
+
+		self.accountName = [name stringByAppendingString:@"@simulation"];
+
+		self.injectedMessages = [NSMutableArray array];
+		self.decodedMessages = [NSMutableArray array];
+
+		self.stateChanges = [NSMutableArray array];
+
+		NSString *queueName = [NSString stringWithFormat:@"OTRKitSimulatedPeer.%@", name];
+
+		self.otrKit = [OTRKit new];
+
+		self.otrKit.delegate = self;
+
+		self.otrKit.delegateQueue = dispatch_queue_create([queueName UTF8String], DISPATCH_QUEUE_SERIAL);
+
+		self.otrKit.manualPollingEnabled = YES;
+
+		[self.otrKit setupWithDataPath:dataPath];
+
+		return self;
+	}
+
+	return nil;
+}
+
+#pragma mark -
+#pragma mark Actions
+
+- (BOOL)generatePrivateKeysForProtocols:(NSArray<NSString *> *)protocols timeout:(NSTimeInterval)timeout
+{
+	AssertParamaterCount(protocols)
+
+	NSMutableArray *accounts = [NSMutableArray arrayWithCapacity:[protocols count]];
+
+	for (NSString *protocol in protocols) {
+		[accounts addObject:[[OTRKitAccount alloc] initWithAccountName:self.accountName protocol:protocol]];
+	}
+
+	dispatch_semaphore_t generateSemaphore = dispatch_semaphore_create(0);
+
+	__block NSError *generateError = nil;
+
+	[self.otrKit pregenerateKeysForAccounts:accounts completion:^(NSError *error) {
+		generateError = error;
+
+		dispatch_semaphore_signal(generateSemaphore);
+	}];
+
+	dispatch_time_t waitTime = dispatch_time(DISPATCH_TIME_NOW, (int64_t)(timeout * NSEC_PER_SEC));
+
+	if (dispatch_semaphore_wait(generateSemaphore, waitTime) != 0) {
+		return NO;
+	}
+
+	if (generateError) {
+		LogToConsole(@"Failed to generate private keys for '%@': %@", self.accountName, [generateError localizedDescription])
+
+		return NO;
+	}
+
+	return YES;
+}
+
+- (void)initiateEncryptionWithUsername:(NSString *)username protocol:(NSString *)protocol
+{
+	[self.otrKit initiateEncryptionWithUsername:username
+									accountName:self.accountName
+									   protocol:protocol];
+}
+
+- (void)encodeMessage:(NSString *)message username:(NSString *)username protocol:(NSString *)protocol
+{
+	[self.otrKit encodeMessage:message
+						  tlvs:@[]
+					  username:username
+				   accountName:self.accountName
+					  protocol:protocol
+						   tag:nil];
+}
+
+- (void)decodeMessage:(NSString *)message username:(NSString *)username protocol:(NSString *)protocol
+{
+	[self.otrKit decodeMessage:message
+					  username:username
+				   accountName:self.accountName
+					  protocol:protocol
+						   tag:nil];
+}
+
+- (NSTimeInterval)waitUntilIdle
+{
+	/* -pollInterval is a synchronous operation on every engine which
+	 returns once the messages queued before it were processed. The
+	 delegate calls those messages made are queued by then as well. */
+	NSTimeInterval pollInterval = [self.otrKit pollInterval];
+
+	dispatch_sync(self.otrKit.delegateQueue, ^{
+	});
+
+	return pollInterval;
+}
+
+#pragma mark -
+#pragma mark Results
+
+- (NSArray *)_takeObjectsFromArray:(NSMutableArray *)array
+{
+	NSArray *objects = nil;
+
+	@synchronized(array) {
+		objects = [array copy];
+
+		[array removeAllObjects];
+	}
+
+	return objects;
+}
+
+- (NSArray<OTRKitSimulatedMessage *> *)takeInjectedMessages
+{
+	return [self _takeObjectsFromArray:self.injectedMessages];
+}
+
+- (NSArray<OTRKitSimulatedMessage *> *)takeDecodedMessages
+{
+	return [self _takeObjectsFromArray:self.decodedMessages];
+}
+
+- (NSArray<OTRKitSimulatedStateChange *> *)takeStateChanges
+{
+	return [self _takeObjectsFromArray:self.stateChanges];
+}
+
+- (void)_addMessage:(NSString *)message username:(NSString *)username protocol:(NSString *)protocol toArray:(NSMutableArray *)array
+{
+	OTRKitSimulatedMessage *simulatedMessage = [OTRKitSimulatedMessage new];
+
+	simulatedMessage.username = username;
+	simulatedMessage.protocol = protocol;
+	simulatedMessage.message = message;
+
+	simulatedMessage.time = CFAbsoluteTimeGetCurrent();
+
+	@synchronized(array) {
+		[array addObject:simulatedMessage];
+	}
+}
+
+#pragma mark -
+#pragma mark Delegate
+
+- (void) otrKit:(OTRKit *)otrKit
+  injectMessage:(NSString *)message
+	   username:(NSString *)username
+	accountName:(NSString *)accountName
+	   protocol:(NSString *)protocol
+			tag:(id)tag
+{
+	[self _addMessage:message username:username protocol:protocol toArray:self.injectedMessages];
+}
+
+- (void) otrKit:(OTRKit *)otrKit
+ injectMessages:(NSArray<NSString *> *)messages
+  fragmentCount:(NSUInteger)fragmentCount
+	  byteCount:(NSUInteger)byteCount
+	   username:(NSString *)username
+	accountName:(NSString *)accountName
+	   protocol:(NSString *)protocol
+			tag:(id)tag
+{
+	for (NSString *message in messages) {
+		[self _addMessage:message username:username protocol:protocol toArray:self.injectedMessages];
+	}
+}
+
+- (void) otrKit:(OTRKit *)otrKit
+ encodedMessage:(NSString *)encodedMessage
+   wasEncrypted:(BOOL)wasEncrypted
+	   username:(NSString *)username
+	accountName:(NSString *)accountName
+	   protocol:(NSString *)protocol
+			tag:(id)tag
+		  error:(NSError *)error
+{
+
+}
+
+- (void) otrKit:(OTRKit *)otrKit
+ decodedMessage:(NSString *)decodedMessage
+   wasEncrypted:(BOOL)wasEncrypted
+		   tlvs:(NSArray<OTRTLV *> *)tlvs
+	   username:(NSString *)username
+	accountName:(NSString *)accountName
+	   protocol:(NSString *)protocol
+			tag:(id)tag
+{
+	if (decodedMessage == nil) {
+		return;
+	}
+
+	[self _addMessage:decodedMessage username:username protocol:protocol toArray:self.decodedMessages];
+}
+
+- (void)    otrKit:(OTRKit *)otrKit
+updateMessageState:(OTRKitMessageState)messageState
+		  username:(NSString *)username
+	   accountName:(NSString *)accountName
+		  protocol:(NSString *)protocol
+{
+	OTRKitSimulatedStateChange *stateChange = [OTRKitSimulatedStateChange new];
+
+	stateChange.username = username;
+	stateChange.protocol = protocol;
+
+	stateChange.messageState = messageState;
+
+	@synchronized(self.stateChanges) {
+		[self.stateChanges addObject:stateChange];
+	}
+}
+
+- (BOOL)       otrKit:(OTRKit *)otrKit
+   isUsernameLoggedIn:(NSString *)username
+		  accountName:(NSString *)accountName
+			 protocol:(NSString *)protocol
+{
+	return YES;
+}
+
+- (void)                           otrKit:(OTRKit *)otrKit
+  showFingerprintConfirmationForTheirHash:(NSString *)theirHash
+								  ourHash:(NSString *)ourHash
+								 username:(NSString *)username
+							  accountName:(NSString *)accountName
+								 protocol:(NSString *)protocol
+{
+
+}
+
+- (void)							  otrKit:(OTRKit *)otrKit
+fingerprintIsVerifiedStateChangedForUsername:(NSString *)username
+								 accountName:(NSString *)accountName
+									protocol:(NSString *)protocol
+									verified:(BOOL)verified
+{
+
+}
+
+- (void) otrKit:(OTRKit *)otrKit
+ handleSMPEvent:(OTRKitSMPEvent)event
+	   progress:(double)progress
+	   question:(NSString *)question
+	   username:(NSString *)username
+	accountName:(NSString *)accountName
+	   protocol:(NSString *)protocol
+{
+
+}
+
+- (void)    otrKit:(OTRKit *)otrKit
+handleMessageEvent:(OTRKitMessageEvent)event
+		   message:(NSString *)message
+		  username:(NSString *)username
+	   accountName:(NSString *)accountName
+		  protocol:(NSString *)protocol
+			   tag:(id)tag
+			 error:(NSError *)error
+{
+
+}
+
+- (void)        otrKit:(OTRKit *)otrKit
+  receivedSymmetricKey:(NSData *)symmetricKey
+				forUse:(NSUInteger)use
+			   useData:(NSData *)useData
+			  username:(NSString *)username
+		   accountName:(NSString *)accountName
+			  protocol:(NSString *)protocol
+{
+
+}
+
+@end
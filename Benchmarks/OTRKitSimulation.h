@@ -0,0 +1,129 @@
+/* *********************************************************************
+
+        Copyright (c) 2010 - 2015 Codeux Software, LLC
+     Please see ACKNOWLEDGEMENT for additional information.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+
+ * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+ * Neither the name of "Codeux Software, LLC", nor the names of its 
+   contributors may be used to endorse or promote products derived 
+   from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ SUCH DAMAGE.
+
+ *********************************************************************** */
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+@class OTRKitBenchmarkReport, OTRKitSimulatedNetwork;
+
+/**
+ *  Simulates many conversations between two OTRKit instances over a
+ *  simulated network, on a virtual clock.
+ *
+ *  Each conversation starts at its own time within the initiation window
+ *  with a request for encryption. When it is not secure after the retry
+ *  interval, encryption is requested again, up to the maximum attempt count.
+ *  Once secure, messages are sent in it which tests fragment reassembly.
+ *
+ *  Between steps of the clock, both OTRKit instances are left to become idle
+ *  so that time passes only when the simulation decides. libotr is polled
+ *  on the virtual clock at the interval it asks for. The results are the
+ *  same for every run with the same configuration and seed of the network,
+ *  with the exception of what libotr itself decides by the wall clock.
+ */
+@interface OTRKitSimulation : NSObject
+/**
+ *  @param workingDirectory Where the data paths of the peers are created
+ */
+- (instancetype)initWithWorkingDirectory:(NSString *)workingDirectory;
+
+@property (readonly, copy) NSString *workingDirectory;
+
+/**
+ *  The network the next run uses. A new network must be set for each run
+ *  because a network keeps statistics and the state of its generator.
+ */
+@property (strong) OTRKitSimulatedNetwork *network;
+
+/**
+ *  Default value for property is prpl-irc.
+ */
+@property (copy) NSString *protocol;
+
+/**
+ *  Default value for property is 1000.
+ */
+@property (assign) NSUInteger conversationCount;
+
+/**
+ *  Default value for property is 10 seconds.
+ */
+@property (assign) NSTimeInterval initiationWindow;
+
+/**
+ *  Default value for property is 15 seconds.
+ */
+@property (assign) NSTimeInterval retryInterval;
+
+/**
+ *  Default value for property is 3.
+ */
+@property (assign) NSUInteger maximumAttemptCount;
+
+/**
+ *  Messages sent in each conversation once it is secure.
+ *  Default value for property is 5.
+ */
+@property (assign) NSUInteger messageCount;
+
+/**
+ *  Default value for property is 1024 bytes.
+ */
+@property (assign) NSUInteger messageSize;
+
+/**
+ *  Default value for property is 1 second.
+ */
+@property (assign) NSTimeInterval messageInterval;
+
+/**
+ *  Virtual time after which the simulation stops.
+ *  Default value for property is 600 seconds.
+ */
+@property (assign) NSTimeInterval timeLimit;
+
+/**
+ *  Wall clock time to wait for private keys to be generated.
+ *  Default value for property is 120 seconds.
+ */
+@property (assign) NSTimeInterval timeout;
+
+/**
+ *  Runs the simulation once and adds its results to the report.
+ *
+ *  @return NO if the simulation could not be run
+ */
+- (BOOL)runWithReport:(OTRKitBenchmarkReport *)report suite:(NSString *)suite;
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,544 @@
+/* *********************************************************************
+
+        Copyright (c) 2010 - 2015 Codeux Software, LLC
+     Please see ACKNOWLEDGEMENT for additional information.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+
+ * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+ * Neither the name of "Codeux Software, LLC", nor the names of its 
+   contributors may be used to endorse or promote products derived 
+   from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ SUCH DAMAGE.
+
+ *********************************************************************** */
+
+#import "OTRKitSimulation.h"
+#import "OTRKitSimulatedClock.h"
+#import "OTRKitSimulatedNetwork.h"
+#import "OTRKitSimulatedPeer.h"
+#import "OTRKitBenchmarkReport.h"
+
+@interface OTRKitSimulatedConversation : NSObject
+@property (nonatomic, copy) NSString *username;
+@property (nonatomic, assign) NSTimeInterval initiationTime;
+@property (nonatomic, assign) NSUInteger attemptCount;
+@property (nonatomic, assign) BOOL initiatorEncrypted;
+@property (nonatomic, assign) BOOL responderEncrypted;
+@property (nonatomic, assign) BOOL secured;
+@property (nonatomic, assign) BOOL resolved;
+@property (nonatomic, assign) NSUInteger sentMessageCount;
+@property (nonatomic, assign) NSUInteger deliveredMessageCount;
+@property (nonatomic, assign) NSUInteger messagesInFlight;
+@end
+
+@implementation OTRKitSimulatedConversation
+@end
+
+#pragma mark -
+
+@interface OTRKitSimulation ()
+@property (readwrite, copy) NSString *workingDirectory;
+@property (nonatomic, strong) NSMutableDictionary<NSString *, NSString *> *privateKeyPaths;
+@property (nonatomic, assign) NSUInteger runCount;
+@property (nonatomic, strong) OTRKitSimulatedClock *clock;
+@property (nonatomic, strong) OTRKitSimulatedPeer *initiator;
+@property (nonatomic, strong) OTRKitSimulatedPeer *responder;
+@property (nonatomic, strong) NSMutableDictionary<NSString *, OTRKitSimulatedConversation *> *conversations;
+@property (nonatomic, strong) NSMutableSet<OTRKitSimulatedConversation *> *activeConversations;
+@property (nonatomic, strong) NSMutableSet<NSString *> *peersAwaitingPoll;
+@property (nonatomic, assign) NSUInteger unresolvedConversationCount;
+@property (nonatomic, assign) NSUInteger pollCount;
+@property (nonatomic, strong) NSMutableArray<NSNumber *> *timeToSecureSamples;
+@property (nonatomic, strong) NSMutableArray<NSNumber *> *attemptCountSamples;
+@property (nonatomic, strong) NSMutableArray<NSNumber *> *messageLatencySamples;
+@end
+
+@implementation OTRKitSimulation
+
+- (instancetype)initWithWorkingDirectory:(NSString *)workingDirectory
+{
+	AssertParamaterLength(workingDirectory)
+
+	if ((self = [super init])) {
+		self.workingDirectory = workingDirectory;
+
+		self.privateKeyPaths = [NSMutableDictionary dictionary];
+
+		self.network = [OTRKitSimulatedNetwork new];
+
+		self.protocol = @"prpl-irc";
+
+		self.conversationCount = 1000;
+
+		self.initiationWindow = 10;
+
+		self.retryInterval = 15;
+
+		self.maximumAttemptCount = 3;
+
+		self.messageCount = 5;
+		self.messageSize = 1024;
+		self.messageInterval = 1;
+
+		self.timeLimit = 600;
+
+		self.timeout = 120;
+
+		return self;
+	}
+
+	return nil;
+}
+
+#pragma mark -
+#pragma mark Peers
+
+- (NSString *)_createDirectoryNamed:(NSString *)name
+{
+	NSString *path = [self.workingDirectory stringByAppendingPathComponent:name];
+
+	NSError *createError = nil;
+
+	if ([[NSFileManager defaultManager] createDirectoryAtPath:path withIntermediateDirectories:YES attributes:nil error:&createError] == NO) {
+		LogToConsole(@"Failed to create directory '%@': %@", path, [createError localizedDescription])
+
+		return nil;
+	}
+
+	return path;
+}
+
+- (NSString *)_privateKeyPathForPeerNamed:(NSString *)name
+{
+	NSString *privateKeyKey = [NSString stringWithFormat:@"%@.%@", self.protocol, name];
+
+	NSString *privateKeyPath = self.privateKeyPaths[privateKeyKey];
+
+	if (privateKeyPath) {
+		return privateKeyPath;
+	}
+
+	NSString *dataPath = [self _createDirectoryNamed:[NSString stringWithFormat:@"simulation-keys/%@/%@", self.protocol, name]];
+
+	if (dataPath == nil) {
+		return nil;
+	}
+
+	OTRKitSimulatedPeer *peer = [[OTRKitSimulatedPeer alloc] initWithName:name dataPath:dataPath];
+
+	if ([peer generatePrivateKeysForProtocols:@[self.protocol] timeout:self.timeout] == NO) {
+		return nil;
+	}
+
+	privateKeyPath = [[peer otrKit] privateKeyPath];
+
+	self.privateKeyPaths[privateKeyKey] = privateKeyPath;
+
+	return privateKeyPath;
+}
+
+- (BOOL)_createPeers
+{
+	self.runCount += 1;
+
+	NSMutableArray *peers = [NSMutableArray arrayWithCapacity:2];
+
+	for (NSString *name in @[@"alice", @"bob"]) {
+		NSString *privateKeyPath = [self _privateKeyPathForPeerNamed:name];
+
+		if (privateKeyPath == nil) {
+			return NO;
+		}
+
+		NSString *dataPath = [self _createDirectoryNamed:[NSString stringWithFormat:@"simulation-%lu/%@", (unsigned long)self.runCount, name]];
+
+		if (dataPath == nil) {
+			return NO;
+		}
+
+		NSString *privateKeyCopyPath = [dataPath stringByAppendingPathComponent:[privateKeyPath lastPathComponent]];
+
+		NSError *copyError = nil;
+
+		if ([[NSFileManager defaultManager] copyItemAtPath:privateKeyPath toPath:privateKeyCopyPath error:&copyError] == NO) {
+			LogToConsole(@"Failed to copy private key of '%@': %@", name, [copyError localizedDescription])
+
+			return NO;
+		}
+
+		OTRKitSimulatedPeer *peer = [[OTRKitSimulatedPeer alloc] initWithName:name dataPath:dataPath];
+
+		/* An application sets the limit of its transport so that libotr fragments messages to fit */
+		[[peer otrKit] setMaximumProtocolSize:(int)[self.network maximumMessageSizeForProtocol:self.protocol] forProtocol:self.protocol];
+
+		[peers addObject:peer];
+	}
+
+	self.initiator = peers[0];
+	self.responder = peers[1];
+
+	return YES;
+}
+
+#pragma mark -
+#pragma mark Run
+
+- (BOOL)runWithReport:(OTRKitBenchmarkReport *)report suite:(NSString *)suite
+{
+	AssertParamaterNil(report)
+	AssertParamaterLength(suite)
+
+	NSMutableDictionary *parameters = [[self.network parametersForProtocol:self.protocol] mutableCopy];
+
+	parameters[@"conversation_count"] = @(self.conversationCount);
+	parameters[@"initiation_window"] = @(self.initiationWindow);
+	parameters[@"retry_interval"] = @(self.retryInterval);
+	parameters[@"maximum_attempt_count"] = @(self.maximumAttemptCount);
+	parameters[@"message_count"] = @(self.messageCount);
+	parameters[@"message_size"] = @(self.messageSize);
+
+	if ([self _createPeers] == NO) {
+		[report addFailureForSuite:suite name:@"setup" reason:@"The peers could not be created"];
+
+		return NO;
+	}
+
+	self.clock = [OTRKitSimulatedClock new];
+
+	self.conversations = [NSMutableDictionary dictionaryWithCapacity:self.conversationCount];
+
+	self.activeConversations = [NSMutableSet set];
+
+	self.peersAwaitingPoll = [NSMutableSet set];
+
+	self.unresolvedConversationCount = self.conversationCount;
+
+	self.pollCount = 0;
+
+	self.timeToSecureSamples = [NSMutableArray array];
+	self.attemptCountSamples = [NSMutableArray array];
+	self.messageLatencySamples = [NSMutableArray array];
+
+	for (NSUInteger i = 0; i < self.conversationCount; i++) {
+		OTRKitSimulatedConversation *conversation = [OTRKitSimulatedConversation new];
+
+		conversation.username = [NSString stringWithFormat:@"peer%lu@simulation", (unsigned long)i];
+
+		self.conversations[conversation.username] = conversation;
+
+		NSTimeInterval initiationTime = ((self.initiationWindow * i) / self.conversationCount);
+
+		[self.clock scheduleBlock:^{
+			[self _attemptEncryptionInConversation:conversation];
+		} atTime:initiationTime];
+	}
+
+	CFAbsoluteTime runStart = CFAbsoluteTimeGetCurrent();
+
+	while (self.unresolvedConversationCount > 0 && [self.clock nextEventTime] <= self.timeLimit) {
+		@autoreleasepool {
+			[self.clock runEventsAtNextTime];
+
+			/* The initiator is always collected from first so that
+			 the network makes its decisions in the same order. */
+			[self _collectFromPeer:self.initiator];
+			[self _collectFromPeer:self.responder];
+
+			for (OTRKitSimulatedConversation *conversation in self.activeConversations) {
+				[self _resolveConversationIfFinished:conversation];
+			}
+
+			[self.activeConversations removeAllObjects];
+		}
+	}
+
+	NSTimeInterval wallTime = (CFAbsoluteTimeGetCurrent() - runStart);
+
+	[self _addResultsToReport:report suite:suite parameters:parameters wallTime:wallTime];
+
+	/* The events of the clock reference the simulation */
+	self.clock = nil;
+
+	self.initiator = nil;
+	self.responder = nil;
+
+	self.conversations = nil;
+
+	return YES;
+}
+
+- (void)_attemptEncryptionInConversation:(OTRKitSimulatedConversation *)conversation
+{
+	if (conversation.secured || conversation.resolved) {
+		return;
+	}
+
+	if (conversation.attemptCount == 0) {
+		conversation.initiationTime = [self.clock now];
+	}
+
+	conversation.attemptCount += 1;
+
+	[self.initiator initiateEncryptionWithUsername:conversation.username protocol:self.protocol];
+
+	[self.clock scheduleBlock:^{
+		[self _retryConversation:conversation];
+	} afterDelay:self.retryInterval];
+}
+
+- (void)_retryConversation:(OTRKitSimulatedConversation *)conversation
+{
+	if (conversation.secured || conversation.resolved) {
+		return;
+	}
+
+	if (conversation.attemptCount < self.maximumAttemptCount) {
+		[self _attemptEncryptionInConversation:conversation];
+
+		return;
+	}
+
+	[self _resolveConversation:conversation];
+}
+
+- (void)_conversationBecameSecure:(OTRKitSimulatedConversation *)conversation
+{
+	conversation.secured = YES;
+
+	[self.timeToSecureSamples addObject:@([self.clock now] - conversation.initiationTime)];
+
+	[self.attemptCountSamples addObject:@(conversation.attemptCount)];
+
+	for (NSUInteger i = 0; i < self.messageCount; i++) {
+		[self.clock scheduleBlock:^{
+			[self _sendMessageInConversation:conversation];
+		} afterDelay:(i * self.messageInterval)];
+	}
+}
+
+- (void)_sendMessageInConversation:(OTRKitSimulatedConversation *)conversation
+{
+	conversation.sentMessageCount += 1;
+
+	[self.activeConversations addObject:conversation];
+
+	/* The time it was sent is carried in the message to measure latency */
+	NSString *message = [NSString stringWithFormat:@"t=%.6f;", [self.clock now]];
+
+	if ([message length] < self.messageSize) {
+		message = [message stringByPaddingToLength:self.messageSize withString:@"x" startingAtIndex:0];
+	}
+
+	[self.initiator encodeMessage:message username:conversation.username protocol:self.protocol];
+}
+
+- (NSTimeInterval)_sendTimeOfMessage:(NSString *)message
+{
+	if ([message hasPrefix:@"t="] == NO) {
+		return (-1);
+	}
+
+	NSRange terminatorRange = [message rangeOfString:@";"];
+
+	if (terminatorRange.location == NSNotFound) {
+		return (-1);
+	}
+
+	return [[message substringWithRange:NSMakeRange(2, (terminatorRange.location - 2))] doubleValue];
+}
+
+- (void)_resolveConversation:(OTRKitSimulatedConversation *)conversation
+{
+	if (conversation.resolved) {
+		return;
+	}
+
+	conversation.resolved = YES;
+
+	self.unresolvedConversationCount -= 1;
+}
+
+- (void)_resolveConversationIfFinished:(OTRKitSimulatedConversation *)conversation
+{
+	/* Nothing more happens in a secure conversation that has sent every
+	 message once nothing is left on the network for it. Messages that
+	 were lost are never delivered. */
+	if (conversation.secured &&
+		conversation.sentMessageCount == self.messageCount &&
+		conversation.messagesInFlight == 0)
+	{
+		[self _resolveConversation:conversation];
+	}
+}
+
+- (void)_schedulePollOfPeer:(OTRKitSimulatedPeer *)peer interval:(NSTimeInterval)pollInterval
+{
+	if (pollInterval <= 0 || [self.peersAwaitingPoll containsObject:[peer name]]) {
+		return;
+	}
+
+	[self.peersAwaitingPoll addObject:[peer name]];
+
+	[self.clock scheduleBlock:^{
+		[self.peersAwaitingPoll removeObject:[peer name]];
+
+		[[peer otrKit] messagePoll];
+
+		self.pollCount += 1;
+	} afterDelay:pollInterval];
+}
+
+- (void)_collectFromPeer:(OTRKitSimulatedPeer *)peer
+{
+	NSTimeInterval pollInterval = [peer waitUntilIdle];
+
+	[self _schedulePollOfPeer:peer interval:pollInterval];
+
+	BOOL isInitiator = (peer == self.initiator);
+
+	OTRKitSimulatedPeer *remotePeer = ((isInitiator) ? self.responder : self.initiator);
+
+	NSTimeInterval now = [self.clock now];
+
+	for (OTRKitSimulatedStateChange *stateChange in [peer takeStateChanges]) {
+		OTRKitSimulatedConversation *conversation = self.conversations[[stateChange username]];
+
+		if (conversation == nil) {
+			continue;
+		}
+
+		BOOL encrypted = ([stateChange messageState] == OTRKitMessageStateEncrypted);
+
+		if (isInitiator) {
+			conversation.initiatorEncrypted = encrypted;
+		} else {
+			conversation.responderEncrypted = encrypted;
+		}
+
+		if (conversation.initiatorEncrypted && conversation.responderEncrypted && conversation.secured == NO) {
+			[self _conversationBecameSecure:conversation];
+		}
+
+		[self.activeConversations addObject:conversation];
+	}
+
+	for (OTRKitSimulatedMessage *decodedMessage in [peer takeDecodedMessages]) {
+		OTRKitSimulatedConversation *conversation = self.conversations[[decodedMessage username]];
+
+		if (conversation == nil || isInitiator) {
+			continue;
+		}
+
+		NSTimeInterval sendTime = [self _sendTimeOfMessage:[decodedMessage message]];
+
+		if (sendTime < 0) {
+			continue;
+		}
+
+		conversation.deliveredMessageCount += 1;
+
+		[self.messageLatencySamples addObject:@(now - sendTime)];
+
+		[self.activeConversations addObject:conversation];
+	}
+
+	for (OTRKitSimulatedMessage *injectedMessage in [peer takeInjectedMessages]) {
+		OTRKitSimulatedConversation *conversation = self.conversations[[injectedMessage username]];
+
+		if (conversation == nil) {
+			continue;
+		}
+
+		NSString *link = [NSString stringWithFormat:@"%@>%@", [peer name], [injectedMessage username]];
+
+		NSArray *deliveryTimes = [self.network deliveryTimesForMessage:[injectedMessage message]
+																onLink:link
+															  protocol:[injectedMessage protocol]
+																   now:now];
+
+		for (NSNumber *deliveryTime in deliveryTimes) {
+			conversation.messagesInFlight += 1;
+
+			[self.clock scheduleBlock:^{
+				conversation.messagesInFlight -= 1;
+
+				[self.activeConversations addObject:conversation];
+
+				[remotePeer decodeMessage:[injectedMessage message]
+								 username:[injectedMessage username]
+								 protocol:[injectedMessage protocol]];
+			} atTime:[deliveryTime doubleValue]];
+		}
+
+		[self.activeConversations addObject:conversation];
+	}
+}
+
+#pragma mark -
+#pragma mark Results
+
+- (void)_addResultsToReport:(OTRKitBenchmarkReport *)report suite:(NSString *)suite parameters:(NSDictionary *)parameters wallTime:(NSTimeInterval)wallTime
+{
+	OTRKitSimulatedNetwork *network = self.network;
+
+	NSUInteger securedCount = [self.timeToSecureSamples count];
+
+	NSUInteger sentMessageCount = 0;
+	NSUInteger deliveredMessageCount = 0;
+
+	for (OTRKitSimulatedConversation *conversation in [self.conversations allValues]) {
+		sentMessageCount += conversation.sentMessageCount;
+
+		deliveredMessageCount += conversation.deliveredMessageCount;
+	}
+
+	[report addResultForSuite:suite name:@"ake_success_rate" value:((double)securedCount / MAX(self.conversationCount, 1)) unit:@"ratio" parameters:parameters];
+
+	if (securedCount > 0) {
+		[report addResultForSuite:suite name:@"time_to_secure" samples:self.timeToSecureSamples unit:@"seconds" parameters:parameters];
+
+		[report addResultForSuite:suite name:@"ake_attempts" samples:self.attemptCountSamples unit:@"attempts" parameters:parameters];
+	}
+
+	if (sentMessageCount > 0) {
+		[report addResultForSuite:suite name:@"message_delivery_rate" value:((double)deliveredMessageCount / sentMessageCount) unit:@"ratio" parameters:parameters];
+	}
+
+	if ([self.messageLatencySamples count] > 0) {
+		[report addResultForSuite:suite name:@"message_latency" samples:self.messageLatencySamples unit:@"seconds" parameters:parameters];
+	}
+
+	[report addResultForSuite:suite name:@"network_messages_sent" value:[network sentMessageCount] unit:@"messages" parameters:parameters];
+	[report addResultForSuite:suite name:@"network_messages_lost" value:[network lostMessageCount] unit:@"messages" parameters:parameters];
+	[report addResultForSuite:suite name:@"network_messages_duplicated" value:[network duplicatedMessageCount] unit:@"messages" parameters:parameters];
+	[report addResultForSuite:suite name:@"network_messages_reordered" value:[network reorderedMessageCount] unit:@"messages" parameters:parameters];
+	[report addResultForSuite:suite name:@"network_messages_oversized" value:[network oversizedMessageCount] unit:@"messages" parameters:parameters];
+	[report addResultForSuite:suite name:@"network_bytes_sent" value:[network sentByteCount] unit:@"bytes" parameters:parameters];
+
+	[report addResultForSuite:suite name:@"polls" value:self.pollCount unit:@"polls" parameters:parameters];
+
+	[report addResultForSuite:suite name:@"virtual_time" value:[self.clock now] unit:@"seconds" parameters:parameters];
+	[report addResultForSuite:suite name:@"wall_time" value:wallTime unit:@"seconds" parameters:parameters];
+
+	[report addResultForSuite:suite name:@"events" value:[self.clock processedEventCount] unit:@"events" parameters:parameters];
+}
+
+@end
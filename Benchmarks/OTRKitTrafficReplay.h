@@ -0,0 +1,86 @@
+/* *********************************************************************
+
+        Copyright (c) 2010 - 2015 Codeux Software, LLC
+     Please see ACKNOWLEDGEMENT for additional information.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+
+ * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+ * Neither the name of "Codeux Software, LLC", nor the names of its 
+   contributors may be used to endorse or promote products derived 
+   from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ SUCH DAMAGE.
+
+ *********************************************************************** */
+
+#import <EncryptionKit/EncryptionKit.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+@class OTRKitBenchmarkReport;
+
+/**
+ *  Replays a trace written by OTRKitTrafficRecorder between two fresh
+ *  OTRKit instances, "local" and "remote", and reports how fast it went.
+ *
+ *  Only what the application did is replayed. A message given to the
+ *  recorded OTRKit to encode is encoded by local, and a message decoded
+ *  by the recorded OTRKit is encoded by remote, each as a message of the
+ *  same length. The key exchanges, fragments, and other protocol messages
+ *  in the trace are not replayed because libotr makes its own. Every
+ *  conversation is made secure before the replay begins.
+ */
+@interface OTRKitTrafficReplay : NSObject
+/**
+ *  @param workingDirectory	Where the data paths of the peers are created.
+ */
+- (instancetype)initWithTrace:(OTRKitTrafficTrace *)trace workingDirectory:(NSString *)workingDirectory;
+
+@property (readonly) OTRKitTrafficTrace *trace;
+@property (readonly, copy) NSString *workingDirectory;
+
+/**
+ *  When set, each message is sent at the time it was recorded.
+ *  Otherwise messages are sent as fast as they are accepted.
+ *  Default value for property is NO.
+ */
+@property (assign) BOOL replaysAtRecordedPace;
+
+/**
+ *  Protocol of the conversations. Default value for property is prpl-irc.
+ */
+@property (copy) NSString *protocol;
+
+/**
+ *  See -[OTRKit setMaximumProtocolSize:forProtocol:]. Zero uses the
+ *  limit OTRKit knows of for the protocol. Default value for property is 0.
+ */
+@property (assign) NSUInteger maximumProtocolSize;
+
+/**
+ *  How long to wait for conversations to become secure, and for the last
+ *  messages to be delivered. Default value for property is 120 seconds.
+ */
+@property (assign) NSTimeInterval timeout;
+
+- (BOOL)runWithReport:(OTRKitBenchmarkReport *)report suite:(NSString *)suite;
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,344 @@
+/* *********************************************************************
+
+        Copyright (c) 2010 - 2015 Codeux Software, LLC
+     Please see ACKNOWLEDGEMENT for additional information.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+
+ * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+ * Neither the name of "Codeux Software, LLC", nor the names of its 
+   contributors may be used to endorse or promote products derived 
+   from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ SUCH DAMAGE.
+
+ *********************************************************************** */
+
+#import "OTRKitTrafficReplay.h"
+#import "OTRKitSimulatedPeer.h"
+#import "OTRKitBenchmarkReport.h"
+
+/* Microseconds to sleep for when there was nothing to relay */
+#define OTRKitTrafficReplayIdleInterval		500
+
+@interface OTRKitTrafficReplay ()
+@property (readwrite, strong) OTRKitTrafficTrace *trace;
+@property (readwrite, copy) NSString *workingDirectory;
+@property (nonatomic, strong) OTRKitSimulatedPeer *localPeer;
+@property (nonatomic, strong) OTRKitSimulatedPeer *remotePeer;
+@property (nonatomic, strong) NSMutableSet<NSString *> *localEncryptedUsernames;
+@property (nonatomic, strong) NSMutableSet<NSString *> *remoteEncryptedUsernames;
+@property (nonatomic, strong) NSMutableArray<NSNumber *> *sendTimes;
+@property (nonatomic, strong) NSMutableArray<NSNumber *> *latencySamples;
+@property (nonatomic, assign) unsigned long long sentByteCount;
+@property (nonatomic, assign) NSUInteger relayedMessageCount;
+@end
+
+@implementation OTRKitTrafficReplay
+
+- (instancetype)initWithTrace:(OTRKitTrafficTrace *)trace workingDirectory:(NSString *)workingDirectory
+{
+	AssertParamaterNil(trace)
+	AssertParamaterLength(workingDirectory)
+
+	if ((self = [super init])) {
+		self.trace = trace;
+
+		self.workingDirectory = workingDirectory;
+
+		self.protocol = @"prpl-irc";
+
+		self.timeout = 120;
+
+		return self;
+	}
+
+	return nil;
+}
+
+#pragma mark -
+#pragma mark Peers
+
+- (NSString *)_usernameOfConversation:(NSUInteger)conversation
+{
+	return [NSString stringWithFormat:@"conversation%lu@replay", (unsigned long)conversation];
+}
+
+- (OTRKitSimulatedPeer *)_newPeerNamed:(NSString *)name
+{
+	NSString *dataPath = [self.workingDirectory stringByAppendingPathComponent:[@"replay/" stringByAppendingString:name]];
+
+	NSError *createError = nil;
+
+	if ([[NSFileManager defaultManager] createDirectoryAtPath:dataPath withIntermediateDirectories:YES attributes:nil error:&createError] == NO) {
+		LogToConsole(@"Failed to create directory '%@': %@", dataPath, [createError localizedDescription])
+
+		return nil;
+	}
+
+	OTRKitSimulatedPeer *peer = [[OTRKitSimulatedPeer alloc] initWithName:name dataPath:dataPath];
+
+	if ([peer generatePrivateKeysForProtocols:@[self.protocol] timeout:self.timeout] == NO) {
+		return nil;
+	}
+
+	if (self.maximumProtocolSize > 0) {
+		[[peer otrKit] setMaximumProtocolSize:(int)self.maximumProtocolSize forProtocol:self.protocol];
+	}
+
+	return peer;
+}
+
+- (BOOL)_createPeers
+{
+	self.localPeer = [self _newPeerNamed:@"local"];
+
+	self.remotePeer = [self _newPeerNamed:@"remote"];
+
+	return (self.localPeer && self.remotePeer);
+}
+
+#pragma mark -
+#pragma mark Relaying
+
+- (void)_takeStateChangesFromPeer:(OTRKitSimulatedPeer *)peer intoSet:(NSMutableSet *)encryptedUsernames
+{
+	for (OTRKitSimulatedStateChange *stateChange in [peer takeStateChanges]) {
+		if ([stateChange messageState] == OTRKitMessageStateEncrypted) {
+			[encryptedUsernames addObject:[stateChange username]];
+		} else {
+			[encryptedUsernames removeObject:[stateChange username]];
+		}
+	}
+}
+
+- (void)_takeDecodedMessagesFromPeer:(OTRKitSimulatedPeer *)peer
+{
+	for (OTRKitSimulatedMessage *decodedMessage in [peer takeDecodedMessages]) {
+		NSString *message = [decodedMessage message];
+
+		if ([message hasPrefix:@"r="] == NO) {
+			continue;
+		}
+
+		NSUInteger sequence = (NSUInteger)[[message substringFromIndex:2] integerValue];
+
+		if (sequence >= [self.sendTimes count]) {
+			continue;
+		}
+
+		[self.latencySamples addObject:@([decodedMessage time] - [self.sendTimes[sequence] doubleValue])];
+	}
+}
+
+/**
+ *  Hands what each peer injected to the other, without waiting.
+ *
+ *  @return YES if anything was relayed
+ */
+- (BOOL)_relayMessages
+{
+	NSArray *localMessages = [self.localPeer takeInjectedMessages];
+
+	for (OTRKitSimulatedMessage *injectedMessage in localMessages) {
+		[self.remotePeer decodeMessage:[injectedMessage message] username:[injectedMessage username] protocol:[injectedMessage protocol]];
+	}
+
+	NSArray *remoteMessages = [self.remotePeer takeInjectedMessages];
+
+	for (OTRKitSimulatedMessage *injectedMessage in remoteMessages) {
+		[self.localPeer decodeMessage:[injectedMessage message] username:[injectedMessage username] protocol:[injectedMessage protocol]];
+	}
+
+	[self _takeStateChangesFromPeer:self.localPeer intoSet:self.localEncryptedUsernames];
+	[self _takeStateChangesFromPeer:self.remotePeer intoSet:self.remoteEncryptedUsernames];
+
+	[self _takeDecodedMessagesFromPeer:self.localPeer];
+	[self _takeDecodedMessagesFromPeer:self.remotePeer];
+
+	NSUInteger relayedMessageCount = ([localMessages count] + [remoteMessages count]);
+
+	self.relayedMessageCount += relayedMessageCount;
+
+	return (relayedMessageCount > 0);
+}
+
+- (void)_relayMessagesUntilTime:(CFAbsoluteTime)time
+{
+	while (CFAbsoluteTimeGetCurrent() < time) {
+		if ([self _relayMessages] == NO) {
+			usleep(OTRKitTrafficReplayIdleInterval);
+		}
+	}
+}
+
+- (BOOL)_relayMessagesUntil:(BOOL (^)(void))condition
+{
+	CFAbsoluteTime limitTime = (CFAbsoluteTimeGetCurrent() + self.timeout);
+
+	while (condition() == NO) {
+		if (CFAbsoluteTimeGetCurrent() > limitTime) {
+			return NO;
+		}
+
+		if ([self _relayMessages] == NO) {
+			usleep(OTRKitTrafficReplayIdleInterval);
+		}
+	}
+
+	return YES;
+}
+
+#pragma mark -
+#pragma mark Replay
+
+- (void)_sendMessageOfLength:(NSUInteger)length inConversation:(NSUInteger)conversation fromPeer:(OTRKitSimulatedPeer *)peer
+{
+	/* The sequence number is carried in the message to measure latency */
+	NSString *message = [NSString stringWithFormat:@"r=%lu;", (unsigned long)[self.sendTimes count]];
+
+	if ([message length] < length) {
+		message = [message stringByPaddingToLength:length withString:@"x" startingAtIndex:0];
+	}
+
+	self.sentByteCount += [message length];
+
+	[self.sendTimes addObject:@(CFAbsoluteTimeGetCurrent())];
+
+	[peer encodeMessage:message username:[self _usernameOfConversation:conversation] protocol:self.protocol];
+}
+
+- (BOOL)runWithReport:(OTRKitBenchmarkReport *)report suite:(NSString *)suite
+{
+	AssertParamaterNil(report)
+	AssertParamaterLength(suite)
+
+	OTRKitTrafficTrace *trace = self.trace;
+
+	NSUInteger conversationCount = [trace conversationCount];
+
+	NSUInteger recordCounts[(OTRKitTrafficRecordTypeInject + 1)] = {0};
+
+	for (OTRKitTrafficRecord *record in [trace records]) {
+		recordCounts[[record type]] += 1;
+	}
+
+	NSDictionary *parameters = @{
+		@"pace" : ((self.replaysAtRecordedPace) ? @"recorded" : @"fast"),
+		@"protocol" : self.protocol,
+		@"maximum_protocol_size" : @(self.maximumProtocolSize),
+		@"conversation_count" : @(conversationCount),
+		@"record_count" : @([[trace records] count]),
+		@"recorded_encode_count" : @(recordCounts[OTRKitTrafficRecordTypeEncode]),
+		@"recorded_decode_count" : @(recordCounts[OTRKitTrafficRecordTypeDecode]),
+		@"recorded_inject_count" : @(recordCounts[OTRKitTrafficRecordTypeInject]),
+		@"recorded_duration" : @([trace duration] / (double)NSEC_PER_SEC)
+	};
+
+	if ([self _createPeers] == NO) {
+		[report addFailureForSuite:suite name:@"setup" reason:@"The peers could not be created"];
+
+		return NO;
+	}
+
+	self.localEncryptedUsernames = [NSMutableSet set];
+	self.remoteEncryptedUsernames = [NSMutableSet set];
+
+	self.sendTimes = [NSMutableArray array];
+
+	self.latencySamples = [NSMutableArray array];
+
+	for (NSUInteger i = 1; i <= conversationCount; i++) {
+		[self.localPeer initiateEncryptionWithUsername:[self _usernameOfConversation:i] protocol:self.protocol];
+	}
+
+	BOOL conversationsSecure = [self _relayMessagesUntil:^BOOL{
+		return ([self.localEncryptedUsernames count] == conversationCount &&
+				[self.remoteEncryptedUsernames count] == conversationCount);
+	}];
+
+	if (conversationsSecure == NO) {
+		[report addFailureForSuite:suite name:@"setup" reason:@"Timed out making conversations secure"];
+
+		return NO;
+	}
+
+	self.relayedMessageCount = 0;
+
+	CFAbsoluteTime replayStart = CFAbsoluteTimeGetCurrent();
+
+	for (OTRKitTrafficRecord *record in [trace records]) {
+		if ([record conversation] == 0) {
+			continue;
+		}
+
+		OTRKitSimulatedPeer *sender = nil;
+
+		if ([record type] == OTRKitTrafficRecordTypeEncode) {
+			sender = self.localPeer;
+		} else if ([record type] == OTRKitTrafficRecordTypeDecoded && [record length] > 0) {
+			sender = self.remotePeer;
+		} else {
+			continue;
+		}
+
+		if (self.replaysAtRecordedPace) {
+			[self _relayMessagesUntilTime:(replayStart + ([record timestamp] / (double)NSEC_PER_SEC))];
+		} else {
+			[self _relayMessages];
+		}
+
+		[self _sendMessageOfLength:[record length] inConversation:[record conversation] fromPeer:sender];
+	}
+
+	NSUInteger sentMessageCount = [self.sendTimes count];
+
+	BOOL messagesDelivered = [self _relayMessagesUntil:^BOOL{
+		return ([self.latencySamples count] >= sentMessageCount);
+	}];
+
+	NSTimeInterval replayDuration = (CFAbsoluteTimeGetCurrent() - replayStart);
+
+	if (messagesDelivered == NO) {
+		[report addFailureForSuite:suite name:@"replay" reason:@"Timed out waiting for messages to be delivered"];
+	}
+
+	[report addResultForSuite:suite name:@"messages" value:sentMessageCount unit:@"messages" parameters:parameters];
+
+	[report addResultForSuite:suite name:@"relayed_messages" value:self.relayedMessageCount unit:@"messages" parameters:parameters];
+
+	[report addResultForSuite:suite name:@"duration" value:replayDuration unit:@"seconds" parameters:parameters];
+
+	if (replayDuration > 0) {
+		[report addResultForSuite:suite name:@"throughput" value:(sentMessageCount / replayDuration) unit:@"messages_per_second" parameters:parameters];
+
+		[report addResultForSuite:suite name:@"byte_throughput" value:(self.sentByteCount / replayDuration) unit:@"bytes_per_second" parameters:parameters];
+	}
+
+	if ([self.latencySamples count] > 0) {
+		[report addResultForSuite:suite name:@"latency" samples:self.latencySamples unit:@"seconds" parameters:parameters];
+	}
+
+	self.localPeer = nil;
+	self.remotePeer = nil;
+
+	return messagesDelivered;
+}
+
+@end
@@ -0,0 +1,288 @@
+/* *********************************************************************
+
+        Copyright (c) 2010 - 2015 Codeux Software, LLC
+     Please see ACKNOWLEDGEMENT for additional information.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+
+ * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+ * Neither the name of "Codeux Software, LLC", nor the names of its 
+   contributors may be used to endorse or promote products derived 
+   from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ SUCH DAMAGE.
+
+ *********************************************************************** */
+
+#import <EncryptionKit/EncryptionKit.h>
+
+#import "OTRKitBenchmark.h"
+#import "OTRKitBenchmarkReport.h"
+#import "OTRKitSimulatedNetwork.h"
+#import "OTRKitSimulation.h"
+
+static void OTRKitBenchmarkPrintUsage(void)
+{
+	fprintf(stderr,
+			"usage: OTRKitBenchmark [options]\n"
+			"\n"
+			"  --suite NAME                 Run a suite, may be repeated (default: all)\n"
+			"                               %s\n"
+			"  --output PATH                Write the JSON report to a file (default: standard output)\n"
+			"  --iterations N               Samples taken by the ake and smp suites\n"
+			"  --messages N                 Messages sent for each throughput measurement\n"
+			"  --message-sizes A,B,...      Sizes of the messages sent, in bytes\n"
+			"  --protocol-sizes A,B,...     Maximum protocol sizes of the fragmentation suite\n"
+			"  --fingerprint-counts A,B,... Sizes of the fingerprint stores\n"
+			"  --timeout SECONDS            How long to wait before a measurement is abandoned\n"
+			"\n"
+			"  Network suite:\n"
+			"  --conversations N            Conversations established at the same time\n"
+			"  --network-protocol NAME      Protocol of the conversations (default: prpl-irc)\n"
+			"  --latency SPEC               constant:S, uniform:MIN:MAX, normal:MEAN:DEVIATION,\n"
+			"                               exponential:MEAN, or pareto:MIN:SHAPE\n"
+			"  --loss RATE                  Probability that a message is lost (0 to 1)\n"
+			"  --duplication RATE           Probability that a message is delivered twice\n"
+			"  --reordering RATE            Probability that a message overtakes those before it\n"
+			"  --reordering-delay SECONDS   Most that a reordered message is held back\n"
+			"  --mtu BYTES                  Largest message the network carries (0: unlimited)\n"
+			"  --seed N                     Seed of the decisions made by the network\n"
+			"  --retry-interval SECONDS     Time before encryption is initiated again\n"
+			"  --attempts N                 Most times encryption is initiated\n"
+			"  --time-limit SECONDS         Virtual time after which the simulation stops\n"
+			"\n"
+			"  Replay suite:\n"
+			"  --trace PATH                 Trace written by OTRKitTrafficRecorder (the suite is skipped without one)\n"
+			"  --pace fast|recorded         Send as fast as possible or when recorded (default: fast)\n"
+			"\n"
+			"  --working-directory PATH     Where to create data paths (default: a temporary directory)\n"
+			"  --keep                       Do not remove the working directory when finished\n",
+			[[[OTRKitBenchmark suiteNames] componentsJoinedByString:@", "] UTF8String]);
+}
+
+static NSArray<NSNumber *> *OTRKitBenchmarkParseList(NSString *argument)
+{
+	NSMutableArray *values = [NSMutableArray array];
+
+	for (NSString *component in [argument componentsSeparatedByString:@","]) {
+		NSString *value = [component stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceCharacterSet]];
+
+		if ([value length] == 0) {
+			continue;
+		}
+
+		[values addObject:@([value longLongValue])];
+	}
+
+	return values;
+}
+
+int main(int argc, const char *argv[])
+{
+	@autoreleasepool {
+		NSMutableArray *suites = [NSMutableArray array];
+
+		NSString *outputPath = nil;
+
+		NSString *workingDirectory = nil;
+
+		BOOL keepWorkingDirectory = NO;
+
+		NSMutableDictionary *options = [NSMutableDictionary dictionary];
+
+		for (int i = 1; i < argc; i++) {
+			NSString *argument = @(argv[i]);
+
+			if ([argument isEqualToString:@"--keep"]) {
+				keepWorkingDirectory = YES;
+
+				continue;
+			} else if ([argument isEqualToString:@"--help"]) {
+				OTRKitBenchmarkPrintUsage();
+
+				return 0;
+			}
+
+			if ((i + 1) >= argc) {
+				OTRKitBenchmarkPrintUsage();
+
+				return 2;
+			}
+
+			NSString *value = @(argv[++i]);
+
+			if ([argument isEqualToString:@"--suite"]) {
+				if ([[OTRKitBenchmark suiteNames] containsObject:value] == NO) {
+					fprintf(stderr, "Unknown suite '%s'\n", [value UTF8String]);
+
+					return 2;
+				}
+
+				[suites addObject:value];
+			} else if ([argument isEqualToString:@"--output"]) {
+				outputPath = value;
+			} else if ([argument isEqualToString:@"--working-directory"]) {
+				workingDirectory = value;
+			} else if ([argument hasPrefix:@"--"]) {
+				options[[argument substringFromIndex:2]] = value;
+			} else {
+				OTRKitBenchmarkPrintUsage();
+
+				return 2;
+			}
+		}
+
+		if ([suites count] == 0) {
+			[suites addObjectsFromArray:[OTRKitBenchmark suiteNames]];
+		}
+
+		if (workingDirectory == nil) {
+			NSString *directoryName = [NSString stringWithFormat:@"OTRKitBenchmark-%d", [[NSProcessInfo processInfo] processIdentifier]];
+
+			workingDirectory = [NSTemporaryDirectory() stringByAppendingPathComponent:directoryName];
+		}
+
+		OTRKitBenchmarkReport *report = [OTRKitBenchmarkReport new];
+
+		OTRKitBenchmark *benchmark = [[OTRKitBenchmark alloc] initWithWorkingDirectory:workingDirectory report:report];
+
+		OTRKitSimulation *simulation = benchmark.simulation;
+
+		/* The network is replaced when seeded so the seed is applied
+		 before any option that configures the network. */
+		if (options[@"seed"]) {
+			simulation.network = [[OTRKitSimulatedNetwork alloc] initWithSeed:strtoull([options[@"seed"] UTF8String], NULL, 10)];
+
+			[options removeObjectForKey:@"seed"];
+		}
+
+		for (NSString *option in options) {
+			NSString *value = options[option];
+
+			if ([option isEqualToString:@"iterations"]) {
+				benchmark.iterations = (NSUInteger)[value integerValue];
+			} else if ([option isEqualToString:@"messages"]) {
+				benchmark.messageCount = (NSUInteger)[value integerValue];
+			} else if ([option isEqualToString:@"message-sizes"]) {
+				benchmark.messageSizes = OTRKitBenchmarkParseList(value);
+			} else if ([option isEqualToString:@"protocol-sizes"]) {
+				benchmark.maximumProtocolSizes = OTRKitBenchmarkParseList(value);
+			} else if ([option isEqualToString:@"fingerprint-counts"]) {
+				benchmark.fingerprintCounts = OTRKitBenchmarkParseList(value);
+			} else if ([option isEqualToString:@"timeout"]) {
+				benchmark.timeout = [value doubleValue];
+			} else if ([option isEqualToString:@"conversations"]) {
+				simulation.conversationCount = (NSUInteger)[value integerValue];
+			} else if ([option isEqualToString:@"network-protocol"]) {
+				simulation.protocol = value;
+			} else if ([option isEqualToString:@"latency"]) {
+				OTRKitLatencyDistribution *latency = [OTRKitLatencyDistribution latencyWithSpecification:value];
+
+				if (latency == nil) {
+					fprintf(stderr, "Invalid latency '%s'\n", [value UTF8String]);
+
+					return 2;
+				}
+
+				simulation.network.latency = latency;
+			} else if ([option isEqualToString:@"loss"]) {
+				simulation.network.lossRate = [value doubleValue];
+			} else if ([option isEqualToString:@"duplication"]) {
+				simulation.network.duplicationRate = [value doubleValue];
+			} else if ([option isEqualToString:@"reordering"]) {
+				simulation.network.reorderingRate = [value doubleValue];
+			} else if ([option isEqualToString:@"reordering-delay"]) {
+				simulation.network.reorderingDelay = [value doubleValue];
+			} else if ([option isEqualToString:@"retry-interval"]) {
+				simulation.retryInterval = [value doubleValue];
+			} else if ([option isEqualToString:@"attempts"]) {
+				simulation.maximumAttemptCount = (NSUInteger)[value integerValue];
+			} else if ([option isEqualToString:@"time-limit"]) {
+				simulation.timeLimit = [value doubleValue];
+			} else if ([option isEqualToString:@"trace"]) {
+				benchmark.tracePath = value;
+			} else if ([option isEqualToString:@"pace"]) {
+				if ([value isEqualToString:@"recorded"]) {
+					benchmark.replaysAtRecordedPace = YES;
+				} else if ([value isEqualToString:@"fast"] == NO) {
+					fprintf(stderr, "Unknown pace '%s'\n", [value UTF8String]);
+
+					return 2;
+				}
+			} else if ([option isEqualToString:@"mtu"]) {
+				/* Applied once the protocol is known */
+			} else {
+				fprintf(stderr, "Unknown option '--%s'\n", [option UTF8String]);
+
+				return 2;
+			}
+		}
+
+		/* The limit belongs to a protocol which may itself be an option */
+		if (options[@"mtu"]) {
+			[simulation.network setMaximumMessageSize:(NSUInteger)[options[@"mtu"] integerValue] forProtocol:simulation.protocol];
+		}
+
+		if (benchmark.iterations == 0 || benchmark.messageCount == 0 || simulation.conversationCount == 0) {
+			OTRKitBenchmarkPrintUsage();
+
+			return 2;
+		}
+
+		NSProcessInfo *processInfo = [NSProcessInfo processInfo];
+
+		[report setConfigurationValue:[OTRKit libotrVersion] forKey:@"libotr"];
+		[report setConfigurationValue:[OTRKit libgcryptVersion] forKey:@"libgcrypt"];
+		[report setConfigurationValue:[OTRKit libgpgErrorVersion] forKey:@"libgpg-error"];
+
+		[report setConfigurationValue:[processInfo operatingSystemVersionString] forKey:@"operating_system"];
+		[report setConfigurationValue:@([processInfo activeProcessorCount]) forKey:@"processor_count"];
+		[report setConfigurationValue:@([processInfo physicalMemory]) forKey:@"physical_memory"];
+
+		[report setConfigurationValue:suites forKey:@"suites"];
+		[report setConfigurationValue:@(benchmark.iterations) forKey:@"iterations"];
+		[report setConfigurationValue:@(benchmark.messageCount) forKey:@"message_count"];
+		[report setConfigurationValue:benchmark.messageSizes forKey:@"message_sizes"];
+		[report setConfigurationValue:benchmark.maximumProtocolSizes forKey:@"maximum_protocol_sizes"];
+		[report setConfigurationValue:benchmark.fingerprintCounts forKey:@"fingerprint_counts"];
+		[report setConfigurationValue:@(simulation.network.seed) forKey:@"network_seed"];
+
+		for (NSString *suite in suites) {
+			@autoreleasepool {
+				[benchmark runSuite:suite];
+			}
+		}
+
+		benchmark = nil;
+
+		if (keepWorkingDirectory == NO) {
+			[[NSFileManager defaultManager] removeItemAtPath:workingDirectory error:NULL];
+		}
+
+		NSError *writeError = nil;
+
+		if ([report writeToPath:outputPath error:&writeError] == NO) {
+			fprintf(stderr, "Failed to write report: %s\n", [[writeError localizedDescription] UTF8String]);
+
+			return 1;
+		}
+
+		return (([report hasFailures]) ? 1 : 0);
+	}
+}
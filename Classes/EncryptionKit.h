@@ -31,7 +31,20 @@
  *********************************************************************** */
 
 #import <EncryptionKit/OTRKit.h>
+#import <EncryptionKit/OTRKitAccount.h>
 #import <EncryptionKit/OTRKitConcreteObject.h>
+#import <EncryptionKit/OTRKitConversation.h>
+#import <EncryptionKit/OTRKitKeyGenerationJob.h>
+#import <EncryptionKit/OTRKitMessageBatch.h>
+#import <EncryptionKit/OTRKitLoadStatistics.h>
+#import <EncryptionKit/OTRKitWriteStatistics.h>
+#import <EncryptionKit/OTRKitEvictionStatistics.h>
+#import <EncryptionKit/OTRKitMetrics.h>
+#import <EncryptionKit/OTRKitTracer.h>
+#import <EncryptionKit/OTRKitTrafficRecorder.h>
+#import <EncryptionKit/OTRKitStorage.h>
+#import <EncryptionKit/OTRKitMemoryStorage.h>
+#import <EncryptionKit/OTRKitSQLiteStorage.h>
 #import <EncryptionKit/OTRKitAuthenticationDialog.h>
 #import <EncryptionKit/OTRKitFingerprintManagerDialog.h>
 
@@ -37,10 +37,26 @@
 NS_ASSUME_NONNULL_BEGIN
 
 @class OTRKit;
+@class OTRKitAccount;
+@class OTRKitKeyGenerationJob;
 @class OTRKitConcreteObject;
+@class OTRKitConversation;
+@class OTRKitLoadStatistics;
+@class OTRKitWriteStatistics;
+@class OTRKitEvictionStatistics;
+@class OTRKitMetrics;
+@class OTRKitTrafficRecorder;
+
+@protocol OTRKitTracer;
+@class OTRKitOutgoingMessage;
+@class OTRKitEncodedMessage;
+@class OTRKitIncomingMessage;
+@class OTRKitDecodedMessage;
 
 @class OTRTLV;
 
+@protocol OTRKitStorage;
+
 typedef NS_ENUM(NSUInteger, OTRKitMessageState) {
 	OTRKitMessageStatePlaintext,
 	OTRKitMessageStateEncrypted,
@@ -107,6 +123,18 @@ typedef NS_ENUM(NSUInteger, OTRKitMessageType) {
 	OTRKitMessageTypeUnknown
 };
 
+/**
+ *  A filter that decides whether an incoming message is ignored.
+ *  See -incomingMessageFilter
+ *
+ *  @return YES to ignore message
+ */
+typedef BOOL (^OTRKitIncomingMessageFilter)(NSString *message,
+											OTRKitMessageType messageType,
+											NSString *username,
+											NSString *accountName,
+											NSString *protocol);
+
 /** 
  *  Notification fired when a fingerprint and/or its attributes change. This 
  *  includes a new fingerprint arriving, one being deleted, or the trust of an 
@@ -123,6 +151,17 @@ extern NSString * const OTRKitListOfFingerprintsDidChangeNotification;
  */
 extern NSString * const OTRKitMessageStateDidChangeNotification;
 
+/**
+ *  Notification fired when the state of the generation of a private key
+ *  changes. Posted on the delegate queue.
+ *
+ *  The userInfo dictionary contains the new OTRKitKeyGenerationJob
+ *  for the key OTRKitKeyGenerationJobKey
+ */
+extern NSString * const OTRKitKeyGenerationJobDidChangeNotification;
+
+extern NSString * const OTRKitKeyGenerationJobKey;
+
 @protocol OTRKitDelegate <NSObject>
 @required
 
@@ -207,6 +246,10 @@ updateMessageState:(OTRKitMessageState)messageState
  *  libotr likes to know if users are still "online". This method
  *  is called synchronously on the callback queue so be careful.
  *
+ *  This method is no longer called once the presence of any user
+ *  has been supplied using -[OTRKit setLoggedIn:forUsername:accountName:protocol:]
+ *  until -[OTRKit removeAllLoggedInStates] is called.
+ *
  *  @param otrKit		Reference to shared instance
  *  @param username		The account name of the remote user
  *  @param accountName	The account name of the local user
@@ -315,6 +358,10 @@ handleMessageEvent:(OTRKitMessageEvent)event
 /**
  *  Called when starting to generate a private key, may take a while.
  *
+ *  The key is generated in the background. Until it is finished, messages
+ *  sent and received by the account are held, up to a limit, and are then
+ *  processed in order. Messages past the limit fail with an error.
+ *
  *  @param otrKit      Reference to shared instance
  *  @param accountName The account name of the local user
  *  @param protocol    The protocol of the exchange
@@ -339,6 +386,10 @@ didFinishGeneratingPrivateKeyForAccountName:(NSString *)accountName
 /**
  *  Conditionally ignore an incoming message (message to decode)
  *
+ *  This method is called synchronously on the delegate queue for every
+ *  incoming message which blocks decoding until the delegate queue is free.
+ *  It is not called when -[OTRKit incomingMessageFilter] is set.
+ *
  *  @param otrKit		Reference to shared instance
  *  @param message		The message to be decoded
  *  @param messageType	The type of message
@@ -354,6 +405,67 @@ didFinishGeneratingPrivateKeyForAccountName:(NSString *)accountName
 		 username:(NSString *)username
 	  accountName:(NSString *)accountName
 		 protocol:(NSString *)protocol;
+
+/**
+ *  Delivers the result of -encodeMessages:username:accountName:protocol: in
+ *  a single callback. When implemented, neither -otrKit:encodedMessage:...
+ *  nor -otrKit:injectMessage:... is called for messages that are part of a
+ *  batch. The messages to send for each result are instead found in its
+ *  injectedMessages property.
+ *
+ *  @param otrKit			Reference to shared instance
+ *  @param encodedMessages	One result for each message in the batch, in the same order
+ *  @param username			The account name of the remote user
+ *  @param accountName		The account name of the local user
+ *  @param protocol			The protocol of the exchange
+ */
+- (void)  otrKit:(OTRKit *)otrKit
+ encodedMessages:(NSArray<OTRKitEncodedMessage *> *)encodedMessages
+		username:(NSString *)username
+	 accountName:(NSString *)accountName
+		protocol:(NSString *)protocol;
+
+/**
+ *  Delivers every message libotr injected while encoding a single message
+ *  in one callback. A message larger than the maximum size of the protocol
+ *  is injected as fragments which must be sent in the order given. When
+ *  implemented, -otrKit:injectMessage:... is not called for messages that
+ *  are injected while encoding.
+ *
+ *  @param otrKit			Reference to shared instance
+ *  @param messages			Messages to be sent over the network, in order
+ *  @param fragmentCount	Number of messages, which is more than one when the message was fragmented
+ *  @param byteCount		Length of all the messages together in bytes of UTF-8
+ *  @param username			The account name of the remote user
+ *  @param accountName		The account name of the local user
+ *  @param protocol			The protocol of the exchange
+ *  @param tag				Optional tag to attached to message. Only used locally.
+ */
+- (void) otrKit:(OTRKit *)otrKit
+ injectMessages:(NSArray<NSString *> *)messages
+  fragmentCount:(NSUInteger)fragmentCount
+	  byteCount:(NSUInteger)byteCount
+	   username:(NSString *)username
+	accountName:(NSString *)accountName
+	   protocol:(NSString *)protocol
+			tag:(nullable id)tag;
+
+/**
+ *  Delivers the result of -decodeMessages:username:accountName:protocol: in
+ *  a single callback. When implemented, -otrKit:decodedMessage:... is not
+ *  called for messages that are part of a batch.
+ *
+ *  @param otrKit			Reference to shared instance
+ *  @param decodedMessages	One result for each message in the batch, in the same order
+ *  @param username			The account name of the remote user
+ *  @param accountName		The account name of the local user
+ *  @param protocol			The protocol of the exchange
+ */
+- (void)  otrKit:(OTRKit *)otrKit
+ decodedMessages:(NSArray<OTRKitDecodedMessage *> *)decodedMessages
+		username:(NSString *)username
+	 accountName:(NSString *)accountName
+		protocol:(NSString *)protocol;
 @end
 
 @interface OTRKit : NSObject
@@ -364,6 +476,16 @@ didFinishGeneratingPrivateKeyForAccountName:(NSString *)accountName
  */
 @property (nonatomic, strong, nullable) dispatch_queue_t delegateQueue;
 
+/**
+ *  Conditionally ignore incoming messages without a trip to the delegate queue.
+ *
+ *  The filter is called on the internal queue of OTRKit, possibly from several
+ *  threads at once when sharding is enabled, so it must be thread safe and it
+ *  should return quickly. When set, -otrKit:ignoreMessage:... is not called.
+ *  Default value for property is nil.
+ */
+@property (copy, nullable) OTRKitIncomingMessageFilter incomingMessageFilter;
+
 /**
  * By default uses `OTRKitPolicyDefault`
  */
@@ -399,8 +521,110 @@ didFinishGeneratingPrivateKeyForAccountName:(NSString *)accountName
 @property (nonatomic, copy) NSString *accountNameSeparator;
 
 /**
- *  Always use the sharedInstance. Using two OTRKits within your application
- *  may exhibit strange problems.
+ *  When enabled, each account name and protocol pair is given an engine of
+ *  its own: a separate libotr user state, a separate serial queue, and a
+ *  separate copy of its private key, fingerprints, and instance tags stored
+ *  in a subfolder of the data path. Conversations that belong to different
+ *  accounts are then processed in parallel while messages that belong to
+ *  the same conversation are still processed in order.
+ *
+ *  The first time sharding is enabled, the existing data is divided among
+ *  the accounts it belongs to. The original files are left untouched.
+ *
+ *  This property must be set before -setupWithDataPath: is called.
+ *  Default value for property is NO.
+ */
+@property (nonatomic, assign) BOOL shardingEnabled;
+
+/**
+ *  The fingerprints file is written in the background. Changes made within
+ *  this many seconds of each other are written to disk together.
+ *
+ *  Changes that have not been written yet are lost if the application exits
+ *  without calling -flushFingerprints first.
+ *  Default value for property is 0.5 seconds.
+ */
+@property (assign) NSTimeInterval fingerprintsWriteCoalescingInterval;
+
+/**
+ *  When enabled, the fingerprints of a remote user are only loaded once
+ *  a conversation with that user needs them instead of all at once when
+ *  OTRKit is set up. -requestAllFingerprints still returns all of them.
+ *
+ *  Fingerprints are loaded lazily from the snapshot described in
+ *  -loadStatistics which means they are loaded all at once when a
+ *  snapshot does not exist yet. They are also all loaded before the
+ *  fingerprints file is written in full.
+ *
+ *  This property must be set before -setupWithDataPath: is called.
+ *  Default value for property is NO.
+ */
+@property (nonatomic, assign) BOOL lazyFingerprintLoading;
+
+/**
+ *  Where private keys, fingerprints, and instance tags are stored.
+ *
+ *  When nil, they are stored in the files libotr uses in the data path,
+ *  along with the snapshot and journal described above. When set, they
+ *  are read from and written to the storage instead and none of those
+ *  files are used. Changes to fingerprints are written to the storage
+ *  in transactions that follow the same coalescing interval.
+ *
+ *  OTRKitSQLiteStorage and OTRKitMemoryStorage are provided. When sharding
+ *  is enabled, an engine is created for each account that has a private
+ *  key or an instance tag in the storage. Fingerprints are not loaded
+ *  lazily from a storage.
+ *
+ *  This property must be set before -setupWithDataPath: is called.
+ *  Default value for property is nil.
+ */
+@property (nonatomic, strong, nullable) id<OTRKitStorage> storage;
+
+/**
+ *  libotr asks to be polled at an interval while it has old keys to expire.
+ *  By default OTRKit polls on a timer of its own. When manual polling is
+ *  enabled, that timer is never started and the application calls
+ *  -messagePoll at the interval in -pollInterval instead. This is meant for
+ *  simulations that keep time with a clock of their own.
+ *
+ *  This property must be set before -setupWithDataPath: is called.
+ *  Default value for property is NO.
+ */
+@property (nonatomic, assign) BOOL manualPollingEnabled;
+
+/**
+ *  libotr keeps the key exchange, session keys, and socialist millionaires'
+ *  state of every remote user a conversation was had with until OTRKit
+ *  is deallocated. Conversations can be evicted to bound that memory.
+ *
+ *  Evicting a conversation disconnects it from the remote user if it was
+ *  encrypted and throws away its state. Its fingerprints are kept. The
+ *  conversation starts over as if new the next time it is used.
+ *
+ *  Conversations not used for longer than the idle timeout are evicted.
+ *  When there are more conversations than the maximum count, or they are
+ *  estimated to use more bytes than the memory budget, those used the
+ *  longest time ago are evicted. The conversation used last is never
+ *  evicted for exceeding a limit. When sharding is enabled, the limits
+ *  apply to each account on its own.
+ *
+ *  Changes take effect the next time a conversation is used.
+ *  Default value for each property is 0 which disables it.
+ */
+@property (assign) NSTimeInterval conversationIdleTimeout;
+@property (assign) NSUInteger maximumLiveConversationCount;
+@property (assign) unsigned long long conversationMemoryBudget;
+
+/**
+ *  A shared instance for applications that only need one OTRKit.
+ *
+ *  Additional instances can be created with -init. Each instance is fully
+ *  isolated: it has its own delegate, policy, queues, and poll timer. Each
+ *  instance must be given a data path of its own with -setupWithDataPath:
+ *  because instances that share a data path will overwrite each other's files.
+ *
+ *  The authentication and fingerprint manager dialogs always operate on
+ *  the shared instance.
  *
  *  @return singleton instance
  */
@@ -413,6 +637,55 @@ didFinishGeneratingPrivateKeyForAccountName:(NSString *)accountName
  */
 - (void)setupWithDataPath:(NSString *)dataPath;
 
+/**
+ *  Inform OTRKit of a change to whether a remote user is online.
+ *
+ *  libotr asks whether a user is online during heartbeats and when a
+ *  conversation is disconnected. Once presence is supplied with this method,
+ *  those questions are answered by OTRKit without a synchronous trip to the
+ *  delegate queue, and -otrKit:isUsernameLoggedIn:... is no longer called.
+ *  Users whose presence was never supplied are reported as unknown.
+ *
+ *  @param loggedIn		Whether the remote user is online
+ *  @param username		The account name of the remote user
+ *  @param accountName	The account name of the local user
+ *  @param protocol		The protocol of the exchange
+ */
+- (void)setLoggedIn:(BOOL)loggedIn
+		forUsername:(NSString *)username
+		accountName:(NSString *)accountName
+		   protocol:(NSString *)protocol;
+
+/**
+ *  Same as -setLoggedIn:forUsername:accountName:protocol: for several
+ *  remote users at once, such as when a roster is first received.
+ */
+- (void)setLoggedIn:(BOOL)loggedIn
+	   forUsernames:(NSArray<NSString *> *)usernames
+		accountName:(NSString *)accountName
+		   protocol:(NSString *)protocol;
+
+/**
+ *  Forget the presence of a remote user, such as when they are removed
+ *  from a roster. The user is reported as unknown afterwards.
+ */
+- (void)removeLoggedInStateForUsername:(NSString *)username
+						   accountName:(NSString *)accountName
+							  protocol:(NSString *)protocol;
+
+/**
+ *  Forget the presence of every remote user seen from an account,
+ *  such as when the account is disconnected.
+ */
+- (void)removeLoggedInStatesForAccountName:(NSString *)accountName
+								  protocol:(NSString *)protocol;
+
+/**
+ *  Forget the presence of every remote user. OTRKit goes back to asking
+ *  -otrKit:isUsernameLoggedIn:... until presence is supplied again.
+ */
+- (void)removeAllLoggedInStates;
+
 /**
  *  For specifying fragmentation for a protocol.
  *
@@ -421,9 +694,23 @@ didFinishGeneratingPrivateKeyForAccountName:(NSString *)accountName
  */
 - (void)setMaximumProtocolSize:(int)maxSize forProtocol:(NSString *)protocol;
 
+/**
+ *  The shortest interval in seconds at which libotr asked to be polled,
+ *  or 0 when it does not need to be polled. Waits for messages that are
+ *  being processed. See -manualPollingEnabled
+ */
+- (NSTimeInterval)pollInterval;
+
+/**
+ *  Polls libotr now, whether manual polling is enabled or not.
+ */
+- (void)messagePoll;
+
 /**
  * Encodes a message and optional array of OTRTLVs, splits it into fragments,
- * then injects the encoded data via the injectMessage: delegate method.
+ * then injects the encoded data via the injectMessage: delegate method, or
+ * all fragments at once via the injectMessages: delegate method when it is
+ * implemented.
  *
  * @param message		The message to be encoded
  * @param tlvs			Array of OTRTLVs, the data length of each TLV must be smaller than UINT16_MAX or it will be ignored.
@@ -439,6 +726,23 @@ didFinishGeneratingPrivateKeyForAccountName:(NSString *)accountName
 			 protocol:(NSString *)protocol
 				  tag:(nullable id)tag;
 
+/**
+ * Encodes an ordered batch of messages that belong to the same conversation.
+ *
+ * The batch is processed in one pass on the internal queue and the results
+ * are delivered in one pass on the delegate queue, preserving the order of
+ * the messages. See -otrKit:encodedMessages:username:accountName:protocol:
+ *
+ * @param messages		Array of OTRKitOutgoingMessage
+ * @param username		The account name of the remote user
+ * @param accountName	The account name of the local user
+ * @param protocol		The protocol of the exchange
+ */
+- (void)encodeMessages:(NSArray<OTRKitOutgoingMessage *> *)messages
+			  username:(NSString *)username
+		   accountName:(NSString *)accountName
+			  protocol:(NSString *)protocol;
+
 /**
  *  All messages should be sent through here before being processed by your program.
  *
@@ -454,16 +758,71 @@ didFinishGeneratingPrivateKeyForAccountName:(NSString *)accountName
 			 protocol:(NSString *)protocol
 				  tag:(nullable id)tag;
 
+/**
+ *  Decodes an ordered batch of incoming messages that belong to the same
+ *  conversation, such as those replayed by a server when reconnecting.
+ *
+ *  The batch is processed in one pass on the internal queue and the results
+ *  are delivered in one pass on the delegate queue, preserving the order of
+ *  the messages. See -otrKit:decodedMessages:username:accountName:protocol:
+ *
+ *  @param messages			Array of OTRKitIncomingMessage
+ *  @param username			The account name of the remote user
+ *  @param accountName		The account name of the local user
+ *  @param protocol			The protocol of the exchange
+ */
+- (void)decodeMessages:(NSArray<OTRKitIncomingMessage *> *)messages
+			  username:(NSString *)username
+		   accountName:(NSString *)accountName
+			  protocol:(NSString *)protocol;
+
 /**
  *  You can use this method to determine whether or not OTRKit is 
  *  currently generating a private key.
  *
+ *  The answer is read from memory and may be asked for from any thread
+ *  without waiting for messages that are being processed.
+ *
  *  @param accountName		The account name of the local user
  *  @param protocol			The protocol of the exchange
  */
 - (BOOL)isGeneratingKeyForAccountName:(NSString *)accountName
 							 protocol:(NSString *)protocol;
 
+/**
+ *  The most recent generation of the private key of an account, or nil
+ *  if no key was generated for it since OTRKit was set up. Safe to call
+ *  from any thread.
+ *
+ *  @param accountName		The account name of the local user
+ *  @param protocol			The protocol of the exchange
+ */
+- (nullable OTRKitKeyGenerationJob *)keyGenerationJobForAccountName:(NSString *)accountName
+														   protocol:(NSString *)protocol;
+
+/**
+ *  The most recent generation of the private key of every account
+ *  for which a key was generated. Safe to call from any thread.
+ */
+- (NSArray<OTRKitKeyGenerationJob *> *)keyGenerationJobs;
+
+/**
+ *  Generates the private keys of several accounts ahead of time so that
+ *  nobody has to wait for a key to be generated in their first conversation.
+ *
+ *  Keys are generated in parallel using every processor core. The keys of
+ *  accounts that share a private key file are written to it all at once.
+ *  Accounts that already have a key, or are having one generated, are skipped.
+ *  The delegate is informed of each key through -otrKit:willStartGeneratingPrivateKeyForAccountName:protocol:
+ *  and -otrKit:didFinishGeneratingPrivateKeyForAccountName:protocol:error:
+ *
+ *  @param accounts		The accounts to generate keys for
+ *  @param completion	Called on the delegate queue once every key is finished.
+ *						error is the first error that occurred, if any.
+ */
+- (void)pregenerateKeysForAccounts:(NSArray<OTRKitAccount *> *)accounts
+						completion:(void (^ __nullable)(NSError * __nullable error))completion;
+
 /**
  *  Shortcut for injecting a "?OTR?" message.
  *
@@ -511,6 +870,8 @@ didFinishGeneratingPrivateKeyForAccountName:(NSString *)accountName
 
 /**
  *  Return type of message.
+ *
+ *  This method is thread safe and returns without waiting on any queue.
  */
 - (OTRKitMessageType)typeOfMessage:(NSString *)message;
 
@@ -675,6 +1036,134 @@ didFinishGeneratingPrivateKeyForAccountName:(NSString *)accountName
 - (void)setFingerprintVerificationForConcreteObject:(OTRKitConcreteObject *)fingerprint
 										   verified:(BOOL)verified;
 
+/**
+ *  Writes changes to fingerprints that are waiting to be written and
+ *  blocks until they are on disk. Call before the application exits.
+ */
+- (void)flushFingerprints;
+
+/**
+ *  Counts and timings of the writes made to the fingerprints file
+ *  since OTRKit was set up, combined for all engines.
+ */
+- (OTRKitWriteStatistics *)fingerprintsWriteStatistics;
+
+/**
+ *  Timings of loading the private keys, fingerprints, and instance tags
+ *  from disk, combined for all engines that have finished loading.
+ *
+ *  The first time the files are loaded, a binary snapshot of them is saved
+ *  to the data path. Later loads use the snapshot for as long as the files
+ *  are unchanged.
+ */
+- (OTRKitLoadStatistics *)loadStatistics;
+
+/**
+ *  Blocks until every engine has finished loading the private keys,
+ *  fingerprints, and instance tags that it was set up with. Loading
+ *  happens in the background, so call this before reading -loadStatistics
+ *  to be sure that it is complete.
+ */
+- (void)waitUntilLoaded;
+
+/**
+ *  The number and estimated footprint of the conversations in memory and
+ *  counts of those evicted, combined for all engines. See -conversationIdleTimeout
+ *
+ *  Conversations are only counted while a limit is set, once they are used.
+ */
+- (OTRKitEvictionStatistics *)conversationEvictionStatistics;
+
+/**
+ *  Depth of the queues, the number of conversations and fingerprints that
+ *  libotr holds, and counts and latencies of each kind of operation.
+ *
+ *  The counters are cheap enough to always be kept and are read without
+ *  waiting for operations in progress to finish.
+ */
+- (OTRKitMetrics *)metrics;
+
+/**
+ *  Told when each stage of encoding or decoding a message begins and ends
+ *  to find where the time spent on a slow message went. See OTRKitTracer
+ *  and OTRKitChromeTraceWriter.
+ *
+ *  Tracing costs nothing more than reading this property when it is nil.
+ *  Default value for property is nil.
+ */
+@property (strong, nullable) id<OTRKitTracer> tracer;
+
+/**
+ *  Records the length, type, and timing of every message given to OTRKit
+ *  to encode or decode, what decoding them produced, and every message
+ *  libotr injects, to replay the shape of a workload elsewhere. No part
+ *  of any message is recorded. See OTRKitTrafficRecorder
+ *
+ *  Recording costs nothing more than reading this property when it is nil.
+ *  Default value for property is nil.
+ */
+@property (strong, nullable) OTRKitTrafficRecorder *trafficRecorder;
+
+/**
+ *  Returns the handle for a conversation. The same handle is returned for
+ *  the same conversation until it is evicted. A handle that is kept after
+ *  its conversation is evicted keeps working.
+ *
+ *  Each of the methods below is the same as the method of the same name
+ *  that takes a username, account name, and protocol. The handle does away
+ *  with the cost of transcoding those strings and of looking up the
+ *  conversation on every call, which makes them preferable on busy paths.
+ *
+ *  @param username		The account name of the remote user
+ *  @param accountName	The account name of the local user
+ *  @param protocol		The protocol of the exchange
+ */
+- (OTRKitConversation *)conversationForUsername:(NSString *)username
+									accountName:(NSString *)accountName
+									   protocol:(NSString *)protocol;
+
+- (void)encodeMessage:(nullable NSString *)message
+				 tlvs:(NSArray<OTRTLV *> *)tlvs
+		 conversation:(OTRKitConversation *)conversation
+				  tag:(nullable id)tag;
+
+- (void)encodeMessages:(NSArray<OTRKitOutgoingMessage *> *)messages
+		  conversation:(OTRKitConversation *)conversation;
+
+- (void)decodeMessage:(NSString *)message
+		 conversation:(OTRKitConversation *)conversation
+				  tag:(nullable id)tag;
+
+- (void)decodeMessages:(NSArray<OTRKitIncomingMessage *> *)messages
+		  conversation:(OTRKitConversation *)conversation;
+
+- (void)initiateEncryptionInConversation:(OTRKitConversation *)conversation;
+
+- (void)disableEncryptionInConversation:(OTRKitConversation *)conversation;
+
+- (OTRKitMessageState)messageStateForConversation:(OTRKitConversation *)conversation;
+
+- (OTRKitOfferState)offerStateForConversation:(OTRKitConversation *)conversation;
+
+- (void)initiateSMPInConversation:(OTRKitConversation *)conversation
+						   secret:(NSString *)secret;
+
+- (void)initiateSMPInConversation:(OTRKitConversation *)conversation
+						 question:(NSString *)question
+						   secret:(NSString *)secret;
+
+- (void)respondToSMPInConversation:(OTRKitConversation *)conversation
+							secret:(NSString *)secret;
+
+- (void)abortSMPInConversation:(OTRKitConversation *)conversation;
+
+- (nullable NSString *)activeFingerprintForConversation:(OTRKitConversation *)conversation;
+
+- (BOOL)activeFingerprintIsVerifiedForConversation:(OTRKitConversation *)conversation;
+
+- (void)setActiveFingerprintVerificationForConversation:(OTRKitConversation *)conversation
+											   verified:(BOOL)verified;
+
 /**
  *  Test if a string starts with "?OTR".
  *
@@ -36,70 +36,83 @@
 
 #import "OTRKitPrivate.h"
 
-static NSString * const kOTRKitPrivateKeyFileName		= @"OTR-PrivateKey";
-static NSString * const kOTRKitFingerprintsFileName		= @"OTR-Fingerprints";
-static NSString * const kOTRKitInstanceTagsFileName		= @"OTR-InstanceTags";
+static NSString * const kOTRKitShardsDirectoryName		= @"Shards";
 
 static NSString * const kOTRKitErrorDomain				= @"org.chatsecure.OTRKit";
 
 NSString * const OTRKitListOfFingerprintsDidChangeNotification	= @"OTRKitListOfFingerprintsDidChangeNotification";
 NSString * const OTRKitMessageStateDidChangeNotification		= @"OTRKitMessageStateDidChangeNotification";
+NSString * const OTRKitKeyGenerationJobDidChangeNotification	= @"OTRKitKeyGenerationJobDidChangeNotification";
+
+NSString * const OTRKitKeyGenerationJobKey						= @"OTRKitKeyGenerationJobKey";
+
+/* A private key between the start and the finish of its generation */
+@interface OTRKitPendingPrivateKey : NSObject
+@property (nonatomic, strong) OTRKitEngine *engine;
+@property (nonatomic, strong) OTRKitAccount *account;
+@property (nonatomic, assign) void *otrKey;
+@property (nonatomic, strong) NSError *error;
+@property (nonatomic, assign) uint64_t enqueueTime;
+@end
+
+@implementation OTRKitPendingPrivateKey
+@end
 
 @implementation OTRKit
 
 #pragma mark -
 #pragma mark libotr ui_ops callback functions
 
-static OtrlPolicy policy_cb(void *opdata, ConnContext *context)
+static OtrlMessageAppOps ui_ops;
+
+/* OTRKit always passes an instance of OTRKitOpData as the opdata of a libotr
+ call. The engine it references is the one whose user state is in use. */
+static OTRKitEngine *engine_for_opdata(void *opdata)
 {
-	OTRKit *otrKit = [OTRKit sharedInstance];
+	OTRKitOpData *opData = (__bridge OTRKitOpData *)(opdata);
 
-	return [otrKit _otrlPolicy];
+	return [opData engine];
 }
 
-static void create_privkey_cb(void *opdata, const char *accountname, const char *protocol)
+static id tag_for_opdata(void *opdata)
 {
-	OTRKit *otrKit = [OTRKit sharedInstance];
-
-	/* Inform delegate of intent to create key */
-	NSString *accountNameString = @(accountname);
-	NSString *protocolString = @(protocol);
-
-	[otrKit _performAsyncOperationOnDelegateQueue:^{
-		[[otrKit delegate] otrKit:otrKit willStartGeneratingPrivateKeyForAccountName:accountNameString protocol:protocolString];
-	}];
-
-	/* Create key then inform delegate */
-	void *otrKey;
+	OTRKitOpData *opData = (__bridge OTRKitOpData *)(opdata);
 
-	gcry_error_t generateError = otrl_privkey_generate_start([otrKit userState], accountname, protocol, &otrKey);
-
-	NSString *path = [otrKit privateKeyPath];
+	return [opData tag];
+}
 
-	FILE *filePointer = fopen([path UTF8String], "w+b");
+static OtrlPolicy policy_cb(void *opdata, ConnContext *context)
+{
+	OTRKit *otrKit = [engine_for_opdata(opdata) otrKit];
 
-	if (generateError == gcry_error(GPG_ERR_NO_ERROR)) {
-		otrl_privkey_generate_calculate(otrKey);
+	return [otrKit _otrlPolicy];
+}
 
-		otrl_privkey_generate_finish_FILEp([otrKit userState], otrKey, filePointer);
+static void create_privkey_cb(void *opdata, const char *accountname, const char *protocol)
+{
+	OTRKitOpData *opData = (__bridge OTRKitOpData *)(opdata);
 
-		[otrKit _performAsyncOperationOnDelegateQueue:^{
-			[[otrKit delegate] otrKit:otrKit didFinishGeneratingPrivateKeyForAccountName:accountNameString protocol:protocolString error:nil];
-		}];
-	} else {
-		NSError *error = [otrKit _errorForGPGError:generateError];
+	OTRKitEngine *engine = [opData engine];
 
-		[otrKit _performAsyncOperationOnDelegateQueue:^{
-			[[otrKit delegate] otrKit:otrKit didFinishGeneratingPrivateKeyForAccountName:accountNameString protocol:protocolString error:error];
-		}];
-	}
+	/* Generating a key takes seconds. It is done in the background
+	 and libotr carries on without one for now. The caller makes the
+	 call again once the key exists. */
+	[[engine otrKit] _generatePrivateKeyForAccountName:@(accountname) protocol:@(protocol) engine:engine];
 
-	fclose(filePointer);
+	[opData setPrivateKeyRequested:YES];
 }
 
 static int is_logged_in_cb(void *opdata, const char *accountname, const char *protocol, const char *recipient)
 {
-	OTRKit *otrKit = [OTRKit sharedInstance];
+	OTRKit *otrKit = [engine_for_opdata(opdata) otrKit];
+
+	/* Once the application has pushed the presence of any user to OTRKit,
+	 it is assumed it will continue doing so and the delegate is not asked. */
+	OTRKitPresenceCache *presenceCache = [otrKit presenceCache];
+
+	if ([presenceCache isPushed]) {
+		return [presenceCache loggedInStateForUsername:recipient accountName:accountname protocol:protocol];
+	}
 
 	if ([otrKit delegate] == nil) {
 		return (-1);
@@ -123,9 +136,43 @@ static int is_logged_in_cb(void *opdata, const char *accountname, const char *pr
 
 static void inject_message_cb(void *opdata, const char *accountname, const char *protocol, const char *recipient, const char *message)
 {
-	OTRKit *otrKit = [OTRKit sharedInstance];
+	OTRKitOpData *opData = (__bridge OTRKitOpData *)(opdata);
+
+	OTRKit *otrKit = [engine_for_opdata(opdata) otrKit];
+
+	OTRKitConversation *conversation = [opData conversation];
+
+	if ([otrKit tracer]) {
+		OTRKitMessageType messageType = OTRKitMessageTypeForUTF8String(message);
+
+		if (messageType >= OTRKitMessageTypeDHCommit && messageType <= OTRKitMessageTypeV1KeyExchange) {
+			[otrKit _traceKeyExchangeInProgress:YES username:recipient accountName:accountname protocol:protocol opData:opData];
+		}
+	}
+
+	OTRKitTrafficRecorder *trafficRecorder = [otrKit trafficRecorder];
+
+	if (trafficRecorder) {
+		[trafficRecorder recordType:OTRKitTrafficRecordTypeInject
+					   conversation:conversation
+						messageType:OTRKitMessageTypeForUTF8String(message)
+							 length:strlen(message)
+						   tlvCount:0];
+	}
+
+	[otrKit _traceBeginStage:OTRKitTraceStageMessageInjection conversation:conversation];
+
+	if ([opData injectedMessages]) {
+		[[opData injectedMessages] addObject:@(message)];
+
+		[otrKit _traceEndStage:OTRKitTraceStageMessageInjection conversation:conversation];
+
+		return;
+	}
 
 	if ([otrKit delegate] == nil) {
+		[otrKit _traceEndStage:OTRKitTraceStageMessageInjection conversation:conversation];
+
 		return;
 	}
 
@@ -136,11 +183,13 @@ static void inject_message_cb(void *opdata, const char *accountname, const char
 
 	NSString *protocolString = @(protocol);
 
-	id tag = (__bridge id)(opdata);
+	id tag = tag_for_opdata(opdata);
 
 	[otrKit _performAsyncOperationOnDelegateQueue:^{
 		[[otrKit delegate] otrKit:otrKit injectMessage:messageString username:usernameString accountName:accountNameString protocol:protocolString tag:tag];
-	}];
+	} tracingConversation:conversation];
+
+	[otrKit _traceEndStage:OTRKitTraceStageMessageInjection conversation:conversation];
 }
 
 static void update_context_list_cb(void *opdata)
@@ -149,7 +198,26 @@ static void update_context_list_cb(void *opdata)
 
 static void confirm_fingerprint_cb(void *opdata, OtrlUserState us, const char *accountname, const char *protocol, const char *username, unsigned char fingerprint[20])
 {
-	OTRKit *otrKit = [OTRKit sharedInstance];
+	OTRKitEngine *engine = engine_for_opdata(opdata);
+
+	OTRKit *otrKit = [engine otrKit];
+
+	/* libotr added the fingerprint before telling of it */
+	OTRKitMetricsFingerprintCountDidChange([engine metricsCounters], 1);
+
+	/* A fingerprint is new to libotr when the peer it belongs to was not
+	 loaded yet. Loading the peer restores the trust of the fingerprint. */
+	OTRKitFingerprintIndex *fingerprintIndex = [engine fingerprintIndex];
+
+	if (fingerprintIndex) {
+		BOOL fingerprintIsKnown = [fingerprintIndex containsUnloadedFingerprint:fingerprint username:username accountName:accountname protocol:protocol];
+
+		[engine loadFingerprintsForUsername:username accountName:accountname protocol:protocol];
+
+		if (fingerprintIsKnown) {
+			return;
+		}
+	}
 
 	NSString *accountNameString = @(accountname);
 	NSString *usernameString = @(username);
@@ -172,14 +240,18 @@ static void confirm_fingerprint_cb(void *opdata, OtrlUserState us, const char *a
 
 static void write_fingerprints_cb(void *opdata)
 {
-	OTRKit *otrKit = [OTRKit sharedInstance];
+	OTRKitOpData *opData = (__bridge OTRKitOpData *)(opdata);
+
+	OTRKitEngine *engine = [opData engine];
 
-	[otrKit _writeFingerprintsPath];
+	[[engine otrKit] _writeFingerprintsPathForEngine:engine conversation:[opData conversation]];
 }
 
 static void gone_secure_cb(void *opdata, ConnContext *context)
 {
-	OTRKit *otrKit = [OTRKit sharedInstance];
+	OTRKit *otrKit = [engine_for_opdata(opdata) otrKit];
+
+	[otrKit _traceKeyExchangeInProgress:NO username:context->username accountName:context->accountname protocol:context->protocol opData:(__bridge OTRKitOpData *)(opdata)];
 
 	[otrKit _updateEncryptionStatusWithContext:context];
 }
@@ -189,35 +261,25 @@ static void gone_secure_cb(void *opdata, ConnContext *context)
  */
 static void gone_insecure_cb(void *opdata, ConnContext *context)
 {
-	OTRKit *otrKit = [OTRKit sharedInstance];
+	OTRKit *otrKit = [engine_for_opdata(opdata) otrKit];
 
 	[otrKit _updateEncryptionStatusWithContext:context];
 }
 
 static void still_secure_cb(void *opdata, ConnContext *context, int is_reply)
 {
-	OTRKit *otrKit = [OTRKit sharedInstance];
+	OTRKit *otrKit = [engine_for_opdata(opdata) otrKit];
+
+	[otrKit _traceKeyExchangeInProgress:NO username:context->username accountName:context->accountname protocol:context->protocol opData:(__bridge OTRKitOpData *)(opdata)];
 
 	[otrKit _updateEncryptionStatusWithContext:context];
 }
 
 static int max_message_size_cb(void *opdata, ConnContext *context)
 {
-	NSString *protocolString = @(context->protocol);
-
-	if ([protocolString length] == 0) {
-		return 0;
-	}
-
-	OTRKit *otrKit = [OTRKit sharedInstance];
-
-	NSNumber *maxMessageSize = [otrKit protocolMaxSize][protocolString];
-
-	if (maxMessageSize) {
-		return [maxMessageSize intValue];
-	}
-
-	return 0;
+	/* libotr asks for each message it sends so the size is cached
+	 with the context rather than looked up by the protocol name. */
+	return [engine_for_opdata(opdata) maximumMessageSizeForContext:context];
 }
 
 static const char *otr_error_message_cb(void *opdata, ConnContext *context, OtrlErrorCode err_code)
@@ -269,7 +331,11 @@ static void otr_error_message_free_cb(void *opdata, const char *err_msg)
 
 static void handle_smp_event_cb(void *opdata, OtrlSMPEvent smp_event, ConnContext *context, unsigned short progress_percent, char *question)
 {
-	OTRKit *otrKit = [OTRKit sharedInstance];
+	OTRKitEngine *engine = engine_for_opdata(opdata);
+
+	[(__bridge OTRKitOpData *)(opdata) setSmpEventHandled:YES];
+
+	OTRKit *otrKit = [engine otrKit];
 
 	OTRKitSMPEvent event = OTRKitSMPEventNone;
 
@@ -341,8 +407,18 @@ static void handle_smp_event_cb(void *opdata, OtrlSMPEvent smp_event, ConnContex
 		}
 	}
 
+	if ([otrKit tracer]) {
+		BOOL smpInProgress = (event == OTRKitSMPEventAskForSecret ||
+							  event == OTRKitSMPEventAskForAnswer ||
+							  event == OTRKitSMPEventInProgress);
+
+		if (event != OTRKitSMPEventNone) {
+			[otrKit _traceSMPInProgress:smpInProgress context:context opData:(__bridge OTRKitOpData *)(opdata)];
+		}
+	}
+
 	if (abortSMP) {
-		otrl_message_abort_smp([otrKit userState], &ui_ops, opdata, context);
+		otrl_message_abort_smp([engine userState], &ui_ops, opdata, context);
 	}
 
 	NSString *questionString = nil;
@@ -367,7 +443,7 @@ static void handle_msg_event_cb(void *opdata, OtrlMessageEvent msg_event, ConnCo
 		return;
 	}
 
-	OTRKit *otrKit = [OTRKit sharedInstance];
+	OTRKit *otrKit = [engine_for_opdata(opdata) otrKit];
 
 	NSString *messageString = nil;
 
@@ -483,7 +559,7 @@ static void handle_msg_event_cb(void *opdata, OtrlMessageEvent msg_event, ConnCo
 
 	NSString *protocolString = @(context->protocol);
 
-	id tag = (__bridge id)(opdata);
+	id tag = tag_for_opdata(opdata);
 
 	[otrKit _performAsyncOperationOnDelegateQueue:^{
 		[[otrKit delegate] otrKit:otrKit handleMessageEvent:event message:messageString username:usernameString accountName:accountNameString protocol:protocolString tag:tag error:error];
@@ -492,39 +568,33 @@ static void handle_msg_event_cb(void *opdata, OtrlMessageEvent msg_event, ConnCo
 
 static void create_instag_cb(void *opdata, const char *accountname, const char *protocol)
 {
-	OTRKit *otrKit = [OTRKit sharedInstance];
+	OTRKitEngine *engine = engine_for_opdata(opdata);
 
-	NSString *path = [otrKit instanceTagsPath];
+	OTRKit *otrKit = [engine otrKit];
 
-	FILE *filePointer = fopen([path UTF8String], "w+b");
+	FILE *filePointer = [otrKit _openInstanceTagsForWritingForEngine:engine];
 
-	otrl_instag_generate_FILEp([otrKit userState], filePointer, accountname, protocol);
+	otrl_instag_generate_FILEp([engine userState], filePointer, accountname, protocol);
 
 	fclose(filePointer);
+
+	[otrKit _writeInstanceTagToStorageForAccountName:accountname protocol:protocol engine:engine];
 }
 
 static void timer_control_cb(void *opdata, unsigned int interval)
 {
-	OTRKit *otrKit = [OTRKit sharedInstance];
-
-	[otrKit _performAsyncOperationOnInternalQueue:^{
-		if ( [otrKit pollTimer]) {
-			[[otrKit pollTimer] invalidate];
-
-			[otrKit setPollTimer:nil];
-		}
+	OTRKitEngine *engine = engine_for_opdata(opdata);
 
-		if (interval > 0) {
-			NSTimer *pollTimer = [NSTimer scheduledTimerWithTimeInterval:interval target:otrKit selector:@selector(messagePoll:) userInfo:nil repeats:YES];
-
-			[otrKit setPollTimer:pollTimer];
-		}
+	/* libotr asks for a new interval from within the calls it makes on the
+	 internal queue, so this runs inline instead of being queued. */
+	[engine performAsyncOperation:^{
+		[engine setPollInterval:interval];
 	}];
 }
 
 static void received_symkey_cb(void *opdata, ConnContext *context, unsigned int use, const unsigned char *usedata, size_t usedatalen, const unsigned char *symkey)
 {
-	OTRKit *otrKit = [OTRKit sharedInstance];
+	OTRKit *otrKit = [engine_for_opdata(opdata) otrKit];
 
 	NSData *symmetricKey = [[NSData alloc] initWithBytes:symkey length:OTRL_EXTRAKEY_BYTES];
 
@@ -585,46 +655,61 @@ static OtrlMessageAppOps ui_ops = {
 
 - (void)dealloc
 {
-	if ( self.pollTimer) {
-		[self.pollTimer invalidate];
-		 self.pollTimer = nil;
-	}
-
-	otrl_userstate_free(self.userState);
+	OTRKitMetricsCountersFree(self.metricsCounters);
 
-	self.userState = NULL;
+	self.metricsCounters = NULL;
 }
 
 - (instancetype)init
 {
 	if ((self = [super init])) {
-		self.internalQueue = dispatch_queue_create("OTRKit Internal Queue", DISPATCH_QUEUE_SERIAL);
+		self.accountNameSeparator = @"@";
 
-		IsOnInternalQueueKey = &IsOnInternalQueueKey;
-		dispatch_queue_set_specific(self.internalQueue, IsOnInternalQueueKey, (void *)1, NULL);
+		self.fingerprintsWriteCoalescingInterval = 0.5;
 
-		[self _performAsyncOperationOnInternalQueue:^{
-			OTRL_INIT;
+		NSDictionary *protocolDefaults = @{@"prpl-msn":   @(1409),
+										   @"prpl-icq":   @(2346),
+										   @"prpl-aim":   @(2343),
+										   @"prpl-yahoo": @(832),
+										   @"prpl-gg":    @(1999),
+										   @"prpl-irc":   @(400),
+										   @"prpl-oscar": @(2343)};
 
-			self.accountNameSeparator = @"@";
+		self.protocolMaxSize = protocolDefaults;
 
-			NSDictionary *protocolDefaults = @{@"prpl-msn":   @(1409),
-											   @"prpl-icq":   @(2346),
-											   @"prpl-aim":   @(2343),
-											   @"prpl-yahoo": @(832),
-											   @"prpl-gg":    @(1999),
-											   @"prpl-irc":   @(400),
-											   @"prpl-oscar": @(2343)};
+		/* Contexts start out with a cached size of generation zero
+		 which is never current so that it is looked up the first time. */
+		self.protocolMaxSizeGeneration = 1;
 
-			self.protocolMaxSize = protocolDefaults;
+		self.shardEngines = [NSMutableDictionary dictionary];
 
-			self.userState = otrl_userstate_create();
-		}];
+		self.presenceCache = [OTRKitPresenceCache new];
+
+		self.conversations = [OTRKitConversationTable new];
+
+		self.keyGenerationJobTable = [NSMutableDictionary dictionary];
+
+		self.metricsCounters = OTRKitMetricsCountersCreate();
+
+		self.defaultEngine = [[OTRKitEngine alloc] initWithOTRKit:self accountName:nil protocol:nil];
+
+		[OTRKit _initializeLibotr];
 	}
 
 	return self;
 }
 
++ (void)_initializeLibotr
+{
+	/* libotr keeps global state of its own (e.g. libgcrypt) which must
+	 only be initialized once no matter how many instances of OTRKit exist. */
+	static dispatch_once_t onceToken;
+
+	dispatch_once(&onceToken, ^{
+		OTRL_INIT;
+	});
+}
+
 - (void)setupWithDataPath:(NSString *)dataPath
 {
 	if (dataPath == nil || [dataPath length] == 0) {
@@ -648,319 +733,1752 @@ static OtrlMessageAppOps ui_ops = {
 		NSAssert1(createDirectoryResult, @"Tried to create data path but failed doing so: '%@'", [createDirectoryError localizedDescription]);
 	}
 
-	[self _readLibotrConfiguration];
-}
-
-- (void)_readLibotrConfiguration
-{
-	[self _performAsyncOperationOnInternalQueue:^{
-		[self _readPrivateKeyPath];
-
-		[self _readFingerprintsPath];
+	[self.defaultEngine setDataPath:self.dataPath];
 
-		[self _readInstanceTagsPath];
-	}];
+	if (self.shardingEnabled) {
+		[self _setupShardEngines];
+	} else {
+		[self _readLibotrConfigurationForEngine:self.defaultEngine];
+	}
 }
 
-- (void)setMaximumProtocolSize:(int)maxSize forProtocol:(NSString *)protocol
+- (void)_readLibotrConfigurationForEngine:(OTRKitEngine *)engine
 {
-	AssertParamaterLength(protocol)
-
-	[self _performAsyncOperationOnInternalQueue:^{
-		NSMutableDictionary *protocolMaxSizeMutable = [self.protocolMaxSize mutableCopy];
+	[engine performAsyncOperation:^{
+		if (self.storage) {
+			[self _readStorageForEngine:engine];
 
-		protocolMaxSizeMutable[protocol] = @(maxSize);
-
-		self.protocolMaxSize = protocolMaxSizeMutable;
-	}];
-}
-
-- (void)messagePoll:(NSTimer *)timer
-{
-	[self _performAsyncOperationOnInternalQueue:^{
-		if (self.userState) {
-			otrl_message_poll(self.userState, &ui_ops, NULL);
-		} else {
-			[timer invalidate];
+			return;
 		}
-	}];
-}
-
-#pragma mark Initialization
-
-- (void)decodeMessage:(NSString *)message username:(NSString *)username accountName:(NSString *)accountName protocol:(NSString *)protocol tag:(id)tag
-{
-	AssertParamaterLength(message)
-	AssertParamaterLength(username)
-	AssertParamaterLength(accountName)
-	AssertParamaterLength(protocol)
 
-	OTRKitMessageType otrMessageType = [self typeOfMessage:message];
-
-	__block BOOL ignoreMessageSaysDelegate = NO;
+		if ([engine isShard] && [[NSFileManager defaultManager] fileExistsAtPath:[engine dataPath]] == NO) {
+			[self _migrateLibotrConfigurationToShardEngine:engine];
 
-	[self _performSyncOperationOnDelegateQueue:^{
-		if ([self.delegate respondsToSelector:@selector(otrKit:ignoreMessage:messageType:username:accountName:protocol:)] == NO) {
 			return;
 		}
 
-		ignoreMessageSaysDelegate =
-		[self.delegate otrKit:self
-				ignoreMessage:message
-				  messageType:otrMessageType
-					 username:username
-				  accountName:accountName
-					 protocol:protocol];
-	}];
+		OTRKitLoadStatistics *loadStatistics = [OTRKitLoadStatistics new];
 
-	if (ignoreMessageSaysDelegate) {
-		return;
-	}
+		CFAbsoluteTime loadStart = CFAbsoluteTimeGetCurrent();
 
-	[self _performAsyncOperationOnInternalQueue:^{
-		char *otrDecodedMessage = NULL;
+		BOOL snapshotRead = [OTRKitSnapshot readSnapshotOfEngine:engine loadingFingerprints:(self.lazyFingerprintLoading == NO)];
 
-		ConnContext *otrContext = [self _contextForUsername:username accountName:accountName protocol:protocol];
+		loadStatistics.snapshotReadDuration = (CFAbsoluteTimeGetCurrent() - loadStart);
 
-		OtrlTLV *otr_tlvs = NULL;
+		if (snapshotRead) {
+			loadStatistics.snapshotLoadCount = 1;
+		} else {
+			loadStatistics.fileLoadCount = 1;
 
-		int ignoreMessage = otrl_message_receiving(self.userState,
-												   &ui_ops,
-												   (__bridge void *)tag,
-												   [accountName UTF8String],
-												   [protocol UTF8String],
-												   [username UTF8String],
-												   [message UTF8String],
-												   &otrDecodedMessage,
-												   &otr_tlvs,
-												   &otrContext,
-												   NULL,
-												   NULL);
+			[self _readLibotrConfigurationFilesForEngine:engine statistics:loadStatistics];
 
-		NSString *decodedMessage = nil;
+			CFAbsoluteTime snapshotCreateStart = CFAbsoluteTimeGetCurrent();
 
-		NSArray *tlvs = nil;
+			[self _writeSnapshotForEngine:engine];
 
-		if (otr_tlvs) {
-			tlvs = [self _tlvArrayForTLVChain:otr_tlvs];
+			loadStatistics.snapshotCreateDuration = (CFAbsoluteTimeGetCurrent() - snapshotCreateStart);
 		}
 
-		if (otrContext) {
-			if (otrContext->msgstate == OTRL_MSGSTATE_FINISHED) {
-				[self disableEncryptionWithUsername:username accountName:accountName protocol:protocol];
-			}
-		}
+		/* The journal is not part of the snapshot so it is replayed either way */
+		CFAbsoluteTime journalReplayStart = CFAbsoluteTimeGetCurrent();
 
-		BOOL wasEncrypted = (otrMessageType != OTRKitMessageTypeNotOTR);
+		[self _replayFingerprintsJournalForPath:[engine fingerprintsPath] forEngine:engine];
 
-		if (ignoreMessage == 0)
-		{
-			if (otrDecodedMessage) {
-				decodedMessage = @(otrDecodedMessage);
-			} else {
-				decodedMessage = message; // Nothing changed...
-			}
+		loadStatistics.journalReplayDuration = (CFAbsoluteTimeGetCurrent() - journalReplayStart);
 
-			[self _performAsyncOperationOnDelegateQueue:^{
-				[self.delegate otrKit:self
-					   decodedMessage:decodedMessage
-						 wasEncrypted:wasEncrypted
-								 tlvs:tlvs
-							 username:username
-						  accountName:accountName
-							 protocol:protocol
-								  tag:tag];
-			}];
-		}
-		else if (tlvs)
-		{
-			[self _performAsyncOperationOnDelegateQueue:^{
-				[self.delegate otrKit:self
-					   decodedMessage:nil
-						 wasEncrypted:wasEncrypted
-								 tlvs:tlvs
-							 username:username
-						  accountName:accountName
-							 protocol:protocol
-								  tag:tag];
-			}];
-		}
+		loadStatistics.totalDuration = (CFAbsoluteTimeGetCurrent() - loadStart);
 
-		if (otrDecodedMessage) {
-			otrl_message_free(otrDecodedMessage);
-		}
+		[engine setLoadStatistics:loadStatistics];
 
-		if (otr_tlvs) {
-			otrl_tlv_free(otr_tlvs);
-		}
+		[engine recountFingerprints];
 	}];
 }
 
-- (void)encodeMessage:(NSString *)message
-				 tlvs:(NSArray *)tlvs
-			 username:(NSString *)username
-		  accountName:(NSString *)accountName
-			 protocol:(NSString *)protocol
-				  tag:(id)tag
+- (void)_readStorageForEngine:(OTRKitEngine *)engine
 {
-//	AssertParamaterLength(message)
-	AssertParamaterLength(username)
-	AssertParamaterLength(accountName)
-	AssertParamaterLength(protocol)
+	OTRKitLoadStatistics *loadStatistics = [OTRKitLoadStatistics new];
 
-	[self _performAsyncOperationOnInternalQueue:^{
-		ConnContext *otrContext = [self _contextForUsername:username accountName:accountName protocol:protocol];
+	loadStatistics.storageLoadCount = 1;
 
-		/*
-		 * If our policy is not oppritunistic (automatic) and we are not in an encrypted,
-		 * then return unecnrypted message to delegate. This exception is made because when
-		 * OTRL_POLICY_MANUAL is set, OTR discards outgoing * messages altogther.
-		 *
-		 * If our policy is ppritunistic (automatic) and our OTR request was rejected,
-		 * then we will return unecnrypted message to delegate. OTR will refuse to do further
-		 * work when the state is rejected.
-		 */
-		if (/* 1 */ (self.otrPolicy == OTRKitPolicyManual ||
-					 self.otrPolicy == OTRKitPolicyNever) ||
-			/* 2 */ (self.otrPolicy == OTRKitPolicyOpportunistic &&
-					 [self _offerStateForContext:otrContext] == OTRKitOfferStateRejected))
-		{
-			OTRKitMessageState otrMessageState = [self _messageStateForContext:otrContext];
-
-			if (otrMessageState == OTRKitMessageStatePlaintext) {
-				[self _performAsyncOperationOnDelegateQueue:^{
-					[self.delegate otrKit:self
-						   encodedMessage:message
-							 wasEncrypted:NO
-								 username:username
-							  accountName:accountName
-								 protocol:protocol
-									  tag:tag
-									error:nil];
-
-					[self.delegate otrKit:self
-							injectMessage:message
-								 username:username
-							  accountName:accountName
-								 protocol:protocol
-									  tag:tag];
-				}];
-
-				return;
-			}
-		}
+	CFAbsoluteTime loadStart = CFAbsoluteTimeGetCurrent();
 
-		[self _encodeMessage:message
-				   inContext:otrContext
-						tlvs:tlvs
-					username:username
-				 accountName:accountName
-					protocol:protocol
-						 tag:tag];
-	}];
+	/* Both are nil for the default engine which reads every account */
+	OTRKitStorageReadIntoUserState(self.storage, [engine userState], [engine accountName], [engine protocol], loadStatistics);
+
+	loadStatistics.totalDuration = (CFAbsoluteTimeGetCurrent() - loadStart);
+
+	[engine setLoadStatistics:loadStatistics];
+
+	[engine recountFingerprints];
 }
 
-- (void)_encodeMessage:(NSString *)message
-			 inContext:(ConnContext *)otrContext
-				  tlvs:(NSArray *)tlvs
-			  username:(NSString *)username
-		   accountName:(NSString *)accountName
-			  protocol:(NSString *)protocol
-				   tag:(id)tag
+- (void)_readLibotrConfigurationFilesForEngine:(OTRKitEngine *)engine statistics:(OTRKitLoadStatistics *)loadStatistics
 {
-	AssertParamaterLength(username)
-	AssertParamaterLength(accountName)
-	AssertParamaterLength(protocol)
+	/* The files are read one after the other on the internal queue. They
+	 cannot be read at the same time: reading fingerprints looks up contexts
+	 which reads the instance tags of the user state. Instance tags are read
+	 before fingerprints for the same reason. */
+	CFAbsoluteTime readStart = CFAbsoluteTimeGetCurrent();
 
-	gcry_error_t otrError;
-
-	char *otrEncodedMessage = NULL;
+	[self _readPrivateKeyPath:[engine privateKeyPath] forEngine:engine];
 
-	// Set nil messages to empty string if TLVs are present, otherwise libotr
-	// will silence the message, even though you may have meant to inject a TLV.
-	NSString *messageToEncode = message;
+	loadStatistics.privateKeysReadDuration = (CFAbsoluteTimeGetCurrent() - readStart);
 
-	if (message == nil && [tlvs count] > 0) {
-		messageToEncode = @"";
-	}
+	readStart = CFAbsoluteTimeGetCurrent();
 
-	OtrlTLV *otr_tlvs = [self _tlvChainForTLVs:tlvs];
+	[self _readInstanceTagsPath:[engine instanceTagsPath] forEngine:engine];
 
-	otrError = otrl_message_sending(self.userState,
-									 &ui_ops,
-									 (__bridge void *)(tag),
-									 [accountName UTF8String],
-									 [protocol UTF8String],
-									 [username UTF8String],
-									 OTRL_INSTAG_BEST,
-									 [messageToEncode UTF8String],
-									 otr_tlvs,
-									 &otrEncodedMessage,
-									 OTRL_FRAGMENT_SEND_ALL,
-									 &otrContext,
-									 NULL,
-									 NULL);
+	loadStatistics.instanceTagsReadDuration = (CFAbsoluteTimeGetCurrent() - readStart);
 
-	if (otr_tlvs) {
-		otrl_tlv_free(otr_tlvs);
-	}
+	readStart = CFAbsoluteTimeGetCurrent();
 
-	BOOL wasEncrypted = NO;
+	[self _readFingerprintsPath:[engine fingerprintsPath] forEngine:engine];
 
-	NSString *encodedMessage = nil;
+	loadStatistics.fingerprintsReadDuration = (CFAbsoluteTimeGetCurrent() - readStart);
+}
 
-	if (otrEncodedMessage) {
-		encodedMessage = @(otrEncodedMessage);
+- (void)_writeSnapshotForEngine:(OTRKitEngine *)engine
+{
+	NSString *snapshotPath = [engine snapshotPath];
 
-		otrl_message_free(otrEncodedMessage);
+	NSData *snapshot = [OTRKitSnapshot snapshotOfEngine:engine];
 
-		wasEncrypted = ([self typeOfMessage:encodedMessage] != OTRKitMessageTypeNotOTR);
+	if (snapshotPath == nil || snapshot == nil) {
+		return;
 	}
 
-	NSError *errorString = nil;
+	dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_BACKGROUND, 0), ^{
+		[snapshot writeToFile:snapshotPath options:NSDataWritingAtomic error:NULL];
+	});
+}
 
-	if (otrError != 0) {
-		errorString = [self _errorForGPGError:otrError];
+- (OTRKitLoadStatistics *)loadStatistics
+{
+	OTRKitLoadStatistics *statistics = [OTRKitLoadStatistics new];
 
-		encodedMessage = nil;
+	for (OTRKitEngine *engine in [self _allEngines]) {
+		OTRKitLoadStatistics *engineStatistics = [engine loadStatistics];
+
+		if (engineStatistics) {
+			[statistics addStatistics:engineStatistics];
+		}
 	}
 
-	[self _performAsyncOperationOnDelegateQueue:^{
-		[self.delegate otrKit:self
-			   encodedMessage:encodedMessage
-				 wasEncrypted:wasEncrypted
-					 username:username
-				  accountName:accountName
-					 protocol:protocol
-						  tag:tag
-						error:errorString];
-	}];
+	return statistics;
 }
 
-- (void)initiateEncryptionWithUsername:(NSString *)username
-						   accountName:(NSString *)accountName
-							  protocol:(NSString *)protocol
+- (void)waitUntilLoaded
 {
-	ConnContext *otrContext = [self _contextForUsername:username accountName:accountName protocol:protocol];
+	/* Reading the configuration is the first operation of each engine so
+	 an empty operation returns once it is read. The default engine goes
+	 first because migrating to shards creates the engines of the shards. */
+	[self.defaultEngine performSyncOperation:^{
+	}];
 
-	[self _encodeMessage:@"?OTR?" inContext:otrContext tlvs:nil username:username accountName:accountName protocol:protocol tag:nil];
+	for (OTRKitEngine *engine in [self _allEngines]) {
+		[engine performSyncOperation:^{
+		}];
+	}
 }
 
-- (void)disableEncryptionWithUsername:(NSString *)username
-						  accountName:(NSString *)accountName
-							 protocol:(NSString *)protocol
+- (void)setMaximumProtocolSize:(int)maxSize forProtocol:(NSString *)protocol
 {
-	AssertParamaterLength(username)
-	AssertParamaterLength(accountName)
 	AssertParamaterLength(protocol)
 
-	[self _performAsyncOperationOnInternalQueue:^{
-		otrl_message_disconnect_all_instances(self.userState, &ui_ops, NULL, [accountName UTF8String], [protocol UTF8String], [username UTF8String]);
+	@synchronized (self) {
+		NSMutableDictionary *protocolMaxSizeMutable = [self.protocolMaxSize mutableCopy];
 
-		ConnContext *otrContext = [self _contextForUsername:username accountName:accountName protocol:protocol];
+		protocolMaxSizeMutable[protocol] = @(maxSize);
 
-		if (otrContext) {
-			[self _updateEncryptionStatusWithContext:otrContext];
+		self.protocolMaxSize = protocolMaxSizeMutable;
+
+		/* The sizes cached with contexts are looked up again */
+		self.protocolMaxSizeGeneration += 1;
+	}
+}
+
+- (int)_maximumProtocolSizeForProtocol:(const char *)protocol
+{
+	if (protocol == NULL || protocol[0] == '\0') {
+		return 0;
+	}
+
+	NSNumber *maxMessageSize = self.protocolMaxSize[@(protocol)];
+
+	if (maxMessageSize) {
+		return [maxMessageSize intValue];
+	}
+
+	return 0;
+}
+
+- (NSTimeInterval)pollInterval
+{
+	__block unsigned int pollInterval = 0;
+
+	for (OTRKitEngine *engine in [self _allEngines]) {
+		[engine performSyncOperation:^{
+			unsigned int enginePollInterval = [engine pollInterval];
+
+			if (enginePollInterval > 0 && (pollInterval == 0 || enginePollInterval < pollInterval)) {
+				pollInterval = enginePollInterval;
+			}
+		}];
+	}
+
+	return pollInterval;
+}
+
+- (void)messagePoll
+{
+	for (OTRKitEngine *engine in [self _allEngines]) {
+		[self _messagePollForEngine:engine];
+	}
+}
+
+- (void)_messagePollForEngine:(OTRKitEngine *)engine
+{
+	[engine performAsyncOperation:^{
+		if (engine.userState) {
+			OTRKitOpData *opData = [engine opDataWithTag:nil];
+
+			otrl_message_poll(engine.userState, &ui_ops, (__bridge void *)(opData));
+		} else {
+			[engine setPollInterval:0];
+		}
+	}];
+}
+
+#pragma mark -
+#pragma mark Eviction
+
+- (void)_evictConversationsForEngine:(OTRKitEngine *)engine
+{
+	NSParameterAssert([engine isOnInternalQueue]);
+
+	NSTimeInterval idleTimeout = self.conversationIdleTimeout;
+
+	NSUInteger maximumCount = self.maximumLiveConversationCount;
+
+	unsigned long long memoryBudget = self.conversationMemoryBudget;
+
+	OTRKitEvictionReason reason;
+
+	ConnContext *masterContext = NULL;
+
+	while ((masterContext = [engine nextMasterContextToEvictWithIdleTimeout:idleTimeout maximumCount:maximumCount memoryBudget:memoryBudget reason:&reason])) {
+		[self _evictMasterContext:masterContext reason:reason engine:engine];
+	}
+
+	[engine scheduleIdleEvictionWithTimeout:idleTimeout];
+}
+
+- (void)_evictMasterContext:(ConnContext *)masterContext reason:(OTRKitEvictionReason)reason engine:(OTRKitEngine *)engine
+{
+	NSString *username = @(masterContext->username);
+	NSString *accountName = @(masterContext->accountname);
+
+	NSString *protocol = @(masterContext->protocol);
+
+	BOOL wasEncrypted = NO;
+
+	for (ConnContext *context = masterContext; context && context->m_context == masterContext; context = context->next) {
+		if (context->msgstate == OTRL_MSGSTATE_ENCRYPTED) {
+			wasEncrypted = YES;
+		}
+	}
+
+	[engine willEvictMasterContext:masterContext reason:reason disconnect:wasEncrypted];
+
+	/* Disconnecting tells the remote user that the session ended and
+	 frees the key exchange and session keys of every instance. */
+	OTRKitOpData *opData = [engine opDataWithTag:nil];
+
+	otrl_message_disconnect_all_instances(engine.userState, &ui_ops, (__bridge void *)(opData), [accountName UTF8String], [protocol UTF8String], [username UTF8String]);
+
+	/* Fingerprints belong to the master context so it is kept as long
+	 as it has any. Instances have nothing worth keeping. */
+	ConnContext *context = masterContext->next;
+
+	while (context && context->m_context == masterContext) {
+		ConnContext *contextNext = context->next;
+
+		otrl_context_forget(context);
+
+		context = contextNext;
+	}
+
+	if (masterContext->fingerprint_root.next == NULL) {
+		otrl_context_forget(masterContext);
+	}
+
+	/* The conversation is let go of along with the state of its
+	 context so that the table does not grow without bound. */
+	[self.conversations removeConversationForUsername:username accountName:accountName protocol:protocol];
+
+	if (wasEncrypted) {
+		[self _updateEncryptionStatusWithUsername:username accountName:accountName protocol:protocol];
+	}
+}
+
+- (OTRKitEvictionStatistics *)conversationEvictionStatistics
+{
+	OTRKitEvictionStatistics *statistics = [OTRKitEvictionStatistics new];
+
+	for (OTRKitEngine *engine in [self _allEngines]) {
+		[statistics addStatistics:[engine evictionStatistics]];
+	}
+
+	return statistics;
+}
+
+#pragma mark -
+#pragma mark Metrics
+
+- (void)_recordMetricsOperation:(OTRKitMetricsOperation)operation libotrStart:(uint64_t)libotrStart engine:(OTRKitEngine *)engine
+{
+	uint64_t libotrTime = (OTRKitMetricsNow() - libotrStart);
+
+	OTRKitMetricsRecordOperation([engine metricsCounters], operation, libotrTime, [engine takeQueueWaitTime]);
+}
+
+- (OTRKitMetrics *)metrics
+{
+	OTRKitMetricsValues values;
+
+	memset(&values, 0, sizeof(OTRKitMetricsValues));
+
+	OTRKitMetricsCountersAddToValues(self.metricsCounters, &values);
+
+	/* The counters are read without waiting for the engines */
+	for (OTRKitEngine *engine in [self _allEngines]) {
+		OTRKitMetricsCountersAddToValues([engine metricsCounters], &values);
+	}
+
+	return [[OTRKitMetrics alloc] initWithValues:values];
+}
+
+#pragma mark -
+#pragma mark Tracing
+
+- (void)_traceBeginStage:(OTRKitTraceStage)stage conversation:(OTRKitConversation *)conversation
+{
+	id<OTRKitTracer> tracer = self.tracer;
+
+	if (tracer == nil) {
+		return;
+	}
+
+	[tracer beginStage:stage conversation:conversation timestamp:OTRKitMetricsNow()];
+}
+
+- (void)_traceEndStage:(OTRKitTraceStage)stage conversation:(OTRKitConversation *)conversation
+{
+	id<OTRKitTracer> tracer = self.tracer;
+
+	if (tracer == nil) {
+		return;
+	}
+
+	[tracer endStage:stage conversation:conversation timestamp:OTRKitMetricsNow()];
+}
+
+/* The key exchange and SMP stages begin and end in callbacks of libotr
+ that are only told of a context, so the conversation remembers whether
+ the stage began to report each beginning and end once. */
+- (void)_traceKeyExchangeInProgress:(BOOL)inProgress username:(const char *)username accountName:(const char *)accountName protocol:(const char *)protocol opData:(OTRKitOpData *)opData
+{
+	if (self.tracer == nil) {
+		return;
+	}
+
+	OTRKitConversation *conversation = [opData conversation];
+
+	if (conversation == nil) {
+		conversation = [self conversationForUsername:@(username) accountName:@(accountName) protocol:@(protocol)];
+	}
+
+	if ([conversation keyExchangeTraced] == inProgress) {
+		return;
+	}
+
+	[conversation setKeyExchangeTraced:inProgress];
+
+	if (inProgress) {
+		[self _traceBeginStage:OTRKitTraceStageKeyExchange conversation:conversation];
+	} else {
+		[self _traceEndStage:OTRKitTraceStageKeyExchange conversation:conversation];
+	}
+}
+
+- (void)_traceSMPInProgress:(BOOL)inProgress context:(ConnContext *)context opData:(OTRKitOpData *)opData
+{
+	if (self.tracer == nil) {
+		return;
+	}
+
+	OTRKitConversation *conversation = [opData conversation];
+
+	if (conversation == nil) {
+		conversation = [self conversationForUsername:@(context->username) accountName:@(context->accountname) protocol:@(context->protocol)];
+	}
+
+	if ([conversation smpTraced] == inProgress) {
+		return;
+	}
+
+	[conversation setSmpTraced:inProgress];
+
+	if (inProgress) {
+		[self _traceBeginStage:OTRKitTraceStageSMP conversation:conversation];
+	} else {
+		[self _traceEndStage:OTRKitTraceStageSMP conversation:conversation];
+	}
+}
+
+- (void)_performAsyncOperation:(dispatch_block_t)block onEngine:(OTRKitEngine *)engine tracingConversation:(OTRKitConversation *)conversation
+{
+	id<OTRKitTracer> tracer = self.tracer;
+
+	if (tracer == nil || [engine isOnInternalQueue]) {
+		[engine performAsyncOperation:block];
+
+		return;
+	}
+
+	[tracer beginStage:OTRKitTraceStageInternalQueueWait conversation:conversation timestamp:OTRKitMetricsNow()];
+
+	[engine performAsyncOperation:^{
+		[tracer endStage:OTRKitTraceStageInternalQueueWait conversation:conversation timestamp:OTRKitMetricsNow()];
+
+		block();
+	}];
+}
+
+- (void)_performAsyncOperationOnDelegateQueue:(dispatch_block_t)block tracingConversation:(OTRKitConversation *)conversation
+{
+	id<OTRKitTracer> tracer = self.tracer;
+
+	if (tracer == nil) {
+		[self _performAsyncOperationOnDelegateQueue:block];
+
+		return;
+	}
+
+	[tracer beginStage:OTRKitTraceStageDelegateDelivery conversation:conversation timestamp:OTRKitMetricsNow()];
+
+	[self _performAsyncOperationOnDelegateQueue:^{
+		block();
+
+		[tracer endStage:OTRKitTraceStageDelegateDelivery conversation:conversation timestamp:OTRKitMetricsNow()];
+	}];
+}
+
+#pragma mark -
+#pragma mark Traffic Recording
+
+- (void)_recordTrafficOfType:(OTRKitTrafficRecordType)recordType
+					 message:(NSString *)message
+				 messageType:(OTRKitMessageType)messageType
+					tlvCount:(NSUInteger)tlvCount
+				conversation:(OTRKitConversation *)conversation
+{
+	OTRKitTrafficRecorder *trafficRecorder = self.trafficRecorder;
+
+	if (trafficRecorder == nil) {
+		return;
+	}
+
+	[trafficRecorder recordType:recordType
+				   conversation:conversation
+					messageType:messageType
+						 length:[message lengthOfBytesUsingEncoding:NSUTF8StringEncoding]
+					   tlvCount:tlvCount];
+}
+
+#pragma mark -
+#pragma mark Conversations
+
+- (OTRKitConversation *)conversationForUsername:(NSString *)username accountName:(NSString *)accountName protocol:(NSString *)protocol
+{
+	return [self.conversations conversationForUsername:username accountName:accountName protocol:protocol];
+}
+
+- (OTRKitEngine *)_engineForConversation:(OTRKitConversation *)conversation
+{
+	OTRKitEngine *engine = [conversation engine];
+
+	if (engine == nil) {
+		engine = [self _engineForAccountName:[conversation accountName] protocol:[conversation protocol]];
+
+		[conversation setEngine:engine];
+	}
+
+	return engine;
+}
+
+#pragma mark -
+#pragma mark Presence
+
+- (void)setLoggedIn:(BOOL)loggedIn forUsername:(NSString *)username accountName:(NSString *)accountName protocol:(NSString *)protocol
+{
+	AssertParamaterLength(username)
+
+	[self setLoggedIn:loggedIn forUsernames:@[username] accountName:accountName protocol:protocol];
+}
+
+- (void)setLoggedIn:(BOOL)loggedIn forUsernames:(NSArray<NSString *> *)usernames accountName:(NSString *)accountName protocol:(NSString *)protocol
+{
+	[self.presenceCache setLoggedIn:loggedIn forUsernames:usernames accountName:accountName protocol:protocol];
+}
+
+- (void)removeLoggedInStateForUsername:(NSString *)username accountName:(NSString *)accountName protocol:(NSString *)protocol
+{
+	AssertParamaterLength(username)
+
+	[self.presenceCache removeUsernames:@[username] accountName:accountName protocol:protocol];
+}
+
+- (void)removeLoggedInStatesForAccountName:(NSString *)accountName protocol:(NSString *)protocol
+{
+	[self.presenceCache removeAllUsernamesForAccountName:accountName protocol:protocol];
+}
+
+- (void)removeAllLoggedInStates
+{
+	[self.presenceCache removeAllUsernames];
+}
+
+#pragma mark -
+#pragma mark Shard Engines
+
+- (NSString *)_shardsPath
+{
+	return [self.dataPath stringByAppendingPathComponent:kOTRKitShardsDirectoryName];
+}
+
+- (OTRKitEngine *)_engineForAccountName:(NSString *)accountName protocol:(NSString *)protocol
+{
+	if (self.shardingEnabled == NO) {
+		return self.defaultEngine;
+	}
+
+	NSString *shardKey = [OTRKitEngine shardKeyForAccountName:accountName protocol:protocol];
+
+	return [self _engineForShardKey:shardKey];
+}
+
+- (OTRKitEngine *)_engineForShardKey:(NSString *)shardKey
+{
+	@synchronized (self.shardEngines) {
+		OTRKitEngine *engine = self.shardEngines[shardKey];
+
+		if (engine) {
+			return engine;
+		}
+
+		NSString *accountName = nil;
+		NSString *protocol = nil;
+
+		[OTRKitEngine getAccountName:&accountName protocol:&protocol forShardKey:shardKey];
+
+		engine = [[OTRKitEngine alloc] initWithOTRKit:self accountName:accountName protocol:protocol];
+
+		NSString *directoryName = [OTRKitEngine directoryNameForShardKey:shardKey];
+
+		[engine setDataPath:[[self _shardsPath] stringByAppendingPathComponent:directoryName]];
+
+		self.shardEngines[shardKey] = engine;
+
+		/* The configuration is scheduled while the lock is still held so that
+		 reading it is guaranteed to be the first thing the engine does. */
+		[self _readLibotrConfigurationForEngine:engine];
+
+		return engine;
+	}
+}
+
+- (OTRKitEngine *)_engineForContext:(ConnContext *)context
+{
+	if (self.shardingEnabled == NO) {
+		return self.defaultEngine;
+	}
+
+	return [self _engineForAccountName:@(context->accountname) protocol:@(context->protocol)];
+}
+
+- (NSArray<OTRKitEngine *> *)_allEngines
+{
+	NSMutableArray *allEngines = [NSMutableArray array];
+
+	if (self.defaultEngine) {
+		[allEngines addObject:self.defaultEngine];
+	}
+
+	@synchronized (self.shardEngines) {
+		[allEngines addObjectsFromArray:[self.shardEngines allValues]];
+	}
+
+	return [allEngines copy];
+}
+
+- (void)_setupShardEngines
+{
+	if (self.storage) {
+		[self _setupShardEnginesFromStorage];
+
+		return;
+	}
+
+	NSString *shardsPath = [self _shardsPath];
+
+	NSFileManager *fileManager = [NSFileManager defaultManager];
+
+	if ([fileManager fileExistsAtPath:shardsPath] == NO) {
+		[self _migrateLibotrConfigurationToShardEngines];
+
+		return;
+	}
+
+	NSArray *directoryNames = [fileManager contentsOfDirectoryAtPath:shardsPath error:NULL];
+
+	for (NSString *directoryName in directoryNames) {
+		NSString *shardKey = [OTRKitEngine shardKeyForDirectoryName:directoryName];
+
+		if (shardKey) {
+			(void)[self _engineForShardKey:shardKey];
+		}
+	}
+}
+
+- (void)_setupShardEnginesFromStorage
+{
+	/* A storage is not divided into folders. Every account with a key
+	 or an instance tag has an engine. Accounts without either have no
+	 fingerprints either because none could have been exchanged yet. */
+	NSMutableSet *shardKeys = [NSMutableSet set];
+
+	for (OTRKitPrivateKeyRecord *privateKey in [self.storage privateKeysForAccountName:nil protocol:nil]) {
+		[self _addShardKeyForAccountName:[[privateKey accountName] UTF8String] protocol:[[privateKey protocol] UTF8String] toSet:shardKeys];
+	}
+
+	for (OTRKitInstanceTagRecord *instanceTag in [self.storage instanceTagsForAccountName:nil protocol:nil]) {
+		[self _addShardKeyForAccountName:[[instanceTag accountName] UTF8String] protocol:[[instanceTag protocol] UTF8String] toSet:shardKeys];
+	}
+
+	for (NSString *shardKey in shardKeys) {
+		(void)[self _engineForShardKey:shardKey];
+	}
+}
+
+- (void)_migrateLibotrConfigurationToShardEngines
+{
+	/* Sharding is being used for the first time. The existing configuration
+	 is read so that an engine can be created for each account it references.
+	 Each of those engines will then copy its own slice of the configuration. */
+	OTRKitEngine *defaultEngine = self.defaultEngine;
+
+	[defaultEngine performAsyncOperation:^{
+		[self _readPrivateKeyPath:[self privateKeyPath] forEngine:defaultEngine];
+
+		[self _readInstanceTagsPath:[self instanceTagsPath] forEngine:defaultEngine];
+
+		[self _readFingerprintsPath:[self fingerprintsPath] forEngine:defaultEngine];
+
+		[self _replayFingerprintsJournalForPath:[self fingerprintsPath] forEngine:defaultEngine];
+
+		OtrlUserState userState = [defaultEngine userState];
+
+		NSMutableSet *shardKeys = [NSMutableSet set];
+
+		for (OtrlPrivKey *privateKey = userState->privkey_root; privateKey; privateKey = privateKey->next) {
+			[self _addShardKeyForAccountName:privateKey->accountname protocol:privateKey->protocol toSet:shardKeys];
+		}
+
+		for (ConnContext *context = userState->context_root; context; context = context->next) {
+			[self _addShardKeyForAccountName:context->accountname protocol:context->protocol toSet:shardKeys];
+		}
+
+		for (OtrlInsTag *instanceTag = userState->instag_root; instanceTag; instanceTag = instanceTag->next) {
+			[self _addShardKeyForAccountName:instanceTag->accountname protocol:instanceTag->protocol toSet:shardKeys];
+		}
+
+		/* The default engine does not hold any configuration of its own once
+		 sharding is enabled. */
+		otrl_context_forget_all(userState);
+		otrl_privkey_forget_all(userState);
+		otrl_instag_forget_all(userState);
+
+		[defaultEngine recountFingerprints];
+
+		[[NSFileManager defaultManager] createDirectoryAtPath:[self _shardsPath] withIntermediateDirectories:YES attributes:nil error:NULL];
+
+		for (NSString *shardKey in shardKeys) {
+			(void)[self _engineForShardKey:shardKey];
+		}
+	}];
+}
+
+- (void)_addShardKeyForAccountName:(const char *)accountname protocol:(const char *)protocol toSet:(NSMutableSet *)shardKeys
+{
+	if (accountname == NULL || strlen(accountname) == 0 ||
+		protocol == NULL || strlen(protocol) == 0)
+	{
+		return;
+	}
+
+	NSString *shardKey = [OTRKitEngine shardKeyForAccountName:@(accountname) protocol:@(protocol)];
+
+	[shardKeys addObject:shardKey];
+}
+
+- (void)_migrateLibotrConfigurationToShardEngine:(OTRKitEngine *)engine
+{
+	NSFileManager *fileManager = [NSFileManager defaultManager];
+
+	[fileManager createDirectoryAtPath:[engine dataPath] withIntermediateDirectories:YES attributes:nil error:NULL];
+
+	/* Read the shared configuration then throw away everything
+	 that does not belong to the account of this shard. */
+	[self _readPrivateKeyPath:[self privateKeyPath] forEngine:engine];
+
+	[self _readInstanceTagsPath:[self instanceTagsPath] forEngine:engine];
+
+	[self _readFingerprintsPath:[self fingerprintsPath] forEngine:engine];
+
+	[self _replayFingerprintsJournalForPath:[self fingerprintsPath] forEngine:engine];
+
+	OtrlUserState userState = [engine userState];
+
+	const char *accountName = [[engine accountName] UTF8String];
+	const char *protocol = [[engine protocol] UTF8String];
+
+	OtrlPrivKey *privateKey = userState->privkey_root;
+
+	while (privateKey) {
+		OtrlPrivKey *privateKeyNext = privateKey->next;
+
+		if (strcmp(privateKey->accountname, accountName) != 0 || strcmp(privateKey->protocol, protocol) != 0) {
+			otrl_privkey_forget(privateKey);
+		}
+
+		privateKey = privateKeyNext;
+	}
+
+	ConnContext *context = userState->context_root;
+
+	while (context) {
+		ConnContext *contextNext = context->next;
+
+		if (strcmp(context->accountname, accountName) != 0 || strcmp(context->protocol, protocol) != 0) {
+			otrl_context_forget(context);
+		}
+
+		context = contextNext;
+	}
+
+	OtrlInsTag *instanceTag = userState->instag_root;
+
+	while (instanceTag) {
+		OtrlInsTag *instanceTagNext = instanceTag->next;
+
+		if (strcmp(instanceTag->accountname, accountName) != 0 || strcmp(instanceTag->protocol, protocol) != 0) {
+			otrl_instag_forget(instanceTag);
+		}
+
+		instanceTag = instanceTagNext;
+	}
+
+	if (userState->privkey_root) {
+		NSData *privateKeysData = OTRKitStoragePrivateKeysFileData(userState);
+
+		if (privateKeysData) {
+			[privateKeysData writeToFile:[engine privateKeyPath] options:NSDataWritingAtomic error:NULL];
+		} else {
+			LogToConsole(@"Failed to encode the private key of '%@' for its shard", [engine accountName]);
+		}
+	}
+
+	[self _writeFingerprintsPathForEngine:engine];
+
+	[self _writeInstanceTagsPathForEngine:engine];
+
+	[engine recountFingerprints];
+}
+
+#pragma mark Initialization
+
+- (void)decodeMessage:(NSString *)message username:(NSString *)username accountName:(NSString *)accountName protocol:(NSString *)protocol tag:(id)tag
+{
+	OTRKitConversation *conversation = [self conversationForUsername:username accountName:accountName protocol:protocol];
+
+	[self decodeMessage:message conversation:conversation tag:tag];
+}
+
+- (void)decodeMessage:(NSString *)message conversation:(OTRKitConversation *)conversation tag:(id)tag
+{
+	AssertParamaterNil(conversation)
+	AssertParamaterLength(message)
+
+	NSString *username = [conversation username];
+	NSString *accountName = [conversation accountName];
+	NSString *protocol = [conversation protocol];
+
+	OTRKitMessageType otrMessageType = [self typeOfMessage:message];
+
+	[self _recordTrafficOfType:OTRKitTrafficRecordTypeDecode message:message messageType:otrMessageType tlvCount:0 conversation:conversation];
+
+	OTRKitIncomingMessageFilter incomingMessageFilter = self.incomingMessageFilter;
+
+	if (incomingMessageFilter == nil && [self _delegateWantsToIgnoreMessages]) {
+		__block BOOL ignoreMessageSaysDelegate = NO;
+
+		[self _performSyncOperationOnDelegateQueue:^{
+			ignoreMessageSaysDelegate =
+			[self.delegate otrKit:self
+					ignoreMessage:message
+					  messageType:otrMessageType
+						 username:username
+					  accountName:accountName
+						 protocol:protocol];
+		}];
+
+		if (ignoreMessageSaysDelegate) {
+			return;
+		}
+	}
+
+	OTRKitEngine *engine = [self _engineForConversation:conversation];
+
+	[self _performAsyncOperation:^{
+		if (incomingMessageFilter &&
+			incomingMessageFilter(message, otrMessageType, username, accountName, protocol))
+		{
+			return;
+		}
+
+		[self _decodeMessage:message messageType:otrMessageType conversation:conversation tag:tag];
+	} onEngine:engine tracingConversation:conversation];
+}
+
+- (void)_decodeMessage:(NSString *)message messageType:(OTRKitMessageType)messageType conversation:(OTRKitConversation *)conversation tag:(id)tag
+{
+	OTRKitEngine *engine = [self _engineForConversation:conversation];
+
+	dispatch_block_t decodeOperation = ^{
+		[self _decodeMessage:message messageType:messageType conversation:conversation tag:tag];
+	};
+
+	OTRKitHoldResult holdResult = [self _holdOperation:decodeOperation forConversation:conversation];
+
+	if (holdResult == OTRKitHoldResultRejected) {
+		[self _failHeldDecodingOfMessage:message conversation:conversation tag:tag];
+	}
+
+	if (holdResult != OTRKitHoldResultNotHeld) {
+		return;
+	}
+
+	ConnContext *otrContext = [self _contextForConversation:conversation];
+
+	OTRKitOpData *opData = [engine opDataWithTag:tag conversation:conversation];
+
+	OTRKitDecodedMessage *decodedMessage =
+	[self _decodedMessageForMessage:message
+						messageType:messageType
+						  inContext:&otrContext
+					   conversation:conversation
+							 opData:opData];
+
+	/* libotr could not answer without a private key so the
+	 message is decoded again once the key is generated. */
+	if ([opData privateKeyRequested]) {
+		holdResult = [self _holdOperation:decodeOperation forConversation:conversation];
+
+		if (holdResult == OTRKitHoldResultRejected) {
+			[self _failHeldDecodingOfMessage:message conversation:conversation tag:tag];
+		}
+
+		if (holdResult != OTRKitHoldResultNotHeld) {
+			return;
+		}
+	}
+
+	if ([decodedMessage status] == OTRKitDecodedMessageStatusDecoded ||
+		[[decodedMessage tlvs] count] > 0)
+	{
+		NSString *username = [conversation username];
+		NSString *accountName = [conversation accountName];
+		NSString *protocol = [conversation protocol];
+
+		[self _performAsyncOperationOnDelegateQueue:^{
+			[self.delegate otrKit:self
+				   decodedMessage:[decodedMessage decodedMessage]
+					 wasEncrypted:[decodedMessage wasEncrypted]
+							 tlvs:[decodedMessage tlvs]
+						 username:username
+					  accountName:accountName
+						 protocol:protocol
+							  tag:tag];
+		} tracingConversation:conversation];
+	}
+}
+
+- (OTRKitHoldResult)_holdOperation:(dispatch_block_t)operation forConversation:(OTRKitConversation *)conversation
+{
+	OTRKitEngine *engine = [self _engineForConversation:conversation];
+
+	return [engine holdOperation:operation untilKeyIsGeneratedForAccountName:[conversation accountName] protocol:[conversation protocol]];
+}
+
+- (NSError *)_heldOperationLimitError
+{
+	return [NSError errorWithDomain:kOTRKitErrorDomain
+							   code:ENOBUFS
+						   userInfo:@{NSLocalizedDescriptionKey : @"Too many messages are waiting for a private key to be generated"}];
+}
+
+- (OTRKitEncodedMessage *)_encodedMessageFailingHeldMessage:(NSString *)message tag:(id)tag
+{
+	OTRKitEncodedMessage *result = [OTRKitEncodedMessage new];
+
+	[result setMessage:message];
+
+	[result setTag:tag];
+
+	[result setError:[self _heldOperationLimitError]];
+
+	return result;
+}
+
+- (OTRKitDecodedMessage *)_decodedMessageFailingHeldMessage:(OTRKitIncomingMessage *)message
+{
+	OTRKitDecodedMessage *result = [OTRKitDecodedMessage new];
+
+	[result setMessage:[message message]];
+
+	[result setTag:[message tag]];
+
+	[result setStatus:OTRKitDecodedMessageStatusFailed];
+
+	[result setError:[self _heldOperationLimitError]];
+
+	return result;
+}
+
+- (void)_failHeldDecodingOfMessage:(NSString *)message conversation:(OTRKitConversation *)conversation tag:(id)tag
+{
+	NSString *username = [conversation username];
+	NSString *accountName = [conversation accountName];
+	NSString *protocol = [conversation protocol];
+
+	NSError *error = [self _heldOperationLimitError];
+
+	[self _performAsyncOperationOnDelegateQueue:^{
+		[self.delegate otrKit:self
+		   handleMessageEvent:OTRKitMessageEventReceivedMessageGeneralError
+					  message:message
+					 username:username
+				  accountName:accountName
+					 protocol:protocol
+						  tag:tag
+						error:error];
+	} tracingConversation:conversation];
+}
+
+- (void)decodeMessages:(NSArray<OTRKitIncomingMessage *> *)messages
+			  username:(NSString *)username
+		   accountName:(NSString *)accountName
+			  protocol:(NSString *)protocol
+{
+	OTRKitConversation *conversation = [self conversationForUsername:username accountName:accountName protocol:protocol];
+
+	[self decodeMessages:messages conversation:conversation];
+}
+
+- (void)decodeMessages:(NSArray<OTRKitIncomingMessage *> *)messages conversation:(OTRKitConversation *)conversation
+{
+	AssertParamaterNil(conversation)
+	AssertParamaterNil(messages)
+
+	NSString *username = [conversation username];
+	NSString *accountName = [conversation accountName];
+	NSString *protocol = [conversation protocol];
+
+	NSUInteger messageCount = [messages count];
+
+	if (messageCount == 0) {
+		return;
+	}
+
+	/* Classify each message and, unless a filter is set, ask the delegate which
+	 to ignore using at most one trip to the delegate queue for the entire batch.
+	 Both are kept in data so that they outlive a batch that is held. */
+	NSMutableData *messageTypesData = [NSMutableData dataWithLength:(messageCount * sizeof(OTRKitMessageType))];
+
+	NSMutableData *ignoredMessagesData = [NSMutableData dataWithLength:(messageCount * sizeof(BOOL))];
+
+	OTRKitMessageType *messageTypes = [messageTypesData mutableBytes];
+
+	BOOL *ignoredMessages = [ignoredMessagesData mutableBytes];
+
+	for (NSUInteger i = 0; i < messageCount; i++) {
+		messageTypes[i] = [self typeOfMessage:[messages[i] message]];
+
+		[self _recordTrafficOfType:OTRKitTrafficRecordTypeDecode message:[messages[i] message] messageType:messageTypes[i] tlvCount:0 conversation:conversation];
+	}
+
+	OTRKitIncomingMessageFilter incomingMessageFilter = self.incomingMessageFilter;
+
+	if (incomingMessageFilter == nil && [self _delegateWantsToIgnoreMessages]) {
+		[self _performSyncOperationOnDelegateQueue:^{
+			for (NSUInteger i = 0; i < messageCount; i++) {
+				ignoredMessages[i] =
+				[self.delegate otrKit:self
+						ignoreMessage:[messages[i] message]
+						  messageType:messageTypes[i]
+							 username:username
+						  accountName:accountName
+							 protocol:protocol];
+			}
+		}];
+	}
+
+	OTRKitEngine *engine = [self _engineForConversation:conversation];
+
+	[self _performAsyncOperation:^{
+		if (incomingMessageFilter) {
+			for (NSUInteger i = 0; i < messageCount; i++) {
+				ignoredMessages[i] = incomingMessageFilter([messages[i] message], messageTypes[i], username, accountName, protocol);
+			}
+		}
+
+		[self _decodeMessages:messages
+				 messageTypes:messageTypesData
+			  ignoredMessages:ignoredMessagesData
+					fromIndex:0
+			  decodedMessages:[NSMutableArray arrayWithCapacity:messageCount]
+				 conversation:conversation];
+	} onEngine:engine tracingConversation:conversation];
+}
+
+- (void)_decodeMessages:(NSArray<OTRKitIncomingMessage *> *)messages
+		   messageTypes:(NSData *)messageTypesData
+		ignoredMessages:(NSData *)ignoredMessagesData
+			  fromIndex:(NSUInteger)firstIndex
+		decodedMessages:(NSMutableArray<OTRKitDecodedMessage *> *)decodedMessages
+		   conversation:(OTRKitConversation *)conversation
+{
+	OTRKitEngine *engine = [self _engineForConversation:conversation];
+
+	ConnContext *otrContext = [self _contextForConversation:conversation];
+
+	const OTRKitMessageType *messageTypes = [messageTypesData bytes];
+
+	const BOOL *ignoredMessages = [ignoredMessagesData bytes];
+
+	NSUInteger messageCount = [messages count];
+
+	for (NSUInteger i = firstIndex; i < messageCount; i++) {
+		OTRKitIncomingMessage *message = messages[i];
+
+		OTRKitDecodedMessage *decodedMessage = nil;
+
+		if (ignoredMessages[i]) {
+			decodedMessage = [OTRKitDecodedMessage new];
+
+			[decodedMessage setMessage:[message message]];
+
+			[decodedMessage setWasEncrypted:(messageTypes[i] != OTRKitMessageTypeNotOTR)];
+
+			[decodedMessage setTag:[message tag]];
+
+			[decodedMessage setStatus:OTRKitDecodedMessageStatusIgnored];
+
+			[decodedMessages addObject:decodedMessage];
+
+			continue;
+		}
+
+		/* The rest of a batch that has to wait for a private key is held
+		 as one, so that the batch is still delivered once and in order. */
+		dispatch_block_t decodeOperation = ^{
+			[self _decodeMessages:messages
+					 messageTypes:messageTypesData
+				  ignoredMessages:ignoredMessagesData
+						fromIndex:i
+				  decodedMessages:decodedMessages
+					 conversation:conversation];
+		};
+
+		OTRKitHoldResult holdResult = [self _holdOperation:decodeOperation forConversation:conversation];
+
+		if (holdResult == OTRKitHoldResultHeld) {
+			return;
+		}
+
+		OTRKitOpData *opData = nil;
+
+		if (holdResult == OTRKitHoldResultNotHeld) {
+			opData = [engine opDataWithTag:[message tag] conversation:conversation];
+
+			decodedMessage =
+			[self _decodedMessageForMessage:[message message]
+								messageType:messageTypes[i]
+								  inContext:&otrContext
+							   conversation:conversation
+									 opData:opData];
+
+			/* libotr could not answer without a private key so the
+			 message is decoded again once the key is generated. */
+			if ([opData privateKeyRequested]) {
+				holdResult = [self _holdOperation:decodeOperation forConversation:conversation];
+
+				if (holdResult == OTRKitHoldResultHeld) {
+					return;
+				}
+			}
+		}
+
+		if (holdResult == OTRKitHoldResultRejected) {
+			for (NSUInteger j = i; j < messageCount; j++) {
+				[decodedMessages addObject:[self _decodedMessageFailingHeldMessage:messages[j]]];
+			}
+
+			break;
+		}
+
+		[decodedMessages addObject:decodedMessage];
+	}
+
+	[self _performAsyncOperationOnDelegateQueue:^{
+		[self _deliverDecodedMessages:decodedMessages conversation:conversation];
+	} tracingConversation:conversation];
+}
+
+- (BOOL)_delegateWantsToIgnoreMessages
+{
+	return [self.delegate respondsToSelector:@selector(otrKit:ignoreMessage:messageType:username:accountName:protocol:)];
+}
+
+- (void)_deliverDecodedMessages:(NSArray<OTRKitDecodedMessage *> *)decodedMessages conversation:(OTRKitConversation *)conversation
+{
+	NSString *username = [conversation username];
+	NSString *accountName = [conversation accountName];
+	NSString *protocol = [conversation protocol];
+
+	if ([self.delegate respondsToSelector:@selector(otrKit:decodedMessages:username:accountName:protocol:)]) {
+		[self.delegate otrKit:self
+			  decodedMessages:decodedMessages
+					 username:username
+				  accountName:accountName
+					 protocol:protocol];
+
+		return;
+	}
+
+	/* Delegates that do not implement the batched method are
+	 informed of each message the same way -decodeMessage: would. */
+	for (OTRKitDecodedMessage *decodedMessage in decodedMessages) {
+		if ([decodedMessage status] == OTRKitDecodedMessageStatusIgnored) {
+			continue;
+		}
+
+		if ([decodedMessage status] == OTRKitDecodedMessageStatusFailed) {
+			[self.delegate otrKit:self
+			   handleMessageEvent:OTRKitMessageEventReceivedMessageGeneralError
+						  message:[decodedMessage message]
+						 username:username
+					  accountName:accountName
+						 protocol:protocol
+							  tag:[decodedMessage tag]
+							error:[decodedMessage error]];
+
+			continue;
+		}
+
+		if ([decodedMessage status] == OTRKitDecodedMessageStatusProtocol &&
+			[[decodedMessage tlvs] count] == 0)
+		{
+			continue;
+		}
+
+		[self.delegate otrKit:self
+			   decodedMessage:[decodedMessage decodedMessage]
+				 wasEncrypted:[decodedMessage wasEncrypted]
+						 tlvs:[decodedMessage tlvs]
+					 username:username
+				  accountName:accountName
+					 protocol:protocol
+						  tag:[decodedMessage tag]];
+	}
+}
+
+- (OTRKitDecodedMessage *)_decodedMessageForMessage:(NSString *)message
+										messageType:(OTRKitMessageType)messageType
+										  inContext:(ConnContext **)otrContext
+									   conversation:(OTRKitConversation *)conversation
+											 opData:(OTRKitOpData *)opData
+{
+	char *otrDecodedMessage = NULL;
+
+	OtrlTLV *otr_tlvs = NULL;
+
+	OTRKitEngine *engine = [opData engine];
+
+	if (messageType >= OTRKitMessageTypeDHCommit && messageType <= OTRKitMessageTypeV1KeyExchange) {
+		[self _traceKeyExchangeInProgress:YES username:[conversation usernameUTF8String] accountName:[conversation accountNameUTF8String] protocol:[conversation protocolUTF8String] opData:opData];
+	}
+
+	[self _traceBeginStage:OTRKitTraceStageMessageReceiving conversation:conversation];
+
+	uint64_t libotrStart = OTRKitMetricsNow();
+
+	int ignoreMessage = otrl_message_receiving(engine.userState,
+											   &ui_ops,
+											   (__bridge void *)(opData),
+											   [conversation accountNameUTF8String],
+											   [conversation protocolUTF8String],
+											   [conversation usernameUTF8String],
+											   [message UTF8String],
+											   &otrDecodedMessage,
+											   &otr_tlvs,
+											   otrContext,
+											   NULL,
+											   NULL);
+
+	NSArray *tlvs = nil;
+
+	if (otr_tlvs) {
+		tlvs = [self _tlvArrayForTLVChain:otr_tlvs];
+	}
+
+	[self _traceEndStage:OTRKitTraceStageMessageReceiving conversation:conversation];
+
+	OTRKitMetricsOperation metricsOperation = OTRKitMetricsOperationDecode;
+
+	if ([opData smpEventHandled]) {
+		metricsOperation = OTRKitMetricsOperationSMP;
+	} else if (messageType >= OTRKitMessageTypeDHCommit && messageType <= OTRKitMessageTypeV1KeyExchange) {
+		metricsOperation = OTRKitMetricsOperationKeyExchange;
+	}
+
+	[self _recordMetricsOperation:metricsOperation libotrStart:libotrStart engine:engine];
+
+	[engine noteActivityInConversation:conversation];
+
+	if (*otrContext) {
+		if ((*otrContext)->msgstate == OTRL_MSGSTATE_FINISHED) {
+			[self disableEncryptionInConversation:conversation];
+		}
+	}
+
+	OTRKitDecodedMessage *result = [OTRKitDecodedMessage new];
+
+	[result setMessage:message];
+
+	[result setWasEncrypted:(messageType != OTRKitMessageTypeNotOTR)];
+
+	[result setTlvs:tlvs];
+
+	[result setTag:[opData tag]];
+
+	if (ignoreMessage == 0) {
+		if (otrDecodedMessage) {
+			[result setDecodedMessage:@(otrDecodedMessage)];
+		} else {
+			[result setDecodedMessage:message]; // Nothing changed...
+		}
+
+		[result setStatus:OTRKitDecodedMessageStatusDecoded];
+	} else {
+		[result setStatus:OTRKitDecodedMessageStatusProtocol];
+	}
+
+	[self _recordTrafficOfType:OTRKitTrafficRecordTypeDecoded message:[result decodedMessage] messageType:OTRKitMessageTypeNotOTR tlvCount:[tlvs count] conversation:conversation];
+
+	if (otrDecodedMessage) {
+		otrl_message_free(otrDecodedMessage);
+	}
+
+	if (otr_tlvs) {
+		otrl_tlv_free(otr_tlvs);
+	}
+
+	return result;
+}
+
+- (void)encodeMessage:(NSString *)message
+				 tlvs:(NSArray *)tlvs
+			 username:(NSString *)username
+		  accountName:(NSString *)accountName
+			 protocol:(NSString *)protocol
+				  tag:(id)tag
+{
+	OTRKitConversation *conversation = [self conversationForUsername:username accountName:accountName protocol:protocol];
+
+	[self encodeMessage:message tlvs:tlvs conversation:conversation tag:tag];
+}
+
+- (void)encodeMessage:(NSString *)message
+				 tlvs:(NSArray *)tlvs
+		 conversation:(OTRKitConversation *)conversation
+				  tag:(id)tag
+{
+	AssertParamaterNil(conversation)
+//	AssertParamaterLength(message)
+
+	[self _recordTrafficOfType:OTRKitTrafficRecordTypeEncode message:message messageType:OTRKitMessageTypeNotOTR tlvCount:[tlvs count] conversation:conversation];
+
+	OTRKitEngine *engine = [self _engineForConversation:conversation];
+
+	[self _performAsyncOperation:^{
+		[self _encodeMessage:message tlvs:tlvs conversation:conversation tag:tag];
+	} onEngine:engine tracingConversation:conversation];
+}
+
+- (void)_encodeMessage:(NSString *)message tlvs:(NSArray *)tlvs conversation:(OTRKitConversation *)conversation tag:(id)tag
+{
+	NSString *username = [conversation username];
+	NSString *accountName = [conversation accountName];
+	NSString *protocol = [conversation protocol];
+
+	/* Outgoing messages wait for a private key that is being generated
+	 so that they stay in order with the incoming messages held for it. */
+	dispatch_block_t encodeOperation = ^{
+		[self _encodeMessage:message tlvs:tlvs conversation:conversation tag:tag];
+	};
+
+	OTRKitHoldResult holdResult = [self _holdOperation:encodeOperation forConversation:conversation];
+
+	if (holdResult == OTRKitHoldResultRejected) {
+		OTRKitEncodedMessage *failedMessage = [self _encodedMessageFailingHeldMessage:message tag:tag];
+
+		[self _performAsyncOperationOnDelegateQueue:^{
+			[self.delegate otrKit:self
+				   encodedMessage:[failedMessage encodedMessage]
+					 wasEncrypted:NO
+						 username:username
+					  accountName:accountName
+						 protocol:protocol
+							  tag:tag
+							error:[failedMessage error]];
+		} tracingConversation:conversation];
+	}
+
+	if (holdResult != OTRKitHoldResultNotHeld) {
+		return;
+	}
+
+	ConnContext *otrContext = [self _contextForConversation:conversation];
+
+	if ([self _shouldBypassEncodingInContext:otrContext]) {
+		[self _recordTrafficOfType:OTRKitTrafficRecordTypeInject message:message messageType:OTRKitMessageTypeNotOTR tlvCount:0 conversation:conversation];
+
+		[self _performAsyncOperationOnDelegateQueue:^{
+			[self.delegate otrKit:self
+				   encodedMessage:message
+					 wasEncrypted:NO
+						 username:username
+					  accountName:accountName
+						 protocol:protocol
+							  tag:tag
+							error:nil];
+
+			[self.delegate otrKit:self
+					injectMessage:message
+						 username:username
+					  accountName:accountName
+						 protocol:protocol
+							  tag:tag];
+		} tracingConversation:conversation];
+
+		return;
+	}
+
+	[self _encodeMessage:message
+			   inContext:otrContext
+					tlvs:tlvs
+			conversation:conversation
+					 tag:tag];
+}
+
+- (void)encodeMessages:(NSArray<OTRKitOutgoingMessage *> *)messages
+			  username:(NSString *)username
+		   accountName:(NSString *)accountName
+			  protocol:(NSString *)protocol
+{
+	OTRKitConversation *conversation = [self conversationForUsername:username accountName:accountName protocol:protocol];
+
+	[self encodeMessages:messages conversation:conversation];
+}
+
+- (void)encodeMessages:(NSArray<OTRKitOutgoingMessage *> *)messages conversation:(OTRKitConversation *)conversation
+{
+	AssertParamaterNil(conversation)
+	AssertParamaterNil(messages)
+
+	if ([messages count] == 0) {
+		return;
+	}
+
+	if (self.trafficRecorder) {
+		for (OTRKitOutgoingMessage *message in messages) {
+			[self _recordTrafficOfType:OTRKitTrafficRecordTypeEncode message:[message message] messageType:OTRKitMessageTypeNotOTR tlvCount:[[message tlvs] count] conversation:conversation];
+		}
+	}
+
+	OTRKitEngine *engine = [self _engineForConversation:conversation];
+
+	[self _performAsyncOperation:^{
+		[self _encodeMessages:messages conversation:conversation];
+	} onEngine:engine tracingConversation:conversation];
+}
+
+- (void)_encodeMessages:(NSArray<OTRKitOutgoingMessage *> *)messages conversation:(OTRKitConversation *)conversation
+{
+	dispatch_block_t encodeOperation = ^{
+		[self _encodeMessages:messages conversation:conversation];
+	};
+
+	OTRKitHoldResult holdResult = [self _holdOperation:encodeOperation forConversation:conversation];
+
+	if (holdResult == OTRKitHoldResultRejected) {
+		NSMutableArray *failedMessages = [NSMutableArray arrayWithCapacity:[messages count]];
+
+		for (OTRKitOutgoingMessage *message in messages) {
+			[failedMessages addObject:[self _encodedMessageFailingHeldMessage:[message message] tag:[message tag]]];
+		}
+
+		[self _performAsyncOperationOnDelegateQueue:^{
+			[self _deliverEncodedMessages:failedMessages conversation:conversation];
+		} tracingConversation:conversation];
+	}
+
+	if (holdResult != OTRKitHoldResultNotHeld) {
+		return;
+	}
+
+	OTRKitEngine *engine = [self _engineForConversation:conversation];
+
+	ConnContext *otrContext = [self _contextForConversation:conversation];
+
+	NSMutableArray *encodedMessages = [NSMutableArray arrayWithCapacity:[messages count]];
+
+	for (OTRKitOutgoingMessage *message in messages) {
+		OTRKitEncodedMessage *encodedMessage = nil;
+
+		/* The offer state and message state can change part way through
+		 a batch (e.g. the first message triggers an OTR query) which is
+		 why the bypass is checked for each message individually. */
+		if ([self _shouldBypassEncodingInContext:otrContext]) {
+			encodedMessage = [OTRKitEncodedMessage new];
+
+			[encodedMessage setMessage:[message message]];
+			[encodedMessage setEncodedMessage:[message message]];
+
+			if ([message message]) {
+				[encodedMessage setInjectedMessages:@[[message message]]];
+
+				[self _recordTrafficOfType:OTRKitTrafficRecordTypeInject message:[message message] messageType:OTRKitMessageTypeNotOTR tlvCount:0 conversation:conversation];
+			}
+
+			[encodedMessage setTag:[message tag]];
+		} else {
+			OTRKitOpData *opData = [engine opDataWithTag:[message tag] conversation:conversation];
+
+			[opData setInjectedMessages:[NSMutableArray array]];
+
+			encodedMessage =
+			[self _encodedMessageForMessage:[message message]
+								  inContext:&otrContext
+									   tlvs:[message tlvs]
+							   conversation:conversation
+									 opData:opData];
+		}
+
+		[encodedMessages addObject:encodedMessage];
+	}
+
+	[self _performAsyncOperationOnDelegateQueue:^{
+		[self _deliverEncodedMessages:encodedMessages conversation:conversation];
+	} tracingConversation:conversation];
+}
+
+- (void)_deliverEncodedMessages:(NSArray<OTRKitEncodedMessage *> *)encodedMessages conversation:(OTRKitConversation *)conversation
+{
+	NSString *username = [conversation username];
+	NSString *accountName = [conversation accountName];
+	NSString *protocol = [conversation protocol];
+
+	if ([self.delegate respondsToSelector:@selector(otrKit:encodedMessages:username:accountName:protocol:)]) {
+		[self.delegate otrKit:self
+			  encodedMessages:encodedMessages
+					 username:username
+				  accountName:accountName
+					 protocol:protocol];
+
+		return;
+	}
+
+	/* Delegates that do not implement the batched method are
+	 informed of each message the same way -encodeMessage: would. */
+	for (OTRKitEncodedMessage *encodedMessage in encodedMessages) {
+		[self _deliverInjectedMessages:[encodedMessage injectedMessages] conversation:conversation tag:[encodedMessage tag]];
+
+		[self.delegate otrKit:self
+			   encodedMessage:[encodedMessage encodedMessage]
+				 wasEncrypted:[encodedMessage wasEncrypted]
+					 username:username
+				  accountName:accountName
+					 protocol:protocol
+						  tag:[encodedMessage tag]
+						error:[encodedMessage error]];
+	}
+}
+
+- (void)_deliverInjectedMessages:(NSArray<NSString *> *)injectedMessages conversation:(OTRKitConversation *)conversation tag:(id)tag
+{
+	NSUInteger injectedMessageCount = [injectedMessages count];
+
+	if (injectedMessageCount == 0) {
+		return;
+	}
+
+	NSString *username = [conversation username];
+	NSString *accountName = [conversation accountName];
+	NSString *protocol = [conversation protocol];
+
+	if ([self.delegate respondsToSelector:@selector(otrKit:injectMessages:fragmentCount:byteCount:username:accountName:protocol:tag:)]) {
+		NSUInteger byteCount = 0;
+
+		for (NSString *injectedMessage in injectedMessages) {
+			byteCount += [injectedMessage lengthOfBytesUsingEncoding:NSUTF8StringEncoding];
+		}
+
+		[self.delegate otrKit:self
+			   injectMessages:injectedMessages
+				fragmentCount:injectedMessageCount
+					byteCount:byteCount
+					 username:username
+				  accountName:accountName
+					 protocol:protocol
+						  tag:tag];
+
+		return;
+	}
+
+	for (NSString *injectedMessage in injectedMessages) {
+		[self.delegate otrKit:self
+				injectMessage:injectedMessage
+					 username:username
+				  accountName:accountName
+					 protocol:protocol
+						  tag:tag];
+	}
+}
+
+- (BOOL)_shouldBypassEncodingInContext:(ConnContext *)otrContext
+{
+	/*
+	 * If our policy is not oppritunistic (automatic) and we are not in an encrypted,
+	 * then return unecnrypted message to delegate. This exception is made because when
+	 * OTRL_POLICY_MANUAL is set, OTR discards outgoing * messages altogther.
+	 *
+	 * If our policy is ppritunistic (automatic) and our OTR request was rejected,
+	 * then we will return unecnrypted message to delegate. OTR will refuse to do further
+	 * work when the state is rejected.
+	 */
+	if (/* 1 */ (self.otrPolicy == OTRKitPolicyManual ||
+				 self.otrPolicy == OTRKitPolicyNever) ||
+		/* 2 */ (self.otrPolicy == OTRKitPolicyOpportunistic &&
+				 [self _offerStateForContext:otrContext] == OTRKitOfferStateRejected))
+	{
+		OTRKitMessageState otrMessageState = [self _messageStateForContext:otrContext];
+
+		if (otrMessageState == OTRKitMessageStatePlaintext) {
+			return YES;
+		}
+	}
+
+	return NO;
+}
+
+- (void)_encodeMessage:(NSString *)message
+			 inContext:(ConnContext *)otrContext
+				  tlvs:(NSArray *)tlvs
+		  conversation:(OTRKitConversation *)conversation
+				   tag:(id)tag
+{
+	NSString *username = [conversation username];
+	NSString *accountName = [conversation accountName];
+	NSString *protocol = [conversation protocol];
+
+	OTRKitEngine *engine = [self _engineForConversation:conversation];
+
+	OTRKitOpData *opData = [engine opDataWithTag:tag conversation:conversation];
+
+	/* A message too large for the protocol is injected as many fragments.
+	 They are collected and handed to the delegate along with the result
+	 instead of taking a trip to the delegate queue each. */
+	[opData setInjectedMessages:[NSMutableArray array]];
+
+	OTRKitEncodedMessage *encodedMessage =
+	[self _encodedMessageForMessage:message
+						  inContext:&otrContext
+							   tlvs:tlvs
+					   conversation:conversation
+							 opData:opData];
+
+	[self _performAsyncOperationOnDelegateQueue:^{
+		[self _deliverInjectedMessages:[encodedMessage injectedMessages] conversation:conversation tag:tag];
+
+		[self.delegate otrKit:self
+			   encodedMessage:[encodedMessage encodedMessage]
+				 wasEncrypted:[encodedMessage wasEncrypted]
+					 username:username
+				  accountName:accountName
+					 protocol:protocol
+						  tag:tag
+						error:[encodedMessage error]];
+	} tracingConversation:conversation];
+}
+
+- (OTRKitEncodedMessage *)_encodedMessageForMessage:(NSString *)message
+										  inContext:(ConnContext **)otrContext
+											   tlvs:(NSArray *)tlvs
+									   conversation:(OTRKitConversation *)conversation
+											 opData:(OTRKitOpData *)opData
+{
+	gcry_error_t otrError;
+
+	char *otrEncodedMessage = NULL;
+
+	// Set nil messages to empty string if TLVs are present, otherwise libotr
+	// will silence the message, even though you may have meant to inject a TLV.
+	NSString *messageToEncode = message;
+
+	if (message == nil && [tlvs count] > 0) {
+		messageToEncode = @"";
+	}
+
+	OtrlTLV *otr_tlvs = [self _tlvChainForTLVs:tlvs];
+
+	OTRKitEngine *engine = [opData engine];
+
+	[self _traceBeginStage:OTRKitTraceStageMessageSending conversation:conversation];
+
+	uint64_t libotrStart = OTRKitMetricsNow();
+
+	otrError = otrl_message_sending(engine.userState,
+									 &ui_ops,
+									 (__bridge void *)(opData),
+									 [conversation accountNameUTF8String],
+									 [conversation protocolUTF8String],
+									 [conversation usernameUTF8String],
+									 OTRL_INSTAG_BEST,
+									 [messageToEncode UTF8String],
+									 otr_tlvs,
+									 &otrEncodedMessage,
+									 OTRL_FRAGMENT_SEND_ALL,
+									 otrContext,
+									 NULL,
+									 NULL);
+
+	if (otr_tlvs) {
+		otrl_tlv_free(otr_tlvs);
+	}
+
+	[self _recordMetricsOperation:OTRKitMetricsOperationEncode libotrStart:libotrStart engine:engine];
+
+	[self _traceEndStage:OTRKitTraceStageMessageSending conversation:conversation];
+
+	[engine noteActivityInConversation:conversation];
+
+	BOOL wasEncrypted = NO;
+
+	NSString *encodedMessage = nil;
+
+	if (otrEncodedMessage) {
+		encodedMessage = @(otrEncodedMessage);
+
+		otrl_message_free(otrEncodedMessage);
+
+		wasEncrypted = ([self typeOfMessage:encodedMessage] != OTRKitMessageTypeNotOTR);
+	}
+
+	NSError *errorString = nil;
+
+	if (otrError != 0) {
+		errorString = [self _errorForGPGError:otrError];
+
+		encodedMessage = nil;
+	}
+
+	OTRKitEncodedMessage *result = [OTRKitEncodedMessage new];
+
+	[result setMessage:message];
+	[result setEncodedMessage:encodedMessage];
+
+	[result setWasEncrypted:wasEncrypted];
+
+	if ([opData injectedMessages]) {
+		[result setInjectedMessages:[opData injectedMessages]];
+	}
+
+	[result setTag:[opData tag]];
+
+	[result setError:errorString];
+
+	return result;
+}
+
+- (void)initiateEncryptionWithUsername:(NSString *)username
+						   accountName:(NSString *)accountName
+							  protocol:(NSString *)protocol
+{
+	OTRKitConversation *conversation = [self conversationForUsername:username accountName:accountName protocol:protocol];
+
+	[self initiateEncryptionInConversation:conversation];
+}
+
+- (void)initiateEncryptionInConversation:(OTRKitConversation *)conversation
+{
+	AssertParamaterNil(conversation)
+
+	OTRKitEngine *engine = [self _engineForConversation:conversation];
+
+	[engine performAsyncOperation:^{
+		ConnContext *otrContext = [self _contextForConversation:conversation];
+
+		[self _encodeMessage:@"?OTR?" inContext:otrContext tlvs:nil conversation:conversation tag:nil];
+	}];
+}
+
+- (void)disableEncryptionWithUsername:(NSString *)username
+						  accountName:(NSString *)accountName
+							 protocol:(NSString *)protocol
+{
+	OTRKitConversation *conversation = [self conversationForUsername:username accountName:accountName protocol:protocol];
+
+	[self disableEncryptionInConversation:conversation];
+}
+
+- (void)disableEncryptionInConversation:(OTRKitConversation *)conversation
+{
+	AssertParamaterNil(conversation)
+
+	OTRKitEngine *engine = [self _engineForConversation:conversation];
+
+	[engine performAsyncOperation:^{
+		OTRKitOpData *opData = [engine opDataWithTag:nil conversation:conversation];
+
+		otrl_message_disconnect_all_instances(engine.userState, &ui_ops, (__bridge void *)(opData), [conversation accountNameUTF8String], [conversation protocolUTF8String], [conversation usernameUTF8String]);
+
+		ConnContext *otrContext = [self _contextForConversation:conversation];
+
+		if (otrContext) {
+			[self _updateEncryptionStatusWithContext:otrContext];
 		}
 	}];
 }
@@ -974,132 +2492,461 @@ static OtrlMessageAppOps ui_ops = {
 		return nil;
 	}
 
-	const char *gpg_error_string = gcry_strerror(gpg_error);
-	const char *gpg_error_source = gcry_strsource(gpg_error);
+	const char *gpg_error_string = gcry_strerror(gpg_error);
+	const char *gpg_error_source = gcry_strsource(gpg_error);
+
+	gpg_err_code_t gpg_error_code = gcry_err_code(gpg_error);
+
+	int errorCode = gcry_err_code_to_errno(gpg_error_code);
+
+	NSString *errorString = nil;
+	NSString *errorSource = nil;
+
+	if (gpg_error_string) {
+		errorString = @(gpg_error_string);
+	}
+
+	if (gpg_error_source) {
+		errorSource = @(gpg_error_source);
+	}
+
+	NSMutableString *errorDescription = [NSMutableString string];
+
+	if (errorString) {
+		[errorDescription appendString:errorString];
+	}
+
+	if (errorSource) {
+		[errorDescription appendString:@" - "];
+		[errorDescription appendString:errorSource];
+	}
+
+	NSError *error = [NSError errorWithDomain:kOTRKitErrorDomain
+										 code:errorCode
+									 userInfo:@{NSLocalizedDescriptionKey : errorDescription}];
+
+	return error;
+}
+
+#pragma mark -
+#pragma mark TLV
+
+- (OtrlTLV *)_tlvChainForTLVs:(NSArray<OTRTLV *> *)tlvs
+{
+	if (tlvs == nil || [tlvs count] == 0) {
+		return NULL;
+	}
+
+	OtrlTLV *root_tlv = NULL;
+	OtrlTLV *current_tlv = NULL;
+
+	NSUInteger validTLVCount = 0;
+
+	for (OTRTLV *tlv in tlvs) {
+		if ([tlv isValidLength] == NO) {
+			continue;
+		}
+
+		OtrlTLV *new_tlv = otrl_tlv_new([tlv type], [[tlv data] length], [[tlv data] bytes]);
+
+		if (validTLVCount == 0) {
+			root_tlv = new_tlv;
+		} else {
+			current_tlv->next = new_tlv;
+		}
+
+		current_tlv = new_tlv;
+
+		validTLVCount++;
+	}
+
+	return root_tlv;
+}
+
+- (NSArray<OTRTLV *> *)_tlvArrayForTLVChain:(OtrlTLV *)tlv_chain
+{
+	if (tlv_chain == NULL) {
+		return nil;
+	}
+
+	NSMutableArray *tlvArray = [NSMutableArray array];
+
+	OtrlTLV *current_tlv = tlv_chain;
+
+	while (current_tlv) {
+		NSData *tlvData = [NSData dataWithBytes:current_tlv->data length:current_tlv->len];
+
+		OTRTLVType type = current_tlv->type;
+
+		OTRTLV *tlv = [[OTRTLV alloc] initWithType:type data:tlvData];
+
+		[tlvArray addObject:tlv];
+
+		current_tlv = current_tlv->next;
+	}
+
+	return [tlvArray copy];
+}
+
+#pragma mark -
+#pragma mark Context
+
+- (ConnContext *)_contextForUsername:(NSString *)username accountName:(NSString *)accountName protocol:(NSString *)protocol
+{
+	OTRKitEngine *engine = [self _engineForAccountName:accountName protocol:protocol];
+
+	ConnContext *masterContext = [engine masterContextForUsername:username accountName:accountName protocol:protocol];
+
+	if (masterContext == NULL) {
+		return NULL;
+	}
+
+	/* Equivalent to otrl_context_find() with OTRL_INSTAG_BEST */
+	return otrl_context_find_recent_secure_instance(masterContext);
+}
+
+- (ConnContext *)_contextForConversation:(OTRKitConversation *)conversation
+{
+	OTRKitEngine *engine = [self _engineForConversation:conversation];
+
+	ConnContext *masterContext = [engine masterContextForConversation:conversation];
+
+	if (masterContext == NULL) {
+		return NULL;
+	}
+
+	return otrl_context_find_recent_secure_instance(masterContext);
+}
+
+- (BOOL)isGeneratingKeyForAccountName:(NSString *)accountName protocol:(NSString *)protocol
+{
+	OTRKitKeyGenerationJob *job = [self keyGenerationJobForAccountName:accountName protocol:protocol];
+
+	return [job isActive];
+}
+
+- (OTRKitKeyGenerationJob *)keyGenerationJobForAccountName:(NSString *)accountName protocol:(NSString *)protocol
+{
+	AssertParamaterLength(accountName)
+	AssertParamaterLength(protocol)
+
+	OTRKitAccount *account = [[OTRKitAccount alloc] initWithAccountName:accountName protocol:protocol];
+
+	@synchronized (self.keyGenerationJobTable) {
+		return self.keyGenerationJobTable[account];
+	}
+}
+
+- (NSArray<OTRKitKeyGenerationJob *> *)keyGenerationJobs
+{
+	@synchronized (self.keyGenerationJobTable) {
+		return [self.keyGenerationJobTable allValues];
+	}
+}
+
+- (void)_setKeyGenerationState:(OTRKitKeyGenerationState)state error:(NSError *)error forAccount:(OTRKitAccount *)account
+{
+	OTRKitKeyGenerationJob *job = nil;
+
+	@synchronized (self.keyGenerationJobTable) {
+		OTRKitKeyGenerationJob *jobPrevious = self.keyGenerationJobTable[account];
+
+		/* A job that ended is replaced by a new one when the key is generated again */
+		if (state == OTRKitKeyGenerationStateQueued || jobPrevious == nil) {
+			job = [[OTRKitKeyGenerationJob alloc] initWithAccountName:[account accountName] protocol:[account protocol]];
+
+			if (state != OTRKitKeyGenerationStateQueued) {
+				job = [job jobWithState:state error:error];
+			}
+		} else {
+			job = [jobPrevious jobWithState:state error:error];
+		}
+
+		self.keyGenerationJobTable[account] = job;
+	}
+
+	[self _performAsyncOperationOnDelegateQueue:^{
+		[[NSNotificationCenter defaultCenter] postNotificationName:OTRKitKeyGenerationJobDidChangeNotification
+															object:self
+														  userInfo:@{OTRKitKeyGenerationJobKey : job}];
+	}];
+}
+
+- (void)pregenerateKeysForAccounts:(NSArray<OTRKitAccount *> *)accounts completion:(void (^)(NSError *error))completion
+{
+	AssertParamaterNil(accounts)
+
+	/* Accounts are grouped by the engine that owns their user state */
+	NSMapTable<OTRKitEngine *, NSMutableArray<OTRKitAccount *> *> *engineAccounts = [NSMapTable strongToStrongObjectsMapTable];
+
+	for (OTRKitAccount *account in [NSOrderedSet orderedSetWithArray:accounts]) {
+		OTRKitEngine *engine = [self _engineForAccountName:[account accountName] protocol:[account protocol]];
+
+		NSMutableArray *accountsOfEngine = [engineAccounts objectForKey:engine];
+
+		if (accountsOfEngine == nil) {
+			accountsOfEngine = [NSMutableArray array];
+
+			[engineAccounts setObject:accountsOfEngine forKey:engine];
+		}
+
+		[accountsOfEngine addObject:account];
+	}
+
+	NSMutableArray<OTRKitPendingPrivateKey *> *pendingKeys = [NSMutableArray array];
+
+	__block NSError *startError = nil;
+
+	dispatch_group_t startGroup = dispatch_group_create();
 
-	gpg_err_code_t gpg_error_code = gcry_err_code(gpg_error);
+	for (OTRKitEngine *engine in engineAccounts) {
+		NSArray *accountsOfEngine = [engineAccounts objectForKey:engine];
 
-	int errorCode = gcry_err_code_to_errno(gpg_error_code);
+		dispatch_group_enter(startGroup);
 
-	NSString *errorString = nil;
-	NSString *errorSource = nil;
+		[engine performAsyncOperation:^{
+			NSError *startErrorOfEngine = nil;
 
-	if (gpg_error_string) {
-		errorString = @(gpg_error_string);
-	}
+			NSArray *pendingKeysOfEngine = [self _startGeneratingPrivateKeysForAccounts:accountsOfEngine engine:engine error:&startErrorOfEngine];
 
-	if (gpg_error_source) {
-		errorSource = @(gpg_error_source);
-	}
+			@synchronized (pendingKeys) {
+				[pendingKeys addObjectsFromArray:pendingKeysOfEngine];
 
-	NSMutableString *errorDescription = [NSMutableString string];
+				if (startError == nil) {
+					startError = startErrorOfEngine;
+				}
+			}
 
-	if (errorString) {
-		[errorDescription appendString:errorString];
+			dispatch_group_leave(startGroup);
+		}];
 	}
 
-	if (errorSource) {
-		[errorDescription appendString:@" - "];
-		[errorDescription appendString:errorSource];
-	}
+	/* Every key is started before any is calculated so that
+	 the calculations can be spread over every core at once. */
+	dispatch_group_notify(startGroup, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+		void (^calculateCompletion)(NSError *error) = completion;
 
-	NSError *error = [NSError errorWithDomain:kOTRKitErrorDomain
-										 code:errorCode
-									 userInfo:@{NSLocalizedDescriptionKey : errorDescription}];
+		/* Keys that could not be started are not part of the calculation */
+		if (completion && startError) {
+			calculateCompletion = ^(NSError *error) {
+				completion((error) ? error : startError);
+			};
+		}
 
-	return error;
+		[self _calculatePrivateKeys:pendingKeys completion:calculateCompletion];
+	});
 }
 
-#pragma mark -
-#pragma mark TLV
-
-- (OtrlTLV *)_tlvChainForTLVs:(NSArray<OTRTLV *> *)tlvs
+- (void)_generatePrivateKeyForAccountName:(NSString *)accountName protocol:(NSString *)protocol engine:(OTRKitEngine *)engine
 {
-	if (tlvs == nil || [tlvs count] == 0) {
-		return NULL;
+	OTRKitAccount *account = [[OTRKitAccount alloc] initWithAccountName:accountName protocol:protocol];
+
+	NSArray *pendingKeys = [self _startGeneratingPrivateKeysForAccounts:@[account] engine:engine error:NULL];
+
+	if ([pendingKeys count] == 0) {
+		return;
 	}
 
-	OtrlTLV *root_tlv = NULL;
-	OtrlTLV *current_tlv = NULL;
+	dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+		[self _calculatePrivateKeys:pendingKeys completion:nil];
+	});
+}
 
-	NSUInteger validTLVCount = 0;
+- (NSArray<OTRKitPendingPrivateKey *> *)_startGeneratingPrivateKeysForAccounts:(NSArray<OTRKitAccount *> *)accounts engine:(OTRKitEngine *)engine error:(NSError **)startError
+{
+	NSMutableArray *pendingKeys = [NSMutableArray arrayWithCapacity:[accounts count]];
 
-	for (OTRTLV *tlv in tlvs) {
-		if ([tlv isValidLength] == NO) {
+	for (OTRKitAccount *account in accounts) {
+		NSString *accountName = [account accountName];
+		NSString *protocol = [account protocol];
+
+		if ([engine isGeneratingKeyForAccountName:accountName protocol:protocol] ||
+			otrl_privkey_find([engine userState], [accountName UTF8String], [protocol UTF8String]))
+		{
 			continue;
 		}
 
-		OtrlTLV *new_tlv = otrl_tlv_new([tlv type], [[tlv data] length], [[tlv data] bytes]);
+		uint64_t enqueueTime = OTRKitMetricsNow();
 
-		if (validTLVCount == 0) {
-			root_tlv = new_tlv;
-		} else {
-			current_tlv->next = new_tlv;
+		void *otrKey = NULL;
+
+		gcry_error_t generateError = otrl_privkey_generate_start([engine userState], [accountName UTF8String], [protocol UTF8String], &otrKey);
+
+		/* A key that could not be started was never begun on the
+		 engine so there is nothing held for it to finish. */
+		if (generateError != gcry_error(GPG_ERR_NO_ERROR)) {
+			NSError *error = [self _errorForGPGError:generateError];
+
+			if (startError && *startError == nil) {
+				*startError = error;
+			}
+
+			[self _setKeyGenerationState:OTRKitKeyGenerationStateFailed error:error forAccount:account];
+
+			[self _performAsyncOperationOnDelegateQueue:^{
+				[[self delegate] otrKit:self didFinishGeneratingPrivateKeyForAccountName:accountName protocol:protocol error:error];
+			}];
+
+			continue;
 		}
 
-		current_tlv = new_tlv;
+		/* Inform delegate of intent to create key */
+		[self _performAsyncOperationOnDelegateQueue:^{
+			[[self delegate] otrKit:self willStartGeneratingPrivateKeyForAccountName:accountName protocol:protocol];
+		}];
 
-		validTLVCount++;
+		OTRKitPendingPrivateKey *pendingKey = [OTRKitPendingPrivateKey new];
+
+		[pendingKey setEngine:engine];
+
+		[pendingKey setAccount:account];
+
+		[pendingKey setEnqueueTime:enqueueTime];
+
+		[pendingKey setOtrKey:otrKey];
+
+		[engine beginGeneratingKeyForAccountName:accountName protocol:protocol];
+
+		[self _setKeyGenerationState:OTRKitKeyGenerationStateQueued error:nil forAccount:account];
+
+		[pendingKeys addObject:pendingKey];
 	}
 
-	return root_tlv;
+	return [pendingKeys copy];
 }
 
-- (NSArray<OTRTLV *> *)_tlvArrayForTLVChain:(OtrlTLV *)tlv_chain
+- (void)_calculatePrivateKeys:(NSArray<OTRKitPendingPrivateKey *> *)pendingKeys completion:(void (^)(NSError *error))completion
 {
-	if (tlv_chain == NULL) {
-		return nil;
-	}
+	/* The calculation only touches the pending key, not the user state,
+	 so it is safe to perform away from the internal queue. dispatch_apply()
+	 runs as many calculations at once as there are processor cores. */
+	dispatch_apply([pendingKeys count], dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t keyIndex) {
+		OTRKitPendingPrivateKey *pendingKey = pendingKeys[keyIndex];
 
-	NSMutableArray *tlvArray = [NSMutableArray array];
+		void *otrKey = [pendingKey otrKey];
 
-	OtrlTLV *current_tlv = tlv_chain;
+		if (otrKey) {
+			[self _setKeyGenerationState:OTRKitKeyGenerationStateRunning error:nil forAccount:[pendingKey account]];
 
-	while (current_tlv) {
-		NSData *tlvData = [NSData dataWithBytes:current_tlv->data length:current_tlv->len];
+			uint64_t calculateStart = OTRKitMetricsNow();
 
-		OTRTLVType type = current_tlv->type;
+			otrl_privkey_generate_calculate(otrKey);
 
-		OTRTLV *tlv = [[OTRTLV alloc] initWithType:type data:tlvData];
+			OTRKitMetricsRecordOperation([[pendingKey engine] metricsCounters], OTRKitMetricsOperationKeyGeneration, (OTRKitMetricsNow() - calculateStart), (calculateStart - [pendingKey enqueueTime]));
+		}
+	});
 
-		[tlvArray addObject:tlv];
+	NSMapTable<OTRKitEngine *, NSMutableArray<OTRKitPendingPrivateKey *> *> *enginePendingKeys = [NSMapTable strongToStrongObjectsMapTable];
 
-		current_tlv = current_tlv->next;
+	for (OTRKitPendingPrivateKey *pendingKey in pendingKeys) {
+		NSMutableArray *pendingKeysOfEngine = [enginePendingKeys objectForKey:[pendingKey engine]];
+
+		if (pendingKeysOfEngine == nil) {
+			pendingKeysOfEngine = [NSMutableArray array];
+
+			[enginePendingKeys setObject:pendingKeysOfEngine forKey:[pendingKey engine]];
+		}
+
+		[pendingKeysOfEngine addObject:pendingKey];
 	}
 
-	return [tlvArray copy];
-}
+	dispatch_group_t finishGroup = dispatch_group_create();
 
-#pragma mark -
-#pragma mark Context
+	for (OTRKitEngine *engine in enginePendingKeys) {
+		NSArray *pendingKeysOfEngine = [enginePendingKeys objectForKey:engine];
 
-- (ConnContext *)_contextForUsername:(NSString *)username accountName:(NSString *)accountName protocol:(NSString *)protocol
-{
-	ConnContext *context = otrl_context_find(self.userState, [username UTF8String], [accountName UTF8String], [protocol UTF8String], OTRL_INSTAG_BEST, NO, NULL, NULL, NULL);
+		dispatch_group_enter(finishGroup);
+
+		[engine performAsyncOperation:^{
+			[self _finishGeneratingPrivateKeys:pendingKeysOfEngine engine:engine];
+
+			dispatch_group_leave(finishGroup);
+		}];
+	}
+
+	if (completion == nil) {
+		return;
+	}
 
-	return context;
+	dispatch_group_notify(finishGroup, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+		NSError *error = nil;
+
+		for (OTRKitPendingPrivateKey *pendingKey in pendingKeys) {
+			if ([pendingKey error]) {
+				error = [pendingKey error];
+
+				break;
+			}
+		}
+
+		[self _performAsyncOperationOnDelegateQueue:^{
+			completion(error);
+		}];
+	});
 }
 
-- (BOOL)isGeneratingKeyForAccountName:(NSString *)accountName protocol:(NSString *)protocol
+- (void)_finishGeneratingPrivateKeys:(NSArray<OTRKitPendingPrivateKey *> *)pendingKeys engine:(OTRKitEngine *)engine
 {
-	AssertParamaterLength(accountName)
-	AssertParamaterLength(protocol)
+	/* libotr writes and reads back every key it knows each time a key
+	 is finished. Each key is inserted into the user state on its own
+	 and the keys are serialized once after the last of them. */
+	NSMutableArray<OTRKitAccount *> *finishedAccounts = [NSMutableArray array];
+
+	for (OTRKitPendingPrivateKey *pendingKey in pendingKeys) {
+		void *otrKey = [pendingKey otrKey];
+
+		if (otrKey == NULL) {
+			continue;
+		}
 
-	__block BOOL generatingKey = NO;
+		[pendingKey setOtrKey:NULL];
 
-	[self _performSyncOperationOnInternalQueue:^{
-		void *otrKey;
+		gcry_error_t finishError = OTRKitStorageFinishGeneratingPrivateKey([engine userState], otrKey);
 
-		gcry_error_t otrError = otrl_privkey_generate_start(self.userState, [accountName UTF8String], [protocol UTF8String], &otrKey);
+		if (finishError == gcry_error(GPG_ERR_NO_ERROR)) {
+			[finishedAccounts addObject:[pendingKey account]];
+		} else {
+			[pendingKey setError:[self _errorForGPGError:finishError]];
+		}
+	}
+
+	NSError *writeError = nil;
 
-		if (otrError == 0) {
-			otrl_privkey_generate_cancelled(self.userState, otrKey);
+	if ([finishedAccounts count] > 0) {
+		NSData *privateKeysData = OTRKitStoragePrivateKeysFileData([engine userState]);
+
+		if (privateKeysData) {
+			writeError = [self _writePrivateKeysData:privateKeysData forAccounts:finishedAccounts engine:engine];
+		} else {
+			writeError = [self _errorForGPGError:gcry_error(GPG_ERR_ENOMEM)];
 		}
+	}
 
-		generatingKey = (otrError == gcry_error(GPG_ERR_EEXIST));
-	}];
+	for (OTRKitPendingPrivateKey *pendingKey in pendingKeys) {
+		if ([pendingKey error] == nil) {
+			[pendingKey setError:writeError];
+		}
+
+		NSString *accountName = [[pendingKey account] accountName];
+		NSString *protocol = [[pendingKey account] protocol];
+
+		NSError *error = [pendingKey error];
+
+		if (error) {
+			[self _setKeyGenerationState:OTRKitKeyGenerationStateFailed error:error forAccount:[pendingKey account]];
+		} else {
+			[self _setKeyGenerationState:OTRKitKeyGenerationStateFinished error:nil forAccount:[pendingKey account]];
+		}
+
+		[self _performAsyncOperationOnDelegateQueue:^{
+			[[self delegate] otrKit:self didFinishGeneratingPrivateKeyForAccountName:accountName protocol:protocol error:error];
+		}];
 
-	return generatingKey;
+		/* Held messages are processed even if the key could not be
+		 generated so that they are not held forever. libotr will
+		 ask for the key again when it needs it. */
+		[engine finishGeneratingKeyForAccountName:accountName protocol:protocol];
+	}
 }
 
 #pragma mark -
@@ -1137,14 +2984,21 @@ static OtrlMessageAppOps ui_ops = {
 								  accountName:(NSString *)accountName
 									 protocol:(NSString *)protocol
 {
-	AssertParamaterLength(username)
-	AssertParamaterLength(accountName)
-	AssertParamaterLength(protocol)
+	OTRKitConversation *conversation = [self conversationForUsername:username accountName:accountName protocol:protocol];
+
+	return [self messageStateForConversation:conversation];
+}
+
+- (OTRKitMessageState)messageStateForConversation:(OTRKitConversation *)conversation
+{
+	AssertParamaterNil(conversation)
 
 	__block OTRKitMessageState messageState = OTRKitMessageStatePlaintext;
 
-	[self _performSyncOperationOnInternalQueue:^{
-		ConnContext *otrContext = [self _contextForUsername:username accountName:accountName protocol:protocol];
+	OTRKitEngine *engine = [self _engineForConversation:conversation];
+
+	[engine performSyncOperation:^{
+		ConnContext *otrContext = [self _contextForConversation:conversation];
 
 		messageState = [self _messageStateForContext:otrContext];
 	}];
@@ -1190,14 +3044,21 @@ static OtrlMessageAppOps ui_ops = {
 							  accountName:(NSString *)accountName
 								 protocol:(NSString *)protocol
 {
-	AssertParamaterLength(username)
-	AssertParamaterLength(accountName)
-	AssertParamaterLength(protocol)
+	OTRKitConversation *conversation = [self conversationForUsername:username accountName:accountName protocol:protocol];
+
+	return [self offerStateForConversation:conversation];
+}
+
+- (OTRKitOfferState)offerStateForConversation:(OTRKitConversation *)conversation
+{
+	AssertParamaterNil(conversation)
 
 	__block OTRKitOfferState offerState = OTRKitOfferStateNone;
 
-	[self _performSyncOperationOnInternalQueue:^{
-		ConnContext *otrContext = [self _contextForUsername:username accountName:accountName protocol:protocol];
+	OTRKitEngine *engine = [self _engineForConversation:conversation];
+
+	[engine performSyncOperation:^{
+		ConnContext *otrContext = [self _contextForConversation:conversation];
 
 		offerState = [self _offerStateForContext:otrContext];
 	}];
@@ -1209,82 +3070,7 @@ static OtrlMessageAppOps ui_ops = {
 {
 	AssertParamaterLength(message)
 
-	__block OTRKitMessageType messageType = OTRKitMessageTypeUnknown;
-
-	[self _performSyncOperationOnInternalQueue:^{
-		OtrlMessageType otrMessageType = otrl_proto_message_type([message UTF8String]);
-
-		switch (otrMessageType) {
-			case OTRL_MSGTYPE_NOTOTR:
-			{
-				messageType = OTRKitMessageTypeNotOTR;
-
-				break;
-			}
-			case OTRL_MSGTYPE_TAGGEDPLAINTEXT:
-			{
-				messageType = OTRKitMessageTypeTaggedPlainText;
-
-				break;
-			}
-			case OTRL_MSGTYPE_QUERY:
-			{
-				messageType = OTRKitMessageTypeQuery;
-
-				break;
-			}
-			case OTRL_MSGTYPE_DH_COMMIT:
-			{
-				messageType = OTRKitMessageTypeDHCommit;
-
-				break;
-			}
-			case OTRL_MSGTYPE_DH_KEY:
-			{
-				messageType = OTRKitMessageTypeDHKey;
-
-				break;
-			}
-			case OTRL_MSGTYPE_REVEALSIG:
-			{
-				messageType = OTRKitMessageTypeRevealSignature;
-
-				break;
-			}
-			case OTRL_MSGTYPE_SIGNATURE:
-			{
-				messageType = OTRKitMessageTypeSignature;
-
-				break;
-			}
-			case OTRL_MSGTYPE_V1_KEYEXCH:
-			{
-				messageType = OTRKitMessageTypeV1KeyExchange;
-
-				break;
-			}
-			case OTRL_MSGTYPE_DATA:
-			{
-				messageType = OTRKitMessageTypeData;
-
-				break;
-			}
-			case OTRL_MSGTYPE_ERROR:
-			{
-				messageType = OTRKitMessageTypeError;
-
-				break;
-			}
-			case OTRL_MSGTYPE_UNKNOWN:
-			{
-				messageType = OTRKitMessageTypeUnknown;
-				
-				break;
-			}
-		}
-	}];
-
-	return messageType;
+	return OTRKitMessageTypeForString(message);
 }
 
 #pragma mark -
@@ -1331,97 +3117,173 @@ static OtrlMessageAppOps ui_ops = {
 
 - (NSString *)privateKeyPath
 {
-	return [self.dataPath stringByAppendingPathComponent:kOTRKitPrivateKeyFileName];
+	return [self.defaultEngine privateKeyPath];
 }
 
 - (NSString *)fingerprintsPath
 {
-	return [self.dataPath stringByAppendingPathComponent:kOTRKitFingerprintsFileName];
+	return [self.defaultEngine fingerprintsPath];
 }
 
 - (NSString *)instanceTagsPath
 {
-	return [self.dataPath stringByAppendingPathComponent:kOTRKitInstanceTagsFileName];
+	return [self.defaultEngine instanceTagsPath];
 }
 
 #pragma mark
 #pragma mark Fingerprint Management
 
-- (Fingerprint *)_fingerprintForUsername:(NSString *)username accountName:(NSString *)accountName protocol:(NSString *)protocol
-{
-	Fingerprint *otrFingerprint = NULL;
+- (Fingerprint *)_fingerprintForUsername:(NSString *)username accountName:(NSString *)accountName protocol:(NSString *)protocol
+{
+	Fingerprint *otrFingerprint = NULL;
+
+	ConnContext *otrContext = [self _contextForUsername:username accountName:accountName protocol:protocol];
+
+	if (otrContext) {
+		otrFingerprint = otrContext->active_fingerprint;
+	}
+
+	return otrFingerprint;
+}
+
+- (Fingerprint *)_fingerprintForConversation:(OTRKitConversation *)conversation
+{
+	Fingerprint *otrFingerprint = NULL;
+
+	ConnContext *otrContext = [self _contextForConversation:conversation];
+
+	if (otrContext) {
+		otrFingerprint = otrContext->active_fingerprint;
+	}
+
+	return otrFingerprint;
+}
+
+- (NSString *)_fingerprintStringFromFingerprint:(Fingerprint *)otrFingerprint
+{
+	char fingerprintHash[OTRL_PRIVKEY_FPRINT_HUMAN_LEN];
+
+	if (otrFingerprint && otrFingerprint->fingerprint) {
+		otrl_privkey_hash_to_human(fingerprintHash, otrFingerprint->fingerprint);
+
+		return @(fingerprintHash);
+	}
+
+	return nil;
+}
+
+- (NSArray *)requestAllFingerprints
+{
+	NSMutableArray *fingerprintsArray = [NSMutableArray array];
+
+	for (OTRKitEngine *engine in [self _allEngines]) {
+		[engine performSyncOperation:^{
+			[self _addFingerprintsOfEngine:engine toArray:fingerprintsArray];
+		}];
+	}
+
+	return [fingerprintsArray copy];
+}
+
+- (void)_addFingerprintsOfEngine:(OTRKitEngine *)engine toArray:(NSMutableArray *)fingerprintsArray
+{
+	ConnContext *otrContext = engine.userState->context_root;
+
+	while (otrContext) {
+		Fingerprint *otrFingerprint = otrContext->fingerprint_root.next;
+
+		while (otrFingerprint) {
+			/* Gather information about the current fingerprint. */
+			NSString *fingerprintString = [self _fingerprintStringFromFingerprint:otrFingerprint];
+
+			NSString *username = @(otrContext->username);
+			NSString *accountName = @(otrContext->accountname);
+
+			NSString *protocol = @(otrContext->protocol);
+
+			BOOL isTrusted = (otrl_context_is_fingerprint_trusted(otrFingerprint) == true);
+
+			/* Build a concrete object around the information gathered */
+			OTRKitConcreteObject *resultObject = [OTRKitConcreteObject new];
 
-	ConnContext *otrContext = [self _contextForUsername:username accountName:accountName protocol:protocol];
+			[resultObject setUsername:username];
+			[resultObject setAccountName:accountName];
 
-	if (otrContext) {
-		otrFingerprint = otrContext->active_fingerprint;
-	}
+			[resultObject setProtocol:protocol];
 
-	return otrFingerprint;
-}
+			[resultObject setFingerprint:otrFingerprint];
+			[resultObject setFingerprintString:fingerprintString];
 
-- (NSString *)_fingerprintStringFromFingerprint:(Fingerprint *)otrFingerprint
-{
-	char fingerprintHash[OTRL_PRIVKEY_FPRINT_HUMAN_LEN];
+			[resultObject setFingerprintIsTrusted:isTrusted];
 
-	if (otrFingerprint && otrFingerprint->fingerprint) {
-		otrl_privkey_hash_to_human(fingerprintHash, otrFingerprint->fingerprint);
+			[fingerprintsArray addObject:resultObject];
 
-		return @(fingerprintHash);
+			/* Move on to the next fingerprint in the chain */
+			otrFingerprint = otrFingerprint->next;
+		}
+
+		otrContext = otrContext->next;
 	}
 
-	return nil;
-}
+	/* Peers that are not loaded yet are read from the index. Their concrete
+	 objects have no fingerprint reference which is looked up on use. */
+	OTRKitFingerprintIndex *fingerprintIndex = [engine fingerprintIndex];
 
-- (NSArray *)requestAllFingerprints
-{
-	__block NSArray *allFingerprints = nil;
+	[fingerprintIndex enumerateUnloadedFingerprintsUsingBlock:^(const char *username, const char *accountName, const char *protocol, const unsigned char *fingerprint, const char *trust) {
+		char fingerprintHash[OTRL_PRIVKEY_FPRINT_HUMAN_LEN];
 
-	[self _performSyncOperationOnInternalQueue:^{
-		NSMutableArray *fingerprintsArray = [NSMutableArray array];
+		otrl_privkey_hash_to_human(fingerprintHash, (unsigned char *)fingerprint);
 
-		ConnContext *otrContext = self.userState->context_root;
+		OTRKitConcreteObject *resultObject = [OTRKitConcreteObject new];
 
-		while (otrContext) {
-			Fingerprint *otrFingerprint = otrContext->fingerprint_root.next;
+		[resultObject setUsername:@(username)];
+		[resultObject setAccountName:@(accountName)];
 
-			while (otrFingerprint) {
-				/* Gather information about the current fingerprint. */
-				NSString *fingerprintString = [self _fingerprintStringFromFingerprint:otrFingerprint];
+		[resultObject setProtocol:@(protocol)];
 
-				NSString *username = @(otrContext->username);
-				NSString *accountName = @(otrContext->accountname);
+		[resultObject setFingerprintString:@(fingerprintHash)];
 
-				NSString *protocol = @(otrContext->protocol);
+		[resultObject setFingerprintIsTrusted:(trust && trust[0] != '\0')];
 
-				BOOL isTrusted = (otrl_context_is_fingerprint_trusted(otrFingerprint) == true);
+		[fingerprintsArray addObject:resultObject];
+	}];
+}
 
-				/* Build a concrete object around the information gathered */
-				OTRKitConcreteObject *resultObject = [OTRKitConcreteObject new];
+- (Fingerprint *)_fingerprintForConcreteObject:(OTRKitConcreteObject *)fingerprint
+{
+	Fingerprint *otrFingerprint = [fingerprint fingerprint];
 
-				[resultObject setUsername:username];
-				[resultObject setAccountName:accountName];
+	if (otrFingerprint) {
+		return otrFingerprint;
+	}
 
-				[resultObject setProtocol:protocol];
+	/* Looking up the context loads the peer if it is not loaded yet */
+	ConnContext *otrContext = [self _contextForUsername:[fingerprint username] accountName:[fingerprint accountName] protocol:[fingerprint protocol]];
 
-				[resultObject setFingerprint:otrFingerprint];
-				[resultObject setFingerprintString:fingerprintString];
+	if (otrContext == NULL) {
+		return NULL;
+	}
 
-				[resultObject setFingerprintIsTrusted:isTrusted];
+	return [self _fingerprintWithString:[fingerprint fingerprintString] inContext:otrContext];
+}
 
-				[fingerprintsArray addObject:resultObject];
+- (Fingerprint *)_fingerprintWithString:(NSString *)fingerprint inContext:(ConnContext *)otrContext
+{
+	Fingerprint *otrFingerprint = otrContext->m_context->fingerprint_root.next;
 
-				/* Move on to the next fingerprint in the chain */
-				otrFingerprint = otrFingerprint->next;
-			}
+	while (otrFingerprint) {
+		char fingerprintHash[OTRL_PRIVKEY_FPRINT_HUMAN_LEN];
+
+		otrl_privkey_hash_to_human(fingerprintHash, otrFingerprint->fingerprint);
 
-			otrContext = otrContext->next;
+		if ([@(fingerprintHash) isEqualToString:fingerprint]) {
+			return otrFingerprint;
 		}
 
-		allFingerprints = [fingerprintsArray copy];
-	}];
+		otrFingerprint = otrFingerprint->next;
+	}
 
-	return allFingerprints;
+	return NULL;
 }
 
 - (void)deleteFingerprint:(NSString *)fingerprint
@@ -1434,32 +3296,16 @@ static OtrlMessageAppOps ui_ops = {
 	AssertParamaterLength(accountName)
 	AssertParamaterLength(protocol)
 
-	[self _performAsyncOperationOnInternalQueue:^{
+	OTRKitEngine *engine = [self _engineForAccountName:accountName protocol:protocol];
+
+	[engine performAsyncOperation:^{
 		ConnContext *otrContext = [self _contextForUsername:username accountName:accountName protocol:protocol];
 
 		if (otrContext == NULL) {
 			return;
 		}
 
-		Fingerprint *otrFingerprint = NULL;
-
-		Fingerprint *otrFingerprintCurrent = otrContext->fingerprint_root.next;
-
-		while (otrFingerprintCurrent) {
-			char fingerprintHash[OTRL_PRIVKEY_FPRINT_HUMAN_LEN];
-
-			otrl_privkey_hash_to_human(fingerprintHash, otrFingerprintCurrent->fingerprint);
-
-			NSString *fingerprintCurrent = @(fingerprintHash);
-
-			if ([fingerprintCurrent isEqualToString:fingerprint]) {
-				otrFingerprint = otrFingerprintCurrent;
-
-				break;
-			} else {
-				otrFingerprintCurrent = otrFingerprintCurrent->next;
-			}
-		}
+		Fingerprint *otrFingerprint = [self _fingerprintWithString:fingerprint inContext:otrContext];
 
 		if (otrFingerprint) {
 			[self _deleteFingerprint:otrFingerprint username:username accountName:accountName protocol:protocol];
@@ -1471,8 +3317,14 @@ static OtrlMessageAppOps ui_ops = {
 {
 	AssertParamaterNil(fingerprint)
 
-	[self _performAsyncOperationOnInternalQueue:^{
-		[self _deleteFingerprint:[fingerprint fingerprint] username:[fingerprint username] accountName:[fingerprint accountName] protocol:[fingerprint protocol]];
+	OTRKitEngine *engine = [self _engineForAccountName:[fingerprint accountName] protocol:[fingerprint protocol]];
+
+	[engine performAsyncOperation:^{
+		Fingerprint *otrFingerprint = [self _fingerprintForConcreteObject:fingerprint];
+
+		if (otrFingerprint) {
+			[self _deleteFingerprint:otrFingerprint username:[fingerprint username] accountName:[fingerprint accountName] protocol:[fingerprint protocol]];
+		}
 	}];
 }
 
@@ -1496,9 +3348,15 @@ static OtrlMessageAppOps ui_ops = {
 - (void)_deleteFingerprint:(Fingerprint *)otrFingerprint
 {
 	if (otrFingerprint) {
+		OTRKitEngine *engine = [self _engineForContext:otrFingerprint->context];
+
+		[[engine fingerprintsWriter] appendJournalOperation:OTRKitFingerprintsJournalOperationForget forFingerprint:otrFingerprint];
+
 		otrl_context_forget_fingerprint(otrFingerprint, 0);
 
-		[self _writeFingerprintsPath];
+		OTRKitMetricsFingerprintCountDidChange([engine metricsCounters], -1);
+
+		[self _postFingerprintsDidChangeNotification];
 	}
 }
 
@@ -1510,10 +3368,12 @@ static OtrlMessageAppOps ui_ops = {
 
 	__block NSString *fingerprintString = nil;
 
-	[self _performSyncOperationOnInternalQueue:^{
+	OTRKitEngine *engine = [self _engineForAccountName:accountName protocol:protocol];
+
+	[engine performSyncOperation:^{
 		char fingerprintHash[OTRL_PRIVKEY_FPRINT_HUMAN_LEN];
 
-		otrl_privkey_fingerprint(self.userState, fingerprintHash, [accountName UTF8String], [protocol UTF8String]);
+		otrl_privkey_fingerprint(engine.userState, fingerprintHash, [accountName UTF8String], [protocol UTF8String]);
 
 		fingerprintString = @(fingerprintHash);
 	}];
@@ -1525,14 +3385,21 @@ static OtrlMessageAppOps ui_ops = {
 							   accountName:(NSString *)accountName
 								  protocol:(NSString *)protocol
 {
-	AssertParamaterLength(username)
-	AssertParamaterLength(accountName)
-	AssertParamaterLength(protocol)
+	OTRKitConversation *conversation = [self conversationForUsername:username accountName:accountName protocol:protocol];
+
+	return [self activeFingerprintForConversation:conversation];
+}
+
+- (NSString *)activeFingerprintForConversation:(OTRKitConversation *)conversation
+{
+	AssertParamaterNil(conversation)
 
 	__block NSString *fingerprintString = nil;
 
-	[self _performSyncOperationOnInternalQueue:^{
-		Fingerprint *otrFingerprint = [self _fingerprintForUsername:username accountName:accountName protocol:protocol];
+	OTRKitEngine *engine = [self _engineForConversation:conversation];
+
+	[engine performSyncOperation:^{
+		Fingerprint *otrFingerprint = [self _fingerprintForConversation:conversation];
 
 		if (otrFingerprint) {
 			fingerprintString = [self _fingerprintStringFromFingerprint:otrFingerprint];
@@ -1546,14 +3413,21 @@ static OtrlMessageAppOps ui_ops = {
 								   accountName:(NSString *)accountName
 									  protocol:(NSString *)protocol
 {
-	AssertParamaterLength(username)
-	AssertParamaterLength(accountName)
-	AssertParamaterLength(protocol)
+	OTRKitConversation *conversation = [self conversationForUsername:username accountName:accountName protocol:protocol];
+
+	return [self activeFingerprintIsVerifiedForConversation:conversation];
+}
+
+- (BOOL)activeFingerprintIsVerifiedForConversation:(OTRKitConversation *)conversation
+{
+	AssertParamaterNil(conversation)
 
 	__block BOOL verified = NO;
 
-	[self _performSyncOperationOnInternalQueue:^{
-		Fingerprint *otrFingerprint = [self _fingerprintForUsername:username accountName:accountName protocol:protocol];
+	OTRKitEngine *engine = [self _engineForConversation:conversation];
+
+	[engine performSyncOperation:^{
+		Fingerprint *otrFingerprint = [self _fingerprintForConversation:conversation];
 
 		if (otrFingerprint && otrFingerprint->trust) {
 			if (otrl_context_is_fingerprint_trusted(otrFingerprint) == true) {
@@ -1570,12 +3444,23 @@ static OtrlMessageAppOps ui_ops = {
 										   protocol:(NSString *)protocol
 										   verified:(BOOL)verified
 {
-	AssertParamaterLength(username)
-	AssertParamaterLength(accountName)
-	AssertParamaterLength(protocol)
+	OTRKitConversation *conversation = [self conversationForUsername:username accountName:accountName protocol:protocol];
+
+	[self setActiveFingerprintVerificationForConversation:conversation verified:verified];
+}
+
+- (void)setActiveFingerprintVerificationForConversation:(OTRKitConversation *)conversation verified:(BOOL)verified
+{
+	AssertParamaterNil(conversation)
+
+	NSString *username = [conversation username];
+	NSString *accountName = [conversation accountName];
+	NSString *protocol = [conversation protocol];
+
+	OTRKitEngine *engine = [self _engineForConversation:conversation];
 
-	[self _performAsyncOperationOnInternalQueue:^{
-		Fingerprint *otrFingerprint = [self _fingerprintForUsername:username accountName:accountName protocol:protocol];
+	[engine performAsyncOperation:^{
+		Fingerprint *otrFingerprint = [self _fingerprintForConversation:conversation];
 
 		if (otrFingerprint) {
 			[self _setVerificationForFingerprint:otrFingerprint verified:verified];
@@ -1589,8 +3474,10 @@ static OtrlMessageAppOps ui_ops = {
 {
 	AssertParamaterNil(fingerprint)
 
-	[self _performAsyncOperationOnInternalQueue:^{
-		Fingerprint *otrFingerprint = [fingerprint fingerprint];
+	OTRKitEngine *engine = [self _engineForAccountName:[fingerprint accountName] protocol:[fingerprint protocol]];
+
+	[engine performAsyncOperation:^{
+		Fingerprint *otrFingerprint = [self _fingerprintForConcreteObject:fingerprint];
 
 		if (otrFingerprint) {
 			/* Set the fingerprint on our reference fingerprint */
@@ -1616,54 +3503,229 @@ static OtrlMessageAppOps ui_ops = {
 
 	otrl_context_set_trust(otrFingerprint, newTrust);
 
-	[self _writeFingerprintsPath];
+	OTRKitEngine *engine = [self _engineForContext:otrFingerprint->context];
+
+	[[engine fingerprintsWriter] appendJournalOperation:OTRKitFingerprintsJournalOperationTrust forFingerprint:otrFingerprint];
+
+	[self _postFingerprintsDidChangeNotification];
 }
 
 #pragma mark -
 #pragma mark Read Data and Write Data
 
-- (void)_readPrivateKeyPath
+- (void)_readPrivateKeyPath:(NSString *)path forEngine:(OTRKitEngine *)engine
 {
-	NSString *path = self.privateKeyPath;
+	if (path == nil) {
+		return;
+	}
 
 	FILE *filePointer = fopen([path UTF8String], "rb");
 
 	if (filePointer) {
-		otrl_privkey_read_FILEp(self.userState, filePointer);
-	}
+		otrl_privkey_read_FILEp(engine.userState, filePointer);
 
-	fclose(filePointer);
+		fclose(filePointer);
+	}
 }
 
-- (void)_readFingerprintsPath
+- (void)_readFingerprintsPath:(NSString *)path forEngine:(OTRKitEngine *)engine
 {
-	NSString *path = self.fingerprintsPath;
+	if (path == nil) {
+		return;
+	}
 
 	FILE *filePointer = fopen([path UTF8String], "rb");
 
 	if (filePointer) {
-		otrl_privkey_read_fingerprints_FILEp(self.userState, filePointer, NULL, NULL);
+		otrl_privkey_read_fingerprints_FILEp(engine.userState, filePointer, NULL, NULL);
+
+		fclose(filePointer);
 	}
+}
 
-	fclose(filePointer);
+- (void)_replayFingerprintsJournalForPath:(NSString *)path forEngine:(OTRKitEngine *)engine
+{
+	if (path == nil) {
+		return;
+	}
+
+	OtrlUserState userState = engine.userState;
+
+	OTRKitFingerprintsJournalPeerBlock peerBlock = nil;
+
+	/* A peer must be loaded before a change to it is replayed or
+	 loading the peer later would undo the change. */
+	if ([engine fingerprintIndex]) {
+		peerBlock = ^(const char *username, const char *accountName, const char *protocol) {
+			[engine loadFingerprintsForUsername:username accountName:accountName protocol:protocol];
+		};
+	}
+
+	/* Changes made since the fingerprints file was last written */
+	OTRKitFingerprintsJournalReplay(OTRKitFingerprintsJournalPath(path), userState, peerBlock);
 }
 
-- (void)_readInstanceTagsPath
+- (void)_readInstanceTagsPath:(NSString *)path forEngine:(OTRKitEngine *)engine
 {
-	NSString *path = self.instanceTagsPath;
+	if (path == nil) {
+		return;
+	}
 
 	FILE *filePointer = fopen([path UTF8String], "rb");
 
 	if (filePointer) {
-		otrl_instag_read_FILEp(self.userState, filePointer);
+		otrl_instag_read_FILEp(engine.userState, filePointer);
+
+		fclose(filePointer);
 	}
+}
 
-	fclose(filePointer);
+- (void)_writeFingerprintsPathForEngine:(OTRKitEngine *)engine
+{
+	[[engine fingerprintsWriter] setNeedsWrite];
+
+	[self _postFingerprintsDidChangeNotification];
+}
+
+- (void)_writeFingerprintsPathForEngine:(OTRKitEngine *)engine conversation:(OTRKitConversation *)conversation
+{
+	/* libotr does not say which fingerprints changed. When the conversation
+	 is known, its fingerprints are journaled instead of writing them all. */
+	ConnContext *otrContext = NULL;
+
+	if (conversation) {
+		otrContext = [engine masterContextForConversation:conversation];
+	}
+
+	if (otrContext == NULL) {
+		[self _writeFingerprintsPathForEngine:engine];
+
+		return;
+	}
+
+	Fingerprint *otrFingerprint = otrContext->fingerprint_root.next;
+
+	while (otrFingerprint) {
+		[[engine fingerprintsWriter] appendJournalOperation:OTRKitFingerprintsJournalOperationAdd forFingerprint:otrFingerprint];
+
+		otrFingerprint = otrFingerprint->next;
+	}
+
+	[self _postFingerprintsDidChangeNotification];
+}
+
+- (void)flushFingerprints
+{
+	for (OTRKitEngine *engine in [self _allEngines]) {
+		[[engine fingerprintsWriter] flush];
+	}
+}
+
+- (OTRKitWriteStatistics *)fingerprintsWriteStatistics
+{
+	OTRKitWriteStatistics *statistics = [OTRKitWriteStatistics new];
+
+	for (OTRKitEngine *engine in [self _allEngines]) {
+		[statistics addStatistics:[[engine fingerprintsWriter] statistics]];
+	}
+
+	return statistics;
+}
+
+- (FILE *)_openInstanceTagsForWritingForEngine:(OTRKitEngine *)engine
+{
+	/* libotr writes every instance tag it knows when a tag is generated.
+	 With a storage, only the new tag is kept which is done separately. */
+	if (self.storage) {
+		return OTRKitMemoryFileOpenForWriting([NSMutableData data]);
+	}
+
+	return fopen([[engine instanceTagsPath] UTF8String], "w+b");
+}
+
+- (NSError *)_writePrivateKeysData:(NSData *)privateKeysData forAccounts:(NSArray<OTRKitAccount *> *)accounts engine:(OTRKitEngine *)engine
+{
+	id<OTRKitStorage> storage = self.storage;
+
+	NSError *writeError = nil;
+
+	if (storage == nil) {
+		/* The key is never left half written */
+		[privateKeysData writeToFile:[engine privateKeyPath] options:NSDataWritingAtomic error:&writeError];
+
+		return writeError;
+	}
+
+	/* With a storage, only the keys that are new are written. */
+	NSMutableArray *records = [NSMutableArray arrayWithCapacity:[accounts count]];
+
+	for (OTRKitAccount *account in accounts) {
+		OtrlPrivKey *privateKey = otrl_privkey_find([engine userState], [[account accountName] UTF8String], [[account protocol] UTF8String]);
+
+		if (privateKey == NULL) {
+			continue;
+		}
+
+		OTRKitPrivateKeyRecord *record = OTRKitStoragePrivateKeyRecord(privateKey);
+
+		if (record == nil) {
+			LogToConsole(@"Failed to encode private key of '%@' for storage", [account accountName]);
+
+			continue;
+		}
+
+		[records addObject:record];
+	}
+
+	BOOL writeResult = [storage performTransaction:^(id<OTRKitStorageTransaction> transaction) {
+		for (OTRKitPrivateKeyRecord *record in records) {
+			[transaction setPrivateKey:record];
+		}
+	} error:&writeError];
+
+	if (writeResult == NO) {
+		LogToConsole(@"Failed to write private keys to storage: %@", [writeError localizedDescription]);
+
+		return writeError;
+	}
+
+	return nil;
+}
+
+- (void)_writeInstanceTagToStorageForAccountName:(const char *)accountname protocol:(const char *)protocol engine:(OTRKitEngine *)engine
+{
+	id<OTRKitStorage> storage = self.storage;
+
+	if (storage == nil) {
+		return;
+	}
+
+	OtrlInsTag *instanceTag = otrl_instag_find([engine userState], accountname, protocol);
+
+	if (instanceTag == NULL) {
+		return;
+	}
+
+	OTRKitInstanceTagRecord *record = OTRKitStorageInstanceTagRecord(instanceTag);
+
+	NSError *writeError = nil;
+
+	BOOL writeResult = [storage performTransaction:^(id<OTRKitStorageTransaction> transaction) {
+		[transaction setInstanceTag:record];
+	} error:&writeError];
+
+	if (writeResult == NO) {
+		LogToConsole(@"Failed to write instance tag of '%s' to storage: %@", accountname, [writeError localizedDescription]);
+	}
 }
 
-- (void)_writeFingerprintsPath
+- (void)_writeInstanceTagsPathForEngine:(OTRKitEngine *)engine
 {
-	NSString *path = self.fingerprintsPath;
+	NSString *path = engine.instanceTagsPath;
+
+	if (path == nil) {
+		return;
+	}
 
 	FILE *filePointer = fopen([path UTF8String], "wb");
 
@@ -1671,11 +3733,9 @@ static OtrlMessageAppOps ui_ops = {
 		return;
 	}
 
-	otrl_privkey_write_fingerprints_FILEp(self.userState, filePointer);
+	otrl_instag_write_FILEp(engine.userState, filePointer);
 
 	fclose(filePointer);
-
-	[self _postFingerprintsDidChangeNotification];
 }
 
 #pragma mark -
@@ -1704,11 +3764,11 @@ static OtrlMessageAppOps ui_ops = {
 
 - (void)_updateEncryptionStatusWithContext:(ConnContext *)context
 {
-	NSString *username = @(context->username);
-	NSString *accountName = @(context->accountname);
-
-	NSString *protocol = @(context->protocol);
+	[self _updateEncryptionStatusWithUsername:@(context->username) accountName:@(context->accountname) protocol:@(context->protocol)];
+}
 
+- (void)_updateEncryptionStatusWithUsername:(NSString *)username accountName:(NSString *)accountName protocol:(NSString *)protocol
+{
 	OTRKitMessageState messageState = [self messageStateForUsername:username accountName:accountName protocol:protocol];
 
 	[self _performAsyncOperationOnDelegateQueue:^{
@@ -1733,7 +3793,9 @@ static OtrlMessageAppOps ui_ops = {
 	AssertParamaterLength(protocol)
 	AssertParamaterLength(useData)
 
-	[self _performAsyncOperationOnInternalQueue:^{
+	OTRKitEngine *engine = [self _engineForAccountName:accountName protocol:protocol];
+
+	[engine performAsyncOperation:^{
 		ConnContext *otrContext = [self _contextForUsername:username accountName:accountName protocol:protocol];
 
 		if (otrContext == NULL) {
@@ -1742,7 +3804,13 @@ static OtrlMessageAppOps ui_ops = {
 
 		uint8_t *symmetricKeyBytes = malloc(OTRL_EXTRAKEY_BYTES * sizeof(uint8_t));
 
-		gcry_error_t otrError = otrl_message_symkey(self.userState, &ui_ops, NULL, otrContext, (unsigned int)use, [useData bytes], [useData length], symmetricKeyBytes);
+		OTRKitOpData *opData = [engine opDataWithTag:nil];
+
+		uint64_t libotrStart = OTRKitMetricsNow();
+
+		gcry_error_t otrError = otrl_message_symkey(engine.userState, &ui_ops, (__bridge void *)(opData), otrContext, (unsigned int)use, [useData bytes], [useData length], symmetricKeyBytes);
+
+		[self _recordMetricsOperation:OTRKitMetricsOperationSymmetricKey libotrStart:libotrStart engine:engine];
 
 		NSData *symmetricKey = nil;
 
@@ -1770,13 +3838,20 @@ static OtrlMessageAppOps ui_ops = {
 					   protocol:(NSString *)protocol
 						 secret:(NSString *)secret
 {
-	AssertParamaterLength(username)
-	AssertParamaterLength(accountName)
-	AssertParamaterLength(protocol)
+	OTRKitConversation *conversation = [self conversationForUsername:username accountName:accountName protocol:protocol];
+
+	[self initiateSMPInConversation:conversation secret:secret];
+}
+
+- (void)initiateSMPInConversation:(OTRKitConversation *)conversation secret:(NSString *)secret
+{
+	AssertParamaterNil(conversation)
 	AssertParamaterLength(secret)
 
-	[self _performAsyncOperationOnInternalQueue:^{
-		ConnContext *otrContext = [self _contextForUsername:username accountName:accountName protocol:protocol];
+	OTRKitEngine *engine = [self _engineForConversation:conversation];
+
+	[engine performAsyncOperation:^{
+		ConnContext *otrContext = [self _contextForConversation:conversation];
 
 		if (otrContext == NULL) {
 			return;
@@ -1784,7 +3859,15 @@ static OtrlMessageAppOps ui_ops = {
 
 		NSData *secretBytes = [secret dataUsingEncoding:NSUTF8StringEncoding];
 
-		otrl_message_initiate_smp(self.userState, &ui_ops, NULL, otrContext, [secretBytes bytes], [secretBytes length]);
+		OTRKitOpData *opData = [engine opDataWithTag:nil conversation:conversation];
+
+		[self _traceSMPInProgress:YES context:otrContext opData:opData];
+
+		uint64_t libotrStart = OTRKitMetricsNow();
+
+		otrl_message_initiate_smp(engine.userState, &ui_ops, (__bridge void *)(opData), otrContext, [secretBytes bytes], [secretBytes length]);
+
+		[self _recordMetricsOperation:OTRKitMetricsOperationSMP libotrStart:libotrStart engine:engine];
 	}];
 }
 
@@ -1794,14 +3877,21 @@ static OtrlMessageAppOps ui_ops = {
 					   question:(NSString *)question
 						 secret:(NSString *)secret
 {
-	AssertParamaterLength(username)
-	AssertParamaterLength(accountName)
-	AssertParamaterLength(protocol)
+	OTRKitConversation *conversation = [self conversationForUsername:username accountName:accountName protocol:protocol];
+
+	[self initiateSMPInConversation:conversation question:question secret:secret];
+}
+
+- (void)initiateSMPInConversation:(OTRKitConversation *)conversation question:(NSString *)question secret:(NSString *)secret
+{
+	AssertParamaterNil(conversation)
 	AssertParamaterLength(question)
 	AssertParamaterLength(secret)
 
-	[self _performAsyncOperationOnInternalQueue:^{
-		ConnContext *otrContext = [self _contextForUsername:username accountName:accountName protocol:protocol];
+	OTRKitEngine *engine = [self _engineForConversation:conversation];
+
+	[engine performAsyncOperation:^{
+		ConnContext *otrContext = [self _contextForConversation:conversation];
 
 		if (otrContext == NULL) {
 			return;
@@ -1809,7 +3899,15 @@ static OtrlMessageAppOps ui_ops = {
 
 		NSData *secretBytes = [secret dataUsingEncoding:NSUTF8StringEncoding];
 
-		otrl_message_initiate_smp_q(self.userState, &ui_ops, NULL, otrContext, [question UTF8String], [secretBytes bytes], [secretBytes length]);
+		OTRKitOpData *opData = [engine opDataWithTag:nil conversation:conversation];
+
+		[self _traceSMPInProgress:YES context:otrContext opData:opData];
+
+		uint64_t libotrStart = OTRKitMetricsNow();
+
+		otrl_message_initiate_smp_q(engine.userState, &ui_ops, (__bridge void *)(opData), otrContext, [question UTF8String], [secretBytes bytes], [secretBytes length]);
+
+		[self _recordMetricsOperation:OTRKitMetricsOperationSMP libotrStart:libotrStart engine:engine];
 	}];
 }
 
@@ -1818,13 +3916,20 @@ static OtrlMessageAppOps ui_ops = {
 					   protocol:(NSString *)protocol
 						 secret:(NSString *)secret
 {
-	AssertParamaterLength(username)
-	AssertParamaterLength(accountName)
-	AssertParamaterLength(protocol)
+	OTRKitConversation *conversation = [self conversationForUsername:username accountName:accountName protocol:protocol];
+
+	[self respondToSMPInConversation:conversation secret:secret];
+}
+
+- (void)respondToSMPInConversation:(OTRKitConversation *)conversation secret:(NSString *)secret
+{
+	AssertParamaterNil(conversation)
 	AssertParamaterLength(secret)
 
-	[self _performAsyncOperationOnInternalQueue:^{
-		ConnContext *otrContext = [self _contextForUsername:username accountName:accountName protocol:protocol];
+	OTRKitEngine *engine = [self _engineForConversation:conversation];
+
+	[engine performAsyncOperation:^{
+		ConnContext *otrContext = [self _contextForConversation:conversation];
 
 		if (otrContext == NULL) {
 			return;
@@ -1832,7 +3937,13 @@ static OtrlMessageAppOps ui_ops = {
 
 		NSData *secretBytes = [secret dataUsingEncoding:NSUTF8StringEncoding];
 
-		otrl_message_respond_smp(self.userState, &ui_ops, NULL, otrContext, [secretBytes bytes], [secretBytes length]);
+		OTRKitOpData *opData = [engine opDataWithTag:nil conversation:conversation];
+
+		uint64_t libotrStart = OTRKitMetricsNow();
+
+		otrl_message_respond_smp(engine.userState, &ui_ops, (__bridge void *)(opData), otrContext, [secretBytes bytes], [secretBytes length]);
+
+		[self _recordMetricsOperation:OTRKitMetricsOperationSMP libotrStart:libotrStart engine:engine];
 	}];
 }
 
@@ -1840,18 +3951,31 @@ static OtrlMessageAppOps ui_ops = {
 				accountName:(NSString *)accountName
 				   protocol:(NSString *)protocol
 {
-	AssertParamaterLength(username)
-	AssertParamaterLength(accountName)
-	AssertParamaterLength(protocol)
+	OTRKitConversation *conversation = [self conversationForUsername:username accountName:accountName protocol:protocol];
 
-	[self _performAsyncOperationOnInternalQueue:^{
-		ConnContext *otrContext = [self _contextForUsername:username accountName:accountName protocol:protocol];
+	[self abortSMPInConversation:conversation];
+}
+
+- (void)abortSMPInConversation:(OTRKitConversation *)conversation
+{
+	AssertParamaterNil(conversation)
+
+	OTRKitEngine *engine = [self _engineForConversation:conversation];
+
+	[engine performAsyncOperation:^{
+		ConnContext *otrContext = [self _contextForConversation:conversation];
 
 		if (otrContext == NULL) {
 			return;
 		}
 
-		otrl_message_abort_smp(self.userState, &ui_ops, NULL, otrContext);
+		OTRKitOpData *opData = [engine opDataWithTag:nil conversation:conversation];
+
+		uint64_t libotrStart = OTRKitMetricsNow();
+
+		otrl_message_abort_smp(engine.userState, &ui_ops, (__bridge void *)(opData), otrContext);
+
+		[self _recordMetricsOperation:OTRKitMetricsOperationSMP libotrStart:libotrStart engine:engine];
 	}];
 }
 
@@ -1888,35 +4012,19 @@ static OtrlMessageAppOps ui_ops = {
 		delegateQueue = dispatch_get_main_queue();
 	}
 
-	if (asynchronously) {
-		dispatch_async(delegateQueue, block);
-	} else {
-		dispatch_sync(delegateQueue, block);
-	}
-}
-
-- (void)_performAsyncOperationOnInternalQueue:(dispatch_block_t)block
-{
-	[self _performBlockOnInternalQueue:block asynchronously:YES];
-}
-
-- (void)_performSyncOperationOnInternalQueue:(dispatch_block_t)block
-{
-	[self _performBlockOnInternalQueue:block asynchronously:NO];
-}
+	OTRKitMetricsDelegateQueueDidEnqueue(self.metricsCounters);
 
-- (void)_performBlockOnInternalQueue:(dispatch_block_t)block asynchronously:(BOOL)asynchronously
-{
-	if (dispatch_get_specific(IsOnInternalQueueKey)) {
+	/* The block keeps OTRKit, and with it the counters, alive */
+	dispatch_block_t countedBlock = ^{
 		block();
 
-		return;
-	}
+		OTRKitMetricsDelegateQueueDidDequeue(self.metricsCounters);
+	};
 
 	if (asynchronously) {
-		dispatch_async(self.internalQueue, block);
+		dispatch_async(delegateQueue, countedBlock);
 	} else {
-		dispatch_sync(self.internalQueue, block);
+		dispatch_sync(delegateQueue, countedBlock);
 	}
 }
 
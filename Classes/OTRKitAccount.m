@@ -0,0 +1,86 @@
+/* *********************************************************************
+
+        Copyright (c) 2010 - 2015 Codeux Software, LLC
+     Please see ACKNOWLEDGEMENT for additional information.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+
+ * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+ * Neither the name of "Codeux Software, LLC", nor the names of its 
+   contributors may be used to endorse or promote products derived 
+   from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ SUCH DAMAGE.
+
+ *********************************************************************** */
+
+#import "OTRKitAccount.h"
+
+@interface OTRKitAccount ()
+@property (readwrite, copy) NSString *accountName;
+@property (readwrite, copy) NSString *protocol;
+@end
+
+@implementation OTRKitAccount
+
+- (instancetype)initWithAccountName:(NSString *)accountName protocol:(NSString *)protocol
+{
+	AssertParamaterLength(accountName)
+	AssertParamaterLength(protocol)
+
+	if ((self = [super init])) {
+		self.accountName = accountName;
+		self.protocol = protocol;
+
+		return self;
+	}
+
+	return nil;
+}
+
+- (id)copyWithZone:(NSZone *)zone
+{
+	return self;
+}
+
+- (BOOL)isEqual:(id)object
+{
+	if (self == object) {
+		return YES;
+	}
+
+	if ([object isKindOfClass:[OTRKitAccount class]] == NO) {
+		return NO;
+	}
+
+	return ([self.accountName isEqualToString:[object accountName]] &&
+			[self.protocol isEqualToString:[object protocol]]);
+}
+
+- (NSUInteger)hash
+{
+	return ([self.accountName hash] ^ [self.protocol hash]);
+}
+
+- (NSString *)description
+{
+	return [NSString stringWithFormat:@"<%@: %@ <-> %@>", [self class], self.accountName, self.protocol];
+}
+
+@end
@@ -32,6 +32,7 @@
 
 #import "OTRKitAuthenticationDialogWindowManager.h"
 #import "OTRKitAuthenticationDialogPrivate.h"
+#import "OTRKitPrivate.h"
 
 @interface OTRKitAuthenticationDialogWindowManager ()
 @property (nonatomic, strong) NSMutableDictionary *openDialogs;
@@ -67,10 +68,10 @@
 {
 	AssertParamaterNil(dialog)
 
-	NSString *dictKey = [self storageDictionaryKeyForUsername:[dialog cachedUsername]
-												  accountName:[dialog cachedAccountName]
-													 protocol:[dialog cachedProtocol]
-													  isStale:NO];
+	id dictKey = [self storageDictionaryKeyForUsername:[dialog cachedUsername]
+										   accountName:[dialog cachedAccountName]
+											  protocol:[dialog cachedProtocol]
+											   isStale:NO];
 
 	@synchronized (self.openDialogs) {
 		self.openDialogs[dictKey] = dialog;
@@ -105,17 +106,17 @@
 	AssertParamaterNil(dialog)
 
 	@synchronized (self.openDialogs) {
-		NSString *dictKeyNotStale = [self storageDictionaryKeyForUsername:[dialog cachedUsername]
-															  accountName:[dialog cachedAccountName]
-																 protocol:[dialog cachedProtocol]
-																  isStale:NO];
+		id dictKeyNotStale = [self storageDictionaryKeyForUsername:[dialog cachedUsername]
+													   accountName:[dialog cachedAccountName]
+														  protocol:[dialog cachedProtocol]
+														   isStale:NO];
 
 		[self.openDialogs removeObjectForKey:dictKeyNotStale];
 
-		NSString *dictKeyIsStale = [self storageDictionaryKeyForUsername:[dialog cachedUsername]
-															 accountName:[dialog cachedAccountName]
-																protocol:[dialog cachedProtocol]
-																 isStale:YES];
+		id dictKeyIsStale = [self storageDictionaryKeyForUsername:[dialog cachedUsername]
+													  accountName:[dialog cachedAccountName]
+														 protocol:[dialog cachedProtocol]
+														  isStale:YES];
 
 		self.openDialogs[dictKeyIsStale] = dialog;
 	}
@@ -127,27 +128,26 @@
 	AssertParamaterLength(accountName)
 	AssertParamaterLength(protocol)
 
-	NSString *dictKey = [self storageDictionaryKeyForUsername:username
-												  accountName:accountName
-													 protocol:protocol
-													  isStale:NO];
+	id dictKey = [self storageDictionaryKeyForUsername:username
+										   accountName:accountName
+											  protocol:protocol
+											   isStale:NO];
 
 	@synchronized (self.openDialogs) {
 		return self.openDialogs[dictKey];
 	}
 }
 
-- (NSString *)storageDictionaryKeyForUsername:(NSString *)username accountName:(NSString *)accountName protocol:(NSString *)protocol isStale:(BOOL)isStale
+- (id <NSCopying>)storageDictionaryKeyForUsername:(NSString *)username accountName:(NSString *)accountName protocol:(NSString *)protocol isStale:(BOOL)isStale
 {
 	/* Stale dialogs are those that are still kept a reference to, but will not be returned
 	 if looked up for. Stale dialogs are stored with a random key. We are able to remove them
 	 by enumerating all open dialogs when it is time. */
 	if (isStale) {
-		NSString *randomID = [[NSUUID UUID] UUIDString];
-
-		return [NSString stringWithFormat:@"%@ <-> %@ <-> %@ <-> %@", username, accountName, protocol, randomID];
+		return [NSUUID UUID];
 	} else {
-		return [NSString stringWithFormat:@"%@ <-> %@ <-> %@ <-> %d", username, accountName, protocol, isStale];
+		/* Conversation handles are interned so the handle itself is the key. */
+		return [[OTRKit sharedInstance] conversationForUsername:username accountName:accountName protocol:protocol];
 	}
 }
 
@@ -0,0 +1,90 @@
+/* *********************************************************************
+
+        Copyright (c) 2010 - 2015 Codeux Software, LLC
+     Please see ACKNOWLEDGEMENT for additional information.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+
+ * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+ * Neither the name of "Codeux Software, LLC", nor the names of its 
+   contributors may be used to endorse or promote products derived 
+   from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ SUCH DAMAGE.
+
+ *********************************************************************** */
+
+#import "OTRKitConversationPrivate.h"
+
+@interface OTRKitConversation ()
+@property (nonatomic, readwrite, copy) NSString *conversationKey;
+@end
+
+@implementation OTRKitConversation
+
+- (instancetype)initWithUsername:(NSString *)username accountName:(NSString *)accountName protocol:(NSString *)protocol
+{
+	AssertParamaterLength(username)
+	AssertParamaterLength(accountName)
+	AssertParamaterLength(protocol)
+
+	if ((self = [super init])) {
+		self.username = username;
+		self.accountName = accountName;
+
+		self.protocol = protocol;
+
+		self.conversationKey = [OTRKitConversation conversationKeyForUsername:username accountName:accountName protocol:protocol];
+
+		_usernameUTF8String = strdup([username UTF8String]);
+		_accountNameUTF8String = strdup([accountName UTF8String]);
+
+		_protocolUTF8String = strdup([protocol UTF8String]);
+
+		return self;
+	}
+
+	return nil;
+}
+
+- (void)dealloc
+{
+	free((void *)_usernameUTF8String);
+	free((void *)_accountNameUTF8String);
+
+	free((void *)_protocolUTF8String);
+}
+
++ (NSString *)conversationKeyForUsername:(NSString *)username accountName:(NSString *)accountName protocol:(NSString *)protocol
+{
+	return [NSString stringWithFormat:@"%@\n%@\n%@", username, accountName, protocol];
+}
+
+- (id)copyWithZone:(NSZone *)zone
+{
+	/* Handles are immutable and compared by identity. */
+	return self;
+}
+
+- (NSString *)description
+{
+	return [NSString stringWithFormat:@"<%@: %@ <-> %@ <-> %@>", [self class], self.username, self.accountName, self.protocol];
+}
+
+@end
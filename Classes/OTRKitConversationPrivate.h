@@ -0,0 +1,70 @@
+/* *********************************************************************
+
+        Copyright (c) 2010 - 2015 Codeux Software, LLC
+     Please see ACKNOWLEDGEMENT for additional information.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+
+ * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+ * Neither the name of "Codeux Software, LLC", nor the names of its 
+   contributors may be used to endorse or promote products derived 
+   from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ SUCH DAMAGE.
+
+ *********************************************************************** */
+
+#import "OTRKitConversation.h"
+
+#import "libotr/context.h"
+
+@class OTRKitEngine;
+
+@interface OTRKitConversation ()
+- (instancetype)initWithUsername:(NSString *)username accountName:(NSString *)accountName protocol:(NSString *)protocol;
+
+@property (nonatomic, readwrite, copy) NSString *username;
+@property (nonatomic, readwrite, copy) NSString *accountName;
+@property (nonatomic, readwrite, copy) NSString *protocol;
+
+/* The strings above, transcoded once for use with libotr. */
+@property (nonatomic, readonly) const char *usernameUTF8String;
+@property (nonatomic, readonly) const char *accountNameUTF8String;
+@property (nonatomic, readonly) const char *protocolUTF8String;
+
+/* Key that identifies the conversation in hash tables. */
+@property (nonatomic, readonly, copy) NSString *conversationKey;
+
+/* The engine the conversation belongs to. Assigned once by OTRKit. */
+@property (weak) OTRKitEngine *engine;
+
+/* The master context of the conversation along with the context generation
+ of the engine at the time it was looked up. The pointer is only trusted
+ while the generation of the engine is unchanged. Both properties are only
+ accessed on the internal queue of the engine. */
+@property (nonatomic, assign) ConnContext *masterContext;
+@property (nonatomic, assign) NSUInteger masterContextGeneration;
+
+/* Whether the key exchange and SMP stages were reported to the tracer
+ of OTRKit as having begun. Only accessed on the internal queue. */
+@property (nonatomic, assign) BOOL keyExchangeTraced;
+@property (nonatomic, assign) BOOL smpTraced;
+
++ (NSString *)conversationKeyForUsername:(NSString *)username accountName:(NSString *)accountName protocol:(NSString *)protocol;
+@end
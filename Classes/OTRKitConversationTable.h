@@ -0,0 +1,57 @@
+/* *********************************************************************
+
+        Copyright (c) 2010 - 2015 Codeux Software, LLC
+     Please see ACKNOWLEDGEMENT for additional information.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+
+ * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+ * Neither the name of "Codeux Software, LLC", nor the names of its 
+   contributors may be used to endorse or promote products derived 
+   from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ SUCH DAMAGE.
+
+ *********************************************************************** */
+
+#import "OTRKitConversation.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ *  Hands out one OTRKitConversation for each combination of username,
+ *  account name and protocol until it is removed.
+ *
+ *  The table is divided into stripes that are each guarded by their own
+ *  lock, so lookups of different conversations rarely contend. Lookups
+ *  hash the strings they are given directly instead of building a key.
+ *  Conversations are held strongly so that the state cached on them
+ *  survives between lookups.
+ */
+@interface OTRKitConversationTable : NSObject
+- (OTRKitConversation *)conversationForUsername:(NSString *)username accountName:(NSString *)accountName protocol:(NSString *)protocol;
+
+/**
+ *  A conversation that is still referenced elsewhere keeps working. The
+ *  next lookup hands out a new conversation for the same combination.
+ */
+- (void)removeConversationForUsername:(NSString *)username accountName:(NSString *)accountName protocol:(NSString *)protocol;
+@end
+
+NS_ASSUME_NONNULL_END
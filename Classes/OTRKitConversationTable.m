@@ -0,0 +1,191 @@
+/* *********************************************************************
+
+        Copyright (c) 2010 - 2015 Codeux Software, LLC
+     Please see ACKNOWLEDGEMENT for additional information.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+
+ * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+ * Neither the name of "Codeux Software, LLC", nor the names of its 
+   contributors may be used to endorse or promote products derived 
+   from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ SUCH DAMAGE.
+
+ *********************************************************************** */
+
+#import "OTRKitPrivate.h"
+
+/* Must be a power of two */
+#define OTRKitConversationTableStripeCount		16
+
+typedef struct {
+	CFStringRef username;
+	CFStringRef accountName;
+	CFStringRef protocol;
+	NSUInteger hash;
+} OTRKitConversationTableKey;
+
+/* The key only borrows the strings. It is only valid while they are. */
+static OTRKitConversationTableKey conversation_table_key_make(NSString *username, NSString *accountName, NSString *protocol)
+{
+	OTRKitConversationTableKey key;
+
+	key.username = (__bridge CFStringRef)username;
+	key.accountName = (__bridge CFStringRef)accountName;
+	key.protocol = (__bridge CFStringRef)protocol;
+
+	key.hash = (([username hash] * 31 + [accountName hash]) * 31 + [protocol hash]);
+
+	return key;
+}
+
+static NSUInteger conversation_table_key_hash(const void *item, NSUInteger (*size)(const void *item))
+{
+	const OTRKitConversationTableKey *key = item;
+
+	return key->hash;
+}
+
+static BOOL conversation_table_key_is_equal(const void *item1, const void *item2, NSUInteger (*size)(const void *item))
+{
+	const OTRKitConversationTableKey *key1 = item1;
+	const OTRKitConversationTableKey *key2 = item2;
+
+	return (key1->hash == key2->hash &&
+			CFEqual(key1->username, key2->username) &&
+			CFEqual(key1->accountName, key2->accountName) &&
+			CFEqual(key1->protocol, key2->protocol));
+}
+
+/* A key that is added to a stripe is copied. Keys that
+ are only looked up live on the stack of the caller. */
+static void *conversation_table_key_acquire(const void *src, NSUInteger (*size)(const void *item), BOOL shouldCopy)
+{
+	const OTRKitConversationTableKey *key = src;
+
+	OTRKitConversationTableKey *keyCopy = malloc(sizeof(OTRKitConversationTableKey));
+
+	if (keyCopy == NULL) {
+		return NULL;
+	}
+
+	keyCopy->username = CFStringCreateCopy(kCFAllocatorDefault, key->username);
+	keyCopy->accountName = CFStringCreateCopy(kCFAllocatorDefault, key->accountName);
+	keyCopy->protocol = CFStringCreateCopy(kCFAllocatorDefault, key->protocol);
+
+	keyCopy->hash = key->hash;
+
+	return keyCopy;
+}
+
+static void conversation_table_key_relinquish(const void *item, NSUInteger (*size)(const void *item))
+{
+	const OTRKitConversationTableKey *key = item;
+
+	CFRelease(key->username);
+	CFRelease(key->accountName);
+	CFRelease(key->protocol);
+
+	free((void *)key);
+}
+
+@interface OTRKitConversationTable ()
+@property (nonatomic, copy) NSArray<NSMapTable *> *stripes;
+@end
+
+@implementation OTRKitConversationTable
+
+- (instancetype)init
+{
+	if ((self = [super init])) {
+		NSPointerFunctions *keyFunctions =
+		[NSPointerFunctions pointerFunctionsWithOptions:(NSPointerFunctionsOpaqueMemory | NSPointerFunctionsOpaquePersonality | NSPointerFunctionsCopyIn)];
+
+		keyFunctions.hashFunction = conversation_table_key_hash;
+		keyFunctions.isEqualFunction = conversation_table_key_is_equal;
+		keyFunctions.acquireFunction = conversation_table_key_acquire;
+		keyFunctions.relinquishFunction = conversation_table_key_relinquish;
+
+		NSPointerFunctions *valueFunctions =
+		[NSPointerFunctions pointerFunctionsWithOptions:(NSPointerFunctionsStrongMemory | NSPointerFunctionsObjectPointerPersonality)];
+
+		NSMutableArray *stripes = [NSMutableArray arrayWithCapacity:OTRKitConversationTableStripeCount];
+
+		for (NSUInteger i = 0; i < OTRKitConversationTableStripeCount; i++) {
+			NSMapTable *stripe = [[NSMapTable alloc] initWithKeyPointerFunctions:keyFunctions valuePointerFunctions:valueFunctions capacity:0];
+
+			[stripes addObject:stripe];
+		}
+
+		self.stripes = stripes;
+
+		return self;
+	}
+
+	return nil;
+}
+
+- (OTRKitConversation *)conversationForUsername:(NSString *)username accountName:(NSString *)accountName protocol:(NSString *)protocol
+{
+	AssertParamaterLength(username)
+	AssertParamaterLength(accountName)
+	AssertParamaterLength(protocol)
+
+	OTRKitConversationTableKey key = conversation_table_key_make(username, accountName, protocol);
+
+	NSMapTable *stripe = [self _stripeForKey:&key];
+
+	/* The stripe holds the conversation strongly so it
+	 is retained before the stripe lets go of it. */
+	@synchronized (stripe) {
+		OTRKitConversation *conversation = (__bridge OTRKitConversation *)NSMapGet(stripe, &key);
+
+		if (conversation == nil) {
+			conversation = [[OTRKitConversation alloc] initWithUsername:username accountName:accountName protocol:protocol];
+
+			NSMapInsert(stripe, &key, (__bridge void *)conversation);
+		}
+
+		return conversation;
+	}
+}
+
+- (void)removeConversationForUsername:(NSString *)username accountName:(NSString *)accountName protocol:(NSString *)protocol
+{
+	AssertParamaterLength(username)
+	AssertParamaterLength(accountName)
+	AssertParamaterLength(protocol)
+
+	OTRKitConversationTableKey key = conversation_table_key_make(username, accountName, protocol);
+
+	NSMapTable *stripe = [self _stripeForKey:&key];
+
+	@synchronized (stripe) {
+		NSMapRemove(stripe, &key);
+	}
+}
+
+- (NSMapTable *)_stripeForKey:(const OTRKitConversationTableKey *)key
+{
+	/* The low bits are left to the stripe itself */
+	return self.stripes[((key->hash >> 16) & (OTRKitConversationTableStripeCount - 1))];
+}
+
+@end
@@ -0,0 +1,325 @@
+/* *********************************************************************
+
+        Copyright (c) 2010 - 2015 Codeux Software, LLC
+     Please see ACKNOWLEDGEMENT for additional information.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+
+ * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+ * Neither the name of "Codeux Software, LLC", nor the names of its 
+   contributors may be used to endorse or promote products derived 
+   from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ SUCH DAMAGE.
+
+ *********************************************************************** */
+
+#import "libotr/proto.h"
+#import "libotr/context.h"
+#import "libotr/message.h"
+
+#import "OTRKitEvictionStatistics.h"
+#import "OTRKitMetricsCounters.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+@class OTRKit;
+@class OTRKitEngine;
+@class OTRKitConversation;
+@class OTRKitFingerprintsWriter;
+@class OTRKitLoadStatistics;
+@class OTRKitFingerprintIndex;
+
+typedef NS_ENUM(NSUInteger, OTRKitEvictionReason) {
+	OTRKitEvictionReasonIdle,
+	OTRKitEvictionReasonLimit
+};
+
+typedef NS_ENUM(NSUInteger, OTRKitHoldResult) {
+	/* The key of the account is not being generated.
+	 The caller performs the operation itself. */
+	OTRKitHoldResultNotHeld,
+	OTRKitHoldResultHeld,
+	/* The limit of held operations was reached. The caller fails the
+	 operation. Performing it would get it ahead of those held. */
+	OTRKitHoldResultRejected
+};
+
+@interface OTRKitEvictionStatistics ()
+@property (readwrite) NSUInteger liveConversationCount;
+@property (readwrite) unsigned long long estimatedFootprint;
+@property (readwrite) NSUInteger idleEvictionCount;
+@property (readwrite) NSUInteger limitEvictionCount;
+@property (readwrite) NSUInteger disconnectCount;
+@property (readwrite) unsigned long long bytesEvicted;
+
+/* Adds the values of another snapshot to this one. */
+- (void)addStatistics:(OTRKitEvictionStatistics *)statistics;
+@end
+
+/**
+ *  OTRKitOpData is what OTRKit hands to libotr as the opdata of every call.
+ *  The static ui_ops callbacks use it to find the engine (and through it, the
+ *  OTRKit) they are servicing, as well as the tag the caller supplied.
+ */
+@interface OTRKitOpData : NSObject
+@property (nonatomic, strong, readonly) OTRKitEngine *engine;
+@property (nonatomic, strong, readonly, nullable) id tag;
+
+/**
+ *  The conversation the call is being made for, if known.
+ */
+@property (nonatomic, strong, readonly, nullable) OTRKitConversation *conversation;
+
+/**
+ *  When set, messages that libotr asks to inject are appended to this
+ *  array instead of being handed to the delegate one at a time.
+ */
+@property (nonatomic, strong, nullable) NSMutableArray<NSString *> *injectedMessages;
+
+/**
+ *  Set when libotr asked for a private key that did not exist yet.
+ *  The key is generated in the background so libotr could not finish
+ *  what it was doing and the call has to be made again later.
+ */
+@property (nonatomic, assign) BOOL privateKeyRequested;
+
+/**
+ *  Set when libotr reported progress of the socialist millionaires'
+ *  protocol during the call. Used to tell what the call is counted as.
+ */
+@property (nonatomic, assign) BOOL smpEventHandled;
+@end
+
+/**
+ *  An engine owns a libotr user state and the serial queue that all access
+ *  to that user state is funneled through.
+ *
+ *  OTRKit uses a single engine unless sharding is enabled, in which case
+ *  one engine exists for each account name and protocol pair.
+ */
+@interface OTRKitEngine : NSObject
+- (instancetype)initWithOTRKit:(OTRKit *)otrKit
+				   accountName:(nullable NSString *)accountName
+					  protocol:(nullable NSString *)protocol;
+
+@property (nonatomic, weak, readonly) OTRKit *otrKit;
+
+/**
+ *  The account name and protocol this engine is responsible for.
+ *  Both are nil for the default engine.
+ */
+@property (nonatomic, copy, readonly, nullable) NSString *accountName;
+@property (nonatomic, copy, readonly, nullable) NSString *protocol;
+
+@property (readonly) BOOL isShard;
+
+@property (nonatomic, strong, readonly) dispatch_queue_t internalQueue;
+@property (nonatomic, assign, readonly) OtrlUserState userState;
+
+/**
+ *  Folder that the private key, fingerprints, and instance tags of this
+ *  engine are stored in.
+ */
+@property (nonatomic, copy, nullable) NSString *dataPath;
+
+@property (readonly, nullable) NSString *privateKeyPath;
+@property (readonly, nullable) NSString *fingerprintsPath;
+@property (readonly, nullable) NSString *instanceTagsPath;
+
+/**
+ *  Binary copy of the three files above which is quicker to load.
+ */
+@property (readonly, nullable) NSString *snapshotPath;
+
+/**
+ *  Timings of loading the files above. Nil until they are loaded.
+ */
+@property (strong, nullable) OTRKitLoadStatistics *loadStatistics;
+
+/**
+ *  Set when fingerprints are loaded lazily, until all of them are loaded.
+ *  The master context lookups below load the fingerprints of a peer the
+ *  first time it is looked up. Only accessed on the internal queue.
+ */
+@property (nonatomic, strong, nullable) OTRKitFingerprintIndex *fingerprintIndex;
+
+/**
+ *  Adds the fingerprints of a peer from the fingerprint index to the user
+ *  state and to the number of fingerprints kept in the metrics counters.
+ *  Does nothing without a fingerprint index. Must be called on the
+ *  internal queue.
+ */
+- (void)loadFingerprintsForUsername:(const char *)username
+						accountName:(const char *)accountName
+						   protocol:(const char *)protocol;
+
+/**
+ *  Counts the fingerprints held by libotr into the metrics counters. Called
+ *  once the user state is read. Fingerprints added or removed afterwards
+ *  change the count as they happen. Must be called on the internal queue.
+ */
+- (void)recountFingerprints;
+
+/**
+ *  Writes the fingerprints of this engine to disk in the background.
+ */
+@property (nonatomic, strong, readonly) OTRKitFingerprintsWriter *fingerprintsWriter;
+
+- (OTRKitOpData *)opDataWithTag:(nullable id)tag;
+- (OTRKitOpData *)opDataWithTag:(nullable id)tag conversation:(nullable OTRKitConversation *)conversation;
+
+/**
+ *  Returns the master context of a conversation, or NULL if libotr has not
+ *  created one yet. Must be called on the internal queue.
+ *
+ *  Lookups are answered from a hash table which is filled in lazily. The
+ *  entry for a context is removed when libotr frees that context.
+ */
+- (nullable ConnContext *)masterContextForUsername:(NSString *)username
+									   accountName:(NSString *)accountName
+										  protocol:(NSString *)protocol;
+
+/**
+ *  Same as -masterContextForUsername:accountName:protocol: but answered from
+ *  the context cached by the conversation when it is still valid.
+ */
+- (nullable ConnContext *)masterContextForConversation:(OTRKitConversation *)conversation;
+
+/**
+ *  The maximum size of a message that libotr may send in the context, as
+ *  set with -[OTRKit setMaximumProtocolSize:forProtocol:]. The size is
+ *  cached with the master context when it is in the index and is looked
+ *  up again once any maximum size changes. Called on the internal queue.
+ */
+- (int)maximumMessageSizeForContext:(ConnContext *)context;
+
+/**
+ *  Incremented each time libotr frees a context that is in the index.
+ *  Context pointers cached outside of the index are only valid while
+ *  this value is unchanged.
+ */
+@property (readonly) NSUInteger contextGeneration;
+
+/**
+ *  Private keys are generated in the background. While the key of an
+ *  account is being generated, operations that involve the account are
+ *  held and then performed in the order they were held once the key
+ *  exists. The number of operations held for each account is limited.
+ *  Once the limit is reached, operations are not held.
+ *
+ *  All of these must be called on the internal queue.
+ */
+- (BOOL)isGeneratingKeyForAccountName:(NSString *)accountName protocol:(NSString *)protocol;
+
+- (void)beginGeneratingKeyForAccountName:(NSString *)accountName protocol:(NSString *)protocol;
+
+/**
+ *  Performs the operations held for the account.
+ */
+- (void)finishGeneratingKeyForAccountName:(NSString *)accountName protocol:(NSString *)protocol;
+
+- (OTRKitHoldResult)holdOperation:(dispatch_block_t)operation untilKeyIsGeneratedForAccountName:(NSString *)accountName protocol:(NSString *)protocol;
+
+- (BOOL)isOnInternalQueue;
+
+/**
+ *  Counters of the operations performed by this engine. See OTRKitMetrics
+ *
+ *  The number of contexts counts the master contexts in the index above.
+ */
+@property (nonatomic, assign, readonly) OTRKitMetricsCounters *metricsCounters;
+
+/**
+ *  Time in nanoseconds that the block running on the internal queue waited
+ *  to be run. Returns zero after the first call so that the wait is only
+ *  counted towards the first operation that the block performs.
+ *  Must be called on the internal queue.
+ */
+- (uint64_t)takeQueueWaitTime;
+
+/**
+ *  Interval in seconds at which libotr asked to be polled. The poll timer
+ *  fires on the internal queue. Setting it to zero suspends the timer so
+ *  that an idle engine does not wake up at all. When manual polling is
+ *  enabled in the OTRKit, the interval is recorded but the timer is never
+ *  started. Set on the internal queue.
+ */
+@property (nonatomic, assign) unsigned int pollInterval;
+
+/**
+ *  Handler of the poll timer. Polling is forwarded to the OTRKit that owns
+ *  the engine, if it still exists.
+ */
+- (void)messagePoll;
+
+/**
+ *  Master contexts that were used are kept in a list ordered by when they
+ *  were last used. OTRKit evicts from the end of the list that was used
+ *  the longest time ago. All of these must be called on the internal queue.
+ */
+
+/**
+ *  Moves the master context of the conversation to the front of the list
+ *  and schedules OTRKit to evict once the current operation is finished.
+ */
+- (void)noteActivityInConversation:(OTRKitConversation *)conversation;
+
+/**
+ *  @return The master context to evict next, or NULL when none of the
+ *  limits are exceeded. The most recently used context is never returned
+ *  for exceeding a limit so that the conversation in use stays usable.
+ */
+- (nullable ConnContext *)nextMasterContextToEvictWithIdleTimeout:(NSTimeInterval)idleTimeout
+													 maximumCount:(NSUInteger)maximumCount
+													 memoryBudget:(unsigned long long)memoryBudget
+														   reason:(OTRKitEvictionReason *)reason;
+
+/**
+ *  Removes the master context from the list. Called before it is evicted.
+ */
+- (void)willEvictMasterContext:(ConnContext *)masterContext reason:(OTRKitEvictionReason)reason disconnect:(BOOL)disconnect;
+
+/**
+ *  Arms a timer that evicts again once the least recently used context
+ *  becomes idle. Nothing is armed when there is no timeout or no context.
+ */
+- (void)scheduleIdleEvictionWithTimeout:(NSTimeInterval)idleTimeout;
+
+- (OTRKitEvictionStatistics *)evictionStatistics;
+
+- (void)performAsyncOperation:(dispatch_block_t)block;
+- (void)performSyncOperation:(dispatch_block_t)block;
+
+/**
+ *  Shards are keyed by account name and protocol. The key is also used to
+ *  derive the name of the folder that the shard stores its data in.
+ */
++ (NSString *)shardKeyForAccountName:(NSString *)accountName protocol:(NSString *)protocol;
+
++ (NSString *)directoryNameForShardKey:(NSString *)shardKey;
+
++ (nullable NSString *)shardKeyForDirectoryName:(NSString *)directoryName;
+
++ (void)getAccountName:(NSString * _Nullable * _Nullable)accountName
+			  protocol:(NSString * _Nullable * _Nullable)protocol
+		   forShardKey:(NSString *)shardKey;
+@end
+
+NS_ASSUME_NONNULL_END
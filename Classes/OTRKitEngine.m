@@ -0,0 +1,948 @@
+/* *********************************************************************
+
+        Copyright (c) 2010 - 2015 Codeux Software, LLC
+     Please see ACKNOWLEDGEMENT for additional information.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+
+ * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+ * Neither the name of "Codeux Software, LLC", nor the names of its 
+   contributors may be used to endorse or promote products derived 
+   from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ SUCH DAMAGE.
+
+ *********************************************************************** */
+
+#import "OTRKitPrivate.h"
+
+static NSString * const kOTRKitPrivateKeyFileName		= @"OTR-PrivateKey";
+static NSString * const kOTRKitFingerprintsFileName		= @"OTR-Fingerprints";
+static NSString * const kOTRKitInstanceTagsFileName		= @"OTR-InstanceTags";
+static NSString * const kOTRKitSnapshotFileName			= @"OTR-Snapshot";
+
+static NSString * const kOTRKitShardKeySeparator		= @"\n";
+
+/* Messages that arrive for an account while its key is being generated
+ are held in memory. This keeps a flood of them from growing unbounded.
+ Those past the limit fail instead of being performed out of order. */
+#define OTRKitEngineMaximumHeldOperationCount		512
+
+/* The poll timer may fire up to this fraction of its interval late which
+ lets the system coalesce its wakeups with those of other timers. */
+#define OTRKitEnginePollTimerLeewayFraction			10
+
+/* Estimated number of bytes held by an instance in the middle of the
+ key exchange or encrypted: two DH key pairs and four sets of session
+ keys along with the big numbers that libotr allocates for them. */
+#define OTRKitEngineSessionFootprint				4096
+
+/* An instance of this class is attached to each master context that is
+ in the index so that the index is told when libotr frees the context. */
+@interface OTRKitContextIndexEntry : NSObject
+@property (nonatomic, weak) OTRKitEngine *engine;
+@property (nonatomic, copy) NSString *indexKey;
+@property (nonatomic, assign) ConnContext *masterContext;
+
+/* Links of the list of master contexts ordered by when they were last
+ used. An entry is in the list when it has a neighbor or is its head. */
+@property (nonatomic, weak) OTRKitContextIndexEntry *previousEntry;
+@property (nonatomic, strong) OTRKitContextIndexEntry *nextEntry;
+@property (nonatomic, assign) CFAbsoluteTime lastActivity;
+@property (nonatomic, assign) unsigned long long footprint;
+
+/* The maximum message size of the protocol of the context and the
+ generation of the maximum sizes of OTRKit that it was looked up in */
+@property (nonatomic, assign) int maximumMessageSize;
+@property (nonatomic, assign) NSUInteger maximumMessageSizeGeneration;
+@end
+
+@interface OTRKitOpData ()
+@property (nonatomic, strong, readwrite) OTRKitEngine *engine;
+@property (nonatomic, strong, readwrite) id tag;
+@property (nonatomic, strong, readwrite) OTRKitConversation *conversation;
+@end
+
+@interface OTRKitEngine ()
+@property (nonatomic, weak, readwrite) OTRKit *otrKit;
+@property (nonatomic, copy, readwrite) NSString *accountName;
+@property (nonatomic, copy, readwrite) NSString *protocol;
+@property (nonatomic, strong, readwrite) dispatch_queue_t internalQueue;
+@property (nonatomic, assign, readwrite) OtrlUserState userState;
+@property (nonatomic, strong, readwrite) OTRKitFingerprintsWriter *fingerprintsWriter;
+@property (nonatomic, strong) NSMutableDictionary<NSString *, NSValue *> *contextIndex;
+@property (readwrite, assign) NSUInteger contextGeneration;
+@property (nonatomic, strong) NSMutableDictionary<NSString *, NSMutableArray<dispatch_block_t> *> *heldOperations;
+@property (nonatomic, strong) dispatch_source_t pollTimer;
+@property (nonatomic, assign) BOOL pollTimerSuspended;
+@property (nonatomic, strong) OTRKitContextIndexEntry *evictionHead;
+@property (nonatomic, weak) OTRKitContextIndexEntry *evictionTail;
+@property (nonatomic, assign) BOOL evictionScheduled;
+@property (nonatomic, strong) dispatch_source_t evictionTimer;
+@property (nonatomic, strong) OTRKitEvictionStatistics *evictionStatisticsInternal;
+@property (nonatomic, assign, readwrite) OTRKitMetricsCounters *metricsCounters;
+@property (nonatomic, assign) uint64_t queueWaitTime;
+
+- (void)_removeEvictionEntry:(OTRKitContextIndexEntry *)indexEntry;
+@end
+
+@implementation OTRKitOpData
+@end
+
+@implementation OTRKitContextIndexEntry
+@end
+
+@implementation OTRKitEvictionStatistics
+
+- (NSUInteger)evictionCount
+{
+	return (self.idleEvictionCount + self.limitEvictionCount);
+}
+
+- (void)addStatistics:(OTRKitEvictionStatistics *)statistics
+{
+	AssertParamaterNil(statistics)
+
+	self.liveConversationCount += [statistics liveConversationCount];
+
+	self.estimatedFootprint += [statistics estimatedFootprint];
+
+	self.idleEvictionCount += [statistics idleEvictionCount];
+	self.limitEvictionCount += [statistics limitEvictionCount];
+
+	self.disconnectCount += [statistics disconnectCount];
+
+	self.bytesEvicted += [statistics bytesEvicted];
+}
+
+@end
+
+static void context_index_entry_free_cb(void *data)
+{
+	OTRKitContextIndexEntry *indexEntry = CFBridgingRelease(data);
+
+	/* The engine is nil when the context is being freed
+	 because the engine itself is being deallocated. */
+	OTRKitEngine *engine = [indexEntry engine];
+
+	[[engine contextIndex] removeObjectForKey:[indexEntry indexKey]];
+
+	OTRKitMetricsContextCountDidChange([engine metricsCounters], -1);
+
+	[engine _removeEvictionEntry:indexEntry];
+
+	[engine setContextGeneration:([engine contextGeneration] + 1)];
+}
+
+@implementation OTRKitEngine
+
+- (instancetype)initWithOTRKit:(OTRKit *)otrKit accountName:(NSString *)accountName protocol:(NSString *)protocol
+{
+	AssertParamaterNil(otrKit)
+
+	if ((self = [super init])) {
+		self.otrKit = otrKit;
+
+		self.accountName = accountName;
+		self.protocol = protocol;
+
+		NSString *queueName = nil;
+
+		if (self.isShard) {
+			queueName = [NSString stringWithFormat:@"OTRKit Internal Queue (%@ - %@)", accountName, protocol];
+		} else {
+			queueName = @"OTRKit Internal Queue";
+		}
+
+		self.internalQueue = dispatch_queue_create([queueName UTF8String], DISPATCH_QUEUE_SERIAL);
+
+		/* The engine itself is used as the queue specific key which makes it
+		 possible to tell which engine, if any, the caller is running on. */
+		dispatch_queue_set_specific(self.internalQueue, (__bridge const void *)(self), (__bridge void *)(self), NULL);
+
+		self.userState = otrl_userstate_create();
+
+		self.contextIndex = [NSMutableDictionary dictionary];
+
+		self.heldOperations = [NSMutableDictionary dictionary];
+
+		self.evictionStatisticsInternal = [OTRKitEvictionStatistics new];
+
+		self.metricsCounters = OTRKitMetricsCountersCreate();
+
+		self.fingerprintsWriter = [[OTRKitFingerprintsWriter alloc] initWithEngine:self];
+
+		return self;
+	}
+
+	return nil;
+}
+
+- (void)dealloc
+{
+	if (self.pollTimer) {
+		dispatch_source_cancel(self.pollTimer);
+
+		/* A dispatch source must not be released while it is suspended */
+		if (self.pollTimerSuspended) {
+			dispatch_resume(self.pollTimer);
+		}
+
+		self.pollTimer = nil;
+	}
+
+	if (self.evictionTimer) {
+		dispatch_source_cancel(self.evictionTimer);
+
+		self.evictionTimer = nil;
+	}
+
+	[self.fingerprintsWriter flushDeallocatingEngine:self];
+
+	otrl_userstate_free(self.userState);
+
+	self.userState = NULL;
+
+	OTRKitMetricsCountersFree(self.metricsCounters);
+
+	self.metricsCounters = NULL;
+}
+
+- (BOOL)isShard
+{
+	return (self.accountName != nil);
+}
+
+- (OTRKitOpData *)opDataWithTag:(id)tag
+{
+	return [self opDataWithTag:tag conversation:nil];
+}
+
+- (OTRKitOpData *)opDataWithTag:(id)tag conversation:(OTRKitConversation *)conversation
+{
+	OTRKitOpData *opData = [OTRKitOpData new];
+
+	[opData setEngine:self];
+
+	[opData setTag:tag];
+
+	[opData setConversation:conversation];
+
+	return opData;
+}
+
+#pragma mark -
+#pragma mark Polling
+
+- (void)setPollInterval:(unsigned int)pollInterval
+{
+	NSParameterAssert([self isOnInternalQueue]);
+
+	if (pollInterval == 0 || [self.otrKit manualPollingEnabled]) {
+		_pollInterval = pollInterval;
+
+		/* The timer is suspended rather than cancelled so that it can
+		 be resumed without creating another when polling is needed. */
+		if (self.pollTimer && self.pollTimerSuspended == NO) {
+			dispatch_suspend(self.pollTimer);
+
+			self.pollTimerSuspended = YES;
+		}
+
+		return;
+	}
+
+	if (self.pollTimer == nil) {
+		self.pollTimer = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, self.internalQueue);
+
+		self.pollTimerSuspended = YES;
+
+		/* The timer targets the engine weakly so that a running timer
+		 does not keep the engine or its OTRKit from being deallocated. */
+		__weak OTRKitEngine *weakSelf = self;
+
+		dispatch_source_set_event_handler(self.pollTimer, ^{
+			[weakSelf messagePoll];
+		});
+	} else if (_pollInterval == pollInterval && self.pollTimerSuspended == NO) {
+		return;
+	}
+
+	_pollInterval = pollInterval;
+
+	uint64_t interval = (pollInterval * NSEC_PER_SEC);
+
+	dispatch_source_set_timer(self.pollTimer,
+							  dispatch_time(DISPATCH_TIME_NOW, interval),
+							  interval,
+							  (interval / OTRKitEnginePollTimerLeewayFraction));
+
+	if (self.pollTimerSuspended) {
+		dispatch_resume(self.pollTimer);
+
+		self.pollTimerSuspended = NO;
+	}
+}
+
+- (void)messagePoll
+{
+	OTRKit *otrKit = self.otrKit;
+
+	if (otrKit == nil) {
+		[self setPollInterval:0];
+
+		return;
+	}
+
+	[otrKit _messagePollForEngine:self];
+}
+
+#pragma mark -
+#pragma mark Context Index
+
+- (ConnContext *)masterContextForUsername:(NSString *)username accountName:(NSString *)accountName protocol:(NSString *)protocol
+{
+	NSString *indexKey = [OTRKitConversation conversationKeyForUsername:username accountName:accountName protocol:protocol];
+
+	return [self _masterContextForIndexKey:indexKey
+								  username:[username UTF8String]
+							   accountName:[accountName UTF8String]
+								  protocol:[protocol UTF8String]];
+}
+
+- (ConnContext *)masterContextForConversation:(OTRKitConversation *)conversation
+{
+	NSUInteger contextGeneration = self.contextGeneration;
+
+	ConnContext *masterContext = [conversation masterContext];
+
+	if (masterContext && [conversation masterContextGeneration] == contextGeneration) {
+		return masterContext;
+	}
+
+	masterContext = [self _masterContextForIndexKey:[conversation conversationKey]
+										   username:[conversation usernameUTF8String]
+										accountName:[conversation accountNameUTF8String]
+										   protocol:[conversation protocolUTF8String]];
+
+	[conversation setMasterContext:masterContext];
+
+	[conversation setMasterContextGeneration:contextGeneration];
+
+	return masterContext;
+}
+
+- (ConnContext *)_masterContextForIndexKey:(NSString *)indexKey username:(const char *)username accountName:(const char *)accountName protocol:(const char *)protocol
+{
+	NSValue *indexValue = self.contextIndex[indexKey];
+
+	if (indexValue) {
+		return [indexValue pointerValue];
+	}
+
+	/* The fingerprints of a peer are loaded before the context is looked
+	 for so that the peer is known to libotr before it is asked about it. */
+	[self loadFingerprintsForUsername:username accountName:accountName protocol:protocol];
+
+	/* Misses are not remembered because libotr creates contexts
+	 on its own, such as when a message is received. */
+	ConnContext *context = otrl_context_find(self.userState, username, accountName, protocol, OTRL_INSTAG_MASTER, NO, NULL, NULL, NULL);
+
+	if (context == NULL || context->app_data != NULL) {
+		return context;
+	}
+
+	OTRKitContextIndexEntry *indexEntry = [OTRKitContextIndexEntry new];
+
+	[indexEntry setEngine:self];
+
+	[indexEntry setIndexKey:indexKey];
+
+	[indexEntry setMasterContext:context];
+
+	context->app_data = (void *)CFBridgingRetain(indexEntry);
+
+	context->app_data_free = context_index_entry_free_cb;
+
+	self.contextIndex[indexKey] = [NSValue valueWithPointer:context];
+
+	OTRKitMetricsContextCountDidChange(self.metricsCounters, 1);
+
+	return context;
+}
+
+- (int)maximumMessageSizeForContext:(ConnContext *)context
+{
+	OTRKit *otrKit = self.otrKit;
+
+	ConnContext *masterContext = ((context->m_context) ? context->m_context : context);
+
+	OTRKitContextIndexEntry *indexEntry = (__bridge OTRKitContextIndexEntry *)(masterContext->app_data);
+
+	NSUInteger protocolMaxSizeGeneration = [otrKit protocolMaxSizeGeneration];
+
+	if (indexEntry && [indexEntry maximumMessageSizeGeneration] == protocolMaxSizeGeneration) {
+		return [indexEntry maximumMessageSize];
+	}
+
+	int maximumMessageSize = [otrKit _maximumProtocolSizeForProtocol:masterContext->protocol];
+
+	[indexEntry setMaximumMessageSize:maximumMessageSize];
+
+	[indexEntry setMaximumMessageSizeGeneration:protocolMaxSizeGeneration];
+
+	return maximumMessageSize;
+}
+
+#pragma mark -
+#pragma mark Fingerprint Count
+
+static uint64_t fingerprint_count_of_context(ConnContext *context)
+{
+	uint64_t fingerprintCount = 0;
+
+	if (context == NULL) {
+		return 0;
+	}
+
+	for (Fingerprint *fingerprint = context->fingerprint_root.next; fingerprint; fingerprint = fingerprint->next) {
+		fingerprintCount += 1;
+	}
+
+	return fingerprintCount;
+}
+
+- (void)loadFingerprintsForUsername:(const char *)username accountName:(const char *)accountName protocol:(const char *)protocol
+{
+	OTRKitFingerprintIndex *fingerprintIndex = self.fingerprintIndex;
+
+	if (fingerprintIndex == nil) {
+		return;
+	}
+
+	ConnContext *context = otrl_context_find(self.userState, username, accountName, protocol, OTRL_INSTAG_MASTER, NO, NULL, NULL, NULL);
+
+	uint64_t fingerprintCount = fingerprint_count_of_context(context);
+
+	if ([fingerprintIndex loadFingerprintsForUsername:username accountName:accountName protocol:protocol intoUserState:self.userState] == NO) {
+		return;
+	}
+
+	/* Loading a peer creates its context when libotr did not have one */
+	context = otrl_context_find(self.userState, username, accountName, protocol, OTRL_INSTAG_MASTER, NO, NULL, NULL, NULL);
+
+	OTRKitMetricsFingerprintCountDidChange(self.metricsCounters, (int64_t)(fingerprint_count_of_context(context) - fingerprintCount));
+}
+
+- (void)recountFingerprints
+{
+	uint64_t fingerprintCount = 0;
+
+	for (ConnContext *context = self.userState->context_root; context; context = context->next) {
+		if (context->m_context == context) {
+			fingerprintCount += fingerprint_count_of_context(context);
+		}
+	}
+
+	OTRKitMetricsSetFingerprintCount(self.metricsCounters, fingerprintCount);
+}
+
+#pragma mark -
+#pragma mark Eviction
+
+static unsigned long long master_context_footprint(ConnContext *masterContext)
+{
+	unsigned long long footprint = 0;
+
+	/* Instances follow their master context in the list of contexts */
+	for (ConnContext *context = masterContext; context && context->m_context == masterContext; context = context->next) {
+		footprint += (sizeof(ConnContext) + sizeof(ConnContextPriv));
+
+		footprint += (strlen(context->username) + strlen(context->accountname) + strlen(context->protocol));
+
+		if (context->msgstate != OTRL_MSGSTATE_PLAINTEXT || context->auth.authstate != OTRL_AUTHSTATE_NONE) {
+			footprint += OTRKitEngineSessionFootprint;
+		}
+
+		ConnContextPriv *contextPrivate = context->context_priv;
+
+		footprint += contextPrivate->fragment_len;
+
+		footprint += contextPrivate->saved_mac_keys_len;
+
+		if (contextPrivate->lastmessage) {
+			footprint += strlen(contextPrivate->lastmessage);
+		}
+
+		if (context->smstate) {
+			footprint += sizeof(OtrlSMState);
+		}
+	}
+
+	return footprint;
+}
+
+- (void)noteActivityInConversation:(OTRKitConversation *)conversation
+{
+	NSParameterAssert([self isOnInternalQueue]);
+
+	/* Nothing is evicted without a limit so the footprint of
+	 the conversation is not even estimated. */
+	OTRKit *otrKit = self.otrKit;
+
+	if (otrKit.conversationIdleTimeout == 0 &&
+		otrKit.maximumLiveConversationCount == 0 &&
+		otrKit.conversationMemoryBudget == 0)
+	{
+		return;
+	}
+
+	ConnContext *masterContext = [self masterContextForConversation:conversation];
+
+	if (masterContext == NULL) {
+		return;
+	}
+
+	OTRKitContextIndexEntry *indexEntry = (__bridge OTRKitContextIndexEntry *)(masterContext->app_data);
+
+	unsigned long long footprint = master_context_footprint(masterContext);
+
+	if (indexEntry != self.evictionHead) {
+		[self _removeEvictionEntry:indexEntry];
+
+		[indexEntry setNextEntry:self.evictionHead];
+
+		[self.evictionHead setPreviousEntry:indexEntry];
+
+		self.evictionHead = indexEntry;
+
+		if (self.evictionTail == nil) {
+			self.evictionTail = indexEntry;
+		}
+
+		@synchronized (self.evictionStatisticsInternal) {
+			self.evictionStatisticsInternal.liveConversationCount += 1;
+
+			self.evictionStatisticsInternal.estimatedFootprint += footprint;
+		}
+	} else {
+		@synchronized (self.evictionStatisticsInternal) {
+			self.evictionStatisticsInternal.estimatedFootprint -= [indexEntry footprint];
+
+			self.evictionStatisticsInternal.estimatedFootprint += footprint;
+		}
+	}
+
+	[indexEntry setFootprint:footprint];
+
+	[indexEntry setLastActivity:CFAbsoluteTimeGetCurrent()];
+
+	if (self.evictionScheduled) {
+		return;
+	}
+
+	self.evictionScheduled = YES;
+
+	/* Evicting is deferred until the caller is done with the contexts
+	 it holds and is shared by every conversation used in the meantime. */
+	dispatch_async(self.internalQueue, ^{
+		self.evictionScheduled = NO;
+
+		[self.otrKit _evictConversationsForEngine:self];
+	});
+}
+
+- (void)_removeEvictionEntry:(OTRKitContextIndexEntry *)indexEntry
+{
+	OTRKitContextIndexEntry *previousEntry = [indexEntry previousEntry];
+	OTRKitContextIndexEntry *nextEntry = [indexEntry nextEntry];
+
+	if (previousEntry == nil && indexEntry != self.evictionHead) {
+		return;
+	}
+
+	if (previousEntry) {
+		[previousEntry setNextEntry:nextEntry];
+	} else {
+		self.evictionHead = nextEntry;
+	}
+
+	if (nextEntry) {
+		[nextEntry setPreviousEntry:previousEntry];
+	} else {
+		self.evictionTail = previousEntry;
+	}
+
+	[indexEntry setPreviousEntry:nil];
+	[indexEntry setNextEntry:nil];
+
+	@synchronized (self.evictionStatisticsInternal) {
+		self.evictionStatisticsInternal.liveConversationCount -= 1;
+
+		self.evictionStatisticsInternal.estimatedFootprint -= [indexEntry footprint];
+	}
+}
+
+- (ConnContext *)nextMasterContextToEvictWithIdleTimeout:(NSTimeInterval)idleTimeout maximumCount:(NSUInteger)maximumCount memoryBudget:(unsigned long long)memoryBudget reason:(OTRKitEvictionReason *)reason
+{
+	NSParameterAssert([self isOnInternalQueue]);
+
+	NSParameterAssert(reason != NULL);
+
+	OTRKitContextIndexEntry *indexEntry = self.evictionTail;
+
+	if (indexEntry == nil) {
+		return NULL;
+	}
+
+	if (idleTimeout > 0 && (CFAbsoluteTimeGetCurrent() - [indexEntry lastActivity]) >= idleTimeout) {
+		*reason = OTRKitEvictionReasonIdle;
+
+		return [indexEntry masterContext];
+	}
+
+	if (indexEntry == self.evictionHead) {
+		return NULL;
+	}
+
+	BOOL limitExceeded = NO;
+
+	@synchronized (self.evictionStatisticsInternal) {
+		if (maximumCount > 0 && self.evictionStatisticsInternal.liveConversationCount > maximumCount) {
+			limitExceeded = YES;
+		} else if (memoryBudget > 0 && self.evictionStatisticsInternal.estimatedFootprint > memoryBudget) {
+			limitExceeded = YES;
+		}
+	}
+
+	if (limitExceeded == NO) {
+		return NULL;
+	}
+
+	*reason = OTRKitEvictionReasonLimit;
+
+	return [indexEntry masterContext];
+}
+
+- (void)willEvictMasterContext:(ConnContext *)masterContext reason:(OTRKitEvictionReason)reason disconnect:(BOOL)disconnect
+{
+	NSParameterAssert([self isOnInternalQueue]);
+
+	OTRKitContextIndexEntry *indexEntry = (__bridge OTRKitContextIndexEntry *)(masterContext->app_data);
+
+	[self _removeEvictionEntry:indexEntry];
+
+	@synchronized (self.evictionStatisticsInternal) {
+		if (reason == OTRKitEvictionReasonIdle) {
+			self.evictionStatisticsInternal.idleEvictionCount += 1;
+		} else {
+			self.evictionStatisticsInternal.limitEvictionCount += 1;
+		}
+
+		if (disconnect) {
+			self.evictionStatisticsInternal.disconnectCount += 1;
+		}
+
+		self.evictionStatisticsInternal.bytesEvicted += [indexEntry footprint];
+	}
+}
+
+- (void)scheduleIdleEvictionWithTimeout:(NSTimeInterval)idleTimeout
+{
+	NSParameterAssert([self isOnInternalQueue]);
+
+	OTRKitContextIndexEntry *indexEntry = self.evictionTail;
+
+	if (idleTimeout <= 0 || indexEntry == nil) {
+		if (self.evictionTimer) {
+			dispatch_source_set_timer(self.evictionTimer, DISPATCH_TIME_FOREVER, DISPATCH_TIME_FOREVER, 0);
+		}
+
+		return;
+	}
+
+	if (self.evictionTimer == nil) {
+		self.evictionTimer = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, self.internalQueue);
+
+		__weak OTRKitEngine *weakSelf = self;
+
+		dispatch_source_set_event_handler(self.evictionTimer, ^{
+			OTRKitEngine *strongSelf = weakSelf;
+
+			[[strongSelf otrKit] _evictConversationsForEngine:strongSelf];
+		});
+
+		dispatch_source_set_timer(self.evictionTimer, DISPATCH_TIME_FOREVER, DISPATCH_TIME_FOREVER, 0);
+
+		dispatch_resume(self.evictionTimer);
+	}
+
+	NSTimeInterval idleTime = (CFAbsoluteTimeGetCurrent() - [indexEntry lastActivity]);
+
+	NSTimeInterval timeUntilIdle = MAX((idleTimeout - idleTime), 0);
+
+	/* Being evicted late is harmless so the leeway is generous */
+	dispatch_source_set_timer(self.evictionTimer,
+							  dispatch_time(DISPATCH_TIME_NOW, (int64_t)(timeUntilIdle * NSEC_PER_SEC)),
+							  DISPATCH_TIME_FOREVER,
+							  (uint64_t)(idleTimeout * NSEC_PER_SEC / OTRKitEnginePollTimerLeewayFraction));
+}
+
+- (OTRKitEvictionStatistics *)evictionStatistics
+{
+	OTRKitEvictionStatistics *statistics = [OTRKitEvictionStatistics new];
+
+	@synchronized (self.evictionStatisticsInternal) {
+		[statistics addStatistics:self.evictionStatisticsInternal];
+	}
+
+	return statistics;
+}
+
+#pragma mark -
+#pragma mark Key Generation
+
+- (BOOL)isGeneratingKeyForAccountName:(NSString *)accountName protocol:(NSString *)protocol
+{
+	NSParameterAssert([self isOnInternalQueue]);
+
+	NSString *shardKey = [OTRKitEngine shardKeyForAccountName:accountName protocol:protocol];
+
+	return (self.heldOperations[shardKey] != nil);
+}
+
+- (void)beginGeneratingKeyForAccountName:(NSString *)accountName protocol:(NSString *)protocol
+{
+	NSParameterAssert([self isOnInternalQueue]);
+
+	NSString *shardKey = [OTRKitEngine shardKeyForAccountName:accountName protocol:protocol];
+
+	if (self.heldOperations[shardKey] == nil) {
+		self.heldOperations[shardKey] = [NSMutableArray array];
+	}
+}
+
+- (void)finishGeneratingKeyForAccountName:(NSString *)accountName protocol:(NSString *)protocol
+{
+	NSParameterAssert([self isOnInternalQueue]);
+
+	NSString *shardKey = [OTRKitEngine shardKeyForAccountName:accountName protocol:protocol];
+
+	NSArray *operations = self.heldOperations[shardKey];
+
+	[self.heldOperations removeObjectForKey:shardKey];
+
+	/* Operations are performed in this same block so that
+	 nothing submitted afterwards can get ahead of them. */
+	for (dispatch_block_t operation in operations) {
+		operation();
+	}
+}
+
+- (OTRKitHoldResult)holdOperation:(dispatch_block_t)operation untilKeyIsGeneratedForAccountName:(NSString *)accountName protocol:(NSString *)protocol
+{
+	NSParameterAssert([self isOnInternalQueue]);
+
+	AssertParamaterNil(operation)
+
+	NSString *shardKey = [OTRKitEngine shardKeyForAccountName:accountName protocol:protocol];
+
+	NSMutableArray *operations = self.heldOperations[shardKey];
+
+	if (operations == nil) {
+		return OTRKitHoldResultNotHeld;
+	}
+
+	if ([operations count] >= OTRKitEngineMaximumHeldOperationCount) {
+		return OTRKitHoldResultRejected;
+	}
+
+	[operations addObject:[operation copy]];
+
+	return OTRKitHoldResultHeld;
+}
+
+#pragma mark -
+#pragma mark Paths
+
+- (NSString *)privateKeyPath
+{
+	return [self.dataPath stringByAppendingPathComponent:kOTRKitPrivateKeyFileName];
+}
+
+- (NSString *)fingerprintsPath
+{
+	return [self.dataPath stringByAppendingPathComponent:kOTRKitFingerprintsFileName];
+}
+
+- (NSString *)instanceTagsPath
+{
+	return [self.dataPath stringByAppendingPathComponent:kOTRKitInstanceTagsFileName];
+}
+
+- (NSString *)snapshotPath
+{
+	return [self.dataPath stringByAppendingPathComponent:kOTRKitSnapshotFileName];
+}
+
+#pragma mark -
+#pragma mark Shard Keys
+
++ (NSString *)shardKeyForAccountName:(NSString *)accountName protocol:(NSString *)protocol
+{
+	AssertParamaterLength(accountName)
+	AssertParamaterLength(protocol)
+
+	return [@[accountName, protocol] componentsJoinedByString:kOTRKitShardKeySeparator];
+}
+
++ (void)getAccountName:(NSString **)accountName protocol:(NSString **)protocol forShardKey:(NSString *)shardKey
+{
+	AssertParamaterLength(shardKey)
+
+	NSArray *shardKeyComponents = [shardKey componentsSeparatedByString:kOTRKitShardKeySeparator];
+
+	if ([shardKeyComponents count] != 2) {
+		return;
+	}
+
+	if ( accountName) {
+		*accountName = shardKeyComponents[0];
+	}
+
+	if ( protocol) {
+		*protocol = shardKeyComponents[1];
+	}
+}
+
++ (NSString *)directoryNameForShardKey:(NSString *)shardKey
+{
+	AssertParamaterLength(shardKey)
+
+	/* Account names can contain any character so the shard key
+	 is hex encoded to derive a name that is safe on disk. */
+	NSData *shardKeyData = [shardKey dataUsingEncoding:NSUTF8StringEncoding];
+
+	const unsigned char *shardKeyBytes = [shardKeyData bytes];
+
+	NSMutableString *directoryName = [NSMutableString stringWithCapacity:([shardKeyData length] * 2)];
+
+	for (NSUInteger i = 0; i < [shardKeyData length]; i++) {
+		[directoryName appendFormat:@"%02x", shardKeyBytes[i]];
+	}
+
+	return [directoryName copy];
+}
+
++ (NSString *)shardKeyForDirectoryName:(NSString *)directoryName
+{
+	AssertParamaterNil(directoryName)
+
+	NSUInteger directoryNameLength = [directoryName length];
+
+	if (directoryNameLength == 0 || (directoryNameLength % 2) != 0) {
+		return nil;
+	}
+
+	NSMutableData *shardKeyData = [NSMutableData dataWithCapacity:(directoryNameLength / 2)];
+
+	for (NSUInteger i = 0; i < directoryNameLength; i += 2) {
+		unsigned int byteValue = 0;
+
+		NSScanner *byteScanner = [NSScanner scannerWithString:[directoryName substringWithRange:NSMakeRange(i, 2)]];
+
+		if ([byteScanner scanHexInt:&byteValue] == NO || [byteScanner isAtEnd] == NO) {
+			return nil;
+		}
+
+		unsigned char byte = (unsigned char)byteValue;
+
+		[shardKeyData appendBytes:&byte length:1];
+	}
+
+	NSString *shardKey = [[NSString alloc] initWithData:shardKeyData encoding:NSUTF8StringEncoding];
+
+	if ([[shardKey componentsSeparatedByString:kOTRKitShardKeySeparator] count] != 2) {
+		return nil;
+	}
+
+	return shardKey;
+}
+
+#pragma mark -
+#pragma mark Grand Central Dispatch
+
+- (BOOL)isOnInternalQueue
+{
+	return (dispatch_get_specific((__bridge const void *)(self)) == (__bridge void *)(self));
+}
+
+- (void)performAsyncOperation:(dispatch_block_t)block
+{
+	[self _performBlock:block asynchronously:YES];
+}
+
+- (void)performSyncOperation:(dispatch_block_t)block
+{
+	[self _performBlock:block asynchronously:NO];
+}
+
+- (void)_performBlock:(dispatch_block_t)block asynchronously:(BOOL)asynchronously
+{
+	if ([self isOnInternalQueue]) {
+		block();
+
+		return;
+	}
+
+	OTRKitMetricsCounters *metricsCounters = self.metricsCounters;
+
+	OTRKitMetricsInternalQueueDidEnqueue(metricsCounters);
+
+	uint64_t enqueueTime = OTRKitMetricsNow();
+
+	dispatch_block_t measuredBlock = ^{
+		self.queueWaitTime = (OTRKitMetricsNow() - enqueueTime);
+
+		block();
+
+		self.queueWaitTime = 0;
+
+		OTRKitMetricsInternalQueueDidDequeue(metricsCounters);
+	};
+
+	if (asynchronously) {
+		dispatch_async(self.internalQueue, measuredBlock);
+	} else {
+		dispatch_sync(self.internalQueue, measuredBlock);
+	}
+}
+
+- (uint64_t)takeQueueWaitTime
+{
+	NSParameterAssert([self isOnInternalQueue]);
+
+	uint64_t queueWaitTime = self.queueWaitTime;
+
+	self.queueWaitTime = 0;
+
+	return queueWaitTime;
+}
+
+@end
@@ -0,0 +1,73 @@
+/* *********************************************************************
+
+        Copyright (c) 2010 - 2015 Codeux Software, LLC
+     Please see ACKNOWLEDGEMENT for additional information.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+
+ * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+ * Neither the name of "Codeux Software, LLC", nor the names of its 
+   contributors may be used to endorse or promote products derived 
+   from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ SUCH DAMAGE.
+
+ *********************************************************************** */
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ *  A snapshot of the conversations that OTRKit keeps in memory and of
+ *  those it evicted. Obtained from -[OTRKit conversationEvictionStatistics]
+ *
+ *  When sharding is enabled, the values of all engines are added together.
+ */
+@interface OTRKitEvictionStatistics : NSObject
+/**
+ *  Number of conversations used since OTRKit was set up, or since
+ *  they were last evicted, and the estimated number of bytes that
+ *  libotr holds for them. Fingerprints are not counted.
+ */
+@property (readonly) NSUInteger liveConversationCount;
+@property (readonly) unsigned long long estimatedFootprint;
+
+/**
+ *  Number of conversations evicted because they were idle for longer
+ *  than -[OTRKit conversationIdleTimeout] and because there were more
+ *  of them than -[OTRKit maximumLiveConversationCount] or they used more
+ *  than -[OTRKit conversationMemoryBudget]
+ */
+@property (readonly) NSUInteger idleEvictionCount;
+@property (readonly) NSUInteger limitEvictionCount;
+
+@property (readonly) NSUInteger evictionCount;
+
+/**
+ *  Number of evicted conversations that were encrypted and
+ *  had to be disconnected from the remote user.
+ */
+@property (readonly) NSUInteger disconnectCount;
+
+/**
+ *  Estimated number of bytes released by evictions.
+ */
+@property (readonly) unsigned long long bytesEvicted;
+@end
+
+NS_ASSUME_NONNULL_END
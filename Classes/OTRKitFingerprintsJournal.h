@@ -0,0 +1,78 @@
+/* *********************************************************************
+
+        Copyright (c) 2010 - 2015 Codeux Software, LLC
+     Please see ACKNOWLEDGEMENT for additional information.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+
+ * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+ * Neither the name of "Codeux Software, LLC", nor the names of its 
+   contributors may be used to endorse or promote products derived 
+   from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ SUCH DAMAGE.
+
+ *********************************************************************** */
+
+#import "libotr/proto.h"
+#import "libotr/context.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ *  The journal records changes made to fingerprints since the fingerprints
+ *  file was last written so that a change does not require rewriting the
+ *  whole file. It lives next to the fingerprints file and is emptied each
+ *  time the fingerprints file is written.
+ *
+ *  Each record is a single line using the layout of the fingerprints file
+ *  with the operation in front of it:
+ *
+ *	operation	username	accountname	protocol	fingerprint	trust
+ *
+ *  Applying a record more than once has the same effect as applying it
+ *  once which means a journal that outlives the file it was folded into
+ *  can be replayed safely.
+ */
+typedef NS_ENUM(NSUInteger, OTRKitFingerprintsJournalOperation) {
+	OTRKitFingerprintsJournalOperationAdd,
+	OTRKitFingerprintsJournalOperationTrust,
+	OTRKitFingerprintsJournalOperationForget
+};
+
+typedef void (^OTRKitFingerprintsJournalPeerBlock)(const char *username, const char *accountName, const char *protocol);
+
+NSString *OTRKitFingerprintsJournalPath(NSString *fingerprintsPath);
+
+/**
+ *  Returns the record for an operation on a fingerprint.
+ */
+NSData *OTRKitFingerprintsJournalRecord(OTRKitFingerprintsJournalOperation operation, Fingerprint *fingerprint);
+
+/**
+ *  Applies the journal at path to a user state and returns the number of
+ *  records applied. Records that cannot be read, such as a last record cut
+ *  short by a crash, are skipped.
+ *
+ *  peerBlock, if supplied, is called before each record is applied with
+ *  the peer the record belongs to.
+ */
+NSUInteger OTRKitFingerprintsJournalReplay(NSString *path, OtrlUserState userState, OTRKitFingerprintsJournalPeerBlock _Nullable peerBlock);
+
+NS_ASSUME_NONNULL_END
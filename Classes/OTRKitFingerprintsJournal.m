@@ -0,0 +1,224 @@
+/* *********************************************************************
+
+        Copyright (c) 2010 - 2015 Codeux Software, LLC
+     Please see ACKNOWLEDGEMENT for additional information.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+
+ * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+ * Neither the name of "Codeux Software, LLC", nor the names of its 
+   contributors may be used to endorse or promote products derived 
+   from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ SUCH DAMAGE.
+
+ *********************************************************************** */
+
+#import "OTRKitFingerprintsJournal.h"
+
+#define OTRKitFingerprintsJournalFieldCount		6
+
+#define OTRKitFingerprintLength					20
+
+static NSString * const kOTRKitFingerprintsJournalPathExtension		= @"journal";
+
+static const char * const kOTRKitFingerprintsJournalOperationNames[] = {
+	"add",
+	"trust",
+	"forget"
+};
+
+NSString *OTRKitFingerprintsJournalPath(NSString *fingerprintsPath)
+{
+	return [fingerprintsPath stringByAppendingPathExtension:kOTRKitFingerprintsJournalPathExtension];
+}
+
+NSData *OTRKitFingerprintsJournalRecord(OTRKitFingerprintsJournalOperation operation, Fingerprint *fingerprint)
+{
+	NSCParameterAssert(fingerprint != NULL);
+
+	ConnContext *context = fingerprint->context;
+
+	char fingerprintHex[((OTRKitFingerprintLength * 2) + 1)];
+
+	for (NSUInteger i = 0; i < OTRKitFingerprintLength; i++) {
+		snprintf(&fingerprintHex[(i * 2)], 3, "%02x", fingerprint->fingerprint[i]);
+	}
+
+	const char *trust = "";
+
+	if (fingerprint->trust) {
+		trust = fingerprint->trust;
+	}
+
+	const char *fields[OTRKitFingerprintsJournalFieldCount] = {
+		kOTRKitFingerprintsJournalOperationNames[operation],
+		context->username,
+		context->accountname,
+		context->protocol,
+		fingerprintHex,
+		trust
+	};
+
+	NSMutableData *record = [NSMutableData data];
+
+	for (NSUInteger i = 0; i < OTRKitFingerprintsJournalFieldCount; i++) {
+		[record appendBytes:fields[i] length:strlen(fields[i])];
+
+		if (i < (OTRKitFingerprintsJournalFieldCount - 1)) {
+			[record appendBytes:"\t" length:1];
+		} else {
+			[record appendBytes:"\n" length:1];
+		}
+	}
+
+	return record;
+}
+
+static int fingerprints_journal_hex_value(char character)
+{
+	if (character >= '0' && character <= '9') {
+		return (character - '0');
+	} else if (character >= 'a' && character <= 'f') {
+		return (character - 'a' + 10);
+	} else if (character >= 'A' && character <= 'F') {
+		return (character - 'A' + 10);
+	}
+
+	return -1;
+}
+
+static BOOL fingerprints_journal_read_fingerprint(const char *fingerprintHex, unsigned char *fingerprint)
+{
+	if (strlen(fingerprintHex) != (OTRKitFingerprintLength * 2)) {
+		return NO;
+	}
+
+	for (NSUInteger i = 0; i < OTRKitFingerprintLength; i++) {
+		int highValue = fingerprints_journal_hex_value(fingerprintHex[(i * 2)]);
+		int lowValue = fingerprints_journal_hex_value(fingerprintHex[(i * 2) + 1]);
+
+		if (highValue < 0 || lowValue < 0) {
+			return NO;
+		}
+
+		fingerprint[i] = (unsigned char)((highValue << 4) | lowValue);
+	}
+
+	return YES;
+}
+
+static BOOL fingerprints_journal_apply_record(char *line, OtrlUserState userState, OTRKitFingerprintsJournalPeerBlock peerBlock)
+{
+	char *fields[OTRKitFingerprintsJournalFieldCount];
+
+	for (NSUInteger i = 0; i < OTRKitFingerprintsJournalFieldCount; i++) {
+		fields[i] = strsep(&line, "\t");
+
+		if (fields[i] == NULL) {
+			return NO;
+		}
+	}
+
+	OTRKitFingerprintsJournalOperation operation;
+
+	if (strcmp(fields[0], "add") == 0) {
+		operation = OTRKitFingerprintsJournalOperationAdd;
+	} else if (strcmp(fields[0], "trust") == 0) {
+		operation = OTRKitFingerprintsJournalOperationTrust;
+	} else if (strcmp(fields[0], "forget") == 0) {
+		operation = OTRKitFingerprintsJournalOperationForget;
+	} else {
+		return NO;
+	}
+
+	unsigned char fingerprintBytes[OTRKitFingerprintLength];
+
+	if (fingerprints_journal_read_fingerprint(fields[4], fingerprintBytes) == NO) {
+		return NO;
+	}
+
+	if (peerBlock) {
+		peerBlock(fields[1], fields[2], fields[3]);
+	}
+
+	/* A fingerprint that is being forgotten is not worth creating a context for. */
+	BOOL addIfMissing = (operation != OTRKitFingerprintsJournalOperationForget);
+
+	ConnContext *context = otrl_context_find(userState, fields[1], fields[2], fields[3], OTRL_INSTAG_MASTER, addIfMissing, NULL, NULL, NULL);
+
+	if (context == NULL) {
+		return addIfMissing == NO;
+	}
+
+	Fingerprint *fingerprint = otrl_context_find_fingerprint(context, fingerprintBytes, addIfMissing, NULL);
+
+	if (fingerprint == NULL) {
+		return addIfMissing == NO;
+	}
+
+	if (operation == OTRKitFingerprintsJournalOperationForget) {
+		otrl_context_forget_fingerprint(fingerprint, 0);
+	} else {
+		otrl_context_set_trust(fingerprint, fields[5]);
+	}
+
+	return YES;
+}
+
+NSUInteger OTRKitFingerprintsJournalReplay(NSString *path, OtrlUserState userState, OTRKitFingerprintsJournalPeerBlock peerBlock)
+{
+	NSCParameterAssert(path != nil);
+	NSCParameterAssert(userState != NULL);
+
+	NSData *journal = [NSData dataWithContentsOfFile:path options:NSDataReadingMappedIfSafe error:NULL];
+
+	if (journal == nil) {
+		return 0;
+	}
+
+	NSUInteger recordsApplied = 0;
+
+	const char *bytes = [journal bytes];
+
+	const char *bytesEnd = (bytes + [journal length]);
+
+	while (bytes < bytesEnd) {
+		const char *lineEnd = memchr(bytes, '\n', (bytesEnd - bytes));
+
+		/* A line without a newline was not fully written. */
+		if (lineEnd == NULL) {
+			break;
+		}
+
+		char *line = strndup(bytes, (lineEnd - bytes));
+
+		if (line) {
+			if (fingerprints_journal_apply_record(line, userState, peerBlock)) {
+				recordsApplied += 1;
+			}
+
+			free(line);
+		}
+
+		bytes = (lineEnd + 1);
+	}
+
+	return recordsApplied;
+}
@@ -0,0 +1,111 @@
+/* *********************************************************************
+
+        Copyright (c) 2010 - 2015 Codeux Software, LLC
+     Please see ACKNOWLEDGEMENT for additional information.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+
+ * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+ * Neither the name of "Codeux Software, LLC", nor the names of its 
+   contributors may be used to endorse or promote products derived 
+   from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ SUCH DAMAGE.
+
+ *********************************************************************** */
+
+#import "OTRKitWriteStatistics.h"
+#import "OTRKitFingerprintsJournal.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+@class OTRKitEngine;
+
+@interface OTRKitWriteStatistics ()
+@property (readwrite) NSUInteger requestedWriteCount;
+@property (readwrite) NSUInteger writeCount;
+@property (readwrite) NSUInteger failedWriteCount;
+@property (readwrite) NSUInteger journalRecordCount;
+@property (readwrite) unsigned long long journalBytesWritten;
+@property (readwrite) NSTimeInterval totalJournalWriteDuration;
+@property (readwrite) NSUInteger compactionCount;
+@property (readwrite) unsigned long long bytesWritten;
+@property (readwrite) NSTimeInterval totalSerializationDuration;
+@property (readwrite) NSTimeInterval totalWriteDuration;
+@property (readwrite) NSTimeInterval maximumWriteDuration;
+
+/* Adds the values of another snapshot to this one. */
+- (void)addStatistics:(OTRKitWriteStatistics *)statistics;
+@end
+
+/**
+ *  Writes the fingerprints of an engine to disk behind the back of the
+ *  internal queue.
+ *
+ *  Changes that are known are appended to the journal. Changes that are
+ *  not known are only marked on the internal queue. Marks made within the
+ *  coalescing interval of OTRKit share a single write. When the interval
+ *  passes, the fingerprints are copied into memory on the internal queue
+ *  and the copy is written to a temporary file, which then replaces the
+ *  fingerprints file, on a serial queue of the writer. The journal is
+ *  emptied once the fingerprints file is replaced.
+ *
+ *  When the journal grows past half the size of the fingerprints file,
+ *  it is compacted by writing the fingerprints file the same way.
+ *
+ *  When OTRKit has a storage, no files are used. Changes that are known
+ *  are collected on the internal queue instead of being journaled, and are
+ *  applied to the storage in a single transaction on the writer queue once
+ *  the coalescing interval passes. Changes that are not known replace every
+ *  fingerprint of the engine in the storage.
+ */
+@interface OTRKitFingerprintsWriter : NSObject
+- (instancetype)initWithEngine:(OTRKitEngine *)engine;
+
+/**
+ *  Marks the fingerprints as changed. Must be called on the internal queue.
+ */
+- (void)setNeedsWrite;
+
+/**
+ *  Appends a record for a change to a fingerprint to the journal.
+ *  Must be called on the internal queue after the change is made,
+ *  or in the case of forgetting a fingerprint, before it is made.
+ */
+- (void)appendJournalOperation:(OTRKitFingerprintsJournalOperation)operation
+				forFingerprint:(Fingerprint *)fingerprint;
+
+/**
+ *  Writes pending changes, if any, and waits for every write
+ *  to finish. Must not be called on the writer queue.
+ */
+- (void)flush;
+
+/**
+ *  Writes pending changes, if any, of an engine that is being deallocated
+ *  and waits for every write to finish. Changes waiting for the coalescing
+ *  interval to pass would otherwise be lost because the writer no longer
+ *  reaches the engine. Called by the engine from -dealloc.
+ */
+- (void)flushDeallocatingEngine:(OTRKitEngine *)engine;
+
+- (OTRKitWriteStatistics *)statistics;
+@end
+
+NS_ASSUME_NONNULL_END
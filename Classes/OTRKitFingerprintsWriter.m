@@ -0,0 +1,657 @@
+/* *********************************************************************
+
+        Copyright (c) 2010 - 2015 Codeux Software, LLC
+     Please see ACKNOWLEDGEMENT for additional information.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+
+ * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+ * Neither the name of "Codeux Software, LLC", nor the names of its 
+   contributors may be used to endorse or promote products derived 
+   from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ SUCH DAMAGE.
+
+ *********************************************************************** */
+
+#import "OTRKitPrivate.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+
+/* The journal is not compacted until it is at least this large, no matter
+ how small the fingerprints file is. */
+#define OTRKitFingerprintsJournalMinimumCompactionSize		(64 * 1024)
+
+typedef void (^OTRKitFingerprintsWriterStorageOperation)(id<OTRKitStorageTransaction> transaction);
+
+@interface OTRKitFingerprintsWriter ()
+@property (nonatomic, weak) OTRKitEngine *engine;
+@property (nonatomic, strong) dispatch_queue_t writerQueue;
+@property (nonatomic, strong) OTRKitWriteStatistics *writeStatistics;
+
+/* Only accessed on the internal queue */
+@property (nonatomic, assign) BOOL writeScheduled;
+@property (nonatomic, strong) id<OTRKitStorage> scheduledStorage;
+@property (nonatomic, assign) BOOL scheduledShardingEnabled;
+@property (nonatomic, assign) BOOL needsFullWrite;
+@property (nonatomic, strong) NSMutableArray<OTRKitFingerprintsWriterStorageOperation> *storageOperations;
+
+/* Only accessed on the writer queue */
+@property (nonatomic, assign) int journalFileDescriptor;
+@property (nonatomic, assign) unsigned long long journalSize;
+@property (nonatomic, assign) unsigned long long fingerprintsSize;
+@property (nonatomic, assign) BOOL compactionRequested;
+@end
+
+@implementation OTRKitWriteStatistics
+
+- (NSTimeInterval)averageWriteDuration
+{
+	if (self.writeCount == 0) {
+		return 0;
+	}
+
+	return (self.totalWriteDuration / self.writeCount);
+}
+
+- (void)addStatistics:(OTRKitWriteStatistics *)statistics
+{
+	AssertParamaterNil(statistics)
+
+	self.requestedWriteCount += [statistics requestedWriteCount];
+	self.writeCount += [statistics writeCount];
+	self.failedWriteCount += [statistics failedWriteCount];
+
+	self.journalRecordCount += [statistics journalRecordCount];
+	self.journalBytesWritten += [statistics journalBytesWritten];
+
+	self.totalJournalWriteDuration += [statistics totalJournalWriteDuration];
+
+	self.compactionCount += [statistics compactionCount];
+
+	self.bytesWritten += [statistics bytesWritten];
+
+	self.totalSerializationDuration += [statistics totalSerializationDuration];
+	self.totalWriteDuration += [statistics totalWriteDuration];
+
+	self.maximumWriteDuration = MAX(self.maximumWriteDuration, [statistics maximumWriteDuration]);
+}
+
+@end
+
+@implementation OTRKitFingerprintsWriter
+
+- (instancetype)initWithEngine:(OTRKitEngine *)engine
+{
+	AssertParamaterNil(engine)
+
+	if ((self = [super init])) {
+		self.engine = engine;
+
+		self.writerQueue = dispatch_queue_create("OTRKit Fingerprints Writer Queue", DISPATCH_QUEUE_SERIAL);
+
+		self.writeStatistics = [OTRKitWriteStatistics new];
+
+		self.journalFileDescriptor = -1;
+
+		self.storageOperations = [NSMutableArray array];
+
+		return self;
+	}
+
+	return nil;
+}
+
+- (void)dealloc
+{
+	if (self.journalFileDescriptor >= 0) {
+		close(self.journalFileDescriptor);
+	}
+}
+
+- (void)setNeedsWrite
+{
+	OTRKitEngine *engine = self.engine;
+
+	NSParameterAssert([engine isOnInternalQueue]);
+
+	@synchronized (self.writeStatistics) {
+		self.writeStatistics.requestedWriteCount += 1;
+	}
+
+	self.needsFullWrite = YES;
+
+	[self _scheduleWrite];
+}
+
+- (void)_setNeedsCompaction
+{
+	[self _scheduleWrite];
+}
+
+- (void)_scheduleWrite
+{
+	if (self.writeScheduled) {
+		return;
+	}
+
+	self.writeScheduled = YES;
+
+	OTRKitEngine *engine = self.engine;
+
+	OTRKit *otrKit = [engine otrKit];
+
+	/* OTRKit may be gone by the time a write pending at teardown is
+	 performed so what the write depends on is noted now. */
+	self.scheduledStorage = [otrKit storage];
+
+	self.scheduledShardingEnabled = [otrKit shardingEnabled];
+
+	NSTimeInterval coalescingInterval = [otrKit fingerprintsWriteCoalescingInterval];
+
+	dispatch_time_t writeTime = dispatch_time(DISPATCH_TIME_NOW, (int64_t)(coalescingInterval * NSEC_PER_SEC));
+
+	dispatch_after(writeTime, [engine internalQueue], ^{
+		[self _writeIfNeeded];
+	});
+}
+
+- (void)appendJournalOperation:(OTRKitFingerprintsJournalOperation)operation forFingerprint:(Fingerprint *)fingerprint
+{
+	AssertParamaterNull(fingerprint)
+
+	OTRKitEngine *engine = self.engine;
+
+	NSParameterAssert([engine isOnInternalQueue]);
+
+	if ([[engine otrKit] storage]) {
+		[self _appendStorageOperation:operation forFingerprint:fingerprint];
+
+		return;
+	}
+
+	NSString *path = [engine fingerprintsPath];
+
+	if (path == nil) {
+		return;
+	}
+
+	NSData *record = OTRKitFingerprintsJournalRecord(operation, fingerprint);
+
+	dispatch_async(self.writerQueue, ^{
+		[self _appendJournalRecord:record fingerprintsPath:path];
+	});
+}
+
+- (void)_appendStorageOperation:(OTRKitFingerprintsJournalOperation)operation forFingerprint:(Fingerprint *)fingerprint
+{
+	/* The record is made now because a fingerprint
+	 that is being forgotten is freed right after. */
+	OTRKitFingerprintRecord *record = OTRKitStorageFingerprintRecord(fingerprint);
+
+	if (operation == OTRKitFingerprintsJournalOperationForget) {
+		[self.storageOperations addObject:^(id<OTRKitStorageTransaction> transaction) {
+			[transaction removeFingerprint:record];
+		}];
+	} else {
+		[self.storageOperations addObject:^(id<OTRKitStorageTransaction> transaction) {
+			[transaction setFingerprint:record];
+		}];
+	}
+
+	[self _scheduleWrite];
+}
+
+- (void)_appendJournalRecord:(NSData *)record fingerprintsPath:(NSString *)path
+{
+	if (self.journalFileDescriptor < 0) {
+		if ([self _openJournalForFingerprintsPath:path] == NO) {
+			[self _requestWriteAfterJournalFailure];
+
+			return;
+		}
+	}
+
+	CFAbsoluteTime writeStart = CFAbsoluteTimeGetCurrent();
+
+	ssize_t bytesWritten = write(self.journalFileDescriptor, [record bytes], [record length]);
+
+	CFAbsoluteTime writeDuration = (CFAbsoluteTimeGetCurrent() - writeStart);
+
+	if (bytesWritten != (ssize_t)[record length]) {
+		LogToConsole(@"Failed to append to fingerprints journal: %s", strerror(errno));
+
+		[self _requestWriteAfterJournalFailure];
+
+		return;
+	}
+
+	@synchronized (self.writeStatistics) {
+		OTRKitWriteStatistics *writeStatistics = self.writeStatistics;
+
+		writeStatistics.journalRecordCount += 1;
+
+		writeStatistics.journalBytesWritten += [record length];
+
+		writeStatistics.totalJournalWriteDuration += writeDuration;
+	}
+
+	self.journalSize += [record length];
+
+	if (self.compactionRequested) {
+		return;
+	}
+
+	unsigned long long compactionSize = MAX(OTRKitFingerprintsJournalMinimumCompactionSize, (self.fingerprintsSize / 2));
+
+	if (self.journalSize < compactionSize) {
+		return;
+	}
+
+	OTRKitEngine *engine = self.engine;
+
+	if (engine == nil) {
+		return;
+	}
+
+	self.compactionRequested = YES;
+
+	dispatch_async([engine internalQueue], ^{
+		[self _setNeedsCompaction];
+	});
+}
+
+- (BOOL)_openJournalForFingerprintsPath:(NSString *)path
+{
+	NSString *journalPath = OTRKitFingerprintsJournalPath(path);
+
+	int fileDescriptor = open([journalPath fileSystemRepresentation], (O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC), 0600);
+
+	if (fileDescriptor < 0) {
+		LogToConsole(@"Failed to open fingerprints journal '%@': %s", journalPath, strerror(errno));
+
+		return NO;
+	}
+
+	/* The journal may hold records from a previous launch
+	 which were replayed when the fingerprints were read. */
+	struct stat journalStat;
+
+	if (fstat(fileDescriptor, &journalStat) == 0) {
+		self.journalSize = journalStat.st_size;
+	}
+
+	struct stat fingerprintsStat;
+
+	if (stat([path fileSystemRepresentation], &fingerprintsStat) == 0) {
+		self.fingerprintsSize = fingerprintsStat.st_size;
+	}
+
+	self.journalFileDescriptor = fileDescriptor;
+
+	return YES;
+}
+
+- (void)_requestWriteAfterJournalFailure
+{
+	/* A record that cannot be appended is recovered by writing everything. */
+	OTRKitEngine *engine = self.engine;
+
+	if (engine == nil) {
+		return;
+	}
+
+	dispatch_async([engine internalQueue], ^{
+		[self setNeedsWrite];
+	});
+}
+
+- (void)_closeJournalForFingerprintsPath:(NSString *)path
+{
+	if (self.journalFileDescriptor >= 0) {
+		close(self.journalFileDescriptor);
+
+		self.journalFileDescriptor = -1;
+	}
+
+	NSString *journalPath = OTRKitFingerprintsJournalPath(path);
+
+	unlink([journalPath fileSystemRepresentation]);
+
+	self.journalSize = 0;
+}
+
+- (void)flush
+{
+	OTRKitEngine *engine = self.engine;
+
+	[engine performSyncOperation:^{
+		[self _writeIfNeeded];
+	}];
+
+	/* The writer queue is serial so once this block runs,
+	 every write scheduled before it has finished. */
+	dispatch_sync(self.writerQueue, ^{});
+}
+
+- (void)flushDeallocatingEngine:(OTRKitEngine *)engine
+{
+	AssertParamaterNil(engine)
+
+	dispatch_block_t writeBlock = ^{
+		[self _writeIfNeededForEngine:engine];
+	};
+
+	if ([engine isOnInternalQueue]) {
+		writeBlock();
+	} else {
+		dispatch_sync([engine internalQueue], writeBlock);
+	}
+
+	dispatch_sync(self.writerQueue, ^{});
+}
+
+- (void)_writeIfNeeded
+{
+	OTRKitEngine *engine = self.engine;
+
+	/* A write pending when the engine was deallocated was performed by it */
+	if (engine == nil) {
+		return;
+	}
+
+	[self _writeIfNeededForEngine:engine];
+}
+
+- (void)_writeIfNeededForEngine:(OTRKitEngine *)engine
+{
+	/* The write may have been performed early by -flush */
+	if (self.writeScheduled == NO) {
+		return;
+	}
+
+	self.writeScheduled = NO;
+
+	id<OTRKitStorage> storage = self.scheduledStorage;
+
+	self.scheduledStorage = nil;
+
+	if (storage) {
+		[self _writeStorageIfNeeded:storage engine:engine];
+
+		return;
+	}
+
+	self.needsFullWrite = NO;
+
+	NSString *path = [engine fingerprintsPath];
+
+	if (path == nil) {
+		return;
+	}
+
+	CFAbsoluteTime serializationStart = CFAbsoluteTimeGetCurrent();
+
+	NSData *data = [self _serializedFingerprintsOfEngine:engine];
+
+	CFAbsoluteTime serializationDuration = (CFAbsoluteTimeGetCurrent() - serializationStart);
+
+	@synchronized (self.writeStatistics) {
+		self.writeStatistics.totalSerializationDuration += serializationDuration;
+	}
+
+	if (data == nil) {
+		return;
+	}
+
+	dispatch_async(self.writerQueue, ^{
+		[self _writeData:data toPath:path];
+	});
+}
+
+- (void)_writeStorageIfNeeded:(id<OTRKitStorage>)storage engine:(OTRKitEngine *)engine
+{
+	NSArray *operations = nil;
+
+	BOOL fullWrite = self.needsFullWrite;
+
+	self.needsFullWrite = NO;
+
+	/* The default engine holds nothing once sharding is enabled
+	 so it must not replace the fingerprints of every shard. */
+	if ([engine isShard] == NO && self.scheduledShardingEnabled) {
+		fullWrite = NO;
+	}
+
+	CFAbsoluteTime serializationStart = CFAbsoluteTimeGetCurrent();
+
+	if (fullWrite) {
+		/* Changes collected so far are part of the user state
+		 which replaces everything the engine has in the storage. */
+		operations = @[[self _storageOperationReplacingFingerprintsOfEngine:engine]];
+	} else {
+		operations = [self.storageOperations copy];
+	}
+
+	[self.storageOperations removeAllObjects];
+
+	CFAbsoluteTime serializationDuration = (CFAbsoluteTimeGetCurrent() - serializationStart);
+
+	@synchronized (self.writeStatistics) {
+		self.writeStatistics.totalSerializationDuration += serializationDuration;
+	}
+
+	if ([operations count] == 0) {
+		return;
+	}
+
+	dispatch_async(self.writerQueue, ^{
+		[self _performStorageOperations:operations onStorage:storage fullWrite:fullWrite];
+	});
+}
+
+- (OTRKitFingerprintsWriterStorageOperation)_storageOperationReplacingFingerprintsOfEngine:(OTRKitEngine *)engine
+{
+	NSMutableArray<OTRKitFingerprintRecord *> *records = [NSMutableArray array];
+
+	for (ConnContext *context = [engine userState]->context_root; context; context = context->next) {
+		if (context->m_context != context) {
+			continue;
+		}
+
+		for (Fingerprint *fingerprint = context->fingerprint_root.next; fingerprint; fingerprint = fingerprint->next) {
+			[records addObject:OTRKitStorageFingerprintRecord(fingerprint)];
+		}
+	}
+
+	[[engine fingerprintIndex] enumerateUnloadedFingerprintsUsingBlock:^(const char *username, const char *accountName, const char *protocol, const unsigned char *fingerprint, const char *trust) {
+		OTRKitFingerprintRecord *record =
+		[[OTRKitFingerprintRecord alloc] initWithUsername:@(username)
+											  accountName:@(accountName)
+												 protocol:@(protocol)
+											  fingerprint:[NSData dataWithBytes:fingerprint length:20]
+													trust:((trust) ? @(trust) : nil)];
+
+		[records addObject:record];
+	}];
+
+	/* Both are nil for the default engine which removes every fingerprint */
+	NSString *accountName = [engine accountName];
+	NSString *protocol = [engine protocol];
+
+	return ^(id<OTRKitStorageTransaction> transaction) {
+		[transaction removeAllFingerprintsForAccountName:accountName protocol:protocol];
+
+		for (OTRKitFingerprintRecord *record in records) {
+			[transaction setFingerprint:record];
+		}
+	};
+}
+
+- (void)_performStorageOperations:(NSArray<OTRKitFingerprintsWriterStorageOperation> *)operations onStorage:(id<OTRKitStorage>)storage fullWrite:(BOOL)fullWrite
+{
+	CFAbsoluteTime writeStart = CFAbsoluteTimeGetCurrent();
+
+	NSError *writeError = nil;
+
+	BOOL writeResult = [storage performTransaction:^(id<OTRKitStorageTransaction> transaction) {
+		for (OTRKitFingerprintsWriterStorageOperation operation in operations) {
+			operation(transaction);
+		}
+	} error:&writeError];
+
+	CFAbsoluteTime writeDuration = (CFAbsoluteTimeGetCurrent() - writeStart);
+
+	if (writeResult == NO) {
+		LogToConsole(@"Failed to write fingerprints to storage: %@", [writeError localizedDescription]);
+
+		/* Changes that were lost are recovered by the next
+		 change writing everything, same as for the journal. */
+		if (fullWrite == NO) {
+			OTRKitEngine *engine = self.engine;
+
+			[engine performAsyncOperation:^{
+				self.needsFullWrite = YES;
+			}];
+		}
+	}
+
+	@synchronized (self.writeStatistics) {
+		OTRKitWriteStatistics *writeStatistics = self.writeStatistics;
+
+		if (writeResult) {
+			writeStatistics.writeCount += 1;
+
+			if (fullWrite == NO) {
+				writeStatistics.journalRecordCount += [operations count];
+			}
+		} else {
+			writeStatistics.failedWriteCount += 1;
+		}
+
+		writeStatistics.totalWriteDuration += writeDuration;
+
+		writeStatistics.maximumWriteDuration = MAX(writeStatistics.maximumWriteDuration, writeDuration);
+	}
+
+	[self _recordWriteDuration:writeDuration];
+}
+
+- (NSData *)_serializedFingerprintsOfEngine:(OTRKitEngine *)engine
+{
+	NSMutableData *data = [NSMutableData data];
+
+	FILE *filePointer = OTRKitMemoryFileOpenForWriting(data);
+
+	if (filePointer == NULL) {
+		return nil;
+	}
+
+	otrl_privkey_write_fingerprints_FILEp([engine userState], filePointer);
+
+	/* Peers that were never loaded are unchanged since the snapshot. They
+	 are copied from the index in the format libotr writes instead of being
+	 loaded, so that writing does not make every peer resident. */
+	[[engine fingerprintIndex] enumerateUnloadedFingerprintsUsingBlock:^(const char *username, const char *accountName, const char *protocol, const unsigned char *fingerprint, const char *trust) {
+		fprintf(filePointer, "%s\t%s\t%s\t", username, accountName, protocol);
+
+		for (NSUInteger i = 0; i < 20; i++) {
+			fprintf(filePointer, "%02x", fingerprint[i]);
+		}
+
+		fprintf(filePointer, "\t%s\n", ((trust) ? trust : ""));
+	}];
+
+	fclose(filePointer);
+
+	return data;
+}
+
+- (void)_writeData:(NSData *)data toPath:(NSString *)path
+{
+	CFAbsoluteTime writeStart = CFAbsoluteTimeGetCurrent();
+
+	/* An atomic write goes to a temporary file which then replaces the
+	 original so the file on disk is never left half written. */
+	NSError *writeError = nil;
+
+	BOOL writeResult = [data writeToFile:path options:NSDataWritingAtomic error:&writeError];
+
+	CFAbsoluteTime writeDuration = (CFAbsoluteTimeGetCurrent() - writeStart);
+
+	if (writeResult) {
+		/* Every record in the journal was folded into the data
+		 written because records are appended on this queue
+		 in the same order as they were made. */
+		[self _closeJournalForFingerprintsPath:path];
+
+		self.fingerprintsSize = [data length];
+	} else {
+		LogToConsole(@"Failed to write fingerprints to '%@': %@", path, [writeError localizedDescription]);
+	}
+
+	/* Any write empties the journal. It is counted as a compaction
+	 when it is the first write since the journal grew too large. */
+	BOOL compacted = (writeResult && self.compactionRequested);
+
+	self.compactionRequested = NO;
+
+	@synchronized (self.writeStatistics) {
+		OTRKitWriteStatistics *writeStatistics = self.writeStatistics;
+
+		if (writeResult) {
+			writeStatistics.writeCount += 1;
+
+			writeStatistics.bytesWritten += [data length];
+
+			if (compacted) {
+				writeStatistics.compactionCount += 1;
+			}
+		} else {
+			writeStatistics.failedWriteCount += 1;
+		}
+
+		writeStatistics.totalWriteDuration += writeDuration;
+
+		writeStatistics.maximumWriteDuration = MAX(writeStatistics.maximumWriteDuration, writeDuration);
+	}
+
+	[self _recordWriteDuration:writeDuration];
+}
+
+- (void)_recordWriteDuration:(CFAbsoluteTime)writeDuration
+{
+	OTRKitEngine *engine = self.engine;
+
+	OTRKitMetricsRecordOperation([engine metricsCounters], OTRKitMetricsOperationFingerprintsWrite, (uint64_t)(writeDuration * NSEC_PER_SEC), 0);
+}
+
+- (OTRKitWriteStatistics *)statistics
+{
+	OTRKitWriteStatistics *statistics = [OTRKitWriteStatistics new];
+
+	@synchronized (self.writeStatistics) {
+		[statistics addStatistics:self.writeStatistics];
+	}
+
+	return statistics;
+}
+
+@end
@@ -0,0 +1,85 @@
+/* *********************************************************************
+
+        Copyright (c) 2010 - 2015 Codeux Software, LLC
+     Please see ACKNOWLEDGEMENT for additional information.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+
+ * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+ * Neither the name of "Codeux Software, LLC", nor the names of its 
+   contributors may be used to endorse or promote products derived 
+   from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ SUCH DAMAGE.
+
+ *********************************************************************** */
+
+NS_ASSUME_NONNULL_BEGIN
+
+typedef NS_ENUM(NSUInteger, OTRKitKeyGenerationState) {
+	/* The key was started and is waiting for a processor core. */
+	OTRKitKeyGenerationStateQueued,
+
+	/* The key is being calculated or stored. */
+	OTRKitKeyGenerationStateRunning,
+
+	/* The key was generated and stored. */
+	OTRKitKeyGenerationStateFinished,
+
+	/* The key could not be generated or stored. See error. */
+	OTRKitKeyGenerationStateFailed
+};
+
+/**
+ *  The state of the generation of the private key of an account.
+ *  Obtained from -[OTRKit keyGenerationJobForAccountName:protocol:]
+ *
+ *  A job is an immutable snapshot. A new one replaces it each
+ *  time the state changes.
+ */
+@interface OTRKitKeyGenerationJob : NSObject
+@property (readonly, copy) NSString *accountName;
+@property (readonly, copy) NSString *protocol;
+
+@property (readonly) OTRKitKeyGenerationState state;
+
+/**
+ *  When the job was queued, when the key began being calculated,
+ *  and when the job was finished or failed.
+ */
+@property (readonly, copy) NSDate *queueDate;
+@property (readonly, copy, nullable) NSDate *startDate;
+@property (readonly, copy, nullable) NSDate *finishDate;
+
+/**
+ *  Time spent since the key began being calculated, until the job was
+ *  finished or failed, or until now if it is still running. Zero when
+ *  the job is queued.
+ */
+@property (readonly) NSTimeInterval elapsedTime;
+
+@property (readonly, copy, nullable) NSError *error;
+
+/**
+ *  YES when the state is queued or running.
+ */
+@property (readonly, getter=isActive) BOOL active;
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,119 @@
+/* *********************************************************************
+
+        Copyright (c) 2010 - 2015 Codeux Software, LLC
+     Please see ACKNOWLEDGEMENT for additional information.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+
+ * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+ * Neither the name of "Codeux Software, LLC", nor the names of its 
+   contributors may be used to endorse or promote products derived 
+   from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ SUCH DAMAGE.
+
+ *********************************************************************** */
+
+#import "OTRKitKeyGenerationJobPrivate.h"
+
+@interface OTRKitKeyGenerationJob ()
+@property (readwrite, copy) NSString *accountName;
+@property (readwrite, copy) NSString *protocol;
+@property (readwrite, assign) OTRKitKeyGenerationState state;
+@property (readwrite, copy) NSDate *queueDate;
+@property (readwrite, copy) NSDate *startDate;
+@property (readwrite, copy) NSDate *finishDate;
+@property (readwrite, copy) NSError *error;
+@end
+
+@implementation OTRKitKeyGenerationJob
+
+- (instancetype)initWithAccountName:(NSString *)accountName protocol:(NSString *)protocol
+{
+	AssertParamaterLength(accountName)
+	AssertParamaterLength(protocol)
+
+	if ((self = [super init])) {
+		self.accountName = accountName;
+		self.protocol = protocol;
+
+		self.state = OTRKitKeyGenerationStateQueued;
+
+		self.queueDate = [NSDate date];
+
+		return self;
+	}
+
+	return nil;
+}
+
+- (instancetype)jobWithState:(OTRKitKeyGenerationState)state error:(NSError *)error
+{
+	OTRKitKeyGenerationJob *job = [[OTRKitKeyGenerationJob alloc] initWithAccountName:self.accountName protocol:self.protocol];
+
+	job.state = state;
+
+	job.queueDate = self.queueDate;
+	job.startDate = self.startDate;
+	job.finishDate = self.finishDate;
+
+	job.error = error;
+
+	if (state == OTRKitKeyGenerationStateRunning && job.startDate == nil) {
+		job.startDate = [NSDate date];
+	}
+
+	if (state == OTRKitKeyGenerationStateFinished ||
+		state == OTRKitKeyGenerationStateFailed)
+	{
+		job.finishDate = [NSDate date];
+	}
+
+	return job;
+}
+
+- (NSTimeInterval)elapsedTime
+{
+	NSDate *startDate = self.startDate;
+
+	if (startDate == nil) {
+		return 0;
+	}
+
+	NSDate *finishDate = self.finishDate;
+
+	if (finishDate == nil) {
+		return (-[startDate timeIntervalSinceNow]);
+	}
+
+	return [finishDate timeIntervalSinceDate:startDate];
+}
+
+- (BOOL)isActive
+{
+	return (self.state == OTRKitKeyGenerationStateQueued ||
+			self.state == OTRKitKeyGenerationStateRunning);
+}
+
+- (NSString *)description
+{
+	return [NSString stringWithFormat:@"<%@: %@ <-> %@ state: %lu elapsed: %f>", [self class], self.accountName, self.protocol, (unsigned long)self.state, [self elapsedTime]];
+}
+
+@end
@@ -0,0 +1,82 @@
+/* *********************************************************************
+
+        Copyright (c) 2010 - 2015 Codeux Software, LLC
+     Please see ACKNOWLEDGEMENT for additional information.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+
+ * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+ * Neither the name of "Codeux Software, LLC", nor the names of its 
+   contributors may be used to endorse or promote products derived 
+   from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ SUCH DAMAGE.
+
+ *********************************************************************** */
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ *  Timings of the phases OTRKit went through to load its private keys,
+ *  fingerprints, and instance tags. Obtained from -[OTRKit loadStatistics]
+ *
+ *  When sharding is enabled, the values of all engines are added together.
+ */
+@interface OTRKitLoadStatistics : NSObject
+/**
+ *  Number of engines loaded from a snapshot, from the original files,
+ *  and from the storage assigned to -[OTRKit storage]
+ */
+@property (readonly) NSUInteger snapshotLoadCount;
+@property (readonly) NSUInteger fileLoadCount;
+@property (readonly) NSUInteger storageLoadCount;
+
+/**
+ *  Time spent mapping the snapshot and rebuilding the fingerprints from it.
+ *  This includes the private keys and instance tags stored in the snapshot.
+ */
+@property (readonly) NSTimeInterval snapshotReadDuration;
+
+/**
+ *  Time spent reading each of the original files, one after another.
+ *  When a storage is used, these are the time spent reading the records
+ *  of the storage.
+ */
+@property (readonly) NSTimeInterval privateKeysReadDuration;
+@property (readonly) NSTimeInterval fingerprintsReadDuration;
+@property (readonly) NSTimeInterval instanceTagsReadDuration;
+
+/**
+ *  Time spent applying the fingerprints journal.
+ */
+@property (readonly) NSTimeInterval journalReplayDuration;
+
+/**
+ *  Time spent on the internal queue building a new snapshot after
+ *  the original files were read.
+ */
+@property (readonly) NSTimeInterval snapshotCreateDuration;
+
+/**
+ *  Time the internal queue was unavailable because of loading.
+ */
+@property (readonly) NSTimeInterval totalDuration;
+@end
+
+NS_ASSUME_NONNULL_END
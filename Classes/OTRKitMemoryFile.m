@@ -0,0 +1,124 @@
+/* *********************************************************************
+
+        Copyright (c) 2010 - 2015 Codeux Software, LLC
+     Please see ACKNOWLEDGEMENT for additional information.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+
+ * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+ * Neither the name of "Codeux Software, LLC", nor the names of its 
+   contributors may be used to endorse or promote products derived 
+   from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ SUCH DAMAGE.
+
+ *********************************************************************** */
+
+#import "OTRKitMemoryFile.h"
+
+typedef struct {
+	const void *data;
+	size_t offset;
+} OTRKitMemoryFileReader;
+
+static int memory_file_write_cb(void *cookie, const char *buffer, int length)
+{
+	NSMutableData *data = (__bridge NSMutableData *)(cookie);
+
+	[data appendBytes:buffer length:length];
+
+	return length;
+}
+
+static int memory_file_write_close_cb(void *cookie)
+{
+	CFBridgingRelease(cookie);
+
+	return 0;
+}
+
+static int memory_file_read_cb(void *cookie, char *buffer, int length)
+{
+	OTRKitMemoryFileReader *reader = cookie;
+
+	NSData *data = (__bridge NSData *)(reader->data);
+
+	size_t lengthRemaining = ([data length] - reader->offset);
+
+	if ((size_t)length > lengthRemaining) {
+		length = (int)lengthRemaining;
+	}
+
+	memcpy(buffer, ((const char *)[data bytes] + reader->offset), length);
+
+	reader->offset += length;
+
+	return length;
+}
+
+static int memory_file_read_close_cb(void *cookie)
+{
+	OTRKitMemoryFileReader *reader = cookie;
+
+	CFBridgingRelease(reader->data);
+
+	free(reader);
+
+	return 0;
+}
+
+FILE *OTRKitMemoryFileOpenForWriting(NSMutableData *data)
+{
+	NSCParameterAssert(data != nil);
+
+	void *cookie = (void *)CFBridgingRetain(data);
+
+	FILE *filePointer = funopen(cookie, NULL, memory_file_write_cb, NULL, memory_file_write_close_cb);
+
+	if (filePointer == NULL) {
+		CFBridgingRelease(cookie);
+	}
+
+	return filePointer;
+}
+
+FILE *OTRKitMemoryFileOpenForReading(NSData *data)
+{
+	NSCParameterAssert(data != nil);
+
+	OTRKitMemoryFileReader *reader = malloc(sizeof(OTRKitMemoryFileReader));
+
+	if (reader == NULL) {
+		return NULL;
+	}
+
+	reader->data = CFBridgingRetain(data);
+
+	reader->offset = 0;
+
+	FILE *filePointer = funopen(reader, memory_file_read_cb, NULL, NULL, memory_file_read_close_cb);
+
+	if (filePointer == NULL) {
+		CFBridgingRelease(reader->data);
+
+		free(reader);
+	}
+
+	return filePointer;
+}
@@ -0,0 +1,339 @@
+/* *********************************************************************
+
+        Copyright (c) 2010 - 2015 Codeux Software, LLC
+     Please see ACKNOWLEDGEMENT for additional information.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+
+ * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+ * Neither the name of "Codeux Software, LLC", nor the names of its 
+   contributors may be used to endorse or promote products derived 
+   from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ SUCH DAMAGE.
+
+ *********************************************************************** */
+
+#import "OTRKitPrivate.h"
+#import "OTRKitMemoryStorage.h"
+
+@interface OTRKitMemoryStorageTransaction : NSObject <OTRKitStorageTransaction>
+@property (nonatomic, strong) NSMutableArray<dispatch_block_t> *operations;
+@property (nonatomic, weak) OTRKitMemoryStorage *storage;
+@end
+
+@interface OTRKitMemoryStorage ()
+/* All three are only accessed while synchronized on self */
+@property (nonatomic, strong) NSMutableDictionary<NSString *, OTRKitPrivateKeyRecord *> *privateKeys;
+@property (nonatomic, strong) NSMutableDictionary<NSString *, OTRKitInstanceTagRecord *> *instanceTags;
+@property (nonatomic, strong) NSMutableDictionary<NSString *, NSMutableDictionary<NSData *, OTRKitFingerprintRecord *> *> *fingerprints;
+
+/* Called by transactions while synchronized on self */
+- (void)_setPrivateKey:(OTRKitPrivateKeyRecord *)privateKey;
+- (void)_setInstanceTag:(OTRKitInstanceTagRecord *)instanceTag;
+- (void)_setFingerprint:(OTRKitFingerprintRecord *)fingerprint;
+- (void)_removeFingerprint:(OTRKitFingerprintRecord *)fingerprint;
+- (void)_removeAllFingerprintsForAccountName:(NSString *)accountName protocol:(NSString *)protocol;
+@end
+
+static NSString *OTRKitMemoryStorageAccountKey(NSString *accountName, NSString *protocol)
+{
+	return [NSString stringWithFormat:@"%@\n%@", accountName, protocol];
+}
+
+static NSString *OTRKitMemoryStoragePeerKey(NSString *username, NSString *accountName, NSString *protocol)
+{
+	return [NSString stringWithFormat:@"%@\n%@\n%@", username, accountName, protocol];
+}
+
+static BOOL OTRKitMemoryStorageRecordMatches(NSString *accountName, NSString *protocol, NSString *accountNameFilter, NSString *protocolFilter)
+{
+	if (accountNameFilter && [accountName isEqualToString:accountNameFilter] == NO) {
+		return NO;
+	}
+
+	if (protocolFilter && [protocol isEqualToString:protocolFilter] == NO) {
+		return NO;
+	}
+
+	return YES;
+}
+
+/* Orders records the way libotr orders its context list, but reversed. */
+static NSComparisonResult OTRKitMemoryStorageCompareFingerprints(OTRKitFingerprintRecord *record1, OTRKitFingerprintRecord *record2)
+{
+	int comparison = strcmp([[record1 username] UTF8String], [[record2 username] UTF8String]);
+
+	if (comparison == 0) {
+		comparison = strcmp([[record1 accountName] UTF8String], [[record2 accountName] UTF8String]);
+	}
+
+	if (comparison == 0) {
+		comparison = strcmp([[record1 protocol] UTF8String], [[record2 protocol] UTF8String]);
+	}
+
+	if (comparison > 0) {
+		return NSOrderedAscending;
+	} else if (comparison < 0) {
+		return NSOrderedDescending;
+	}
+
+	return NSOrderedSame;
+}
+
+@implementation OTRKitMemoryStorage
+
+- (instancetype)init
+{
+	if ((self = [super init])) {
+		self.privateKeys = [NSMutableDictionary dictionary];
+		self.instanceTags = [NSMutableDictionary dictionary];
+
+		self.fingerprints = [NSMutableDictionary dictionary];
+
+		return self;
+	}
+
+	return nil;
+}
+
+#pragma mark -
+#pragma mark Reading
+
+- (NSArray<OTRKitPrivateKeyRecord *> *)privateKeysForAccountName:(NSString *)accountName protocol:(NSString *)protocol
+{
+	NSMutableArray *records = [NSMutableArray array];
+
+	@synchronized (self) {
+		for (OTRKitPrivateKeyRecord *record in [self.privateKeys objectEnumerator]) {
+			if (OTRKitMemoryStorageRecordMatches([record accountName], [record protocol], accountName, protocol)) {
+				[records addObject:record];
+			}
+		}
+	}
+
+	return [records copy];
+}
+
+- (NSArray<OTRKitInstanceTagRecord *> *)instanceTagsForAccountName:(NSString *)accountName protocol:(NSString *)protocol
+{
+	NSMutableArray *records = [NSMutableArray array];
+
+	@synchronized (self) {
+		for (OTRKitInstanceTagRecord *record in [self.instanceTags objectEnumerator]) {
+			if (OTRKitMemoryStorageRecordMatches([record accountName], [record protocol], accountName, protocol)) {
+				[records addObject:record];
+			}
+		}
+	}
+
+	return [records copy];
+}
+
+- (void)enumerateFingerprintsForAccountName:(NSString *)accountName protocol:(NSString *)protocol usingBlock:(void (NS_NOESCAPE ^)(OTRKitFingerprintRecord *fingerprint))block
+{
+	AssertParamaterNil(block)
+
+	NSMutableArray<OTRKitFingerprintRecord *> *records = [NSMutableArray array];
+
+	@synchronized (self) {
+		for (NSDictionary *peerFingerprints in [self.fingerprints objectEnumerator]) {
+			for (OTRKitFingerprintRecord *record in [peerFingerprints objectEnumerator]) {
+				if (OTRKitMemoryStorageRecordMatches([record accountName], [record protocol], accountName, protocol)) {
+					[records addObject:record];
+				}
+			}
+		}
+	}
+
+	/* The block is called outside of the lock so that it may
+	 call back into the storage without deadlocking. */
+	[records sortUsingComparator:^NSComparisonResult(OTRKitFingerprintRecord *record1, OTRKitFingerprintRecord *record2) {
+		return OTRKitMemoryStorageCompareFingerprints(record1, record2);
+	}];
+
+	for (OTRKitFingerprintRecord *record in records) {
+		block(record);
+	}
+}
+
+- (NSArray<OTRKitFingerprintRecord *> *)fingerprintsForUsername:(NSString *)username accountName:(NSString *)accountName protocol:(NSString *)protocol
+{
+	AssertParamaterLength(username)
+	AssertParamaterLength(accountName)
+	AssertParamaterLength(protocol)
+
+	NSString *peerKey = OTRKitMemoryStoragePeerKey(username, accountName, protocol);
+
+	@synchronized (self) {
+		NSDictionary *peerFingerprints = self.fingerprints[peerKey];
+
+		if (peerFingerprints == nil) {
+			return @[];
+		}
+
+		return [peerFingerprints allValues];
+	}
+}
+
+#pragma mark -
+#pragma mark Writing
+
+- (BOOL)performTransaction:(void (NS_NOESCAPE ^)(id<OTRKitStorageTransaction> transaction))block error:(NSError **)error
+{
+	AssertParamaterNil(block)
+
+	OTRKitMemoryStorageTransaction *transaction = [OTRKitMemoryStorageTransaction new];
+
+	transaction.storage = self;
+
+	transaction.operations = [NSMutableArray array];
+
+	block(transaction);
+
+	/* Operations are staged by the transaction and only applied
+	 here so that readers never observe half of a transaction. */
+	@synchronized (self) {
+		for (dispatch_block_t operation in transaction.operations) {
+			operation();
+		}
+	}
+
+	transaction.operations = nil;
+
+	return YES;
+}
+
+- (void)_setPrivateKey:(OTRKitPrivateKeyRecord *)privateKey
+{
+	NSString *accountKey = OTRKitMemoryStorageAccountKey([privateKey accountName], [privateKey protocol]);
+
+	self.privateKeys[accountKey] = privateKey;
+}
+
+- (void)_setInstanceTag:(OTRKitInstanceTagRecord *)instanceTag
+{
+	NSString *accountKey = OTRKitMemoryStorageAccountKey([instanceTag accountName], [instanceTag protocol]);
+
+	self.instanceTags[accountKey] = instanceTag;
+}
+
+- (void)_setFingerprint:(OTRKitFingerprintRecord *)fingerprint
+{
+	NSString *peerKey = OTRKitMemoryStoragePeerKey([fingerprint username], [fingerprint accountName], [fingerprint protocol]);
+
+	NSMutableDictionary *peerFingerprints = self.fingerprints[peerKey];
+
+	if (peerFingerprints == nil) {
+		peerFingerprints = [NSMutableDictionary dictionary];
+
+		self.fingerprints[peerKey] = peerFingerprints;
+	}
+
+	peerFingerprints[[fingerprint fingerprint]] = fingerprint;
+}
+
+- (void)_removeFingerprint:(OTRKitFingerprintRecord *)fingerprint
+{
+	NSString *peerKey = OTRKitMemoryStoragePeerKey([fingerprint username], [fingerprint accountName], [fingerprint protocol]);
+
+	NSMutableDictionary *peerFingerprints = self.fingerprints[peerKey];
+
+	[peerFingerprints removeObjectForKey:[fingerprint fingerprint]];
+
+	if ([peerFingerprints count] == 0) {
+		[self.fingerprints removeObjectForKey:peerKey];
+	}
+}
+
+- (void)_removeAllFingerprintsForAccountName:(NSString *)accountName protocol:(NSString *)protocol
+{
+	NSMutableArray *peerKeys = [NSMutableArray array];
+
+	[self.fingerprints enumerateKeysAndObjectsUsingBlock:^(NSString *peerKey, NSDictionary *peerFingerprints, BOOL *stop) {
+		OTRKitFingerprintRecord *record = [[peerFingerprints objectEnumerator] nextObject];
+
+		if (record == nil || OTRKitMemoryStorageRecordMatches([record accountName], [record protocol], accountName, protocol)) {
+			[peerKeys addObject:peerKey];
+		}
+	}];
+
+	[self.fingerprints removeObjectsForKeys:peerKeys];
+}
+
+@end
+
+#pragma mark -
+
+@implementation OTRKitMemoryStorageTransaction
+
+- (void)setPrivateKey:(OTRKitPrivateKeyRecord *)privateKey
+{
+	AssertParamaterNil(privateKey)
+
+	OTRKitMemoryStorage *storage = self.storage;
+
+	[self.operations addObject:^{
+		[storage _setPrivateKey:privateKey];
+	}];
+}
+
+- (void)setFingerprint:(OTRKitFingerprintRecord *)fingerprint
+{
+	AssertParamaterNil(fingerprint)
+
+	OTRKitMemoryStorage *storage = self.storage;
+
+	[self.operations addObject:^{
+		[storage _setFingerprint:fingerprint];
+	}];
+}
+
+- (void)removeFingerprint:(OTRKitFingerprintRecord *)fingerprint
+{
+	AssertParamaterNil(fingerprint)
+
+	OTRKitMemoryStorage *storage = self.storage;
+
+	[self.operations addObject:^{
+		[storage _removeFingerprint:fingerprint];
+	}];
+}
+
+- (void)removeAllFingerprintsForAccountName:(NSString *)accountName protocol:(NSString *)protocol
+{
+	OTRKitMemoryStorage *storage = self.storage;
+
+	[self.operations addObject:^{
+		[storage _removeAllFingerprintsForAccountName:accountName protocol:protocol];
+	}];
+}
+
+- (void)setInstanceTag:(OTRKitInstanceTagRecord *)instanceTag
+{
+	AssertParamaterNil(instanceTag)
+
+	OTRKitMemoryStorage *storage = self.storage;
+
+	[self.operations addObject:^{
+		[storage _setInstanceTag:instanceTag];
+	}];
+}
+
+@end
@@ -0,0 +1,149 @@
+/* *********************************************************************
+
+        Copyright (c) 2010 - 2015 Codeux Software, LLC
+     Please see ACKNOWLEDGEMENT for additional information.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+
+ * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+ * Neither the name of "Codeux Software, LLC", nor the names of its 
+   contributors may be used to endorse or promote products derived 
+   from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ SUCH DAMAGE.
+
+ *********************************************************************** */
+
+NS_ASSUME_NONNULL_BEGIN
+
+@class OTRTLV;
+
+/**
+ *  A single message that is part of a batch handed to
+ *  -encodeMessages:username:accountName:protocol:
+ */
+@interface OTRKitOutgoingMessage : NSObject
+/**
+ * @param message	The message to be encoded
+ * @param tlvs		Array of OTRTLVs, the data length of each TLV must be smaller than UINT16_MAX or it will be ignored.
+ * @param tag		Optional tag to attach additional application-specific data to message. Only used locally.
+ */
+- (instancetype)initWithMessage:(nullable NSString *)message tlvs:(nullable NSArray<OTRTLV *> *)tlvs tag:(nullable id)tag;
+
+@property (readonly, copy, nullable) NSString *message;
+@property (readonly, copy) NSArray<OTRTLV *> *tlvs;
+@property (readonly, strong, nullable) id tag;
+@end
+
+/**
+ *  The result of encoding a single OTRKitOutgoingMessage.
+ */
+@interface OTRKitEncodedMessage : NSObject
+/**
+ *  The message that was encoded, as it was supplied.
+ */
+@property (readonly, copy, nullable) NSString *message;
+
+/**
+ *  The encoded message. nil when an error occurred.
+ */
+@property (readonly, copy, nullable) NSString *encodedMessage;
+
+/**
+ *  Whether or not encodedMessage is ciphertext, or just plaintext appended
+ *  with the opportunistic whitespace.
+ */
+@property (readonly) BOOL wasEncrypted;
+
+/**
+ *  The messages that must be sent to the remote user, in the order they
+ *  must be sent in. These are what would otherwise have been passed to the
+ *  injectMessage: delegate method, one at a time.
+ */
+@property (readonly, copy) NSArray<NSString *> *injectedMessages;
+
+@property (readonly, strong, nullable) id tag;
+
+@property (readonly, copy, nullable) NSError *error;
+@end
+
+typedef NS_ENUM(NSUInteger, OTRKitDecodedMessageStatus) {
+	/* The message was decoded and should be displayed. */
+	OTRKitDecodedMessageStatusDecoded,
+
+	/* The message was part of the OTR protocol and was consumed by
+	 libotr. There is nothing to display, but TLVs may be present. */
+	OTRKitDecodedMessageStatusProtocol,
+
+	/* The message was not decoded because the delegate asked for
+	 it to be ignored. */
+	OTRKitDecodedMessageStatusIgnored,
+
+	/* The message was not decoded. The error of the result says why. */
+	OTRKitDecodedMessageStatusFailed
+};
+
+/**
+ *  A single message that is part of a batch handed to
+ *  -decodeMessages:username:accountName:protocol:
+ */
+@interface OTRKitIncomingMessage : NSObject
+/**
+ * @param message	Encoded or plain text incoming message
+ * @param tag		Optional tag to attach additional application-specific data to message. Only used locally.
+ */
+- (instancetype)initWithMessage:(NSString *)message tag:(nullable id)tag;
+
+@property (readonly, copy) NSString *message;
+@property (readonly, strong, nullable) id tag;
+@end
+
+/**
+ *  The result of decoding a single OTRKitIncomingMessage.
+ */
+@interface OTRKitDecodedMessage : NSObject
+@property (readonly) OTRKitDecodedMessageStatus status;
+
+/**
+ *  The message that was decoded, as it was supplied.
+ */
+@property (readonly, copy) NSString *message;
+
+/**
+ *  Plain text message to display to the user. Only set when status
+ *  is OTRKitDecodedMessageStatusDecoded.
+ */
+@property (readonly, copy, nullable) NSString *decodedMessage;
+
+/**
+ *  Whether or not the original message was encrypted or plain text.
+ */
+@property (readonly) BOOL wasEncrypted;
+
+@property (readonly, copy, nullable) NSArray<OTRTLV *> *tlvs;
+
+@property (readonly, strong, nullable) id tag;
+
+/**
+ *  Only set when status is OTRKitDecodedMessageStatusFailed.
+ */
+@property (readonly, copy, nullable) NSError *error;
+@end
+
+NS_ASSUME_NONNULL_END
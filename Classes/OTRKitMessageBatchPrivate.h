@@ -0,0 +1,63 @@
+/* *********************************************************************
+
+        Copyright (c) 2010 - 2015 Codeux Software, LLC
+     Please see ACKNOWLEDGEMENT for additional information.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+
+ * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+ * Neither the name of "Codeux Software, LLC", nor the names of its 
+   contributors may be used to endorse or promote products derived 
+   from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ SUCH DAMAGE.
+
+ *********************************************************************** */
+
+#import "OTRKitMessageBatch.h"
+
+@interface OTRKitOutgoingMessage ()
+@property (nonatomic, readwrite, copy) NSString *message;
+@property (nonatomic, readwrite, copy) NSArray *tlvs;
+@property (nonatomic, readwrite, strong) id tag;
+@end
+
+@interface OTRKitEncodedMessage ()
+@property (nonatomic, readwrite, copy) NSString *message;
+@property (nonatomic, readwrite, copy) NSString *encodedMessage;
+@property (readwrite, assign) BOOL wasEncrypted;
+@property (nonatomic, readwrite, copy) NSArray *injectedMessages;
+@property (nonatomic, readwrite, strong) id tag;
+@property (nonatomic, readwrite, copy) NSError *error;
+@end
+
+@interface OTRKitIncomingMessage ()
+@property (nonatomic, readwrite, copy) NSString *message;
+@property (nonatomic, readwrite, strong) id tag;
+@end
+
+@interface OTRKitDecodedMessage ()
+@property (readwrite, assign) OTRKitDecodedMessageStatus status;
+@property (nonatomic, readwrite, copy) NSString *message;
+@property (nonatomic, readwrite, copy) NSString *decodedMessage;
+@property (readwrite, assign) BOOL wasEncrypted;
+@property (nonatomic, readwrite, copy) NSArray *tlvs;
+@property (nonatomic, readwrite, strong) id tag;
+@property (nonatomic, readwrite, copy) NSError *error;
+@end
@@ -0,0 +1,172 @@
+/* *********************************************************************
+
+        Copyright (c) 2010 - 2015 Codeux Software, LLC
+     Please see ACKNOWLEDGEMENT for additional information.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+
+ * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+ * Neither the name of "Codeux Software, LLC", nor the names of its 
+   contributors may be used to endorse or promote products derived 
+   from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ SUCH DAMAGE.
+
+ *********************************************************************** */
+
+#import "OTRKitMessageClassifier.h"
+
+/* The libotr constants are not used directly because the values below are
+ compared against. If libotr ever changes them, so must these. */
+static const char OTRKitQueryTag[] = "?OTR";
+
+/* OTRL_MESSAGE_TAG_BASE */
+static const char OTRKitWhitespaceTagBase[] = " \t  \t\t\t\t \t \t \t  ";
+
+#define OTRKitConstantLength(c)			(sizeof(c) - 1)
+
+/* memchr() is vectorized by the C library which makes scanning for the
+ first byte of the needle much faster than comparing one byte at a time. */
+static const char *otrkit_find_bytes(const char *haystack, size_t haystackLength, const char *needle, size_t needleLength)
+{
+	if (needleLength == 0 || needleLength > haystackLength) {
+		return NULL;
+	}
+
+	const char *lastCandidate = (haystack + (haystackLength - needleLength));
+
+	const char *cursor = haystack;
+
+	while (cursor <= lastCandidate) {
+		cursor = memchr(cursor, needle[0], ((lastCandidate - cursor) + 1));
+
+		if (cursor == NULL) {
+			return NULL;
+		}
+
+		if (memcmp(cursor, needle, needleLength) == 0) {
+			return cursor;
+		}
+
+		cursor++;
+	}
+
+	return NULL;
+}
+
+OTRKitMessageType OTRKitMessageTypeForBytes(const char *bytes, size_t length)
+{
+	if (bytes == NULL) {
+		return OTRKitMessageTypeNotOTR;
+	}
+
+	/* libotr operates on C strings so nothing after a NUL byte is considered. */
+	const char *terminator = memchr(bytes, '\0', length);
+
+	if (terminator) {
+		length = (terminator - bytes);
+	}
+
+	const char *otrTag = otrkit_find_bytes(bytes, length, OTRKitQueryTag, OTRKitConstantLength(OTRKitQueryTag));
+
+	if (otrTag == NULL) {
+		if (otrkit_find_bytes(bytes, length, OTRKitWhitespaceTagBase, OTRKitConstantLength(OTRKitWhitespaceTagBase))) {
+			return OTRKitMessageTypeTaggedPlainText;
+		} else {
+			return OTRKitMessageTypeNotOTR;
+		}
+	}
+
+	size_t remainingLength = (length - (otrTag - bytes));
+
+	/* "?OTR?" and "?OTRv" */
+	if (remainingLength >= 5) {
+		if (otrTag[4] == '?' || otrTag[4] == 'v') {
+			return OTRKitMessageTypeQuery;
+		}
+	}
+
+	/* "?OTR:AA" followed by the protocol version (I = 2, M = 3) and message type */
+	if (remainingLength >= 9 && memcmp((otrTag + 4), ":AA", 3) == 0) {
+		char protocolVersion = otrTag[7];
+
+		if (protocolVersion != 'I' && protocolVersion != 'M') {
+			return OTRKitMessageTypeUnknown;
+		}
+
+		switch (otrTag[8]) {
+			case 'C':
+			{
+				return OTRKitMessageTypeDHCommit;
+			}
+			case 'K':
+			{
+				return OTRKitMessageTypeDHKey;
+			}
+			case 'R':
+			{
+				return OTRKitMessageTypeRevealSignature;
+			}
+			case 'S':
+			{
+				return OTRKitMessageTypeSignature;
+			}
+			case 'D':
+			{
+				return OTRKitMessageTypeData;
+			}
+			default:
+			{
+				return OTRKitMessageTypeUnknown;
+			}
+		}
+	}
+
+	/* "?OTR Error:" */
+	if (remainingLength >= 11 && memcmp((otrTag + 4), " Error:", 7) == 0) {
+		return OTRKitMessageTypeError;
+	}
+
+	/* Fragments ("?OTR|" and "?OTR,") are reported as unknown by libotr. */
+	return OTRKitMessageTypeUnknown;
+}
+
+OTRKitMessageType OTRKitMessageTypeForUTF8String(const char *string)
+{
+	if (string == NULL) {
+		return OTRKitMessageTypeNotOTR;
+	}
+
+	return OTRKitMessageTypeForBytes(string, strlen(string));
+}
+
+OTRKitMessageType OTRKitMessageTypeForString(NSString *string)
+{
+	if (string == nil) {
+		return OTRKitMessageTypeNotOTR;
+	}
+
+	const char *stringBytes = CFStringGetCStringPtr((__bridge CFStringRef)string, kCFStringEncodingUTF8);
+
+	if (stringBytes == NULL) {
+		stringBytes = [string UTF8String];
+	}
+
+	return OTRKitMessageTypeForUTF8String(stringBytes);
+}
@@ -0,0 +1,125 @@
+/* *********************************************************************
+
+        Copyright (c) 2010 - 2015 Codeux Software, LLC
+     Please see ACKNOWLEDGEMENT for additional information.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+
+ * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+ * Neither the name of "Codeux Software, LLC", nor the names of its 
+   contributors may be used to endorse or promote products derived 
+   from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ SUCH DAMAGE.
+
+ *********************************************************************** */
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ *  Operations whose latency is measured.
+ *
+ *  Messages that carry the authenticated key exchange are counted as
+ *  OTRKitMetricsOperationKeyExchange, and those that advance the socialist
+ *  millionaires' protocol as OTRKitMetricsOperationSMP, instead of being
+ *  counted as encode or decode.
+ */
+typedef NS_ENUM(NSUInteger, OTRKitMetricsOperation) {
+	OTRKitMetricsOperationEncode,
+	OTRKitMetricsOperationDecode,
+	OTRKitMetricsOperationKeyExchange,
+	OTRKitMetricsOperationSMP,
+	OTRKitMetricsOperationKeyGeneration,
+	OTRKitMetricsOperationSymmetricKey,
+	OTRKitMetricsOperationFingerprintsWrite
+};
+
+#define OTRKitMetricsOperationCount			7
+
+/**
+ *  Bucket zero counts operations that took less than a microsecond.
+ *  Each following bucket counts those that took less than twice the
+ *  time of the bucket before it. The last bucket counts the rest.
+ */
+#define OTRKitMetricsHistogramBucketCount	24
+
+/**
+ *  Times are in nanoseconds.
+ */
+typedef struct {
+	uint64_t count;
+
+	/* Time spent in libotr, or on the writer queue for fingerprint writes */
+	uint64_t libotrTime;
+
+	/* Time spent waiting for the internal queue before the operation began */
+	uint64_t queueWaitTime;
+
+	uint64_t maximumTime;
+
+	/* Histogram of the sum of the two times above */
+	uint64_t histogram[OTRKitMetricsHistogramBucketCount];
+} OTRKitOperationMetrics;
+
+typedef struct {
+	/* Number of blocks waiting on, or running on, the internal queues
+	 and the delegate queue at the time the snapshot was taken */
+	uint64_t internalQueueDepth;
+	uint64_t delegateQueueDepth;
+
+	/* Number of master contexts that libotr holds for conversations that
+	 were looked up, and number of fingerprints that libotr holds */
+	uint64_t contextCount;
+	uint64_t fingerprintCount;
+
+	OTRKitOperationMetrics operations[OTRKitMetricsOperationCount];
+} OTRKitMetricsValues;
+
+/**
+ *  A snapshot of the counters OTRKit keeps of the work it does.
+ *  Obtained from -[OTRKit metrics]
+ *
+ *  The counters are always kept. When sharding is enabled, the values
+ *  of all engines are added together.
+ */
+@interface OTRKitMetrics : NSObject
+@property (readonly) OTRKitMetricsValues values;
+
+/**
+ *  The name used for the operation in -dictionaryRepresentation
+ */
++ (NSString *)nameOfOperation:(OTRKitMetricsOperation)operation;
+
+/**
+ *  The time, in nanoseconds, that operations counted by a bucket of
+ *  the histogram took less than. The bound is exclusive: an operation
+ *  that took exactly this long is counted by the next bucket.
+ *  UINT64_MAX for the last bucket.
+ */
++ (uint64_t)upperBoundOfHistogramBucket:(NSUInteger)bucket;
+
+/**
+ *  The values as a dictionary of numbers suitable for exporting.
+ *  Operations are keyed by their name. Buckets of a histogram
+ *  that did not count anything are left out.
+ */
+- (NSDictionary<NSString *, id> *)dictionaryRepresentation;
+@end
+
+NS_ASSUME_NONNULL_END
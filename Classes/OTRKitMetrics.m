@@ -0,0 +1,315 @@
+/* *********************************************************************
+
+        Copyright (c) 2010 - 2015 Codeux Software, LLC
+     Please see ACKNOWLEDGEMENT for additional information.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+
+ * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+ * Neither the name of "Codeux Software, LLC", nor the names of its 
+   contributors may be used to endorse or promote products derived 
+   from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ SUCH DAMAGE.
+
+ *********************************************************************** */
+
+#import "OTRKitMetricsCounters.h"
+
+#include <stdatomic.h>
+#include <mach/mach_time.h>
+
+typedef struct {
+	atomic_uint_fast64_t count;
+	atomic_uint_fast64_t libotrTime;
+	atomic_uint_fast64_t queueWaitTime;
+	atomic_uint_fast64_t maximumTime;
+	atomic_uint_fast64_t histogram[OTRKitMetricsHistogramBucketCount];
+} OTRKitOperationCounters;
+
+struct OTRKitMetricsCounters {
+	atomic_int_fast64_t internalQueueDepth;
+	atomic_int_fast64_t delegateQueueDepth;
+
+	atomic_int_fast64_t contextCount;
+	atomic_int_fast64_t fingerprintCount;
+
+	OTRKitOperationCounters operations[OTRKitMetricsOperationCount];
+};
+
+OTRKitMetricsCounters *OTRKitMetricsCountersCreate(void)
+{
+	/* Zeroed memory is a valid initial state for lock-free atomics */
+	return calloc(1, sizeof(OTRKitMetricsCounters));
+}
+
+void OTRKitMetricsCountersFree(OTRKitMetricsCounters *counters)
+{
+	free(counters);
+}
+
+uint64_t OTRKitMetricsNow(void)
+{
+	static mach_timebase_info_data_t timebase;
+
+	static dispatch_once_t onceToken;
+
+	dispatch_once(&onceToken, ^{
+		mach_timebase_info(&timebase);
+	});
+
+	uint64_t now = mach_absolute_time();
+
+	if (timebase.numer == timebase.denom) {
+		return now;
+	}
+
+	return ((now * timebase.numer) / timebase.denom);
+}
+
+static NSUInteger histogram_bucket_for_time(uint64_t time)
+{
+	uint64_t microseconds = (time / NSEC_PER_USEC);
+
+	if (microseconds == 0) {
+		return 0;
+	}
+
+	NSUInteger bucket = (NSUInteger)(64 - __builtin_clzll(microseconds));
+
+	return MIN(bucket, (OTRKitMetricsHistogramBucketCount - 1));
+}
+
+void OTRKitMetricsRecordOperation(OTRKitMetricsCounters *counters, OTRKitMetricsOperation operation, uint64_t libotrTime, uint64_t queueWaitTime)
+{
+	if (counters == NULL) {
+		return;
+	}
+
+	OTRKitOperationCounters *operationCounters = &counters->operations[operation];
+
+	uint64_t totalTime = (libotrTime + queueWaitTime);
+
+	atomic_fetch_add_explicit(&operationCounters->count, 1, memory_order_relaxed);
+
+	atomic_fetch_add_explicit(&operationCounters->libotrTime, libotrTime, memory_order_relaxed);
+	atomic_fetch_add_explicit(&operationCounters->queueWaitTime, queueWaitTime, memory_order_relaxed);
+
+	atomic_fetch_add_explicit(&operationCounters->histogram[histogram_bucket_for_time(totalTime)], 1, memory_order_relaxed);
+
+	uint64_t maximumTime = atomic_load_explicit(&operationCounters->maximumTime, memory_order_relaxed);
+
+	while (totalTime > maximumTime) {
+		if (atomic_compare_exchange_weak_explicit(&operationCounters->maximumTime, &maximumTime, totalTime, memory_order_relaxed, memory_order_relaxed)) {
+			break;
+		}
+	}
+}
+
+void OTRKitMetricsInternalQueueDidEnqueue(OTRKitMetricsCounters *counters)
+{
+	atomic_fetch_add_explicit(&counters->internalQueueDepth, 1, memory_order_relaxed);
+}
+
+void OTRKitMetricsInternalQueueDidDequeue(OTRKitMetricsCounters *counters)
+{
+	atomic_fetch_sub_explicit(&counters->internalQueueDepth, 1, memory_order_relaxed);
+}
+
+void OTRKitMetricsDelegateQueueDidEnqueue(OTRKitMetricsCounters *counters)
+{
+	atomic_fetch_add_explicit(&counters->delegateQueueDepth, 1, memory_order_relaxed);
+}
+
+void OTRKitMetricsDelegateQueueDidDequeue(OTRKitMetricsCounters *counters)
+{
+	atomic_fetch_sub_explicit(&counters->delegateQueueDepth, 1, memory_order_relaxed);
+}
+
+void OTRKitMetricsContextCountDidChange(OTRKitMetricsCounters *counters, int64_t change)
+{
+	if (counters == NULL) {
+		return;
+	}
+
+	atomic_fetch_add_explicit(&counters->contextCount, change, memory_order_relaxed);
+}
+
+void OTRKitMetricsFingerprintCountDidChange(OTRKitMetricsCounters *counters, int64_t change)
+{
+	if (counters == NULL) {
+		return;
+	}
+
+	atomic_fetch_add_explicit(&counters->fingerprintCount, change, memory_order_relaxed);
+}
+
+void OTRKitMetricsSetFingerprintCount(OTRKitMetricsCounters *counters, uint64_t fingerprintCount)
+{
+	if (counters == NULL) {
+		return;
+	}
+
+	atomic_store_explicit(&counters->fingerprintCount, (int_fast64_t)fingerprintCount, memory_order_relaxed);
+}
+
+void OTRKitMetricsCountersAddToValues(OTRKitMetricsCounters *counters, OTRKitMetricsValues *values)
+{
+	if (counters == NULL || values == NULL) {
+		return;
+	}
+
+	/* A depth can be read as negative for a moment because
+	 the counters are not read at the same time. */
+	int_fast64_t internalQueueDepth = atomic_load_explicit(&counters->internalQueueDepth, memory_order_relaxed);
+	int_fast64_t delegateQueueDepth = atomic_load_explicit(&counters->delegateQueueDepth, memory_order_relaxed);
+
+	values->internalQueueDepth += (uint64_t)MAX(internalQueueDepth, 0);
+	values->delegateQueueDepth += (uint64_t)MAX(delegateQueueDepth, 0);
+
+	int_fast64_t contextCount = atomic_load_explicit(&counters->contextCount, memory_order_relaxed);
+	int_fast64_t fingerprintCount = atomic_load_explicit(&counters->fingerprintCount, memory_order_relaxed);
+
+	values->contextCount += (uint64_t)MAX(contextCount, 0);
+	values->fingerprintCount += (uint64_t)MAX(fingerprintCount, 0);
+
+	for (NSUInteger operation = 0; operation < OTRKitMetricsOperationCount; operation++) {
+		OTRKitOperationCounters *operationCounters = &counters->operations[operation];
+
+		OTRKitOperationMetrics *operationMetrics = &values->operations[operation];
+
+		operationMetrics->count += atomic_load_explicit(&operationCounters->count, memory_order_relaxed);
+
+		operationMetrics->libotrTime += atomic_load_explicit(&operationCounters->libotrTime, memory_order_relaxed);
+		operationMetrics->queueWaitTime += atomic_load_explicit(&operationCounters->queueWaitTime, memory_order_relaxed);
+
+		operationMetrics->maximumTime = MAX(operationMetrics->maximumTime, atomic_load_explicit(&operationCounters->maximumTime, memory_order_relaxed));
+
+		for (NSUInteger bucket = 0; bucket < OTRKitMetricsHistogramBucketCount; bucket++) {
+			operationMetrics->histogram[bucket] += atomic_load_explicit(&operationCounters->histogram[bucket], memory_order_relaxed);
+		}
+	}
+}
+
+@implementation OTRKitMetrics
+
+- (instancetype)initWithValues:(OTRKitMetricsValues)values
+{
+	if ((self = [super init])) {
+		self->_values = values;
+
+		return self;
+	}
+
+	return nil;
+}
+
++ (NSString *)nameOfOperation:(OTRKitMetricsOperation)operation
+{
+	switch (operation)
+	{
+		case OTRKitMetricsOperationEncode:
+		{
+			return @"encode";
+		}
+		case OTRKitMetricsOperationDecode:
+		{
+			return @"decode";
+		}
+		case OTRKitMetricsOperationKeyExchange:
+		{
+			return @"ake";
+		}
+		case OTRKitMetricsOperationSMP:
+		{
+			return @"smp";
+		}
+		case OTRKitMetricsOperationKeyGeneration:
+		{
+			return @"keygen";
+		}
+		case OTRKitMetricsOperationSymmetricKey:
+		{
+			return @"symkey";
+		}
+		case OTRKitMetricsOperationFingerprintsWrite:
+		{
+			return @"fingerprints_write";
+		}
+	}
+
+	return @"unknown";
+}
+
++ (uint64_t)upperBoundOfHistogramBucket:(NSUInteger)bucket
+{
+	if (bucket >= (OTRKitMetricsHistogramBucketCount - 1)) {
+		return UINT64_MAX;
+	}
+
+	return ((1ULL << bucket) * NSEC_PER_USEC);
+}
+
+- (NSDictionary<NSString *, id> *)dictionaryRepresentation
+{
+	NSMutableDictionary *dictionary = [NSMutableDictionary dictionary];
+
+	dictionary[@"internal_queue_depth"] = @(self->_values.internalQueueDepth);
+	dictionary[@"delegate_queue_depth"] = @(self->_values.delegateQueueDepth);
+
+	dictionary[@"context_count"] = @(self->_values.contextCount);
+	dictionary[@"fingerprint_count"] = @(self->_values.fingerprintCount);
+
+	for (NSUInteger operation = 0; operation < OTRKitMetricsOperationCount; operation++) {
+		const OTRKitOperationMetrics *operationMetrics = &self->_values.operations[operation];
+
+		NSMutableDictionary *histogram = [NSMutableDictionary dictionary];
+
+		for (NSUInteger bucket = 0; bucket < OTRKitMetricsHistogramBucketCount; bucket++) {
+			if (operationMetrics->histogram[bucket] == 0) {
+				continue;
+			}
+
+			uint64_t upperBound = [OTRKitMetrics upperBoundOfHistogramBucket:bucket];
+
+			NSString *bucketName = nil;
+
+			/* The upper bound of a bucket is exclusive */
+			if (upperBound == UINT64_MAX) {
+				bucketName = @"lt_inf";
+			} else {
+				bucketName = [NSString stringWithFormat:@"lt_%llu_ns", upperBound];
+			}
+
+			histogram[bucketName] = @(operationMetrics->histogram[bucket]);
+		}
+
+		dictionary[[OTRKitMetrics nameOfOperation:operation]] = @{
+			@"count" : @(operationMetrics->count),
+			@"libotr_time_ns" : @(operationMetrics->libotrTime),
+			@"queue_wait_time_ns" : @(operationMetrics->queueWaitTime),
+			@"maximum_time_ns" : @(operationMetrics->maximumTime),
+			@"histogram" : [histogram copy]
+		};
+	}
+
+	return [dictionary copy];
+}
+
+@end
@@ -0,0 +1,80 @@
+/* *********************************************************************
+
+        Copyright (c) 2010 - 2015 Codeux Software, LLC
+     Please see ACKNOWLEDGEMENT for additional information.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+
+ * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+ * Neither the name of "Codeux Software, LLC", nor the names of its 
+   contributors may be used to endorse or promote products derived 
+   from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ SUCH DAMAGE.
+
+ *********************************************************************** */
+
+#import "OTRKitMetrics.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ *  Counters behind OTRKitMetrics. Each engine owns a set so that shards
+ *  do not contend with each other. Every counter is updated with a relaxed
+ *  atomic operation so that they can be updated from any thread and read
+ *  while they are being updated without taking a lock.
+ */
+typedef struct OTRKitMetricsCounters OTRKitMetricsCounters;
+
+OTRKitMetricsCounters *OTRKitMetricsCountersCreate(void);
+
+void OTRKitMetricsCountersFree(OTRKitMetricsCounters *counters);
+
+/**
+ *  Monotonic time in nanoseconds.
+ */
+uint64_t OTRKitMetricsNow(void);
+
+void OTRKitMetricsRecordOperation(OTRKitMetricsCounters *counters, OTRKitMetricsOperation operation, uint64_t libotrTime, uint64_t queueWaitTime);
+
+void OTRKitMetricsInternalQueueDidEnqueue(OTRKitMetricsCounters *counters);
+void OTRKitMetricsInternalQueueDidDequeue(OTRKitMetricsCounters *counters);
+
+void OTRKitMetricsDelegateQueueDidEnqueue(OTRKitMetricsCounters *counters);
+void OTRKitMetricsDelegateQueueDidDequeue(OTRKitMetricsCounters *counters);
+
+/**
+ *  The number of contexts is kept by the context index of the engine and
+ *  the number of fingerprints by the code that adds and removes them, so
+ *  that neither has to be counted by walking the user state.
+ */
+void OTRKitMetricsContextCountDidChange(OTRKitMetricsCounters * _Nullable counters, int64_t change);
+void OTRKitMetricsFingerprintCountDidChange(OTRKitMetricsCounters * _Nullable counters, int64_t change);
+void OTRKitMetricsSetFingerprintCount(OTRKitMetricsCounters * _Nullable counters, uint64_t fingerprintCount);
+
+/**
+ *  Adds the current value of each counter to the values.
+ */
+void OTRKitMetricsCountersAddToValues(OTRKitMetricsCounters *counters, OTRKitMetricsValues *values);
+
+@interface OTRKitMetrics ()
+- (instancetype)initWithValues:(OTRKitMetricsValues)values;
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,71 @@
+/* *********************************************************************
+
+        Copyright (c) 2010 - 2015 Codeux Software, LLC
+     Please see ACKNOWLEDGEMENT for additional information.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+
+ * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+ * Neither the name of "Codeux Software, LLC", nor the names of its 
+   contributors may be used to endorse or promote products derived 
+   from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ SUCH DAMAGE.
+
+ *********************************************************************** */
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ *  Presence of remote users that the application pushed to OTRKit.
+ *
+ *  Entries are keyed by the UTF-8 strings that libotr passes to its
+ *  callbacks, so answering libotr does not allocate. The cache is
+ *  guarded by a lock and can be used from any thread.
+ */
+@interface OTRKitPresenceCache : NSObject
+/**
+ *  Whether the application has pushed the presence of any user
+ *  since the cache was created or last emptied.
+ */
+@property (readonly, getter=isPushed) BOOL pushed;
+
+- (void)setLoggedIn:(BOOL)loggedIn forUsernames:(NSArray<NSString *> *)usernames accountName:(NSString *)accountName protocol:(NSString *)protocol;
+
+- (void)removeUsernames:(NSArray<NSString *> *)usernames accountName:(NSString *)accountName protocol:(NSString *)protocol;
+
+/**
+ *  Removes every user seen from an account.
+ */
+- (void)removeAllUsernamesForAccountName:(NSString *)accountName protocol:(NSString *)protocol;
+
+/**
+ *  Removes every user and marks the presence as no longer pushed.
+ */
+- (void)removeAllUsernames;
+
+/**
+ *  Returns 1 if the user is online, 0 if they are not, or -1
+ *  if their presence is not known. These are the values libotr
+ *  expects from its is_logged_in callback.
+ */
+- (int)loggedInStateForUsername:(const char *)username accountName:(const char *)accountName protocol:(const char *)protocol;
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,256 @@
+/* *********************************************************************
+
+        Copyright (c) 2010 - 2015 Codeux Software, LLC
+     Please see ACKNOWLEDGEMENT for additional information.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+
+ * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+ * Neither the name of "Codeux Software, LLC", nor the names of its 
+   contributors may be used to endorse or promote products derived 
+   from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ SUCH DAMAGE.
+
+ *********************************************************************** */
+
+#import "OTRKitPrivate.h"
+
+typedef struct {
+	const char *username;
+	const char *accountName;
+	const char *protocol;
+} OTRKitPresenceKey;
+
+/* A key that is added to the cache is copied into a single block
+ that holds the key followed by its three strings. Keys that are
+ only looked up are never copied. */
+static const void *presence_key_retain_cb(CFAllocatorRef allocator, const void *value)
+{
+	const OTRKitPresenceKey *key = value;
+
+	size_t usernameLength = (strlen(key->username) + 1);
+	size_t accountNameLength = (strlen(key->accountName) + 1);
+	size_t protocolLength = (strlen(key->protocol) + 1);
+
+	OTRKitPresenceKey *keyCopy = malloc(sizeof(OTRKitPresenceKey) + usernameLength + accountNameLength + protocolLength);
+
+	if (keyCopy == NULL) {
+		return NULL;
+	}
+
+	char *strings = (char *)(keyCopy + 1);
+
+	memcpy(strings, key->username, usernameLength);
+
+	keyCopy->username = strings;
+
+	strings += usernameLength;
+
+	memcpy(strings, key->accountName, accountNameLength);
+
+	keyCopy->accountName = strings;
+
+	strings += accountNameLength;
+
+	memcpy(strings, key->protocol, protocolLength);
+
+	keyCopy->protocol = strings;
+
+	return keyCopy;
+}
+
+static void presence_key_release_cb(CFAllocatorRef allocator, const void *value)
+{
+	free((void *)value);
+}
+
+static Boolean presence_key_equal_cb(const void *value1, const void *value2)
+{
+	const OTRKitPresenceKey *key1 = value1;
+	const OTRKitPresenceKey *key2 = value2;
+
+	return (strcmp(key1->username, key2->username) == 0 &&
+			strcmp(key1->accountName, key2->accountName) == 0 &&
+			strcmp(key1->protocol, key2->protocol) == 0);
+}
+
+/* FNV-1a over the three strings including their terminators */
+static CFHashCode presence_key_hash_cb(const void *value)
+{
+	const OTRKitPresenceKey *key = value;
+
+	const char *strings[3] = {key->username, key->accountName, key->protocol};
+
+	uint64_t hash = 14695981039346656037ULL;
+
+	for (int i = 0; i < 3; i++) {
+		const unsigned char *character = (const unsigned char *)strings[i];
+
+		do {
+			hash ^= *character;
+
+			hash *= 1099511628211ULL;
+		} while (*character++ != '\0');
+	}
+
+	return (CFHashCode)hash;
+}
+
+@interface OTRKitPresenceCache ()
+@property (readwrite, getter=isPushed) BOOL pushed;
+@property (nonatomic, assign) CFMutableDictionaryRef loggedInStates;
+@end
+
+@implementation OTRKitPresenceCache
+
+- (instancetype)init
+{
+	if ((self = [super init])) {
+		CFDictionaryKeyCallBacks keyCallBacks = {
+			.version = 0,
+			.retain = presence_key_retain_cb,
+			.release = presence_key_release_cb,
+			.copyDescription = NULL,
+			.equal = presence_key_equal_cb,
+			.hash = presence_key_hash_cb
+		};
+
+		self.loggedInStates = CFDictionaryCreateMutable(kCFAllocatorDefault, 0, &keyCallBacks, &kCFTypeDictionaryValueCallBacks);
+
+		return self;
+	}
+
+	return nil;
+}
+
+- (void)dealloc
+{
+	CFRelease(self.loggedInStates);
+}
+
+- (void)setLoggedIn:(BOOL)loggedIn forUsernames:(NSArray<NSString *> *)usernames accountName:(NSString *)accountName protocol:(NSString *)protocol
+{
+	AssertParamaterNil(usernames)
+	AssertParamaterLength(accountName)
+	AssertParamaterLength(protocol)
+
+	CFBooleanRef loggedInValue = ((loggedIn) ? kCFBooleanTrue : kCFBooleanFalse);
+
+	OTRKitPresenceKey key = {NULL, [accountName UTF8String], [protocol UTF8String]};
+
+	@synchronized (self) {
+		for (NSString *username in usernames) {
+			key.username = [username UTF8String];
+
+			CFDictionarySetValue(self.loggedInStates, &key, loggedInValue);
+		}
+
+		self.pushed = YES;
+	}
+}
+
+- (void)removeUsernames:(NSArray<NSString *> *)usernames accountName:(NSString *)accountName protocol:(NSString *)protocol
+{
+	AssertParamaterNil(usernames)
+	AssertParamaterLength(accountName)
+	AssertParamaterLength(protocol)
+
+	OTRKitPresenceKey key = {NULL, [accountName UTF8String], [protocol UTF8String]};
+
+	@synchronized (self) {
+		for (NSString *username in usernames) {
+			key.username = [username UTF8String];
+
+			CFDictionaryRemoveValue(self.loggedInStates, &key);
+		}
+	}
+}
+
+- (void)removeAllUsernamesForAccountName:(NSString *)accountName protocol:(NSString *)protocol
+{
+	AssertParamaterLength(accountName)
+	AssertParamaterLength(protocol)
+
+	const char *accountNameUTF8String = [accountName UTF8String];
+	const char *protocolUTF8String = [protocol UTF8String];
+
+	@synchronized (self) {
+		CFIndex keyCount = CFDictionaryGetCount(self.loggedInStates);
+
+		if (keyCount == 0) {
+			return;
+		}
+
+		const void **keys = malloc(sizeof(void *) * keyCount);
+
+		if (keys == NULL) {
+			return;
+		}
+
+		CFDictionaryGetKeysAndValues(self.loggedInStates, keys, NULL);
+
+		for (CFIndex i = 0; i < keyCount; i++) {
+			const OTRKitPresenceKey *key = keys[i];
+
+			if (strcmp(key->accountName, accountNameUTF8String) == 0 &&
+				strcmp(key->protocol, protocolUTF8String) == 0)
+			{
+				CFDictionaryRemoveValue(self.loggedInStates, key);
+			}
+		}
+
+		free(keys);
+	}
+}
+
+- (void)removeAllUsernames
+{
+	@synchronized (self) {
+		CFDictionaryRemoveAllValues(self.loggedInStates);
+
+		self.pushed = NO;
+	}
+}
+
+- (int)loggedInStateForUsername:(const char *)username accountName:(const char *)accountName protocol:(const char *)protocol
+{
+	NSParameterAssert(username != NULL);
+	NSParameterAssert(accountName != NULL);
+	NSParameterAssert(protocol != NULL);
+
+	OTRKitPresenceKey key = {username, accountName, protocol};
+
+	CFBooleanRef loggedIn = NULL;
+
+	@synchronized (self) {
+		loggedIn = CFDictionaryGetValue(self.loggedInStates, &key);
+	}
+
+	/* libotr treats -1 as "not known" */
+	if (loggedIn == NULL) {
+		return (-1);
+	} else if (CFBooleanGetValue(loggedIn)) {
+		return 1;
+	} else {
+		return 0;
+	}
+}
+
+@end
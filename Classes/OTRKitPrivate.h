@@ -35,21 +35,45 @@
  */
 
 #import "OTRKit.h"
+#import "OTRKitAccount.h"
+#import "OTRKitKeyGenerationJobPrivate.h"
 #import "OTRKitConcreteObjectPrivate.h"
+#import "OTRKitEngine.h"
+#import "OTRKitFingerprintsWriter.h"
+#import "OTRKitSnapshot.h"
+#import "OTRKitMemoryFile.h"
+#import "OTRKitStorage.h"
+#import "OTRKitStorageBridge.h"
+#import "OTRKitConversationPrivate.h"
+#import "OTRKitConversationTable.h"
+#import "OTRKitPresenceCache.h"
+#import "OTRKitMessageClassifier.h"
+#import "OTRKitMessageBatchPrivate.h"
+#import "OTRKitMetricsCounters.h"
+#import "OTRKitTracer.h"
+#import "OTRKitTrafficRecorderPrivate.h"
 
 #import "OTRTLV.h"
 
 #import "libotr/proto.h"
 #import "libotr/message.h"
 #import "libotr/privkey.h"
+#import "libotr/instag.h"
 
-@interface OTRKit () {
-	void *IsOnInternalQueueKey;
-}
-
-@property (nonatomic, strong) dispatch_queue_t internalQueue;
-@property (nonatomic, strong) NSTimer *pollTimer;
-@property (nonatomic) OtrlUserState userState;
-@property (nonatomic, strong) NSDictionary *protocolMaxSize;
+@interface OTRKit ()
+@property (nonatomic, strong) OTRKitEngine *defaultEngine;
+@property (nonatomic, strong) NSMutableDictionary<NSString *, OTRKitEngine *> *shardEngines;
+@property (copy) NSDictionary *protocolMaxSize;
+@property (assign) NSUInteger protocolMaxSizeGeneration;
+@property (nonatomic, strong) OTRKitPresenceCache *presenceCache;
+@property (nonatomic, strong) OTRKitConversationTable *conversations;
 @property (nonatomic, copy, readwrite) NSString *dataPath;
+@property (nonatomic, strong) NSMutableDictionary<OTRKitAccount *, OTRKitKeyGenerationJob *> *keyGenerationJobTable;
+@property (nonatomic, assign) OTRKitMetricsCounters *metricsCounters;
+
+- (void)_messagePollForEngine:(OTRKitEngine *)engine;
+
+- (int)_maximumProtocolSizeForProtocol:(const char *)protocol;
+
+- (void)_evictConversationsForEngine:(OTRKitEngine *)engine;
 @end
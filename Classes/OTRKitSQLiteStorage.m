@@ -0,0 +1,617 @@
+/* *********************************************************************
+
+        Copyright (c) 2010 - 2015 Codeux Software, LLC
+     Please see ACKNOWLEDGEMENT for additional information.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+
+ * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+ * Neither the name of "Codeux Software, LLC", nor the names of its 
+   contributors may be used to endorse or promote products derived 
+   from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ SUCH DAMAGE.
+
+ *********************************************************************** */
+
+#import "OTRKitPrivate.h"
+#import "OTRKitSQLiteStorage.h"
+
+#include <sqlite3.h>
+
+NSString * const OTRKitSQLiteStorageErrorDomain = @"org.chatsecure.OTRKit.SQLiteStorage";
+
+/* Increment when the schema below changes. */
+#define OTRKitSQLiteStorageSchemaVersion		1
+
+@interface OTRKitSQLiteStorageTransaction : NSObject <OTRKitStorageTransaction>
+@property (nonatomic, strong) NSMutableArray<BOOL (^)(void)> *operations;
+@property (nonatomic, weak) OTRKitSQLiteStorage *storage;
+@end
+
+@interface OTRKitSQLiteStorage ()
+@property (readwrite, copy) NSString *path;
+
+/* Both are only accessed while synchronized on self */
+@property (nonatomic, assign) sqlite3 *database;
+@property (nonatomic, strong) NSMutableDictionary<NSString *, NSValue *> *statements;
+
+/* Called by transactions while synchronized on self */
+- (BOOL)_setPrivateKey:(OTRKitPrivateKeyRecord *)privateKey;
+- (BOOL)_setInstanceTag:(OTRKitInstanceTagRecord *)instanceTag;
+- (BOOL)_setFingerprint:(OTRKitFingerprintRecord *)fingerprint;
+- (BOOL)_removeFingerprint:(OTRKitFingerprintRecord *)fingerprint;
+- (BOOL)_removeAllFingerprintsForAccountName:(NSString *)accountName protocol:(NSString *)protocol;
+@end
+
+@implementation OTRKitSQLiteStorage
+
+- (instancetype)initWithPath:(NSString *)path error:(NSError **)error
+{
+	AssertParamaterLength(path)
+
+	if ((self = [super init])) {
+		self.path = path;
+
+		self.statements = [NSMutableDictionary dictionary];
+
+		if ([self _openDatabase:error] == NO) {
+			return nil;
+		}
+
+		return self;
+	}
+
+	return nil;
+}
+
+- (void)dealloc
+{
+	for (NSValue *statement in [self.statements objectEnumerator]) {
+		sqlite3_finalize([statement pointerValue]);
+	}
+
+	if (self.database) {
+		sqlite3_close(self.database);
+	}
+}
+
+#pragma mark -
+#pragma mark Database
+
+- (BOOL)_openDatabase:(NSError **)error
+{
+	sqlite3 *database = NULL;
+
+	int openFlags = (SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_FULLMUTEX);
+
+	int result = sqlite3_open_v2([self.path fileSystemRepresentation], &database, openFlags, NULL);
+
+	self.database = database;
+
+	if (result != SQLITE_OK) {
+		[self _getError:error forResult:result];
+
+		return NO;
+	}
+
+	/* Another process (or another instance) may hold a lock briefly. */
+	sqlite3_busy_timeout(database, 5000);
+
+	/* With a write-ahead log, NORMAL only syncs when the log is
+	 checkpointed. A commit may be lost on power failure but the
+	 database is never corrupted, which is the same guarantee
+	 that the flat files gave. */
+	NSString *schema =
+	@"PRAGMA journal_mode = WAL;"
+	@"PRAGMA synchronous = NORMAL;"
+	@"CREATE TABLE IF NOT EXISTS private_keys ("
+	@"account_name TEXT NOT NULL, "
+	@"protocol TEXT NOT NULL, "
+	@"key_data BLOB NOT NULL, "
+	@"PRIMARY KEY (account_name, protocol)) WITHOUT ROWID;"
+	@"CREATE TABLE IF NOT EXISTS fingerprints ("
+	@"username TEXT NOT NULL, "
+	@"account_name TEXT NOT NULL, "
+	@"protocol TEXT NOT NULL, "
+	@"fingerprint BLOB NOT NULL, "
+	@"trust TEXT, "
+	@"PRIMARY KEY (username, account_name, protocol, fingerprint)) WITHOUT ROWID;"
+	@"CREATE INDEX IF NOT EXISTS fingerprints_account ON fingerprints (account_name, protocol);"
+	@"CREATE TABLE IF NOT EXISTS instance_tags ("
+	@"account_name TEXT NOT NULL, "
+	@"protocol TEXT NOT NULL, "
+	@"instance_tag INTEGER NOT NULL, "
+	@"PRIMARY KEY (account_name, protocol)) WITHOUT ROWID;";
+
+	result = sqlite3_exec(database, [schema UTF8String], NULL, NULL, NULL);
+
+	if (result == SQLITE_OK) {
+		NSString *version = [NSString stringWithFormat:@"PRAGMA user_version = %d;", OTRKitSQLiteStorageSchemaVersion];
+
+		result = sqlite3_exec(database, [version UTF8String], NULL, NULL, NULL);
+	}
+
+	if (result != SQLITE_OK) {
+		[self _getError:error forResult:result];
+
+		return NO;
+	}
+
+	return YES;
+}
+
+- (void)_getError:(NSError **)error forResult:(int)result
+{
+	const char *message = NULL;
+
+	if (self.database) {
+		message = sqlite3_errmsg(self.database);
+	} else {
+		message = sqlite3_errstr(result);
+	}
+
+	NSString *errorDescription = @(message);
+
+	LogToConsole(@"SQLite storage '%@' failed: %@", self.path, errorDescription);
+
+	if (error == NULL) {
+		return;
+	}
+
+	*error = [NSError errorWithDomain:OTRKitSQLiteStorageErrorDomain
+								 code:result
+							 userInfo:@{NSLocalizedDescriptionKey : errorDescription}];
+}
+
+/* Statements are prepared the first time they are used and then reused.
+ Must be called while synchronized on self. Returns a statement which has
+ been reset and had its bindings cleared, or NULL on failure. */
+- (sqlite3_stmt *)_statementForQuery:(NSString *)query
+{
+	NSValue *statementValue = self.statements[query];
+
+	if (statementValue) {
+		sqlite3_stmt *statement = [statementValue pointerValue];
+
+		sqlite3_reset(statement);
+
+		sqlite3_clear_bindings(statement);
+
+		return statement;
+	}
+
+	sqlite3_stmt *statement = NULL;
+
+	int result = sqlite3_prepare_v2(self.database, [query UTF8String], -1, &statement, NULL);
+
+	if (result != SQLITE_OK) {
+		[self _getError:NULL forResult:result];
+
+		return NULL;
+	}
+
+	self.statements[query] = [NSValue valueWithPointer:statement];
+
+	return statement;
+}
+
+- (BOOL)_stepStatement:(sqlite3_stmt *)statement
+{
+	if (statement == NULL) {
+		return NO;
+	}
+
+	int result = sqlite3_step(statement);
+
+	sqlite3_reset(statement);
+
+	if (result != SQLITE_DONE) {
+		[self _getError:NULL forResult:result];
+
+		return NO;
+	}
+
+	return YES;
+}
+
+static void OTRKitSQLiteBindText(sqlite3_stmt *statement, int index, NSString *text)
+{
+	if (text == nil) {
+		sqlite3_bind_null(statement, index);
+	} else {
+		sqlite3_bind_text(statement, index, [text UTF8String], -1, SQLITE_TRANSIENT);
+	}
+}
+
+static NSString *OTRKitSQLiteColumnText(sqlite3_stmt *statement, int index)
+{
+	const unsigned char *text = sqlite3_column_text(statement, index);
+
+	if (text == NULL) {
+		return nil;
+	}
+
+	return @((const char *)text);
+}
+
+static NSData *OTRKitSQLiteColumnData(sqlite3_stmt *statement, int index)
+{
+	const void *bytes = sqlite3_column_blob(statement, index);
+
+	int length = sqlite3_column_bytes(statement, index);
+
+	return [NSData dataWithBytes:bytes length:length];
+}
+
+/* Account filters are written as (?1 IS NULL OR column = ?1) so that
+ one statement serves both filtered and unfiltered queries. */
+#define OTRKitSQLiteAccountFilter		@"(?1 IS NULL OR account_name = ?1) AND (?2 IS NULL OR protocol = ?2)"
+
+#pragma mark -
+#pragma mark Reading
+
+- (NSArray<OTRKitPrivateKeyRecord *> *)privateKeysForAccountName:(NSString *)accountName protocol:(NSString *)protocol
+{
+	NSMutableArray *records = [NSMutableArray array];
+
+	@synchronized (self) {
+		sqlite3_stmt *statement =
+		[self _statementForQuery:@"SELECT account_name, protocol, key_data FROM private_keys WHERE " OTRKitSQLiteAccountFilter];
+
+		if (statement == NULL) {
+			return @[];
+		}
+
+		OTRKitSQLiteBindText(statement, 1, accountName);
+		OTRKitSQLiteBindText(statement, 2, protocol);
+
+		while (sqlite3_step(statement) == SQLITE_ROW) {
+			OTRKitPrivateKeyRecord *record =
+			[[OTRKitPrivateKeyRecord alloc] initWithAccountName:OTRKitSQLiteColumnText(statement, 0)
+													   protocol:OTRKitSQLiteColumnText(statement, 1)
+														keyData:OTRKitSQLiteColumnData(statement, 2)];
+
+			[records addObject:record];
+		}
+
+		sqlite3_reset(statement);
+	}
+
+	return [records copy];
+}
+
+- (NSArray<OTRKitInstanceTagRecord *> *)instanceTagsForAccountName:(NSString *)accountName protocol:(NSString *)protocol
+{
+	NSMutableArray *records = [NSMutableArray array];
+
+	@synchronized (self) {
+		sqlite3_stmt *statement =
+		[self _statementForQuery:@"SELECT account_name, protocol, instance_tag FROM instance_tags WHERE " OTRKitSQLiteAccountFilter];
+
+		if (statement == NULL) {
+			return @[];
+		}
+
+		OTRKitSQLiteBindText(statement, 1, accountName);
+		OTRKitSQLiteBindText(statement, 2, protocol);
+
+		while (sqlite3_step(statement) == SQLITE_ROW) {
+			OTRKitInstanceTagRecord *record =
+			[[OTRKitInstanceTagRecord alloc] initWithAccountName:OTRKitSQLiteColumnText(statement, 0)
+														protocol:OTRKitSQLiteColumnText(statement, 1)
+													 instanceTag:(uint32_t)sqlite3_column_int64(statement, 2)];
+
+			[records addObject:record];
+		}
+
+		sqlite3_reset(statement);
+	}
+
+	return [records copy];
+}
+
+- (NSArray<OTRKitFingerprintRecord *> *)_fingerprintsOfStatement:(sqlite3_stmt *)statement
+{
+	NSMutableArray *records = [NSMutableArray array];
+
+	while (sqlite3_step(statement) == SQLITE_ROW) {
+		OTRKitFingerprintRecord *record =
+		[[OTRKitFingerprintRecord alloc] initWithUsername:OTRKitSQLiteColumnText(statement, 0)
+											  accountName:OTRKitSQLiteColumnText(statement, 1)
+												 protocol:OTRKitSQLiteColumnText(statement, 2)
+											  fingerprint:OTRKitSQLiteColumnData(statement, 3)
+													trust:OTRKitSQLiteColumnText(statement, 4)];
+
+		[records addObject:record];
+	}
+
+	sqlite3_reset(statement);
+
+	return records;
+}
+
+- (void)enumerateFingerprintsForAccountName:(NSString *)accountName protocol:(NSString *)protocol usingBlock:(void (NS_NOESCAPE ^)(OTRKitFingerprintRecord *fingerprint))block
+{
+	AssertParamaterNil(block)
+
+	NSArray *records = nil;
+
+	@synchronized (self) {
+		/* TEXT columns use the BINARY collation which compares
+		 the same way as strcmp() does for UTF-8 strings. */
+		sqlite3_stmt *statement =
+		[self _statementForQuery:@"SELECT username, account_name, protocol, fingerprint, trust FROM fingerprints WHERE " OTRKitSQLiteAccountFilter
+								 @" ORDER BY username DESC, account_name DESC, protocol DESC"];
+
+		if (statement == NULL) {
+			return;
+		}
+
+		OTRKitSQLiteBindText(statement, 1, accountName);
+		OTRKitSQLiteBindText(statement, 2, protocol);
+
+		records = [self _fingerprintsOfStatement:statement];
+	}
+
+	/* The block is called outside of the lock so that it may
+	 call back into the storage without deadlocking. */
+	for (OTRKitFingerprintRecord *record in records) {
+		block(record);
+	}
+}
+
+- (NSArray<OTRKitFingerprintRecord *> *)fingerprintsForUsername:(NSString *)username accountName:(NSString *)accountName protocol:(NSString *)protocol
+{
+	AssertParamaterLength(username)
+	AssertParamaterLength(accountName)
+	AssertParamaterLength(protocol)
+
+	@synchronized (self) {
+		sqlite3_stmt *statement =
+		[self _statementForQuery:@"SELECT username, account_name, protocol, fingerprint, trust FROM fingerprints "
+								 @"WHERE username = ?3 AND account_name = ?1 AND protocol = ?2"];
+
+		if (statement == NULL) {
+			return @[];
+		}
+
+		OTRKitSQLiteBindText(statement, 1, accountName);
+		OTRKitSQLiteBindText(statement, 2, protocol);
+		OTRKitSQLiteBindText(statement, 3, username);
+
+		return [[self _fingerprintsOfStatement:statement] copy];
+	}
+}
+
+#pragma mark -
+#pragma mark Writing
+
+- (BOOL)performTransaction:(void (NS_NOESCAPE ^)(id<OTRKitStorageTransaction> transaction))block error:(NSError **)error
+{
+	AssertParamaterNil(block)
+
+	OTRKitSQLiteStorageTransaction *transaction = [OTRKitSQLiteStorageTransaction new];
+
+	transaction.storage = self;
+
+	transaction.operations = [NSMutableArray array];
+
+	block(transaction);
+
+	NSArray *operations = transaction.operations;
+
+	transaction.operations = nil;
+
+	if ([operations count] == 0) {
+		return YES;
+	}
+
+	@synchronized (self) {
+		sqlite3 *database = self.database;
+
+		/* IMMEDIATE takes the write lock up front so that the
+		 transaction cannot fail part way through on a lock. */
+		int result = sqlite3_exec(database, "BEGIN IMMEDIATE", NULL, NULL, NULL);
+
+		if (result != SQLITE_OK) {
+			[self _getError:error forResult:result];
+
+			return NO;
+		}
+
+		for (BOOL (^operation)(void) in operations) {
+			if (operation() == NO) {
+				result = sqlite3_errcode(database);
+
+				[self _getError:error forResult:result];
+
+				sqlite3_exec(database, "ROLLBACK", NULL, NULL, NULL);
+
+				return NO;
+			}
+		}
+
+		result = sqlite3_exec(database, "COMMIT", NULL, NULL, NULL);
+
+		if (result != SQLITE_OK) {
+			[self _getError:error forResult:result];
+
+			sqlite3_exec(database, "ROLLBACK", NULL, NULL, NULL);
+
+			return NO;
+		}
+	}
+
+	return YES;
+}
+
+- (BOOL)_setPrivateKey:(OTRKitPrivateKeyRecord *)privateKey
+{
+	sqlite3_stmt *statement =
+	[self _statementForQuery:@"INSERT OR REPLACE INTO private_keys (account_name, protocol, key_data) VALUES (?1, ?2, ?3)"];
+
+	if (statement == NULL) {
+		return NO;
+	}
+
+	NSData *keyData = [privateKey keyData];
+
+	OTRKitSQLiteBindText(statement, 1, [privateKey accountName]);
+	OTRKitSQLiteBindText(statement, 2, [privateKey protocol]);
+
+	sqlite3_bind_blob(statement, 3, [keyData bytes], (int)[keyData length], SQLITE_TRANSIENT);
+
+	return [self _stepStatement:statement];
+}
+
+- (BOOL)_setInstanceTag:(OTRKitInstanceTagRecord *)instanceTag
+{
+	sqlite3_stmt *statement =
+	[self _statementForQuery:@"INSERT OR REPLACE INTO instance_tags (account_name, protocol, instance_tag) VALUES (?1, ?2, ?3)"];
+
+	if (statement == NULL) {
+		return NO;
+	}
+
+	OTRKitSQLiteBindText(statement, 1, [instanceTag accountName]);
+	OTRKitSQLiteBindText(statement, 2, [instanceTag protocol]);
+
+	sqlite3_bind_int64(statement, 3, [instanceTag instanceTag]);
+
+	return [self _stepStatement:statement];
+}
+
+- (BOOL)_setFingerprint:(OTRKitFingerprintRecord *)fingerprint
+{
+	sqlite3_stmt *statement =
+	[self _statementForQuery:@"INSERT OR REPLACE INTO fingerprints (username, account_name, protocol, fingerprint, trust) VALUES (?3, ?1, ?2, ?4, ?5)"];
+
+	if (statement == NULL) {
+		return NO;
+	}
+
+	NSData *fingerprintData = [fingerprint fingerprint];
+
+	OTRKitSQLiteBindText(statement, 1, [fingerprint accountName]);
+	OTRKitSQLiteBindText(statement, 2, [fingerprint protocol]);
+	OTRKitSQLiteBindText(statement, 3, [fingerprint username]);
+
+	sqlite3_bind_blob(statement, 4, [fingerprintData bytes], (int)[fingerprintData length], SQLITE_TRANSIENT);
+
+	OTRKitSQLiteBindText(statement, 5, [fingerprint trust]);
+
+	return [self _stepStatement:statement];
+}
+
+- (BOOL)_removeFingerprint:(OTRKitFingerprintRecord *)fingerprint
+{
+	sqlite3_stmt *statement =
+	[self _statementForQuery:@"DELETE FROM fingerprints WHERE username = ?3 AND account_name = ?1 AND protocol = ?2 AND fingerprint = ?4"];
+
+	if (statement == NULL) {
+		return NO;
+	}
+
+	NSData *fingerprintData = [fingerprint fingerprint];
+
+	OTRKitSQLiteBindText(statement, 1, [fingerprint accountName]);
+	OTRKitSQLiteBindText(statement, 2, [fingerprint protocol]);
+	OTRKitSQLiteBindText(statement, 3, [fingerprint username]);
+
+	sqlite3_bind_blob(statement, 4, [fingerprintData bytes], (int)[fingerprintData length], SQLITE_TRANSIENT);
+
+	return [self _stepStatement:statement];
+}
+
+- (BOOL)_removeAllFingerprintsForAccountName:(NSString *)accountName protocol:(NSString *)protocol
+{
+	sqlite3_stmt *statement =
+	[self _statementForQuery:@"DELETE FROM fingerprints WHERE " OTRKitSQLiteAccountFilter];
+
+	if (statement == NULL) {
+		return NO;
+	}
+
+	OTRKitSQLiteBindText(statement, 1, accountName);
+	OTRKitSQLiteBindText(statement, 2, protocol);
+
+	return [self _stepStatement:statement];
+}
+
+@end
+
+#pragma mark -
+
+@implementation OTRKitSQLiteStorageTransaction
+
+- (void)setPrivateKey:(OTRKitPrivateKeyRecord *)privateKey
+{
+	AssertParamaterNil(privateKey)
+
+	OTRKitSQLiteStorage *storage = self.storage;
+
+	[self.operations addObject:^BOOL{
+		return [storage _setPrivateKey:privateKey];
+	}];
+}
+
+- (void)setFingerprint:(OTRKitFingerprintRecord *)fingerprint
+{
+	AssertParamaterNil(fingerprint)
+
+	OTRKitSQLiteStorage *storage = self.storage;
+
+	[self.operations addObject:^BOOL{
+		return [storage _setFingerprint:fingerprint];
+	}];
+}
+
+- (void)removeFingerprint:(OTRKitFingerprintRecord *)fingerprint
+{
+	AssertParamaterNil(fingerprint)
+
+	OTRKitSQLiteStorage *storage = self.storage;
+
+	[self.operations addObject:^BOOL{
+		return [storage _removeFingerprint:fingerprint];
+	}];
+}
+
+- (void)removeAllFingerprintsForAccountName:(NSString *)accountName protocol:(NSString *)protocol
+{
+	OTRKitSQLiteStorage *storage = self.storage;
+
+	[self.operations addObject:^BOOL{
+		return [storage _removeAllFingerprintsForAccountName:accountName protocol:protocol];
+	}];
+}
+
+- (void)setInstanceTag:(OTRKitInstanceTagRecord *)instanceTag
+{
+	AssertParamaterNil(instanceTag)
+
+	OTRKitSQLiteStorage *storage = self.storage;
+
+	[self.operations addObject:^BOOL{
+		return [storage _setInstanceTag:instanceTag];
+	}];
+}
+
+@end
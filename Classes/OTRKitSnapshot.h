@@ -0,0 +1,132 @@
+/* *********************************************************************
+
+        Copyright (c) 2010 - 2015 Codeux Software, LLC
+     Please see ACKNOWLEDGEMENT for additional information.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+
+ * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+ * Neither the name of "Codeux Software, LLC", nor the names of its 
+   contributors may be used to endorse or promote products derived 
+   from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ SUCH DAMAGE.
+
+ *********************************************************************** */
+
+#import "OTRKitLoadStatistics.h"
+
+#import "libotr/proto.h"
+#import "libotr/context.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+@class OTRKitEngine;
+
+@interface OTRKitLoadStatistics ()
+@property (readwrite) NSUInteger snapshotLoadCount;
+@property (readwrite) NSUInteger fileLoadCount;
+@property (readwrite) NSUInteger storageLoadCount;
+@property (readwrite) NSTimeInterval snapshotReadDuration;
+@property (readwrite) NSTimeInterval privateKeysReadDuration;
+@property (readwrite) NSTimeInterval fingerprintsReadDuration;
+@property (readwrite) NSTimeInterval instanceTagsReadDuration;
+@property (readwrite) NSTimeInterval journalReplayDuration;
+@property (readwrite) NSTimeInterval snapshotCreateDuration;
+@property (readwrite) NSTimeInterval totalDuration;
+
+/* Adds the values of another instance to this one. */
+- (void)addStatistics:(OTRKitLoadStatistics *)statistics;
+@end
+
+typedef void (^OTRKitFingerprintIndexBlock)(const char *username, const char *accountName, const char *protocol, const unsigned char *fingerprint, const char * _Nullable trust);
+
+/**
+ *  Finds the fingerprints of a peer in a snapshot without reading the
+ *  fingerprints of any other peer. Used when fingerprints are loaded
+ *  lazily. Only accessed on the internal queue of the engine.
+ *
+ *  Each peer is only ever loaded once. Afterwards the fingerprints held
+ *  by libotr are the ones that are up to date.
+ */
+@interface OTRKitFingerprintIndex : NSObject
+@property (readonly) NSUInteger peerCount;
+
+/**
+ *  Adds the fingerprints of a peer to a user state. Returns NO if the
+ *  peer is not in the snapshot or was loaded before.
+ */
+- (BOOL)loadFingerprintsForUsername:(const char *)username
+						accountName:(const char *)accountName
+						   protocol:(const char *)protocol
+					  intoUserState:(OtrlUserState)userState;
+
+/**
+ *  Returns YES if the fingerprint belongs to a peer that is not loaded yet.
+ */
+- (BOOL)containsUnloadedFingerprint:(const unsigned char *)fingerprint
+						   username:(const char *)username
+						accountName:(const char *)accountName
+						   protocol:(const char *)protocol;
+
+/**
+ *  Calls the block for each fingerprint of every peer not loaded yet.
+ *  The strings passed to the block are only valid during the call.
+ */
+- (void)enumerateUnloadedFingerprintsUsingBlock:(OTRKitFingerprintIndexBlock)block;
+@end
+
+/**
+ *  A snapshot holds the private keys, fingerprints, and instance tags of
+ *  an engine in a binary form that is quick to load.
+ *
+ *  The private keys and instance tags are stored as the original files
+ *  hold them because libotr has no other means of loading them. Contexts
+ *  and their fingerprints are stored in reverse order so that libotr finds
+ *  the place of each one at the head of its sorted list of contexts which
+ *  makes rebuilding the list linear instead of quadratic.
+ *
+ *  The snapshot ends with the offset of each context which allows the
+ *  fingerprints of a peer to be found without reading the whole file.
+ *
+ *  The snapshot records the size, modification date, and inode of the
+ *  original files. It is only used while all three are unchanged. Because
+ *  the fingerprints journal is replayed after the snapshot is loaded, the
+ *  snapshot remains valid while the journal grows.
+ */
+@interface OTRKitSnapshot : NSObject
+/**
+ *  Rebuilds the user state of an engine from its snapshot. Returns NO,
+ *  leaving the user state empty, if the snapshot is missing, damaged,
+ *  or out of date. Must be called on the internal queue.
+ *
+ *  When loadFingerprints is NO, the engine is given a fingerprint index
+ *  instead of having its fingerprints loaded.
+ */
++ (BOOL)readSnapshotOfEngine:(OTRKitEngine *)engine loadingFingerprints:(BOOL)loadFingerprints;
+
+/**
+ *  Returns a snapshot of the user state of an engine as it is stored in
+ *  the original files. Must be called on the internal queue right after
+ *  the files are read so that nothing has changed in between.
+ */
++ (nullable NSData *)snapshotOfEngine:(OTRKitEngine *)engine;
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,784 @@
+/* *********************************************************************
+
+        Copyright (c) 2010 - 2015 Codeux Software, LLC
+     Please see ACKNOWLEDGEMENT for additional information.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+
+ * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+ * Neither the name of "Codeux Software, LLC", nor the names of its 
+   contributors may be used to endorse or promote products derived 
+   from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ SUCH DAMAGE.
+
+ *********************************************************************** */
+
+#import "OTRKitPrivate.h"
+
+#include <sys/stat.h>
+
+#define OTRKitSnapshotVersion			2
+
+#define OTRKitSnapshotFingerprintLength		20
+
+/* Length written in place of the trust of a fingerprint that has none */
+#define OTRKitSnapshotNoTrust			UINT32_MAX
+
+static const char kOTRKitSnapshotMagic[8] = {'O', 'T', 'R', 'K', 'S', 'N', 'A', 'P'};
+
+/* Identifies the version of an original file the snapshot was made from. */
+typedef struct {
+	uint64_t exists;
+	uint64_t size;
+	uint64_t inode;
+	uint64_t modificationSeconds;
+	uint64_t modificationNanoseconds;
+} OTRKitSnapshotFileStamp;
+
+typedef struct {
+	const uint8_t *bytes;
+	size_t length;
+	size_t offset;
+} OTRKitSnapshotReader;
+
+@implementation OTRKitLoadStatistics
+
+- (void)addStatistics:(OTRKitLoadStatistics *)statistics
+{
+	AssertParamaterNil(statistics)
+
+	self.snapshotLoadCount += [statistics snapshotLoadCount];
+	self.fileLoadCount += [statistics fileLoadCount];
+	self.storageLoadCount += [statistics storageLoadCount];
+
+	self.snapshotReadDuration += [statistics snapshotReadDuration];
+
+	self.privateKeysReadDuration += [statistics privateKeysReadDuration];
+	self.fingerprintsReadDuration += [statistics fingerprintsReadDuration];
+	self.instanceTagsReadDuration += [statistics instanceTagsReadDuration];
+
+	self.journalReplayDuration += [statistics journalReplayDuration];
+
+	self.snapshotCreateDuration += [statistics snapshotCreateDuration];
+
+	self.totalDuration += [statistics totalDuration];
+}
+
+@end
+
+#pragma mark -
+#pragma mark Encoding
+
+static void snapshot_append_uint32(NSMutableData *data, uint32_t value)
+{
+	uint32_t valueLittle = CFSwapInt32HostToLittle(value);
+
+	[data appendBytes:&valueLittle length:sizeof(valueLittle)];
+}
+
+static void snapshot_append_uint64(NSMutableData *data, uint64_t value)
+{
+	uint64_t valueLittle = CFSwapInt64HostToLittle(value);
+
+	[data appendBytes:&valueLittle length:sizeof(valueLittle)];
+}
+
+/* Strings are written with their terminating NUL so that
+ they can be handed to libotr straight from the mapped file. */
+static void snapshot_append_string(NSMutableData *data, const char *string)
+{
+	size_t length = (strlen(string) + 1);
+
+	snapshot_append_uint32(data, (uint32_t)length);
+
+	[data appendBytes:string length:length];
+}
+
+static void snapshot_append_file_stamp(NSMutableData *data, const OTRKitSnapshotFileStamp *stamp)
+{
+	snapshot_append_uint64(data, stamp->exists);
+	snapshot_append_uint64(data, stamp->size);
+	snapshot_append_uint64(data, stamp->inode);
+	snapshot_append_uint64(data, stamp->modificationSeconds);
+	snapshot_append_uint64(data, stamp->modificationNanoseconds);
+}
+
+static OTRKitSnapshotFileStamp snapshot_file_stamp(NSString *path)
+{
+	OTRKitSnapshotFileStamp stamp;
+
+	memset(&stamp, 0, sizeof(stamp));
+
+	struct stat fileStat;
+
+	if (path && stat([path fileSystemRepresentation], &fileStat) == 0) {
+		stamp.exists = 1;
+
+		stamp.size = fileStat.st_size;
+
+		stamp.inode = fileStat.st_ino;
+
+		stamp.modificationSeconds = fileStat.st_mtimespec.tv_sec;
+		stamp.modificationNanoseconds = fileStat.st_mtimespec.tv_nsec;
+	}
+
+	return stamp;
+}
+
+#pragma mark -
+#pragma mark Decoding
+
+static BOOL snapshot_read_bytes(OTRKitSnapshotReader *reader, size_t length, const uint8_t **bytes)
+{
+	if ((reader->length - reader->offset) < length) {
+		return NO;
+	}
+
+	*bytes = (reader->bytes + reader->offset);
+
+	reader->offset += length;
+
+	return YES;
+}
+
+static BOOL snapshot_read_uint32(OTRKitSnapshotReader *reader, uint32_t *value)
+{
+	const uint8_t *bytes = NULL;
+
+	if (snapshot_read_bytes(reader, sizeof(uint32_t), &bytes) == NO) {
+		return NO;
+	}
+
+	uint32_t valueLittle;
+
+	memcpy(&valueLittle, bytes, sizeof(valueLittle));
+
+	*value = CFSwapInt32LittleToHost(valueLittle);
+
+	return YES;
+}
+
+static BOOL snapshot_read_uint64(OTRKitSnapshotReader *reader, uint64_t *value)
+{
+	const uint8_t *bytes = NULL;
+
+	if (snapshot_read_bytes(reader, sizeof(uint64_t), &bytes) == NO) {
+		return NO;
+	}
+
+	uint64_t valueLittle;
+
+	memcpy(&valueLittle, bytes, sizeof(valueLittle));
+
+	*value = CFSwapInt64LittleToHost(valueLittle);
+
+	return YES;
+}
+
+static BOOL snapshot_read_string(OTRKitSnapshotReader *reader, const char **string)
+{
+	uint32_t length = 0;
+
+	if (snapshot_read_uint32(reader, &length) == NO || length == 0) {
+		return NO;
+	}
+
+	const uint8_t *bytes = NULL;
+
+	if (snapshot_read_bytes(reader, length, &bytes) == NO) {
+		return NO;
+	}
+
+	if (bytes[(length - 1)] != '\0') {
+		return NO;
+	}
+
+	*string = (const char *)bytes;
+
+	return YES;
+}
+
+static BOOL snapshot_read_file_stamp_matches(OTRKitSnapshotReader *reader, NSString *path)
+{
+	OTRKitSnapshotFileStamp stamp;
+
+	if (snapshot_read_uint64(reader, &stamp.exists) == NO ||
+		snapshot_read_uint64(reader, &stamp.size) == NO ||
+		snapshot_read_uint64(reader, &stamp.inode) == NO ||
+		snapshot_read_uint64(reader, &stamp.modificationSeconds) == NO ||
+		snapshot_read_uint64(reader, &stamp.modificationNanoseconds) == NO)
+	{
+		return NO;
+	}
+
+	OTRKitSnapshotFileStamp stampCurrent = snapshot_file_stamp(path);
+
+	return (stamp.exists == stampCurrent.exists &&
+			stamp.size == stampCurrent.size &&
+			stamp.inode == stampCurrent.inode &&
+			stamp.modificationSeconds == stampCurrent.modificationSeconds &&
+			stamp.modificationNanoseconds == stampCurrent.modificationNanoseconds);
+}
+
+/* libotr only reads instance tags from a FILE. The section is not
+ copied; the snapshot outlives the FILE that reads it. */
+static FILE *snapshot_open_section(const uint8_t *bytes, size_t length)
+{
+	NSData *section = [NSData dataWithBytesNoCopy:(void *)bytes length:length freeWhenDone:NO];
+
+	return OTRKitMemoryFileOpenForReading(section);
+}
+
+/* Contexts are stored in descending order which is the reverse of
+ the order libotr keeps them in. */
+static int snapshot_compare_peer(const char *username, const char *accountName, const char *protocol,
+								 const char *usernameOther, const char *accountNameOther, const char *protocolOther)
+{
+	int comparison = strcmp(username, usernameOther);
+
+	if (comparison == 0) {
+		comparison = strcmp(accountName, accountNameOther);
+	}
+
+	if (comparison == 0) {
+		comparison = strcmp(protocol, protocolOther);
+	}
+
+	return comparison;
+}
+
+static BOOL snapshot_read_peer(OTRKitSnapshotReader *reader, const char **username, const char **accountName, const char **protocol, uint32_t *fingerprintCount)
+{
+	return (snapshot_read_string(reader, username) &&
+			snapshot_read_string(reader, accountName) &&
+			snapshot_read_string(reader, protocol) &&
+			snapshot_read_uint32(reader, fingerprintCount));
+}
+
+static BOOL snapshot_read_fingerprint(OTRKitSnapshotReader *reader, const uint8_t **fingerprint, const char **trust)
+{
+	uint32_t trustLength = 0;
+
+	if (snapshot_read_bytes(reader, OTRKitSnapshotFingerprintLength, fingerprint) == NO ||
+		snapshot_read_uint32(reader, &trustLength) == NO)
+	{
+		return NO;
+	}
+
+	*trust = NULL;
+
+	if (trustLength != OTRKitSnapshotNoTrust) {
+		reader->offset -= sizeof(uint32_t);
+
+		if (snapshot_read_string(reader, trust) == NO) {
+			return NO;
+		}
+	}
+
+	return YES;
+}
+
+/* Reads a context and its fingerprints then adds them to a user state.
+ A context that already exists is added to. */
+static BOOL snapshot_load_peer(OTRKitSnapshotReader *reader, OtrlUserState userState)
+{
+	const char *username = NULL;
+	const char *accountName = NULL;
+	const char *protocol = NULL;
+
+	uint32_t fingerprintCount = 0;
+
+	if (snapshot_read_peer(reader, &username, &accountName, &protocol, &fingerprintCount) == NO) {
+		return NO;
+	}
+
+	ConnContext *context = otrl_context_find(userState, username, accountName, protocol, OTRL_INSTAG_MASTER, 1, NULL, NULL, NULL);
+
+	if (context == NULL) {
+		return NO;
+	}
+
+	for (uint32_t i = 0; i < fingerprintCount; i++) {
+		const uint8_t *fingerprintBytes = NULL;
+
+		const char *trust = NULL;
+
+		if (snapshot_read_fingerprint(reader, &fingerprintBytes, &trust) == NO) {
+			return NO;
+		}
+
+		/* libotr copies the fingerprint; it is not modified. */
+		Fingerprint *fingerprint = otrl_context_find_fingerprint(context, (unsigned char *)fingerprintBytes, 1, NULL);
+
+		if (fingerprint == NULL) {
+			return NO;
+		}
+
+		otrl_context_set_trust(fingerprint, trust);
+	}
+
+	return YES;
+}
+
+#pragma mark -
+#pragma mark Fingerprint Index
+
+@interface OTRKitFingerprintIndex ()
+@property (nonatomic, strong) NSData *snapshot;
+@property (nonatomic, assign, readwrite) NSUInteger peerCount;
+@property (nonatomic, assign) size_t indexOffset;
+@property (nonatomic, strong) NSMutableIndexSet *loadedPeers;
+@end
+
+@implementation OTRKitFingerprintIndex
+
+- (instancetype)initWithSnapshot:(NSData *)snapshot peerCount:(NSUInteger)peerCount
+{
+	AssertParamaterNil(snapshot)
+
+	if ((self = [super init])) {
+		/* The snapshot ends with the offset of the index which
+		 is followed by the offset of each context, in order. */
+		OTRKitSnapshotReader reader = {[snapshot bytes], [snapshot length], 0};
+
+		if (reader.length < sizeof(uint64_t)) {
+			return nil;
+		}
+
+		reader.offset = (reader.length - sizeof(uint64_t));
+
+		uint64_t indexOffset = 0;
+
+		if (snapshot_read_uint64(&reader, &indexOffset) == NO) {
+			return nil;
+		}
+
+		uint64_t indexLength = ((uint64_t)peerCount * sizeof(uint64_t));
+
+		if (indexOffset > reader.length || (reader.length - sizeof(uint64_t) - indexOffset) != indexLength) {
+			return nil;
+		}
+
+		self.snapshot = snapshot;
+
+		self.peerCount = peerCount;
+
+		self.indexOffset = indexOffset;
+
+		self.loadedPeers = [NSMutableIndexSet indexSet];
+
+		return self;
+	}
+
+	return nil;
+}
+
+/* Returns a reader positioned at a context. The reader is limited to
+ the contexts so that a damaged offset cannot read into the index. */
+- (BOOL)_getReader:(OTRKitSnapshotReader *)reader forPeerAtIndex:(NSUInteger)peerIndex
+{
+	OTRKitSnapshotReader indexReader = {[self.snapshot bytes], [self.snapshot length], (self.indexOffset + (peerIndex * sizeof(uint64_t)))};
+
+	uint64_t peerOffset = 0;
+
+	if (snapshot_read_uint64(&indexReader, &peerOffset) == NO || peerOffset >= self.indexOffset) {
+		return NO;
+	}
+
+	reader->bytes = [self.snapshot bytes];
+	reader->length = self.indexOffset;
+	reader->offset = peerOffset;
+
+	return YES;
+}
+
+- (NSUInteger)_indexOfPeerWithUsername:(const char *)username accountName:(const char *)accountName protocol:(const char *)protocol
+{
+	NSInteger lowIndex = 0;
+	NSInteger highIndex = ((NSInteger)self.peerCount - 1);
+
+	while (lowIndex <= highIndex) {
+		NSInteger middleIndex = (lowIndex + ((highIndex - lowIndex) / 2));
+
+		OTRKitSnapshotReader reader;
+
+		const char *peerUsername = NULL;
+		const char *peerAccountName = NULL;
+		const char *peerProtocol = NULL;
+
+		uint32_t fingerprintCount = 0;
+
+		if ([self _getReader:&reader forPeerAtIndex:middleIndex] == NO ||
+			snapshot_read_peer(&reader, &peerUsername, &peerAccountName, &peerProtocol, &fingerprintCount) == NO)
+		{
+			return NSNotFound;
+		}
+
+		int comparison = snapshot_compare_peer(peerUsername, peerAccountName, peerProtocol, username, accountName, protocol);
+
+		if (comparison == 0) {
+			return middleIndex;
+		} else if (comparison > 0) {
+			lowIndex = (middleIndex + 1);
+		} else {
+			highIndex = (middleIndex - 1);
+		}
+	}
+
+	return NSNotFound;
+}
+
+- (BOOL)_loadPeerAtIndex:(NSUInteger)peerIndex intoUserState:(OtrlUserState)userState
+{
+	if ([self.loadedPeers containsIndex:peerIndex]) {
+		return NO;
+	}
+
+	[self.loadedPeers addIndex:peerIndex];
+
+	OTRKitSnapshotReader reader;
+
+	if ([self _getReader:&reader forPeerAtIndex:peerIndex] == NO) {
+		return NO;
+	}
+
+	return snapshot_load_peer(&reader, userState);
+}
+
+- (BOOL)loadFingerprintsForUsername:(const char *)username accountName:(const char *)accountName protocol:(const char *)protocol intoUserState:(OtrlUserState)userState
+{
+	NSUInteger peerIndex = [self _indexOfPeerWithUsername:username accountName:accountName protocol:protocol];
+
+	if (peerIndex == NSNotFound) {
+		return NO;
+	}
+
+	return [self _loadPeerAtIndex:peerIndex intoUserState:userState];
+}
+
+- (BOOL)containsUnloadedFingerprint:(const unsigned char *)fingerprint username:(const char *)username accountName:(const char *)accountName protocol:(const char *)protocol
+{
+	NSUInteger peerIndex = [self _indexOfPeerWithUsername:username accountName:accountName protocol:protocol];
+
+	if (peerIndex == NSNotFound || [self.loadedPeers containsIndex:peerIndex]) {
+		return NO;
+	}
+
+	__block BOOL fingerprintFound = NO;
+
+	[self _enumerateFingerprintsOfPeerAtIndex:peerIndex usingBlock:^(const char *peerUsername, const char *peerAccountName, const char *peerProtocol, const unsigned char *peerFingerprint, const char *trust) {
+		if (memcmp(peerFingerprint, fingerprint, OTRKitSnapshotFingerprintLength) == 0) {
+			fingerprintFound = YES;
+		}
+	}];
+
+	return fingerprintFound;
+}
+
+- (void)enumerateUnloadedFingerprintsUsingBlock:(OTRKitFingerprintIndexBlock)block
+{
+	for (NSUInteger peerIndex = 0; peerIndex < self.peerCount; peerIndex++) {
+		if ([self.loadedPeers containsIndex:peerIndex] == NO) {
+			[self _enumerateFingerprintsOfPeerAtIndex:peerIndex usingBlock:block];
+		}
+	}
+}
+
+- (void)_enumerateFingerprintsOfPeerAtIndex:(NSUInteger)peerIndex usingBlock:(OTRKitFingerprintIndexBlock)block
+{
+	OTRKitSnapshotReader reader;
+
+	const char *username = NULL;
+	const char *accountName = NULL;
+	const char *protocol = NULL;
+
+	uint32_t fingerprintCount = 0;
+
+	if ([self _getReader:&reader forPeerAtIndex:peerIndex] == NO ||
+		snapshot_read_peer(&reader, &username, &accountName, &protocol, &fingerprintCount) == NO)
+	{
+		return;
+	}
+
+	for (uint32_t i = 0; i < fingerprintCount; i++) {
+		const uint8_t *fingerprint = NULL;
+
+		const char *trust = NULL;
+
+		if (snapshot_read_fingerprint(&reader, &fingerprint, &trust) == NO) {
+			return;
+		}
+
+		block(username, accountName, protocol, fingerprint, trust);
+	}
+}
+
+@end
+
+#pragma mark -
+#pragma mark Snapshot
+
+@implementation OTRKitSnapshot
+
++ (BOOL)readSnapshotOfEngine:(OTRKitEngine *)engine loadingFingerprints:(BOOL)loadFingerprints
+{
+	AssertParamaterNil(engine)
+
+	NSParameterAssert([engine isOnInternalQueue]);
+
+	NSString *snapshotPath = [engine snapshotPath];
+
+	if (snapshotPath == nil) {
+		return NO;
+	}
+
+	NSData *snapshot = [NSData dataWithContentsOfFile:snapshotPath options:NSDataReadingMappedAlways error:NULL];
+
+	if (snapshot == nil) {
+		return NO;
+	}
+
+	OtrlUserState userState = [engine userState];
+
+	BOOL readResult = [self _readSnapshot:snapshot ofEngine:engine intoUserState:userState loadingFingerprints:loadFingerprints];
+
+	if (readResult == NO) {
+		otrl_context_forget_all(userState);
+		otrl_privkey_forget_all(userState);
+		otrl_instag_forget_all(userState);
+	}
+
+	return readResult;
+}
+
++ (BOOL)_readSnapshot:(NSData *)snapshot ofEngine:(OTRKitEngine *)engine intoUserState:(OtrlUserState)userState loadingFingerprints:(BOOL)loadFingerprints
+{
+	OTRKitSnapshotReader reader = {[snapshot bytes], [snapshot length], 0};
+
+	/* Header */
+	const uint8_t *magic = NULL;
+
+	if (snapshot_read_bytes(&reader, sizeof(kOTRKitSnapshotMagic), &magic) == NO ||
+		memcmp(magic, kOTRKitSnapshotMagic, sizeof(kOTRKitSnapshotMagic)) != 0)
+	{
+		return NO;
+	}
+
+	uint32_t version = 0;
+
+	if (snapshot_read_uint32(&reader, &version) == NO || version != OTRKitSnapshotVersion) {
+		return NO;
+	}
+
+	if (snapshot_read_file_stamp_matches(&reader, [engine privateKeyPath]) == NO ||
+		snapshot_read_file_stamp_matches(&reader, [engine fingerprintsPath]) == NO ||
+		snapshot_read_file_stamp_matches(&reader, [engine instanceTagsPath]) == NO)
+	{
+		return NO;
+	}
+
+	/* Private keys and instance tags */
+	uint64_t privateKeysLength = 0;
+	uint64_t instanceTagsLength = 0;
+
+	if (snapshot_read_uint64(&reader, &privateKeysLength) == NO ||
+		snapshot_read_uint64(&reader, &instanceTagsLength) == NO)
+	{
+		return NO;
+	}
+
+	const uint8_t *privateKeys = NULL;
+	const uint8_t *instanceTags = NULL;
+
+	if (snapshot_read_bytes(&reader, privateKeysLength, &privateKeys) == NO ||
+		snapshot_read_bytes(&reader, instanceTagsLength, &instanceTags) == NO)
+	{
+		return NO;
+	}
+
+	if (privateKeysLength > 0) {
+		NSData *privateKeysSection = [NSData dataWithBytesNoCopy:(void *)privateKeys length:privateKeysLength freeWhenDone:NO];
+
+		gcry_error_t readError = OTRKitStorageReadPrivateKeys(userState, privateKeysSection);
+
+		if (readError) {
+			return NO;
+		}
+	}
+
+	if (instanceTagsLength > 0) {
+		FILE *filePointer = snapshot_open_section(instanceTags, instanceTagsLength);
+
+		if (filePointer == NULL) {
+			return NO;
+		}
+
+		gcry_error_t readError = otrl_instag_read_FILEp(userState, filePointer);
+
+		fclose(filePointer);
+
+		if (readError) {
+			return NO;
+		}
+	}
+
+	/* Contexts and fingerprints */
+	uint32_t contextCount = 0;
+
+	if (snapshot_read_uint32(&reader, &contextCount) == NO) {
+		return NO;
+	}
+
+	if (loadFingerprints == NO) {
+		OTRKitFingerprintIndex *fingerprintIndex = [[OTRKitFingerprintIndex alloc] initWithSnapshot:snapshot peerCount:contextCount];
+
+		if (fingerprintIndex == nil) {
+			return NO;
+		}
+
+		[engine setFingerprintIndex:fingerprintIndex];
+
+		return YES;
+	}
+
+	for (uint32_t i = 0; i < contextCount; i++) {
+		if (snapshot_load_peer(&reader, userState) == NO) {
+			return NO;
+		}
+	}
+
+	return YES;
+}
+
++ (NSData *)snapshotOfEngine:(OTRKitEngine *)engine
+{
+	AssertParamaterNil(engine)
+
+	NSParameterAssert([engine isOnInternalQueue]);
+
+	NSString *privateKeyPath = [engine privateKeyPath];
+	NSString *fingerprintsPath = [engine fingerprintsPath];
+	NSString *instanceTagsPath = [engine instanceTagsPath];
+
+	if (privateKeyPath == nil || fingerprintsPath == nil || instanceTagsPath == nil) {
+		return nil;
+	}
+
+	/* The stamps are taken before the private keys and instance tags are
+	 read again so that a change made in between is never hidden. */
+	OTRKitSnapshotFileStamp privateKeyStamp = snapshot_file_stamp(privateKeyPath);
+	OTRKitSnapshotFileStamp fingerprintsStamp = snapshot_file_stamp(fingerprintsPath);
+	OTRKitSnapshotFileStamp instanceTagsStamp = snapshot_file_stamp(instanceTagsPath);
+
+	NSData *privateKeys = nil;
+	NSData *instanceTags = nil;
+
+	if (privateKeyStamp.exists) {
+		privateKeys = [NSData dataWithContentsOfFile:privateKeyPath];
+
+		if (privateKeys == nil) {
+			return nil;
+		}
+	}
+
+	if (instanceTagsStamp.exists) {
+		instanceTags = [NSData dataWithContentsOfFile:instanceTagsPath];
+
+		if (instanceTags == nil) {
+			return nil;
+		}
+	}
+
+	NSMutableData *snapshot = [NSMutableData data];
+
+	[snapshot appendBytes:kOTRKitSnapshotMagic length:sizeof(kOTRKitSnapshotMagic)];
+
+	snapshot_append_uint32(snapshot, OTRKitSnapshotVersion);
+
+	snapshot_append_file_stamp(snapshot, &privateKeyStamp);
+	snapshot_append_file_stamp(snapshot, &fingerprintsStamp);
+	snapshot_append_file_stamp(snapshot, &instanceTagsStamp);
+
+	snapshot_append_uint64(snapshot, [privateKeys length]);
+	snapshot_append_uint64(snapshot, [instanceTags length]);
+
+	if (privateKeys) {
+		[snapshot appendData:privateKeys];
+	}
+
+	if (instanceTags) {
+		[snapshot appendData:instanceTags];
+	}
+
+	/* Only master contexts that have fingerprints are stored, the same as
+	 the fingerprints file. libotr keeps contexts sorted in ascending order
+	 so they are gathered first, then written starting from the last. */
+	NSMutableArray *contexts = [NSMutableArray array];
+
+	for (ConnContext *context = [engine userState]->context_root; context; context = context->next) {
+		if (context->m_context == context && context->fingerprint_root.next) {
+			[contexts addObject:[NSValue valueWithPointer:context]];
+		}
+	}
+
+	snapshot_append_uint32(snapshot, (uint32_t)[contexts count]);
+
+	NSMutableData *contextOffsets = [NSMutableData data];
+
+	for (NSValue *contextValue in [contexts reverseObjectEnumerator]) {
+		ConnContext *context = [contextValue pointerValue];
+
+		snapshot_append_uint64(contextOffsets, [snapshot length]);
+
+		snapshot_append_string(snapshot, context->username);
+		snapshot_append_string(snapshot, context->accountname);
+		snapshot_append_string(snapshot, context->protocol);
+
+		uint32_t fingerprintCount = 0;
+
+		for (Fingerprint *fingerprint = context->fingerprint_root.next; fingerprint; fingerprint = fingerprint->next) {
+			fingerprintCount += 1;
+		}
+
+		snapshot_append_uint32(snapshot, fingerprintCount);
+
+		for (Fingerprint *fingerprint = context->fingerprint_root.next; fingerprint; fingerprint = fingerprint->next) {
+			[snapshot appendBytes:fingerprint->fingerprint length:OTRKitSnapshotFingerprintLength];
+
+			if (fingerprint->trust) {
+				snapshot_append_string(snapshot, fingerprint->trust);
+			} else {
+				snapshot_append_uint32(snapshot, OTRKitSnapshotNoTrust);
+			}
+		}
+	}
+
+	/* The offset of each context, in the order they are stored, makes
+	 it possible to find one without reading the ones before it. */
+	uint64_t indexOffset = [snapshot length];
+
+	[snapshot appendData:contextOffsets];
+
+	snapshot_append_uint64(snapshot, indexOffset);
+
+	return snapshot;
+}
+
+@end
@@ -0,0 +1,175 @@
+/* *********************************************************************
+
+        Copyright (c) 2010 - 2015 Codeux Software, LLC
+     Please see ACKNOWLEDGEMENT for additional information.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+
+ * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+ * Neither the name of "Codeux Software, LLC", nor the names of its 
+   contributors may be used to endorse or promote products derived 
+   from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ SUCH DAMAGE.
+
+ *********************************************************************** */
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ *  The private key of an account.
+ */
+@interface OTRKitPrivateKeyRecord : NSObject
+- (instancetype)initWithAccountName:(NSString *)accountName
+						   protocol:(NSString *)protocol
+							keyData:(NSData *)keyData;
+
+@property (readonly, copy) NSString *accountName;
+@property (readonly, copy) NSString *protocol;
+
+/**
+ *  The key as it appears in the private keys file written by libotr:
+ *  an (account ...) S-expression holding the name, protocol, and key.
+ */
+@property (readonly, copy) NSData *keyData;
+@end
+
+/**
+ *  A fingerprint of a remote user and the trust placed in it.
+ */
+@interface OTRKitFingerprintRecord : NSObject
+- (instancetype)initWithUsername:(NSString *)username
+					 accountName:(NSString *)accountName
+						protocol:(NSString *)protocol
+					 fingerprint:(NSData *)fingerprint
+						   trust:(nullable NSString *)trust;
+
+@property (readonly, copy) NSString *username;
+@property (readonly, copy) NSString *accountName;
+@property (readonly, copy) NSString *protocol;
+
+/**
+ *  The 20 byte fingerprint.
+ */
+@property (readonly, copy) NSData *fingerprint;
+
+/**
+ *  The trust placed in the fingerprint. A fingerprint is trusted when
+ *  this value is not nil and not empty.
+ */
+@property (readonly, copy, nullable) NSString *trust;
+@end
+
+/**
+ *  The OTRv3 instance tag of an account.
+ */
+@interface OTRKitInstanceTagRecord : NSObject
+- (instancetype)initWithAccountName:(NSString *)accountName
+						   protocol:(NSString *)protocol
+						instanceTag:(uint32_t)instanceTag;
+
+@property (readonly, copy) NSString *accountName;
+@property (readonly, copy) NSString *protocol;
+@property (readonly) uint32_t instanceTag;
+@end
+
+/**
+ *  Changes made to a storage inside of -performTransaction:error:
+ */
+@protocol OTRKitStorageTransaction <NSObject>
+/**
+ *  Adds a record or replaces the record for the same account.
+ */
+- (void)setPrivateKey:(OTRKitPrivateKeyRecord *)privateKey;
+
+/**
+ *  Adds a record or replaces the record for the same username,
+ *  account name, protocol, and fingerprint.
+ */
+- (void)setFingerprint:(OTRKitFingerprintRecord *)fingerprint;
+
+/**
+ *  Removes the record for the same username, account name, protocol,
+ *  and fingerprint. The trust of the record passed is not considered.
+ */
+- (void)removeFingerprint:(OTRKitFingerprintRecord *)fingerprint;
+
+/**
+ *  Removes every fingerprint that belongs to an account. Every
+ *  fingerprint is removed when both parameters are nil.
+ */
+- (void)removeAllFingerprintsForAccountName:(nullable NSString *)accountName
+								   protocol:(nullable NSString *)protocol;
+
+/**
+ *  Adds a record or replaces the record for the same account.
+ */
+- (void)setInstanceTag:(OTRKitInstanceTagRecord *)instanceTag;
+@end
+
+/**
+ *  A place for OTRKit to store private keys, fingerprints, and instance
+ *  tags other than the files in its data path. Assign an object that
+ *  conforms to this protocol to -[OTRKit storage]
+ *
+ *  Methods are called from the internal queues of OTRKit, several of which
+ *  may be running at once when sharding is enabled, so an implementation
+ *  must be thread safe.
+ *
+ *  For the methods that accept an account name and a protocol, records
+ *  of every account are returned when both parameters are nil.
+ */
+@protocol OTRKitStorage <NSObject>
+- (NSArray<OTRKitPrivateKeyRecord *> *)privateKeysForAccountName:(nullable NSString *)accountName
+														 protocol:(nullable NSString *)protocol;
+
+- (NSArray<OTRKitInstanceTagRecord *> *)instanceTagsForAccountName:(nullable NSString *)accountName
+														   protocol:(nullable NSString *)protocol;
+
+/**
+ *  Calls the block for each fingerprint of an account.
+ *
+ *  Records should be ordered by username, account name, and protocol,
+ *  in descending order, as compared by strcmp() on their UTF-8 forms.
+ *  libotr loads records in that order in linear instead of quadratic
+ *  time; records in any other order are still loaded correctly.
+ */
+- (void)enumerateFingerprintsForAccountName:(nullable NSString *)accountName
+								   protocol:(nullable NSString *)protocol
+								 usingBlock:(void (NS_NOESCAPE ^)(OTRKitFingerprintRecord *fingerprint))block;
+
+/**
+ *  Returns the fingerprints of a single remote user.
+ */
+- (NSArray<OTRKitFingerprintRecord *> *)fingerprintsForUsername:(NSString *)username
+													accountName:(NSString *)accountName
+													   protocol:(NSString *)protocol;
+
+/**
+ *  Applies the changes made by the block all together, or not at all.
+ *  Changes must not be made to the transaction after the block returns.
+ *
+ *  @return NO if the changes could not be applied, in which case error
+ *  describes why.
+ */
+- (BOOL)performTransaction:(void (NS_NOESCAPE ^)(id<OTRKitStorageTransaction> transaction))block
+					 error:(NSError * _Nullable * _Nullable)error;
+@end
+
+NS_ASSUME_NONNULL_END
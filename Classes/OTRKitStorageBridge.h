@@ -0,0 +1,95 @@
+/* *********************************************************************
+
+        Copyright (c) 2010 - 2015 Codeux Software, LLC
+     Please see ACKNOWLEDGEMENT for additional information.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+
+ * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+ * Neither the name of "Codeux Software, LLC", nor the names of its 
+   contributors may be used to endorse or promote products derived 
+   from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ SUCH DAMAGE.
+
+ *********************************************************************** */
+
+#import "OTRKitStorage.h"
+
+#import "libotr/proto.h"
+#import "libotr/context.h"
+#import "libotr/privkey.h"
+#import "libotr/instag.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+@class OTRKitLoadStatistics;
+
+/**
+ *  Records that describe the current state of libotr structures.
+ */
+OTRKitPrivateKeyRecord * _Nullable OTRKitStoragePrivateKeyRecord(OtrlPrivKey *privateKey);
+
+OTRKitFingerprintRecord *OTRKitStorageFingerprintRecord(Fingerprint *fingerprint);
+
+OTRKitInstanceTagRecord *OTRKitStorageInstanceTagRecord(OtrlInsTag *instanceTag);
+
+/**
+ *  Returns every private key held by a user state in the format of the
+ *  private keys file that libotr writes. Returns nil if a key cannot be
+ *  encoded.
+ */
+NSData * _Nullable OTRKitStoragePrivateKeysFileData(OtrlUserState userState);
+
+/**
+ *  Replaces the private keys of a user state with those in the contents
+ *  of a private keys file.
+ *
+ *  otrl_privkey_read_FILEp() calls fstat() on its FILE to learn its size,
+ *  so it only reads real files. The keys are parsed in memory instead and
+ *  are inserted into the user state the same way libotr inserts them.
+ *  Secret keys therefore never have to be written to disk to be read.
+ */
+gcry_error_t OTRKitStorageReadPrivateKeys(OtrlUserState userState, NSData *privateKeysData);
+
+/**
+ *  Inserts a key started with otrl_privkey_generate_start() into a user
+ *  state, replacing the key of its account, and frees the pending key.
+ *
+ *  otrl_privkey_generate_finish_FILEp() instead writes every key of the
+ *  user state and reads them all back. Nothing is written here; callers
+ *  finishing many keys serialize the user state once when they are done.
+ */
+gcry_error_t OTRKitStorageFinishGeneratingPrivateKey(OtrlUserState userState, void *newKey);
+
+/**
+ *  Reads the private keys, instance tags, and fingerprints of an account
+ *  from a storage into a user state. Records of every account are read
+ *  when both accountName and protocol are nil.
+ *
+ *  The user state is expected to be empty. Must be called on the internal
+ *  queue of the engine that owns the user state.
+ */
+void OTRKitStorageReadIntoUserState(id<OTRKitStorage> storage,
+									OtrlUserState userState,
+									NSString * _Nullable accountName,
+									NSString * _Nullable protocol,
+									OTRKitLoadStatistics * _Nullable loadStatistics);
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,522 @@
+/* *********************************************************************
+
+        Copyright (c) 2010 - 2015 Codeux Software, LLC
+     Please see ACKNOWLEDGEMENT for additional information.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+
+ * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+ * Neither the name of "Codeux Software, LLC", nor the names of its 
+   contributors may be used to endorse or promote products derived 
+   from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ SUCH DAMAGE.
+
+ *********************************************************************** */
+
+#import "OTRKitPrivate.h"
+
+#pragma mark -
+#pragma mark Records
+
+/* Appends an S-expression the same way libotr does when it
+ writes the private keys file. */
+static BOOL storage_append_sexp(NSMutableData *data, gcry_sexp_t sexp)
+{
+	size_t length = gcry_sexp_sprint(sexp, GCRYSEXP_FMT_ADVANCED, NULL, 0);
+
+	if (length == 0) {
+		return NO;
+	}
+
+	char *buffer = malloc(length);
+
+	if (buffer == NULL) {
+		return NO;
+	}
+
+	gcry_sexp_sprint(sexp, GCRYSEXP_FMT_ADVANCED, buffer, length);
+
+	[data appendBytes:buffer length:strnlen(buffer, length)];
+
+	free(buffer);
+
+	return YES;
+}
+
+OTRKitPrivateKeyRecord *OTRKitStoragePrivateKeyRecord(OtrlPrivKey *privateKey)
+{
+	NSCParameterAssert(privateKey != NULL);
+
+	gcry_sexp_t name = NULL;
+	gcry_sexp_t protocol = NULL;
+
+	gcry_error_t buildError = gcry_sexp_build(&name, NULL, "(name %s)", privateKey->accountname);
+
+	if (buildError == gcry_error(GPG_ERR_NO_ERROR)) {
+		buildError = gcry_sexp_build(&protocol, NULL, "(protocol %s)", privateKey->protocol);
+	}
+
+	NSMutableData *keyData = nil;
+
+	if (buildError == gcry_error(GPG_ERR_NO_ERROR)) {
+		keyData = [NSMutableData data];
+
+		[keyData appendBytes:" (account\n" length:10];
+
+		if (storage_append_sexp(keyData, name) == NO ||
+			storage_append_sexp(keyData, protocol) == NO ||
+			storage_append_sexp(keyData, privateKey->privkey) == NO)
+		{
+			keyData = nil;
+		} else {
+			[keyData appendBytes:" )\n" length:3];
+		}
+	}
+
+	gcry_sexp_release(name);
+	gcry_sexp_release(protocol);
+
+	if (keyData == nil) {
+		return nil;
+	}
+
+	return [[OTRKitPrivateKeyRecord alloc] initWithAccountName:@(privateKey->accountname)
+													  protocol:@(privateKey->protocol)
+													   keyData:keyData];
+}
+
+OTRKitFingerprintRecord *OTRKitStorageFingerprintRecord(Fingerprint *fingerprint)
+{
+	NSCParameterAssert(fingerprint != NULL);
+
+	ConnContext *context = fingerprint->context;
+
+	NSString *trust = nil;
+
+	if (fingerprint->trust) {
+		trust = @(fingerprint->trust);
+	}
+
+	return [[OTRKitFingerprintRecord alloc] initWithUsername:@(context->username)
+												 accountName:@(context->accountname)
+													protocol:@(context->protocol)
+												 fingerprint:[NSData dataWithBytes:fingerprint->fingerprint length:20]
+													   trust:trust];
+}
+
+OTRKitInstanceTagRecord *OTRKitStorageInstanceTagRecord(OtrlInsTag *instanceTag)
+{
+	NSCParameterAssert(instanceTag != NULL);
+
+	return [[OTRKitInstanceTagRecord alloc] initWithAccountName:@(instanceTag->accountname)
+													   protocol:@(instanceTag->protocol)
+													instanceTag:instanceTag->instag];
+}
+
+NSData *OTRKitStoragePrivateKeysFileData(OtrlUserState userState)
+{
+	NSCParameterAssert(userState != NULL);
+
+	NSMutableData *privateKeysData = [NSMutableData data];
+
+	[privateKeysData appendBytes:"(privkeys\n" length:10];
+
+	for (OtrlPrivKey *privateKey = userState->privkey_root; privateKey; privateKey = privateKey->next) {
+		OTRKitPrivateKeyRecord *record = OTRKitStoragePrivateKeyRecord(privateKey);
+
+		if (record == nil) {
+			return nil;
+		}
+
+		[privateKeysData appendData:[record keyData]];
+	}
+
+	[privateKeysData appendBytes:")\n" length:2];
+
+	return [privateKeysData copy];
+}
+
+#pragma mark -
+#pragma mark Reading
+
+/* The public key of a private key is the MPIs p, q, g and y of its
+ DSA key, each prefixed with its length. This is what libotr computes
+ for the private keys that it reads itself. */
+static gcry_error_t storage_make_public_key(OtrlPrivKey *privateKey)
+{
+	gcry_sexp_t dsa = gcry_sexp_find_token(privateKey->privkey, "dsa", 0);
+
+	if (dsa == NULL) {
+		return gcry_error(GPG_ERR_UNUSABLE_SECKEY);
+	}
+
+	static const char *parameterTokens[4] = {"p", "q", "g", "y"};
+
+	gcry_mpi_t parameters[4] = {NULL, NULL, NULL, NULL};
+
+	size_t parameterLengths[4] = {0, 0, 0, 0};
+
+	size_t publicKeyLength = 0;
+
+	gcry_error_t makeError = gcry_error(GPG_ERR_NO_ERROR);
+
+	for (int i = 0; i < 4; i++) {
+		gcry_sexp_t parameter = gcry_sexp_find_token(dsa, parameterTokens[i], 0);
+
+		if (parameter) {
+			parameters[i] = gcry_sexp_nth_mpi(parameter, 1, GCRYMPI_FMT_USG);
+
+			gcry_sexp_release(parameter);
+		}
+
+		if (parameters[i] == NULL) {
+			makeError = gcry_error(GPG_ERR_UNUSABLE_SECKEY);
+
+			break;
+		}
+
+		gcry_mpi_print(GCRYMPI_FMT_USG, NULL, 0, &parameterLengths[i], parameters[i]);
+
+		publicKeyLength += (parameterLengths[i] + 4);
+	}
+
+	gcry_sexp_release(dsa);
+
+	unsigned char *publicKey = NULL;
+
+	if (makeError == gcry_error(GPG_ERR_NO_ERROR)) {
+		publicKey = malloc(publicKeyLength);
+
+		if (publicKey == NULL) {
+			makeError = gcry_error(GPG_ERR_ENOMEM);
+		}
+	}
+
+	if (makeError == gcry_error(GPG_ERR_NO_ERROR)) {
+		unsigned char *publicKeyPosition = publicKey;
+
+		for (int i = 0; i < 4; i++) {
+			uint32_t parameterLength = CFSwapInt32HostToBig((uint32_t)parameterLengths[i]);
+
+			memcpy(publicKeyPosition, &parameterLength, 4);
+
+			gcry_mpi_print(GCRYMPI_FMT_USG, (publicKeyPosition + 4), parameterLengths[i], NULL, parameters[i]);
+
+			publicKeyPosition += (parameterLengths[i] + 4);
+		}
+
+		privateKey->pubkey_data = publicKey;
+		privateKey->pubkey_datalen = publicKeyLength;
+	}
+
+	for (int i = 0; i < 4; i++) {
+		gcry_mpi_release(parameters[i]);
+	}
+
+	return makeError;
+}
+
+/* Inserts a private key into a user state the same way libotr does when
+ it reads one. The user state takes ownership of all three arguments,
+ which are freed if the key cannot be inserted. */
+static gcry_error_t storage_insert_private_key(OtrlUserState userState, char *accountName, char *protocol, gcry_sexp_t privateKeySexp)
+{
+	OtrlPrivKey *privateKey = NULL;
+
+	if (accountName && protocol && privateKeySexp) {
+		privateKey = calloc(1, sizeof(OtrlPrivKey));
+	}
+
+	if (privateKey == NULL) {
+		free(accountName);
+		free(protocol);
+
+		gcry_sexp_release(privateKeySexp);
+
+		return gcry_error(GPG_ERR_UNUSABLE_SECKEY);
+	}
+
+	privateKey->accountname = accountName;
+	privateKey->protocol = protocol;
+	privateKey->pubkey_type = OTRL_PUBKEY_TYPE_DSA;
+	privateKey->privkey = privateKeySexp;
+
+	privateKey->next = userState->privkey_root;
+
+	if (privateKey->next) {
+		privateKey->next->tous = &(privateKey->next);
+	}
+
+	privateKey->tous = &(userState->privkey_root);
+
+	userState->privkey_root = privateKey;
+
+	if (storage_make_public_key(privateKey)) {
+		otrl_privkey_forget(privateKey);
+
+		return gcry_error(GPG_ERR_UNUSABLE_SECKEY);
+	}
+
+	return gcry_error(GPG_ERR_NO_ERROR);
+}
+
+static char *storage_copy_sexp_string(gcry_sexp_t sexp, const char *token)
+{
+	gcry_sexp_t value = gcry_sexp_find_token(sexp, token, 0);
+
+	if (value == NULL) {
+		return NULL;
+	}
+
+	size_t length = 0;
+
+	const char *bytes = gcry_sexp_nth_data(value, 1, &length);
+
+	char *string = NULL;
+
+	if (bytes) {
+		string = malloc(length + 1);
+
+		if (string) {
+			memcpy(string, bytes, length);
+
+			string[length] = '\0';
+		}
+	}
+
+	gcry_sexp_release(value);
+
+	return string;
+}
+
+gcry_error_t OTRKitStorageReadPrivateKeys(OtrlUserState userState, NSData *privateKeysData)
+{
+	NSCParameterAssert(userState != NULL);
+	NSCParameterAssert(privateKeysData != nil);
+
+	otrl_privkey_forget_all(userState);
+
+	gcry_sexp_t privateKeys = NULL;
+
+	gcry_error_t readError = gcry_sexp_new(&privateKeys, [privateKeysData bytes], [privateKeysData length], 0);
+
+	if (readError) {
+		return readError;
+	}
+
+	size_t tokenLength = 0;
+
+	const char *token = gcry_sexp_nth_data(privateKeys, 0, &tokenLength);
+
+	if (token == NULL || tokenLength != 8 || strncmp(token, "privkeys", 8) != 0) {
+		gcry_sexp_release(privateKeys);
+
+		return gcry_error(GPG_ERR_UNUSABLE_SECKEY);
+	}
+
+	int accountCount = gcry_sexp_length(privateKeys);
+
+	for (int i = 1; i < accountCount; i++) {
+		gcry_sexp_t account = gcry_sexp_nth(privateKeys, i);
+
+		if (account == NULL) {
+			readError = gcry_error(GPG_ERR_UNUSABLE_SECKEY);
+
+			break;
+		}
+
+		token = gcry_sexp_nth_data(account, 0, &tokenLength);
+
+		if (token == NULL || tokenLength != 7 || strncmp(token, "account", 7) != 0) {
+			gcry_sexp_release(account);
+
+			readError = gcry_error(GPG_ERR_UNUSABLE_SECKEY);
+
+			break;
+		}
+
+		char *accountName = storage_copy_sexp_string(account, "name");
+		char *protocol = storage_copy_sexp_string(account, "protocol");
+
+		gcry_sexp_t privateKeySexp = gcry_sexp_find_token(account, "private-key", 0);
+
+		gcry_sexp_release(account);
+
+		readError = storage_insert_private_key(userState, accountName, protocol, privateKeySexp);
+
+		if (readError) {
+			break;
+		}
+	}
+
+	gcry_sexp_release(privateKeys);
+
+	return readError;
+}
+
+/* The opaque key that otrl_privkey_generate_start() hands out is
+ a struct s_pending_privkey_calc, which libotr does not export. */
+typedef struct {
+	char *accountname;
+	char *protocol;
+	gcry_sexp_t privkey;
+} storage_pending_private_key;
+
+gcry_error_t OTRKitStorageFinishGeneratingPrivateKey(OtrlUserState userState, void *newKey)
+{
+	NSCParameterAssert(userState != NULL);
+	NSCParameterAssert(newKey != NULL);
+
+	storage_pending_private_key *pendingKey = newKey;
+
+	gcry_error_t finishError = gcry_error(GPG_ERR_INV_VALUE);
+
+	if (pendingKey->accountname && pendingKey->protocol && pendingKey->privkey) {
+		OtrlPrivKey *replacedKey = otrl_privkey_find(userState, pendingKey->accountname, pendingKey->protocol);
+
+		if (replacedKey) {
+			otrl_privkey_forget(replacedKey);
+		}
+
+		finishError = storage_insert_private_key(userState,
+												 strdup(pendingKey->accountname),
+												 strdup(pendingKey->protocol),
+												 pendingKey->privkey);
+
+		/* The user state owns the key now so it is not released below. */
+		pendingKey->privkey = NULL;
+	}
+
+	otrl_privkey_generate_cancelled(userState, newKey);
+
+	return finishError;
+}
+
+static void storage_read_private_keys(id<OTRKitStorage> storage, OtrlUserState userState, NSString *accountName, NSString *protocol)
+{
+	NSArray *privateKeys = [storage privateKeysForAccountName:accountName protocol:protocol];
+
+	if ([privateKeys count] == 0) {
+		return;
+	}
+
+	/* libotr forgets every key it knows when it reads keys
+	 so all of them are read in one go as a single file. */
+	NSMutableData *privateKeysData = [NSMutableData data];
+
+	[privateKeysData appendBytes:"(privkeys\n" length:10];
+
+	for (OTRKitPrivateKeyRecord *privateKey in privateKeys) {
+		[privateKeysData appendData:[privateKey keyData]];
+	}
+
+	[privateKeysData appendBytes:")\n" length:2];
+
+	gcry_error_t readError = OTRKitStorageReadPrivateKeys(userState, privateKeysData);
+
+	if (readError) {
+		LogToConsole(@"Failed to read private keys from storage: %s", gcry_strerror(readError));
+	}
+}
+
+static void storage_read_fingerprints(id<OTRKitStorage> storage, OtrlUserState userState, NSString *accountName, NSString *protocol)
+{
+	__block ConnContext *context = NULL;
+
+	[storage enumerateFingerprintsForAccountName:accountName protocol:protocol usingBlock:^(OTRKitFingerprintRecord *record) {
+		const char *username = [[record username] UTF8String];
+		const char *recordAccountName = [[record accountName] UTF8String];
+		const char *recordProtocol = [[record protocol] UTF8String];
+
+		/* Records of a peer arrive together when they are in order */
+		if (context == NULL ||
+			strcmp(context->username, username) != 0 ||
+			strcmp(context->accountname, recordAccountName) != 0 ||
+			strcmp(context->protocol, recordProtocol) != 0)
+		{
+			context = otrl_context_find(userState, username, recordAccountName, recordProtocol, OTRL_INSTAG_MASTER, 1, NULL, NULL, NULL);
+		}
+
+		NSData *fingerprintData = [record fingerprint];
+
+		if (context == NULL || [fingerprintData length] != 20) {
+			return;
+		}
+
+		/* libotr copies the fingerprint; it is not modified. */
+		Fingerprint *fingerprint = otrl_context_find_fingerprint(context, (unsigned char *)[fingerprintData bytes], 1, NULL);
+
+		if (fingerprint) {
+			otrl_context_set_trust(fingerprint, [[record trust] UTF8String]);
+		}
+	}];
+}
+
+static void storage_read_instance_tags(id<OTRKitStorage> storage, OtrlUserState userState, NSString *accountName, NSString *protocol)
+{
+	NSArray *instanceTags = [storage instanceTagsForAccountName:accountName protocol:protocol];
+
+	if ([instanceTags count] == 0) {
+		return;
+	}
+
+	/* Written in the format of the instance tags file */
+	NSMutableString *instanceTagsString = [NSMutableString string];
+
+	for (OTRKitInstanceTagRecord *instanceTag in instanceTags) {
+		[instanceTagsString appendFormat:@"%@\t%@\t%08x\n", [instanceTag accountName], [instanceTag protocol], [instanceTag instanceTag]];
+	}
+
+	FILE *filePointer = OTRKitMemoryFileOpenForReading([instanceTagsString dataUsingEncoding:NSUTF8StringEncoding]);
+
+	if (filePointer == NULL) {
+		return;
+	}
+
+	otrl_instag_read_FILEp(userState, filePointer);
+
+	fclose(filePointer);
+}
+
+void OTRKitStorageReadIntoUserState(id<OTRKitStorage> storage, OtrlUserState userState, NSString *accountName, NSString *protocol, OTRKitLoadStatistics *loadStatistics)
+{
+	NSCParameterAssert(storage != nil);
+	NSCParameterAssert(userState != NULL);
+
+	CFAbsoluteTime readStart = CFAbsoluteTimeGetCurrent();
+
+	storage_read_private_keys(storage, userState, accountName, protocol);
+
+	loadStatistics.privateKeysReadDuration = (CFAbsoluteTimeGetCurrent() - readStart);
+
+	readStart = CFAbsoluteTimeGetCurrent();
+
+	/* Contexts created for fingerprints take their instance
+	 tag from the user state, so instance tags come first. */
+	storage_read_instance_tags(storage, userState, accountName, protocol);
+
+	loadStatistics.instanceTagsReadDuration = (CFAbsoluteTimeGetCurrent() - readStart);
+
+	readStart = CFAbsoluteTimeGetCurrent();
+
+	storage_read_fingerprints(storage, userState, accountName, protocol);
+
+	loadStatistics.fingerprintsReadDuration = (CFAbsoluteTimeGetCurrent() - readStart);
+}
@@ -0,0 +1,116 @@
+/* *********************************************************************
+
+        Copyright (c) 2010 - 2015 Codeux Software, LLC
+     Please see ACKNOWLEDGEMENT for additional information.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+
+ * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+ * Neither the name of "Codeux Software, LLC", nor the names of its 
+   contributors may be used to endorse or promote products derived 
+   from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ SUCH DAMAGE.
+
+ *********************************************************************** */
+
+NS_ASSUME_NONNULL_BEGIN
+
+@class OTRKitConversation;
+
+/**
+ *  Stages that a message goes through on its way through OTRKit.
+ */
+typedef NS_ENUM(NSUInteger, OTRKitTraceStage) {
+	/* Waiting for the internal queue to encode or decode a message */
+	OTRKitTraceStageInternalQueueWait,
+
+	/* Inside otrl_message_sending() and otrl_message_receiving() */
+	OTRKitTraceStageMessageSending,
+	OTRKitTraceStageMessageReceiving,
+
+	/* Handing a message or fragment that libotr injects to the delegate queue */
+	OTRKitTraceStageMessageInjection,
+
+	/* Waiting for the delegate queue and the delegate receiving a result */
+	OTRKitTraceStageDelegateDelivery,
+
+	/* From the first message of the authenticated key exchange of a
+	 conversation until the conversation is secure */
+	OTRKitTraceStageKeyExchange,
+
+	/* From the socialist millionaires' protocol being started by either
+	 side of a conversation until it succeeds, fails, or is aborted */
+	OTRKitTraceStageSMP
+};
+
+/**
+ *  A tracer is told when each stage begins and ends. Timestamps are
+ *  nanoseconds of a monotonic clock. The conversation is nil for work
+ *  that is not done for a particular conversation.
+ *
+ *  The methods are called on the internal queues and the delegate queue
+ *  at the same time so they must be thread safe, and they must return
+ *  quickly because the stage being traced waits for them.
+ *
+ *  Stages of the same conversation can overlap. The key exchange and SMP
+ *  stages can begin without ending when the remote user goes away.
+ */
+@protocol OTRKitTracer <NSObject>
+@required
+
+- (void)beginStage:(OTRKitTraceStage)stage
+	  conversation:(nullable OTRKitConversation *)conversation
+		 timestamp:(uint64_t)timestamp;
+
+- (void)endStage:(OTRKitTraceStage)stage
+	conversation:(nullable OTRKitConversation *)conversation
+	   timestamp:(uint64_t)timestamp;
+@end
+
+/**
+ *  A tracer that writes the stages to a file in the Trace Event Format
+ *  understood by chrome://tracing and Perfetto.
+ *
+ *  Each conversation is drawn as a thread of its own named after the order
+ *  it was first seen in. No names of users or accounts are written.
+ *  Events are written on a background queue.
+ */
+@interface OTRKitChromeTraceWriter : NSObject <OTRKitTracer>
+/**
+ *  Creates the file at path, replacing any file that exists there.
+ *
+ *  @return nil if the file could not be created, in which case error
+ *  describes why.
+ */
+- (nullable instancetype)initWithPath:(NSString *)path error:(NSError * _Nullable * _Nullable)error;
+
+- (instancetype)init NS_UNAVAILABLE;
+
++ (NSString *)nameOfStage:(OTRKitTraceStage)stage;
+
+/**
+ *  Writes the events that have not been written yet and completes the
+ *  file. Events that arrive after the writer is closed are dropped.
+ *  Called when the writer is deallocated if not called sooner.
+ */
+- (void)close;
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,334 @@
+/* *********************************************************************
+
+        Copyright (c) 2010 - 2015 Codeux Software, LLC
+     Please see ACKNOWLEDGEMENT for additional information.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+
+ * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+ * Neither the name of "Codeux Software, LLC", nor the names of its 
+   contributors may be used to endorse or promote products derived 
+   from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ SUCH DAMAGE.
+
+ *********************************************************************** */
+
+#import "OTRKitTracer.h"
+
+#import "OTRKitConversationPrivate.h"
+
+/* Events are collected in memory and written once this many bytes are collected */
+#define OTRKitChromeTraceWriterBufferSize		(64 * 1024)
+
+/* The thread of a conversation and the identifiers of its async events
+ that have begun but not ended yet, oldest first, for each stage. */
+@interface OTRKitChromeTraceThread : NSObject
+@property (nonatomic, assign) NSUInteger thread;
+@property (nonatomic, strong) NSMutableDictionary<NSNumber *, NSMutableArray<NSNumber *> *> *openEvents;
+@end
+
+@implementation OTRKitChromeTraceThread
+@end
+
+@interface OTRKitChromeTraceWriter ()
+@property (nonatomic, assign) FILE *filePointer;
+@property (nonatomic, strong) dispatch_queue_t writerQueue;
+@property (nonatomic, strong) NSMutableData *pendingData;
+@property (nonatomic, strong) NSMutableDictionary<NSString *, OTRKitChromeTraceThread *> *conversationThreads;
+@property (nonatomic, strong) OTRKitChromeTraceThread *mainThread;
+@property (nonatomic, assign) NSUInteger threadCount;
+@property (nonatomic, assign) NSUInteger eventCount;
+@property (nonatomic, assign) BOOL eventWritten;
+@property (nonatomic, assign) BOOL closed;
+@end
+
+@implementation OTRKitChromeTraceWriter
+
+- (instancetype)initWithPath:(NSString *)path error:(NSError **)error
+{
+	AssertParamaterLength(path)
+
+	if ((self = [super init])) {
+		FILE *filePointer = fopen([path fileSystemRepresentation], "w");
+
+		if (filePointer == NULL) {
+			if (error) {
+				*error = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:nil];
+			}
+
+			return nil;
+		}
+
+		fputs("[\n", filePointer);
+
+		self.filePointer = filePointer;
+
+		self.writerQueue = dispatch_queue_create("OTRKit Chrome Trace Writer Queue", DISPATCH_QUEUE_SERIAL);
+
+		self.pendingData = [NSMutableData dataWithCapacity:OTRKitChromeTraceWriterBufferSize];
+
+		/* A conversation that is evicted and used again is a new object
+		 with the same key. Keying by it keeps the conversation on one
+		 thread for as long as the trace is written. */
+		self.conversationThreads = [NSMutableDictionary dictionary];
+
+		self.mainThread = [OTRKitChromeTraceThread new];
+
+		self.mainThread.openEvents = [NSMutableDictionary dictionary];
+
+		[self _appendThreadName:"OTRKit" forThread:0];
+
+		return self;
+	}
+
+	return nil;
+}
+
+- (void)dealloc
+{
+	[self close];
+}
+
++ (NSString *)nameOfStage:(OTRKitTraceStage)stage
+{
+	switch (stage)
+	{
+		case OTRKitTraceStageInternalQueueWait:
+		{
+			return @"internal_queue_wait";
+		}
+		case OTRKitTraceStageMessageSending:
+		{
+			return @"otrl_message_sending";
+		}
+		case OTRKitTraceStageMessageReceiving:
+		{
+			return @"otrl_message_receiving";
+		}
+		case OTRKitTraceStageMessageInjection:
+		{
+			return @"inject_message";
+		}
+		case OTRKitTraceStageDelegateDelivery:
+		{
+			return @"delegate_delivery";
+		}
+		case OTRKitTraceStageKeyExchange:
+		{
+			return @"ake";
+		}
+		case OTRKitTraceStageSMP:
+		{
+			return @"smp";
+		}
+	}
+
+	return @"unknown";
+}
+
++ (BOOL)_stageIsNested:(OTRKitTraceStage)stage
+{
+	/* These stages run on the internal queue within each other. The rest
+	 cross queues and overlap other stages so they are drawn as async
+	 events which do not have to be nested. */
+	return (stage == OTRKitTraceStageMessageSending ||
+			stage == OTRKitTraceStageMessageReceiving ||
+			stage == OTRKitTraceStageMessageInjection);
+}
+
+- (void)beginStage:(OTRKitTraceStage)stage conversation:(OTRKitConversation *)conversation timestamp:(uint64_t)timestamp
+{
+	char phase = (([OTRKitChromeTraceWriter _stageIsNested:stage]) ? 'B' : 'b');
+
+	[self _appendEventOfStage:stage phase:phase conversation:conversation timestamp:timestamp];
+}
+
+- (void)endStage:(OTRKitTraceStage)stage conversation:(OTRKitConversation *)conversation timestamp:(uint64_t)timestamp
+{
+	char phase = (([OTRKitChromeTraceWriter _stageIsNested:stage]) ? 'E' : 'e');
+
+	[self _appendEventOfStage:stage phase:phase conversation:conversation timestamp:timestamp];
+}
+
+- (void)_appendEventOfStage:(OTRKitTraceStage)stage phase:(char)phase conversation:(OTRKitConversation *)conversation timestamp:(uint64_t)timestamp
+{
+	const char *stageName = [[OTRKitChromeTraceWriter nameOfStage:stage] UTF8String];
+
+	@synchronized (self) {
+		if (self.closed) {
+			return;
+		}
+
+		OTRKitChromeTraceThread *thread = [self _threadForConversation:conversation];
+
+		NSUInteger event = [self _eventOfStage:stage phase:phase thread:thread];
+
+		/* Timestamps of the format are microseconds. Async events are
+		 matched by their category and identifier. Stages of a conversation
+		 can overlap themselves, e.g. while several deliveries are queued,
+		 so each begin takes an identifier of its own that its end reuses. */
+		[self _appendFormat:"{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"%c\",\"ts\":%llu.%03llu,\"pid\":1,\"tid\":%lu,\"id\":%lu}",
+			stageName, stageName, phase, (timestamp / 1000), (timestamp % 1000), (unsigned long)[thread thread], (unsigned long)event];
+
+		if ([self.pendingData length] >= OTRKitChromeTraceWriterBufferSize) {
+			[self _writePendingData];
+		}
+	}
+}
+
+- (NSUInteger)_eventOfStage:(OTRKitTraceStage)stage phase:(char)phase thread:(OTRKitChromeTraceThread *)thread
+{
+	/* Nested stages are matched by their order instead. */
+	if (phase != 'b' && phase != 'e') {
+		return 0;
+	}
+
+	NSMutableArray<NSNumber *> *openEvents = thread.openEvents[@(stage)];
+
+	if (phase == 'b') {
+		if (openEvents == nil) {
+			openEvents = [NSMutableArray array];
+
+			thread.openEvents[@(stage)] = openEvents;
+		}
+
+		self.eventCount += 1;
+
+		[openEvents addObject:@(self.eventCount)];
+
+		return self.eventCount;
+	}
+
+	/* Each stage ends in the order it began in. An end
+	 without a begin is given an identifier of its own. */
+	NSNumber *event = [openEvents firstObject];
+
+	if (event == nil) {
+		self.eventCount += 1;
+
+		return self.eventCount;
+	}
+
+	[openEvents removeObjectAtIndex:0];
+
+	return [event unsignedIntegerValue];
+}
+
+- (OTRKitChromeTraceThread *)_threadForConversation:(OTRKitConversation *)conversation
+{
+	if (conversation == nil) {
+		return self.mainThread;
+	}
+
+	NSString *conversationKey = [conversation conversationKey];
+
+	OTRKitChromeTraceThread *thread = self.conversationThreads[conversationKey];
+
+	if (thread) {
+		return thread;
+	}
+
+	self.threadCount += 1;
+
+	thread = [OTRKitChromeTraceThread new];
+
+	thread.thread = self.threadCount;
+
+	thread.openEvents = [NSMutableDictionary dictionary];
+
+	self.conversationThreads[conversationKey] = thread;
+
+	char threadName[32];
+
+	snprintf(threadName, sizeof(threadName), "Conversation %lu", (unsigned long)[thread thread]);
+
+	[self _appendThreadName:threadName forThread:[thread thread]];
+
+	return thread;
+}
+
+- (void)_appendThreadName:(const char *)threadName forThread:(NSUInteger)thread
+{
+	[self _appendFormat:"{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%lu,\"args\":{\"name\":\"%s\"}}",
+		(unsigned long)thread, threadName];
+}
+
+- (void)_appendFormat:(const char *)format, ...
+{
+	char event[256];
+
+	va_list arguments;
+
+	va_start(arguments, format);
+
+	int eventLength = vsnprintf(event, sizeof(event), format, arguments);
+
+	va_end(arguments);
+
+	if (eventLength < 0 || eventLength >= (int)sizeof(event)) {
+		return;
+	}
+
+	if (self.eventWritten) {
+		[self.pendingData appendBytes:",\n" length:2];
+	}
+
+	[self.pendingData appendBytes:event length:eventLength];
+
+	self.eventWritten = YES;
+}
+
+- (void)_writePendingData
+{
+	NSData *data = self.pendingData;
+
+	self.pendingData = [NSMutableData dataWithCapacity:OTRKitChromeTraceWriterBufferSize];
+
+	FILE *filePointer = self.filePointer;
+
+	dispatch_async(self.writerQueue, ^{
+		fwrite([data bytes], 1, [data length], filePointer);
+	});
+}
+
+- (void)close
+{
+	@synchronized (self) {
+		if (self.closed) {
+			return;
+		}
+
+		self.closed = YES;
+
+		[self _writePendingData];
+	}
+
+	FILE *filePointer = self.filePointer;
+
+	dispatch_sync(self.writerQueue, ^{
+		fputs("\n]\n", filePointer);
+
+		fclose(filePointer);
+	});
+
+	self.filePointer = NULL;
+}
+
+@end
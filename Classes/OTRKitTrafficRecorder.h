@@ -0,0 +1,147 @@
+/* *********************************************************************
+
+        Copyright (c) 2010 - 2015 Codeux Software, LLC
+     Please see ACKNOWLEDGEMENT for additional information.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+
+ * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+ * Neither the name of "Codeux Software, LLC", nor the names of its 
+   contributors may be used to endorse or promote products derived 
+   from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ SUCH DAMAGE.
+
+ *********************************************************************** */
+
+NS_ASSUME_NONNULL_BEGIN
+
+@class OTRKitConversation;
+
+/**
+ *  What happened to a message that was recorded.
+ */
+typedef NS_ENUM(uint8_t, OTRKitTrafficRecordType) {
+	/* A message given to OTRKit to encode */
+	OTRKitTrafficRecordTypeEncode = 1,
+
+	/* A message given to OTRKit to decode */
+	OTRKitTrafficRecordTypeDecode = 2,
+
+	/* What libotr made of a message it decoded. The length is zero
+	 when the message was consumed by the protocol (e.g. a fragment). */
+	OTRKitTrafficRecordTypeDecoded = 3,
+
+	/* A message or fragment that libotr injected */
+	OTRKitTrafficRecordTypeInject = 4
+};
+
+/**
+ *  A single record of a traffic trace. Nothing a message says is
+ *  recorded, only its length, its type, and when it was seen.
+ */
+@interface OTRKitTrafficRecord : NSObject
+@property (readonly) OTRKitTrafficRecordType type;
+
+/**
+ *  Nanoseconds since the recording began
+ */
+@property (readonly) uint64_t timestamp;
+
+/**
+ *  Conversations are numbered from 1 in the order they were first seen.
+ *  Zero is work that was not done for a particular conversation.
+ */
+@property (readonly) NSUInteger conversation;
+
+/**
+ *  The type of an encoded message, or OTRKitMessageTypeNotOTR for
+ *  messages that are given to OTRKit to encode and decoded messages.
+ */
+@property (readonly) OTRKitMessageType messageType;
+
+/**
+ *  Length of the message in bytes of UTF-8
+ */
+@property (readonly) NSUInteger length;
+
+/**
+ *  Number of TLVs of a message given to OTRKit to encode
+ */
+@property (readonly) NSUInteger tlvCount;
+@end
+
+/**
+ *  Records the shape of the traffic of an OTRKit to a compact binary file
+ *  that can be replayed later to reproduce a workload. See -trafficRecorder
+ *
+ *  The file begins with the 8 bytes "OTRKTRF" followed by the version, 1.
+ *  Each record that follows is its type as a byte, the nanoseconds since
+ *  the record before it, the conversation, the message type as a byte,
+ *  the length, and the TLV count. Numbers other than bytes are unsigned
+ *  LEB128 so a record is usually 6 to 10 bytes.
+ *
+ *  No names of users or accounts and no part of any message is written.
+ *  Records are written on a background queue.
+ */
+@interface OTRKitTrafficRecorder : NSObject
+/**
+ *  Creates the file at path, replacing any file that exists there.
+ *
+ *  @return nil if the file could not be created, in which case error
+ *  describes why.
+ */
+- (nullable instancetype)initWithPath:(NSString *)path error:(NSError * _Nullable * _Nullable)error;
+
+- (instancetype)init NS_UNAVAILABLE;
+
+@property (readonly) NSUInteger recordCount;
+
+/**
+ *  Writes the records that have not been written yet and closes the file.
+ *  Records that arrive after the recorder is closed are dropped.
+ *  Called when the recorder is deallocated if not called sooner.
+ */
+- (void)close;
+@end
+
+/**
+ *  The records of a file written by OTRKitTrafficRecorder.
+ */
+@interface OTRKitTrafficTrace : NSObject
+/**
+ *  @return nil if the file could not be read or is not a traffic trace,
+ *  in which case error describes why. A record cut short at the end of
+ *  the file, as happens when the recorder was never closed, is ignored.
+ */
+- (nullable instancetype)initWithPath:(NSString *)path error:(NSError * _Nullable * _Nullable)error;
+
+- (instancetype)init NS_UNAVAILABLE;
+
+@property (readonly, copy) NSArray<OTRKitTrafficRecord *> *records;
+
+@property (readonly) NSUInteger conversationCount;
+
+/**
+ *  Nanoseconds from the start of the recording until the last record
+ */
+@property (readonly) uint64_t duration;
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,381 @@
+/* *********************************************************************
+
+        Copyright (c) 2010 - 2015 Codeux Software, LLC
+     Please see ACKNOWLEDGEMENT for additional information.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+
+ * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+ * Neither the name of "Codeux Software, LLC", nor the names of its 
+   contributors may be used to endorse or promote products derived 
+   from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ SUCH DAMAGE.
+
+ *********************************************************************** */
+
+#import "OTRKitTrafficRecorderPrivate.h"
+#import "OTRKitConversationPrivate.h"
+#import "OTRKitMetricsCounters.h"
+
+/* Records are collected in memory and written once this many bytes are collected */
+#define OTRKitTrafficRecorderBufferSize		(64 * 1024)
+
+#define OTRKitTrafficTraceMagicLength		7
+
+#define OTRKitTrafficTraceVersion			1
+
+static const char OTRKitTrafficTraceMagic[OTRKitTrafficTraceMagicLength] = {'O', 'T', 'R', 'K', 'T', 'R', 'F'};
+
+static NSUInteger OTRKitTrafficTraceWriteNumber(uint8_t *buffer, uint64_t number)
+{
+	NSUInteger length = 0;
+
+	do {
+		uint8_t byte = (number & 0x7F);
+
+		number >>= 7;
+
+		if (number > 0) {
+			byte |= 0x80;
+		}
+
+		buffer[length] = byte;
+
+		length += 1;
+	} while (number > 0);
+
+	return length;
+}
+
+static BOOL OTRKitTrafficTraceReadNumber(const uint8_t *bytes, NSUInteger length, NSUInteger *offset, uint64_t *number)
+{
+	uint64_t result = 0;
+
+	unsigned int shift = 0;
+
+	while (*offset < length && shift < 64) {
+		uint8_t byte = bytes[*offset];
+
+		*offset += 1;
+
+		result |= ((uint64_t)(byte & 0x7F) << shift);
+
+		if ((byte & 0x80) == 0) {
+			*number = result;
+
+			return YES;
+		}
+
+		shift += 7;
+	}
+
+	return NO;
+}
+
+#pragma mark -
+
+@interface OTRKitTrafficRecord ()
+@property (readwrite, assign) OTRKitTrafficRecordType type;
+@property (readwrite, assign) uint64_t timestamp;
+@property (readwrite, assign) NSUInteger conversation;
+@property (readwrite, assign) OTRKitMessageType messageType;
+@property (readwrite, assign) NSUInteger length;
+@property (readwrite, assign) NSUInteger tlvCount;
+@end
+
+@implementation OTRKitTrafficRecord
+@end
+
+#pragma mark -
+
+@interface OTRKitTrafficRecorder ()
+@property (nonatomic, assign) FILE *filePointer;
+@property (nonatomic, strong) dispatch_queue_t writerQueue;
+@property (nonatomic, strong) NSMutableData *pendingData;
+@property (nonatomic, strong) NSMutableDictionary<NSString *, NSNumber *> *conversationNumbers;
+@property (nonatomic, assign) NSUInteger conversationCount;
+@property (nonatomic, assign) uint64_t lastTimestamp;
+@property (readwrite, assign) NSUInteger recordCount;
+@property (nonatomic, assign) BOOL closed;
+@end
+
+@implementation OTRKitTrafficRecorder
+
+- (instancetype)initWithPath:(NSString *)path error:(NSError **)error
+{
+	AssertParamaterLength(path)
+
+	if ((self = [super init])) {
+		FILE *filePointer = fopen([path fileSystemRepresentation], "w");
+
+		if (filePointer == NULL) {
+			if (error) {
+				*error = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:nil];
+			}
+
+			return nil;
+		}
+
+		fwrite(OTRKitTrafficTraceMagic, 1, OTRKitTrafficTraceMagicLength, filePointer);
+
+		fputc(OTRKitTrafficTraceVersion, filePointer);
+
+		self.filePointer = filePointer;
+
+		self.writerQueue = dispatch_queue_create("OTRKit Traffic Recorder Queue", DISPATCH_QUEUE_SERIAL);
+
+		self.pendingData = [NSMutableData dataWithCapacity:OTRKitTrafficRecorderBufferSize];
+
+		/* A conversation that is evicted and used again is a new object
+		 with the same key. Keying by it keeps its number for as long as
+		 the trace is recorded so that a replay sees one conversation. */
+		self.conversationNumbers = [NSMutableDictionary dictionary];
+
+		self.lastTimestamp = OTRKitMetricsNow();
+
+		return self;
+	}
+
+	return nil;
+}
+
+- (void)dealloc
+{
+	[self close];
+}
+
+- (void)recordType:(OTRKitTrafficRecordType)type
+	  conversation:(OTRKitConversation *)conversation
+	   messageType:(OTRKitMessageType)messageType
+			length:(NSUInteger)length
+		  tlvCount:(NSUInteger)tlvCount
+{
+	/* The type, three numbers of at most 10 bytes, and the message type */
+	uint8_t record[32];
+
+	@synchronized (self) {
+		if (self.closed) {
+			return;
+		}
+
+		uint64_t timestamp = OTRKitMetricsNow();
+
+		NSUInteger recordLength = 0;
+
+		record[recordLength] = type;
+
+		recordLength += 1;
+
+		recordLength += OTRKitTrafficTraceWriteNumber(&record[recordLength], (timestamp - self.lastTimestamp));
+
+		recordLength += OTRKitTrafficTraceWriteNumber(&record[recordLength], [self _numberForConversation:conversation]);
+
+		record[recordLength] = (uint8_t)messageType;
+
+		recordLength += 1;
+
+		recordLength += OTRKitTrafficTraceWriteNumber(&record[recordLength], length);
+
+		recordLength += OTRKitTrafficTraceWriteNumber(&record[recordLength], tlvCount);
+
+		[self.pendingData appendBytes:record length:recordLength];
+
+		self.lastTimestamp = timestamp;
+
+		self.recordCount += 1;
+
+		if ([self.pendingData length] >= OTRKitTrafficRecorderBufferSize) {
+			[self _writePendingData];
+		}
+	}
+}
+
+- (NSUInteger)_numberForConversation:(OTRKitConversation *)conversation
+{
+	if (conversation == nil) {
+		return 0;
+	}
+
+	NSString *conversationKey = [conversation conversationKey];
+
+	NSNumber *number = self.conversationNumbers[conversationKey];
+
+	if (number) {
+		return [number unsignedIntegerValue];
+	}
+
+	self.conversationCount += 1;
+
+	NSUInteger numberNew = self.conversationCount;
+
+	self.conversationNumbers[conversationKey] = @(numberNew);
+
+	return numberNew;
+}
+
+- (void)_writePendingData
+{
+	NSData *data = self.pendingData;
+
+	self.pendingData = [NSMutableData dataWithCapacity:OTRKitTrafficRecorderBufferSize];
+
+	FILE *filePointer = self.filePointer;
+
+	dispatch_async(self.writerQueue, ^{
+		fwrite([data bytes], 1, [data length], filePointer);
+	});
+}
+
+- (void)close
+{
+	@synchronized (self) {
+		if (self.closed) {
+			return;
+		}
+
+		self.closed = YES;
+
+		[self _writePendingData];
+	}
+
+	FILE *filePointer = self.filePointer;
+
+	dispatch_sync(self.writerQueue, ^{
+		fclose(filePointer);
+	});
+
+	self.filePointer = NULL;
+}
+
+@end
+
+#pragma mark -
+
+@interface OTRKitTrafficTrace ()
+@property (readwrite, copy) NSArray<OTRKitTrafficRecord *> *records;
+@property (readwrite, assign) NSUInteger conversationCount;
+@property (readwrite, assign) uint64_t duration;
+@end
+
+@implementation OTRKitTrafficTrace
+
+- (instancetype)initWithPath:(NSString *)path error:(NSError **)error
+{
+	AssertParamaterLength(path)
+
+	if ((self = [super init])) {
+		NSData *traceData = [NSData dataWithContentsOfFile:path options:NSDataReadingMappedIfSafe error:error];
+
+		if (traceData == nil) {
+			return nil;
+		}
+
+		if ([self _readRecordsFromData:traceData] == NO) {
+			if (error) {
+				*error = [NSError errorWithDomain:NSCocoaErrorDomain code:NSFileReadCorruptFileError userInfo:nil];
+			}
+
+			return nil;
+		}
+
+		return self;
+	}
+
+	return nil;
+}
+
+- (BOOL)_readRecordsFromData:(NSData *)traceData
+{
+	const uint8_t *bytes = [traceData bytes];
+
+	NSUInteger length = [traceData length];
+
+	if (length < (OTRKitTrafficTraceMagicLength + 1) ||
+		memcmp(bytes, OTRKitTrafficTraceMagic, OTRKitTrafficTraceMagicLength) != 0 ||
+		bytes[OTRKitTrafficTraceMagicLength] != OTRKitTrafficTraceVersion)
+	{
+		return NO;
+	}
+
+	NSMutableArray *records = [NSMutableArray array];
+
+	NSUInteger conversationCount = 0;
+
+	uint64_t timestamp = 0;
+
+	NSUInteger offset = (OTRKitTrafficTraceMagicLength + 1);
+
+	while (offset < length) {
+		uint8_t type = bytes[offset];
+
+		offset += 1;
+
+		if (type < OTRKitTrafficRecordTypeEncode || type > OTRKitTrafficRecordTypeInject) {
+			return NO;
+		}
+
+		uint64_t timeDelta = 0;
+		uint64_t conversation = 0;
+		uint64_t messageLength = 0;
+		uint64_t tlvCount = 0;
+
+		if (OTRKitTrafficTraceReadNumber(bytes, length, &offset, &timeDelta) == NO ||
+			OTRKitTrafficTraceReadNumber(bytes, length, &offset, &conversation) == NO ||
+			offset >= length)
+		{
+			break;
+		}
+
+		uint8_t messageType = bytes[offset];
+
+		offset += 1;
+
+		if (OTRKitTrafficTraceReadNumber(bytes, length, &offset, &messageLength) == NO ||
+			OTRKitTrafficTraceReadNumber(bytes, length, &offset, &tlvCount) == NO)
+		{
+			break;
+		}
+
+		timestamp += timeDelta;
+
+		OTRKitTrafficRecord *record = [OTRKitTrafficRecord new];
+
+		record.type = type;
+		record.timestamp = timestamp;
+		record.conversation = (NSUInteger)conversation;
+		record.messageType = messageType;
+		record.length = (NSUInteger)messageLength;
+		record.tlvCount = (NSUInteger)tlvCount;
+
+		[records addObject:record];
+
+		conversationCount = MAX(conversationCount, (NSUInteger)conversation);
+	}
+
+	self.records = records;
+
+	self.conversationCount = conversationCount;
+
+	self.duration = timestamp;
+
+	return YES;
+}
+
+@end
@@ -0,0 +1,88 @@
+/* *********************************************************************
+
+        Copyright (c) 2010 - 2015 Codeux Software, LLC
+     Please see ACKNOWLEDGEMENT for additional information.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+
+ * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+ * Neither the name of "Codeux Software, LLC", nor the names of its 
+   contributors may be used to endorse or promote products derived 
+   from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ SUCH DAMAGE.
+
+ *********************************************************************** */
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ *  A snapshot of the work done by the writer that stores the fingerprints
+ *  file and its journal in the background. Obtained from -[OTRKit fingerprintsWriteStatistics]
+ *
+ *  When -[OTRKit storage] is set, each transaction counts as a write and
+ *  each change to a single fingerprint that it carries counts as a journal
+ *  record. Byte counts are not kept for a storage.
+ */
+@interface OTRKitWriteStatistics : NSObject
+/**
+ *  Number of times the fingerprints were changed and needed to be written.
+ */
+@property (readonly) NSUInteger requestedWriteCount;
+
+/**
+ *  Number of times the file was actually written. The difference between
+ *  this value and requestedWriteCount is the number of writes coalesced.
+ */
+@property (readonly) NSUInteger writeCount;
+
+/**
+ *  Number of writes that failed. The next change retries the write.
+ */
+@property (readonly) NSUInteger failedWriteCount;
+
+/**
+ *  Number of changes appended to the journal instead of
+ *  causing the whole file to be written.
+ */
+@property (readonly) NSUInteger journalRecordCount;
+@property (readonly) unsigned long long journalBytesWritten;
+@property (readonly) NSTimeInterval totalJournalWriteDuration;
+
+/**
+ *  Number of writes that compacted the journal after it grew too large.
+ */
+@property (readonly) NSUInteger compactionCount;
+
+@property (readonly) unsigned long long bytesWritten;
+
+/**
+ *  Time spent on the internal queue copying the fingerprints into memory.
+ */
+@property (readonly) NSTimeInterval totalSerializationDuration;
+
+/**
+ *  Time spent on the writer queue writing the file to disk.
+ */
+@property (readonly) NSTimeInterval totalWriteDuration;
+@property (readonly) NSTimeInterval maximumWriteDuration;
+@property (readonly) NSTimeInterval averageWriteDuration;
+@end
+
+NS_ASSUME_NONNULL_END